@@ -0,0 +1,432 @@
+// Copyright 2014 Intel Corporation All Rights Reserved
+//
+// Intel makes no representations about the suitability of this software for any purpose.
+// THIS SOFTWARE IS PROVIDED ""AS IS."" INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES,
+// EXPRESS OR IMPLIED, AND ALL LIABILITY, INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES,
+// FOR THE USE OF THIS SOFTWARE, INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY
+// RIGHTS, AND INCLUDING THE WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+// Intel does not assume any responsibility for any errors which may appear in this software
+// nor any responsibility to update it.
+
+#include "MappedDDSTexture.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_WIN32)
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <Windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+#include "GraphicsAccessories.hpp"
+#include "RefCntAutoPtr.hpp"
+#include "Errors.hpp"
+
+using namespace Diligent;
+
+namespace AsteroidsDE
+{
+
+namespace
+{
+
+// DDS file structures, see dds.h. They are redefined here with fixed-size types so that
+// the loader does not depend on Windows headers.
+constexpr Uint32 MakeFourCC(char c0, char c1, char c2, char c3)
+{
+    return Uint32{Uint8(c0)} | (Uint32{Uint8(c1)} << 8) | (Uint32{Uint8(c2)} << 16) | (Uint32{Uint8(c3)} << 24);
+}
+
+constexpr Uint32 DDS_MAGIC = MakeFourCC('D', 'D', 'S', ' ');
+
+constexpr Uint32 DDS_FOURCC      = 0x00000004;
+constexpr Uint32 DDS_RGB         = 0x00000040;
+constexpr Uint32 DDS_LUMINANCE   = 0x00020000;
+constexpr Uint32 DDS_ALPHAPIXELS = 0x00000001;
+
+constexpr Uint32 DDS_HEADER_FLAGS_VOLUME = 0x00800000;
+constexpr Uint32 DDS_CUBEMAP             = 0x00000200;
+constexpr Uint32 DDS_CUBEMAP_ALLFACES    = 0x0000FC00;
+
+constexpr Uint32 DDS_DIMENSION_TEXTURE2D       = 3;
+constexpr Uint32 DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+struct DDSPixelFormat
+{
+    Uint32 Size;
+    Uint32 Flags;
+    Uint32 FourCC;
+    Uint32 RGBBitCount;
+    Uint32 RBitMask;
+    Uint32 GBitMask;
+    Uint32 BBitMask;
+    Uint32 ABitMask;
+};
+
+struct DDSHeader
+{
+    Uint32         Size;
+    Uint32         Flags;
+    Uint32         Height;
+    Uint32         Width;
+    Uint32         PitchOrLinearSize;
+    Uint32         Depth;
+    Uint32         MipMapCount;
+    Uint32         Reserved1[11];
+    DDSPixelFormat PixelFormat;
+    Uint32         Caps;
+    Uint32         Caps2;
+    Uint32         Caps3;
+    Uint32         Caps4;
+    Uint32         Reserved2;
+};
+static_assert(sizeof(DDSHeader) == 124, "DDS header must be 124 bytes");
+
+struct DDSHeaderDX10
+{
+    Uint32 DXGIFormat;
+    Uint32 ResourceDimension;
+    Uint32 MiscFlag;
+    Uint32 ArraySize;
+    Uint32 MiscFlags2;
+};
+static_assert(sizeof(DDSHeaderDX10) == 20, "DX10 header must be 20 bytes");
+
+TEXTURE_FORMAT DXGIFormatToTexFormat(Uint32 DXGIFormat)
+{
+    // Values of the DXGI_FORMAT enumeration
+    switch (DXGIFormat)
+    {
+        // clang-format off
+        case  2: return TEX_FORMAT_RGBA32_FLOAT;
+        case 10: return TEX_FORMAT_RGBA16_FLOAT;
+        case 28: return TEX_FORMAT_RGBA8_UNORM;
+        case 29: return TEX_FORMAT_RGBA8_UNORM_SRGB;
+        case 49: return TEX_FORMAT_RG8_UNORM;
+        case 61: return TEX_FORMAT_R8_UNORM;
+        case 71: return TEX_FORMAT_BC1_UNORM;
+        case 72: return TEX_FORMAT_BC1_UNORM_SRGB;
+        case 74: return TEX_FORMAT_BC2_UNORM;
+        case 75: return TEX_FORMAT_BC2_UNORM_SRGB;
+        case 77: return TEX_FORMAT_BC3_UNORM;
+        case 78: return TEX_FORMAT_BC3_UNORM_SRGB;
+        case 80: return TEX_FORMAT_BC4_UNORM;
+        case 81: return TEX_FORMAT_BC4_SNORM;
+        case 83: return TEX_FORMAT_BC5_UNORM;
+        case 84: return TEX_FORMAT_BC5_SNORM;
+        case 87: return TEX_FORMAT_BGRA8_UNORM;
+        case 88: return TEX_FORMAT_BGRX8_UNORM;
+        case 91: return TEX_FORMAT_BGRA8_UNORM_SRGB;
+        case 93: return TEX_FORMAT_BGRX8_UNORM_SRGB;
+        case 95: return TEX_FORMAT_BC6H_UF16;
+        case 96: return TEX_FORMAT_BC6H_SF16;
+        case 98: return TEX_FORMAT_BC7_UNORM;
+        case 99: return TEX_FORMAT_BC7_UNORM_SRGB;
+        // clang-format on
+        default: return TEX_FORMAT_UNKNOWN;
+    }
+}
+
+TEXTURE_FORMAT PixelFormatToTexFormat(const DDSPixelFormat& pf)
+{
+    if (pf.Flags & DDS_FOURCC)
+    {
+        switch (pf.FourCC)
+        {
+            // clang-format off
+            case MakeFourCC('D', 'X', 'T', '1'): return TEX_FORMAT_BC1_UNORM;
+            case MakeFourCC('D', 'X', 'T', '2'):
+            case MakeFourCC('D', 'X', 'T', '3'): return TEX_FORMAT_BC2_UNORM;
+            case MakeFourCC('D', 'X', 'T', '4'):
+            case MakeFourCC('D', 'X', 'T', '5'): return TEX_FORMAT_BC3_UNORM;
+            case MakeFourCC('A', 'T', 'I', '1'):
+            case MakeFourCC('B', 'C', '4', 'U'): return TEX_FORMAT_BC4_UNORM;
+            case MakeFourCC('B', 'C', '4', 'S'): return TEX_FORMAT_BC4_SNORM;
+            case MakeFourCC('A', 'T', 'I', '2'):
+            case MakeFourCC('B', 'C', '5', 'U'): return TEX_FORMAT_BC5_UNORM;
+            case MakeFourCC('B', 'C', '5', 'S'): return TEX_FORMAT_BC5_SNORM;
+            // D3DFMT_A16B16G16R16F and D3DFMT_A32B32G32R32F
+            case 113: return TEX_FORMAT_RGBA16_FLOAT;
+            case 116: return TEX_FORMAT_RGBA32_FLOAT;
+            // clang-format on
+            default: return TEX_FORMAT_UNKNOWN;
+        }
+    }
+
+    if ((pf.Flags & DDS_RGB) && pf.RGBBitCount == 32)
+    {
+        if (pf.RBitMask == 0x000000ff && pf.GBitMask == 0x0000ff00 && pf.BBitMask == 0x00ff0000)
+            return TEX_FORMAT_RGBA8_UNORM;
+        if (pf.RBitMask == 0x00ff0000 && pf.GBitMask == 0x0000ff00 && pf.BBitMask == 0x000000ff)
+            return ((pf.Flags & DDS_ALPHAPIXELS) && pf.ABitMask == 0xff000000) ? TEX_FORMAT_BGRA8_UNORM : TEX_FORMAT_BGRX8_UNORM;
+        return TEX_FORMAT_UNKNOWN;
+    }
+
+    if ((pf.Flags & DDS_LUMINANCE) && pf.RGBBitCount == 8)
+        return TEX_FORMAT_R8_UNORM;
+
+    return TEX_FORMAT_UNKNOWN;
+}
+
+TEXTURE_FORMAT MakeSRGB(TEXTURE_FORMAT Format)
+{
+    switch (Format)
+    {
+        // clang-format off
+        case TEX_FORMAT_RGBA8_UNORM: return TEX_FORMAT_RGBA8_UNORM_SRGB;
+        case TEX_FORMAT_BGRA8_UNORM: return TEX_FORMAT_BGRA8_UNORM_SRGB;
+        case TEX_FORMAT_BGRX8_UNORM: return TEX_FORMAT_BGRX8_UNORM_SRGB;
+        case TEX_FORMAT_BC1_UNORM:   return TEX_FORMAT_BC1_UNORM_SRGB;
+        case TEX_FORMAT_BC2_UNORM:   return TEX_FORMAT_BC2_UNORM_SRGB;
+        case TEX_FORMAT_BC3_UNORM:   return TEX_FORMAT_BC3_UNORM_SRGB;
+        case TEX_FORMAT_BC7_UNORM:   return TEX_FORMAT_BC7_UNORM_SRGB;
+        // clang-format on
+        default: return Format;
+    }
+}
+
+} // namespace
+
+MappedDDSTexture::~MappedDDSTexture()
+{
+    UnmapFile();
+}
+
+bool MappedDDSTexture::MapFile(const char* FilePath)
+{
+#if defined(_WIN32)
+    HANDLE hFile = CreateFileA(FilePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER FileSize = {};
+    if (!GetFileSizeEx(hFile, &FileSize) || FileSize.QuadPart == 0)
+    {
+        CloseHandle(hFile);
+        return false;
+    }
+
+    HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    // The view keeps the mapping alive, so the handles are not needed once it is created
+    CloseHandle(hFile);
+    if (hMapping == nullptr)
+        return false;
+
+    m_pData = static_cast<const Uint8*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+    CloseHandle(hMapping);
+    if (m_pData == nullptr)
+        return false;
+
+    m_Size = static_cast<size_t>(FileSize.QuadPart);
+#else
+    int fd = open(FilePath, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat FileStat = {};
+    if (fstat(fd, &FileStat) != 0 || FileStat.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* pData = mmap(nullptr, static_cast<size_t>(FileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    if (pData == MAP_FAILED)
+        return false;
+
+    // Texel data is read once, front to back, when the texture is created
+    madvise(pData, static_cast<size_t>(FileStat.st_size), MADV_SEQUENTIAL);
+
+    m_pData = static_cast<const Uint8*>(pData);
+    m_Size  = static_cast<size_t>(FileStat.st_size);
+#endif
+    return true;
+}
+
+void MappedDDSTexture::UnmapFile()
+{
+    if (m_pData == nullptr)
+        return;
+
+#if defined(_WIN32)
+    UnmapViewOfFile(m_pData);
+#else
+    munmap(const_cast<Uint8*>(m_pData), m_Size);
+#endif
+    m_pData = nullptr;
+    m_Size  = 0;
+}
+
+bool MappedDDSTexture::Load(const char* FilePath, bool IsSRGB)
+{
+    UnmapFile();
+    m_SubResources.clear();
+    m_Desc = TextureDesc{};
+
+    if (!MapFile(FilePath))
+    {
+        LOG_ERROR_MESSAGE("Failed to map DDS file '", FilePath, "'");
+        return false;
+    }
+
+    if (!ParseHeaders(FilePath, IsSRGB))
+    {
+        UnmapFile();
+        m_SubResources.clear();
+        return false;
+    }
+
+    return true;
+}
+
+bool MappedDDSTexture::ParseHeaders(const char* FilePath, bool IsSRGB)
+{
+    // Headers are copied out of the mapping as the file offsets do not guarantee alignment
+    size_t DataOffset = sizeof(Uint32) + sizeof(DDSHeader);
+    if (m_Size < DataOffset)
+    {
+        LOG_ERROR_MESSAGE("'", FilePath, "' is too small to be a DDS file");
+        return false;
+    }
+
+    Uint32 Magic = 0;
+    std::memcpy(&Magic, m_pData, sizeof(Magic));
+    DDSHeader Header;
+    std::memcpy(&Header, m_pData + sizeof(Magic), sizeof(Header));
+    if (Magic != DDS_MAGIC || Header.Size != sizeof(DDSHeader) || Header.PixelFormat.Size != sizeof(DDSPixelFormat))
+    {
+        LOG_ERROR_MESSAGE("'", FilePath, "' is not a valid DDS file");
+        return false;
+    }
+
+    Uint32 ArraySize = 1;
+    bool   IsCubemap = false;
+    if ((Header.PixelFormat.Flags & DDS_FOURCC) && Header.PixelFormat.FourCC == MakeFourCC('D', 'X', '1', '0'))
+    {
+        if (m_Size < DataOffset + sizeof(DDSHeaderDX10))
+        {
+            LOG_ERROR_MESSAGE("'", FilePath, "' is truncated");
+            return false;
+        }
+
+        DDSHeaderDX10 HeaderDX10;
+        std::memcpy(&HeaderDX10, m_pData + DataOffset, sizeof(HeaderDX10));
+        DataOffset += sizeof(HeaderDX10);
+
+        if (HeaderDX10.ResourceDimension != DDS_DIMENSION_TEXTURE2D)
+        {
+            LOG_ERROR_MESSAGE("'", FilePath, "': only 2D textures are supported");
+            return false;
+        }
+        m_Desc.Format = DXGIFormatToTexFormat(HeaderDX10.DXGIFormat);
+        ArraySize     = HeaderDX10.ArraySize;
+        IsCubemap     = (HeaderDX10.MiscFlag & DDS_RESOURCE_MISC_TEXTURECUBE) != 0;
+        if (IsCubemap)
+            ArraySize *= 6;
+    }
+    else
+    {
+        if (Header.Flags & DDS_HEADER_FLAGS_VOLUME)
+        {
+            LOG_ERROR_MESSAGE("'", FilePath, "': volume textures are not supported");
+            return false;
+        }
+        if (Header.Caps2 & DDS_CUBEMAP)
+        {
+            // Partial cubemaps are not supported by the graphics APIs
+            if ((Header.Caps2 & DDS_CUBEMAP_ALLFACES) != DDS_CUBEMAP_ALLFACES)
+            {
+                LOG_ERROR_MESSAGE("'", FilePath, "': partial cubemaps are not supported");
+                return false;
+            }
+            IsCubemap = true;
+            ArraySize = 6;
+        }
+        m_Desc.Format = PixelFormatToTexFormat(Header.PixelFormat);
+    }
+
+    if (m_Desc.Format == TEX_FORMAT_UNKNOWN)
+    {
+        LOG_ERROR_MESSAGE("'", FilePath, "': unsupported pixel format");
+        return false;
+    }
+    if (IsSRGB)
+        m_Desc.Format = MakeSRGB(m_Desc.Format);
+
+    if (Header.Width == 0 || Header.Height == 0 || ArraySize == 0)
+    {
+        LOG_ERROR_MESSAGE("'", FilePath, "': invalid texture dimensions");
+        return false;
+    }
+
+    m_Desc.Type      = IsCubemap ? (ArraySize > 6 ? RESOURCE_DIM_TEX_CUBE_ARRAY : RESOURCE_DIM_TEX_CUBE) : (ArraySize > 1 ? RESOURCE_DIM_TEX_2D_ARRAY : RESOURCE_DIM_TEX_2D);
+    m_Desc.Width     = Header.Width;
+    m_Desc.Height    = Header.Height;
+    m_Desc.ArraySize = ArraySize;
+    m_Desc.MipLevels = std::max(Header.MipMapCount, Uint32{1});
+    m_Desc.Usage     = USAGE_IMMUTABLE;
+    m_Desc.BindFlags = BIND_SHADER_RESOURCE;
+
+    const Uint32 MaxMipLevels = ComputeMipLevelsCount(m_Desc.Width, m_Desc.Height);
+    if (m_Desc.MipLevels > MaxMipLevels)
+    {
+        LOG_ERROR_MESSAGE("'", FilePath, "': too many mip levels");
+        return false;
+    }
+
+    // DDS stores subresources in the same order as the engine expects them:
+    // all mip levels of slice 0, then all mip levels of slice 1, etc.
+    m_SubResources.resize(size_t{m_Desc.ArraySize} * m_Desc.MipLevels);
+    Uint64 Offset = DataOffset;
+    for (Uint32 Slice = 0; Slice < m_Desc.ArraySize; ++Slice)
+    {
+        for (Uint32 Mip = 0; Mip < m_Desc.MipLevels; ++Mip)
+        {
+            const auto MipProps = GetMipLevelProperties(m_Desc, Mip);
+            if (Offset + MipProps.MipSize > m_Size)
+            {
+                LOG_ERROR_MESSAGE("'", FilePath, "' is truncated");
+                return false;
+            }
+
+            auto& SubRes  = m_SubResources[size_t{Slice} * m_Desc.MipLevels + Mip];
+            SubRes.pData  = m_pData + Offset;
+            SubRes.Stride = static_cast<Uint32>(MipProps.RowSize);
+            Offset += MipProps.MipSize;
+        }
+    }
+
+    return true;
+}
+
+TextureData MappedDDSTexture::GetData()
+{
+    TextureData Data;
+    Data.pSubResources   = m_SubResources.data();
+    Data.NumSubresources = static_cast<Uint32>(m_SubResources.size());
+    return Data;
+}
+
+bool CreateTextureFromDDSFile(IRenderDevice* pDevice, const char* FilePath, const char* Name, bool IsSRGB, ITexture** ppTexture)
+{
+    MappedDDSTexture DDSTexture;
+    if (!DDSTexture.Load(FilePath, IsSRGB))
+        return false;
+
+    auto Desc = DDSTexture.GetDesc();
+    Desc.Name = Name;
+    auto Data = DDSTexture.GetData();
+    pDevice->CreateTexture(Desc, &Data, ppTexture);
+    return *ppTexture != nullptr;
+}
+
+} // namespace AsteroidsDE
@@ -0,0 +1,65 @@
+// Copyright 2014 Intel Corporation All Rights Reserved
+//
+// Intel makes no representations about the suitability of this software for any purpose.
+// THIS SOFTWARE IS PROVIDED ""AS IS."" INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES,
+// EXPRESS OR IMPLIED, AND ALL LIABILITY, INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES,
+// FOR THE USE OF THIS SOFTWARE, INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY
+// RIGHTS, AND INCLUDING THE WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+// Intel does not assume any responsibility for any errors which may appear in this software
+// nor any responsibility to update it.
+
+#pragma once
+
+#include <vector>
+
+#include "RenderDevice.h"
+#include "Texture.h"
+
+namespace AsteroidsDE
+{
+
+// Platform-independent DDS loader. Unlike LoadTextureDataFromFile(), the file is memory-mapped
+// rather than read into a heap buffer, and the subresource data points directly into the mapping.
+// Supports 2D textures, texture arrays and cubemaps in legacy and DX10 DDS formats, including
+// BC1-BC7.
+class MappedDDSTexture
+{
+public:
+    MappedDDSTexture() = default;
+    ~MappedDDSTexture();
+
+    // clang-format off
+    MappedDDSTexture           (const MappedDDSTexture&) = delete;
+    MappedDDSTexture& operator=(const MappedDDSTexture&) = delete;
+    // clang-format on
+
+    // Maps the file and validates its headers. If IsSRGB is true, UNORM color formats
+    // are replaced with their SRGB counterparts.
+    bool Load(const char* FilePath, bool IsSRGB);
+
+    const Diligent::TextureDesc& GetDesc() const { return m_Desc; }
+
+    // The data is only valid while this object is alive
+    Diligent::TextureData GetData();
+
+private:
+    bool MapFile(const char* FilePath);
+    void UnmapFile();
+    bool ParseHeaders(const char* FilePath, bool IsSRGB);
+
+    const Diligent::Uint8* m_pData = nullptr;
+    size_t                 m_Size  = 0;
+
+    Diligent::TextureDesc                    m_Desc;
+    std::vector<Diligent::TextureSubResData> m_SubResources;
+};
+
+// Creates an immutable shader resource texture from the DDS file. Returns false if the file
+// can't be mapped or is not a supported DDS file.
+bool CreateTextureFromDDSFile(Diligent::IRenderDevice* pDevice,
+                              const char*              FilePath,
+                              const char*              Name,
+                              bool                     IsSRGB,
+                              Diligent::ITexture**     ppTexture);
+
+} // namespace AsteroidsDE
@@ -44,11 +44,14 @@ AsteroidsDE::Asteroids*    gWorkloadDE = nullptr;
 bool gd3d11Available = false;
 bool gd3d12Available = false;
 bool gVulkanAvailable = false;
+bool gNativeModesAvailable = true;
 Settings::RenderMode gLastFrameRenderMode = static_cast<Settings::RenderMode>(-1);
 bool gUpdateWorkload = false;
 
 GUI gGUI;
 GUIText* gFPSControl;
+GUIText* gWorkerStatsControl;
+GUIText* gSRBCommitsControl;
 
 enum
 {
@@ -193,7 +196,7 @@ LRESULT CALLBACK WindowProc(
                 return 0;
             case 'B':
                 if (gSettings.mode == Settings::RenderMode::DiligentD3D12 || gSettings.mode == Settings::RenderMode::DiligentVulkan) {
-                    gSettings.resourceBindingMode = (gSettings.resourceBindingMode + 1) % 4;
+                    gSettings.resourceBindingMode = (gSettings.resourceBindingMode + 1) % 6;
                     gUpdateWorkload = true;
                 }
                 return 0;
@@ -209,8 +212,8 @@ LRESULT CALLBACK WindowProc(
                 gUpdateWorkload = true;
                 return 0;
 
-            case '1': gSettings.mode = gd3d11Available ? Settings::RenderMode::NativeD3D11 : gSettings.mode; return 0;
-            case '2': gSettings.mode = gd3d12Available ? Settings::RenderMode::NativeD3D12 : gSettings.mode; return 0;
+            case '1': gSettings.mode = gd3d11Available && gNativeModesAvailable ? Settings::RenderMode::NativeD3D11 : gSettings.mode; return 0;
+            case '2': gSettings.mode = gd3d12Available && gNativeModesAvailable ? Settings::RenderMode::NativeD3D12 : gSettings.mode; return 0;
             case '3': gSettings.mode = gd3d11Available ? Settings::RenderMode::DiligentD3D11 : gSettings.mode; return 0;
             case '4': gSettings.mode = gd3d12Available ? Settings::RenderMode::DiligentD3D12 : gSettings.mode; return 0;
             case '5': gSettings.mode = gVulkanAvailable ? Settings::RenderMode::DiligentVulkan : gSettings.mode; return 0;
@@ -415,6 +418,13 @@ int main(int argc, char** argv)
             gSettings.mode = gd3d12Available ? Settings::RenderMode::DiligentD3D12 : Settings::RenderMode::Undefined;
         } else if (_stricmp(argv[a], "-vk") == 0) {
             gSettings.mode = gVulkanAvailable ? Settings::RenderMode::DiligentVulkan : Settings::RenderMode::Undefined;
+        } else if (_stricmp(argv[a], "-asteroids") == 0 && a + 1 < argc) {
+            gSettings.numAsteroids = std::max(atoi(argv[++a]), 1);
+        } else if (_stricmp(argv[a], "-float_vertices") == 0) {
+            gSettings.quantizeVertices = false;
+        } else if (_stricmp(argv[a], "-verify_gpu_sim") == 0 && a + 1 < argc) {
+            gSettings.verifyGPUSimulationSteps = atoi(argv[++a]);
+            gSettings.resourceBindingMode = 5;
         } else {
             fprintf(stderr, "error: unrecognized argument '%s'\n", argv[a]);
             fprintf(stderr, "usage: asteroids_d3d12 [options]\n");
@@ -427,6 +437,9 @@ int main(int argc, char** argv)
             fprintf(stderr, "  -render_scale [scale]\n");
             fprintf(stderr, "  -locked_fps [fps]\n");
             fprintf(stderr, "  -warp\n");
+            fprintf(stderr, "  -asteroids [count]\n");
+            fprintf(stderr, "  -float_vertices\n");
+            fprintf(stderr, "  -verify_gpu_sim [steps]\n");
             return -1;
         }
     }
@@ -446,11 +459,16 @@ int main(int argc, char** argv)
 
     // Setup GUI
     gFPSControl = gGUI.AddText(150, 10);
+    gWorkerStatsControl = gGUI.AddText(10, 70);
+    gSRBCommitsControl = gGUI.AddText(10, 130);
 
     ResetCameraView();
     // Camera projection set up in WM_SIZE
 
-    AsteroidsSimulation asteroids(1337, NUM_ASTEROIDS, NUM_UNIQUE_MESHES, MESH_MAX_SUBDIV_LEVELS, NUM_UNIQUE_TEXTURES);
+    // Native modes use fixed-size arrays of NUM_ASTEROIDS elements
+    gNativeModesAvailable = gSettings.numAsteroids == NUM_ASTEROIDS;
+
+    AsteroidsSimulation asteroids(1337, gSettings.numAsteroids, NUM_UNIQUE_MESHES, MESH_MAX_SUBDIV_LEVELS, NUM_UNIQUE_TEXTURES);
 
     if (gSettings.mode == Settings::RenderMode::Undefined)
     {
@@ -492,6 +510,8 @@ int main(int argc, char** argv)
     float filteredUpdateTime = 0.0f;
     float filteredRenderTime = 0.0f;
     float filteredFrameTime = 0.0f;
+    std::vector<AsteroidsDE::Asteroids::WorkerPerfCounters> workerCounters;
+    std::vector<AsteroidsDE::Asteroids::WorkerPerfCounters> filteredWorkerCounters;
     for (;;)
     {
         MSG msg = {};
@@ -526,6 +546,22 @@ int main(int argc, char** argv)
             InitWorkload(hWnd, asteroids);
             gLastFrameRenderMode = gSettings.mode;
             gUpdateWorkload = false;
+
+            // Compare GPU-driven simulation against the CPU one and exit
+            if (gSettings.verifyGPUSimulationSteps > 0) {
+                bool passed = false;
+                if (gWorkloadDE != nullptr) {
+                    passed = gWorkloadDE->VerifyGPUSimulation(gSettings.verifyGPUSimulationSteps, 1.f / 60.f, gCamera, gSettings);
+                } else {
+                    fprintf(stderr, "error: GPU simulation verification requires Diligent D3D12 or Vulkan mode\n");
+                }
+                delete gWorkloadDE;
+                gWorkloadDE = nullptr;
+                SafeRelease(&gDXGIFactory);
+                timeEndPeriod(1);
+                EnableMouseInPointer(FALSE);
+                return passed ? 0 : 1;
+            }
         }
 
         // Still need to process inertia even when no interaction is happening
@@ -580,6 +616,8 @@ int main(int argc, char** argv)
                         case 1: resBindModeStr = "-mut";break;
                         case 2: resBindModeStr = "-tex_mut";break;
                         case 3: resBindModeStr = "-bindless";break;
+                        case 4: resBindModeStr = "-mdi";break;
+                        case 5: resBindModeStr = "-gpu";break;
                     }
                 break;
             }
@@ -601,6 +639,27 @@ int main(int argc, char** argv)
                 sprintf_s(buffer, "%.0f fps", 1.0f / filteredFrameTime);
             }
             gFPSControl->Text(buffer);
+
+            // Per-thread busy/idle time of the update and render phases (Diligent modes only)
+            bool showWorkerStats = gWorkloadDE != nullptr;
+            if (showWorkerStats) {
+                gWorkloadDE->GetWorkerPerfCounters(workerCounters);
+                filteredWorkerCounters.resize(workerCounters.size());
+                std::string workerStats = "busy/idle ms:";
+                for (size_t t = 0; t < workerCounters.size(); ++t) {
+                    auto& filtered = filteredWorkerCounters[t];
+                    filtered.BusyTime = filtered.BusyTime * (1.f - filterScale) + filterScale * workerCounters[t].BusyTime;
+                    filtered.IdleTime = filtered.IdleTime * (1.f - filterScale) + filterScale * workerCounters[t].IdleTime;
+                    sprintf_s(buffer, " %.1f/%.1f", 1000.f * filtered.BusyTime, 1000.f * filtered.IdleTime);
+                    workerStats += buffer;
+                }
+                gWorkerStatsControl->Text(workerStats);
+
+                sprintf_s(buffer, "SRB commits: %u", gWorkloadDE->GetNumSRBCommits());
+                gSRBCommitsControl->Text(buffer);
+            }
+            gWorkerStatsControl->Visible(showWorkerStats);
+            gSRBCommitsControl->Visible(showWorkerStats);
         }
 
         switch (gSettings.mode)
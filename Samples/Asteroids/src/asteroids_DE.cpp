@@ -39,13 +39,14 @@
 #endif
 
 #include "MapHelper.hpp"
+#include "ShaderMacroHelper.hpp"
 
 #include "util.h"
 #include "mesh.h"
 #include "noise.h"
 #include "texture.h"
 #include "StringTools.hpp"
-#include "TextureUtilities.h"
+#include "MappedDDSTexture.h"
 
 using namespace Diligent;
 
@@ -93,6 +94,38 @@ struct AsteroidData
     Uint32              mTextureIndex;
 };
 
+// Per-asteroid constants of the GPU simulation, see asteroid_sim_cs.csh
+struct AsteroidSimulationData
+{
+    DirectX::XMFLOAT3 mSpinAxis;
+    float             mSpinVelocity;
+    float             mOrbitVelocity;
+    float             mScale;
+    Uint32            mVertexStart;
+    Uint32            unused0;
+};
+
+struct SimulationConstantBuffer
+{
+    DirectX::XMFLOAT4X4 mViewProjection;
+    DirectX::XMFLOAT4   mCameraEye;
+
+    float  mFrameTime;
+    Uint32 mNumAsteroids;
+    Uint32 mMaxSubdiv;
+    Uint32 mAnimate;
+
+    float mMinSubdivSizeLog2;
+    float mMaxMeshRadius;
+    float unused0;
+    float unused1;
+
+    Uint32 mIndexOffsets[8];
+};
+static_assert(MESH_MAX_SUBDIV_LEVELS + 2 <= _countof(SimulationConstantBuffer::mIndexOffsets), "Not enough space for index offsets");
+
+static constexpr Uint32 SimulationThreadGroupSize = 64;
+
 struct SkyboxConstantBuffer
 {
     DirectX::XMFLOAT4X4 mViewProjection;
@@ -221,11 +254,27 @@ Asteroids::Asteroids(const Settings& settings, AsteroidsSimulation* asteroids, G
 
     InitDevice(hWnd, DevType);
 
-    m_BindingMode = static_cast<BindingMode>(settings.resourceBindingMode);
-    if (m_BindingMode == BindingMode::Bindless && !mDevice->GetDeviceInfo().Features.BindlessResources)
+    m_BindingMode      = static_cast<BindingMode>(settings.resourceBindingMode);
+    mQuantizedVertices = settings.quantizeVertices;
+    if (UseBindlessResources() && !mDevice->GetDeviceInfo().Features.BindlessResources)
         m_BindingMode = BindingMode::TextureMutable;
+    if (m_BindingMode == BindingMode::GPUDriven && !mDevice->GetDeviceInfo().Features.ComputeShaders)
+        m_BindingMode = BindingMode::MultiDrawIndirect;
+
+    mNumAsteroids = settings.numAsteroids;
+    mThreadPerfCounters.resize(mNumSubsets);
+    mMaxChunkSize = (mNumAsteroids + mNumSubsets - 1) / mNumSubsets;
+    {
+        const auto MinChunkSize = std::min(Uint32{MIN_CHUNK_SIZE}, mMaxChunkSize);
+        mUpdateChunkSize        = std::max(mMaxChunkSize / 4, MinChunkSize);
+        mRenderChunkSize        = mUpdateChunkSize;
+        // Every render chunk recorded by a worker thread produces its own command list
+        mCmdLists.resize((mNumAsteroids + MinChunkSize - 1) / MinChunkSize);
+    }
+    mSortedAsteroids.resize(mNumSubsets);
+    for (auto& SortedAsteroids : mSortedAsteroids)
+        SortedAsteroids.reserve(mMaxChunkSize);
 
-    mCmdLists.resize(mDeferredCtxt.size());
     mWorkerThreads.resize(mNumSubsets - 1);
     for (auto& thread : mWorkerThreads)
     {
@@ -249,24 +298,28 @@ Asteroids::Asteroids(const Settings& settings, AsteroidsSimulation* asteroids, G
     std::vector<StateTransitionDesc> Barriers;
     mBackBufferWidth                = mSwapChain->GetDesc().Width;
     mBackBufferHeight               = mSwapChain->GetDesc().Height;
-    const auto MaxAsteroidsInSubset = (NUM_ASTEROIDS + mNumSubsets - 1) / mNumSubsets;
+    // A single chunk never exceeds this size
+    const auto MaxAsteroidsInSubset = mMaxChunkSize;
 
     {
         BufferDesc desc;
         desc.Name = "Asteroids constant buffer";
         // In bindless mode we will be updating the buffer with UpdateBuffer method
-        desc.Usage          = (m_BindingMode == BindingMode::Bindless) ? USAGE_DEFAULT : USAGE_DYNAMIC;
+        desc.Usage          = UseBindlessResources() ? USAGE_DEFAULT : USAGE_DYNAMIC;
         desc.CPUAccessFlags = desc.Usage == USAGE_DYNAMIC ? CPU_ACCESS_WRITE : CPU_ACCESS_NONE;
         desc.BindFlags      = BIND_UNIFORM_BUFFER;
         // In bindless mode, we will only write view-projection matrix
-        desc.Size = static_cast<Uint32>((m_BindingMode == BindingMode::Bindless) ? sizeof(DirectX::XMFLOAT4X4) : sizeof(DrawConstantBuffer));
+        desc.Size = static_cast<Uint32>(UseBindlessResources() ? sizeof(DirectX::XMFLOAT4X4) : sizeof(DrawConstantBuffer));
         mDevice->CreateBuffer(desc, nullptr, &mDrawConstantBuffer);
-        if (m_BindingMode != BindingMode::Bindless)
+        if (!UseBindlessResources())
             Barriers.emplace_back(mDrawConstantBuffer, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_CONSTANT_BUFFER, STATE_TRANSITION_FLAG_UPDATE_STATE);
     }
 
-    if (m_BindingMode == BindingMode::Bindless)
+    if (UseBindlessResources())
     {
+        // In multi-draw-indirect and GPU-driven modes, the entire belt is drawn at once, so asteroids
+        // are indexed globally rather than within a chunk
+        const Uint32 NumIds = DrawEntireBelt() ? mNumAsteroids : MaxAsteroidsInSubset;
         {
             // In Direct3D there is no easy way to pass draw call number into the shader,
             // so we will use this auxiliary buffer that solely contains integers in ascending order
@@ -275,8 +328,8 @@ Asteroids::Asteroids(const Settings& settings, AsteroidsSimulation* asteroids, G
             desc.Name      = "Instance ID buffer";
             desc.Usage     = USAGE_IMMUTABLE;
             desc.BindFlags = BIND_VERTEX_BUFFER;
-            desc.Size      = static_cast<Uint64>(sizeof(Uint32)) * MaxAsteroidsInSubset;
-            std::vector<Uint32> Ids(MaxAsteroidsInSubset);
+            desc.Size      = static_cast<Uint64>(sizeof(Uint32)) * NumIds;
+            std::vector<Uint32> Ids(NumIds);
             for (Uint32 i = 0; i < Ids.size(); ++i)
                 Ids[i] = i;
             BufferData Data{Ids.data(), desc.Size};
@@ -286,7 +339,9 @@ Asteroids::Asteroids(const Settings& settings, AsteroidsSimulation* asteroids, G
 
         {
             // Structured buffer that contains asteroid data. Every thread needs to use
-            // its own buffer.
+            // its own buffer. In multi-draw-indirect mode, a single buffer holds the data
+            // for the entire belt and is mapped by the main thread. In GPU-driven mode,
+            // the buffer holds the simulation state and is only updated by the GPU.
             BufferDesc desc;
             desc.Name              = "Asteroids data buffer";
             desc.Usage             = USAGE_DYNAMIC;
@@ -294,15 +349,41 @@ Asteroids::Asteroids(const Settings& settings, AsteroidsSimulation* asteroids, G
             desc.Mode              = BUFFER_MODE_STRUCTURED;
             desc.CPUAccessFlags    = CPU_ACCESS_WRITE;
             desc.ElementByteStride = static_cast<Uint32>(sizeof(AsteroidData));
-            desc.Size              = desc.ElementByteStride * MaxAsteroidsInSubset;
-            mAsteroidsDataBuffers.resize(mNumSubsets);
-            for (Uint32 i = 0; i < mNumSubsets; ++i)
+            desc.Size              = desc.ElementByteStride * NumIds;
+            if (m_BindingMode == BindingMode::GPUDriven)
+            {
+                desc.Usage          = USAGE_DEFAULT;
+                desc.BindFlags      = BIND_SHADER_RESOURCE | BIND_UNORDERED_ACCESS;
+                desc.CPUAccessFlags = CPU_ACCESS_NONE;
+            }
+            mAsteroidsDataBuffers.resize(DrawEntireBelt() ? 1 : mNumSubsets);
+            for (auto& buffer : mAsteroidsDataBuffers)
             {
-                mDevice->CreateBuffer(desc, nullptr, &mAsteroidsDataBuffers[i]);
+                mDevice->CreateBuffer(desc, nullptr, &buffer);
             }
         }
     }
 
+    if (m_BindingMode == BindingMode::MultiDrawIndirect)
+    {
+        BufferDesc desc;
+        desc.Name = "Asteroids draw args buffer";
+        // Draw commands are written by the threads directly into the mapped buffer
+        desc.Usage             = USAGE_DYNAMIC;
+        desc.BindFlags         = BIND_INDIRECT_DRAW_ARGS;
+        desc.CPUAccessFlags    = CPU_ACCESS_WRITE;
+        desc.ElementByteStride = static_cast<Uint32>(sizeof(IndexedIndirectDrawArgs));
+        desc.Size              = desc.ElementByteStride * mNumAsteroids;
+        mDevice->CreateBuffer(desc, nullptr, &mDrawArgsBuffer);
+    }
+    else if (m_BindingMode == BindingMode::GPUDriven)
+    {
+        CreateGPUSimulationResources(pShaderSourceFactory);
+    }
+
+    // Vertex buffer needs to be created first as it defines the position scale in quantized mode
+    CreateMeshes();
+
     // create pipeline state
     {
         GraphicsPipelineStateCreateInfo PSOCreateInfo;
@@ -316,11 +397,18 @@ Asteroids::Asteroids(const Settings& settings, AsteroidsSimulation* asteroids, G
             LayoutElement{1, 0, 3, VT_FLOAT32},
             LayoutElement{2, 1, 1, VT_UINT32, False, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE}
         };
+        // 16-bit SNORM position and octahedral normal
+        LayoutElement quantizedInputDesc[] =
+        {
+            LayoutElement{0, 0, 4, VT_INT16, True, 0, sizeof(PackedVertex)},
+            LayoutElement{1, 0, 2, VT_INT16, True},
+            LayoutElement{2, 1, 1, VT_UINT32, False, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE}
+        };
         // clang-format on
 
-        GraphicsPipeline.InputLayout.LayoutElements = inputDesc;
+        GraphicsPipeline.InputLayout.LayoutElements = mQuantizedVertices ? quantizedInputDesc : inputDesc;
         // In bindless mode we will use instance ID buffer as the third input
-        GraphicsPipeline.InputLayout.NumElements = (m_BindingMode == BindingMode::Bindless) ? 3 : 2;
+        GraphicsPipeline.InputLayout.NumElements = UseBindlessResources() ? 3 : 2;
 
         GraphicsPipeline.DepthStencilDesc.DepthFunc = COMPARISON_FUNC_GREATER_EQUAL;
 
@@ -333,11 +421,15 @@ Asteroids::Asteroids(const Settings& settings, AsteroidsSimulation* asteroids, G
             attribs.SourceLanguage             = SHADER_SOURCE_LANGUAGE_HLSL;
             attribs.pShaderSourceStreamFactory = pShaderSourceFactory;
 
-            ShaderMacro Macros[] = {{"BINDLESS", "1"}};
-            if (m_BindingMode == BindingMode::Bindless)
+            ShaderMacroHelper Macros;
+            if (UseBindlessResources())
+                Macros.AddShaderMacro("BINDLESS", 1);
+            if (mQuantizedVertices)
             {
-                attribs.Macros = {Macros, _countof(Macros)};
+                Macros.AddShaderMacro("QUANTIZED_VERTICES", 1);
+                Macros.AddShaderMacro("POSITION_SCALE", mPositionScale);
             }
+            attribs.Macros = Macros;
 
             mDevice->CreateShader(attribs, &vs);
         }
@@ -351,7 +443,7 @@ Asteroids::Asteroids(const Settings& settings, AsteroidsSimulation* asteroids, G
             attribs.SourceLanguage             = SHADER_SOURCE_LANGUAGE_HLSL;
 
             ShaderMacro Macros[] = {{"BINDLESS", "1"}};
-            if (m_BindingMode == BindingMode::Bindless)
+            if (UseBindlessResources())
             {
                 attribs.Macros = {Macros, _countof(Macros)};
             }
@@ -380,7 +472,7 @@ Asteroids::Asteroids(const Settings& settings, AsteroidsSimulation* asteroids, G
         std::vector<ShaderResourceVariableDesc> Variables =
             {
                 {SHADER_TYPE_PIXEL, "Tex", m_BindingMode == BindingMode::Dynamic ? SHADER_RESOURCE_VARIABLE_TYPE_DYNAMIC : SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}};
-        if (m_BindingMode == BindingMode::Bindless)
+        if (UseBindlessResources())
             Variables.emplace_back(SHADER_TYPE_VERTEX, "g_Data", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE);
 
         PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_STATIC;
@@ -409,7 +501,7 @@ Asteroids::Asteroids(const Settings& settings, AsteroidsSimulation* asteroids, G
         {
             // Create one SRB per asteroid in mutable binding mode
             PSODesc.SRBAllocationGranularity = 1024;
-            NumSRBs                          = NUM_ASTEROIDS;
+            NumSRBs                          = mNumAsteroids;
         }
         else if (m_BindingMode == BindingMode::TextureMutable)
         {
@@ -422,6 +514,11 @@ Asteroids::Asteroids(const Settings& settings, AsteroidsSimulation* asteroids, G
             // Create one SRB per subset for bindless mode
             NumSRBs = mNumSubsets;
         }
+        else if (DrawEntireBelt())
+        {
+            // The entire belt is drawn with a single SRB in multi-draw-indirect and GPU-driven modes
+            NumSRBs = 1;
+        }
         mAsteroidsSRBs.resize(NumSRBs);
         for (size_t srb = 0; srb < mAsteroidsSRBs.size(); ++srb)
         {
@@ -432,11 +529,9 @@ Asteroids::Asteroids(const Settings& settings, AsteroidsSimulation* asteroids, G
 
     // Load textures
     {
-        TextureLoadInfo loadInfo;
-        loadInfo.IsSRGB = true;
-        loadInfo.Name   = "Skybox";
         RefCntAutoPtr<ITexture> skybox;
-        CreateTextureFromFile("media/starbox_1024.dds", loadInfo, mDevice, &skybox);
+        if (!CreateTextureFromDDSFile(mDevice, "media/starbox_1024.dds", "Skybox", true, &skybox))
+            LOG_ERROR_AND_THROW("Failed to load skybox texture");
         mSkyboxSRV = skybox->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
         Barriers.emplace_back(skybox, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_SHADER_RESOURCE, STATE_TRANSITION_FLAG_UPDATE_STATE);
     }
@@ -612,12 +707,11 @@ Asteroids::Asteroids(const Settings& settings, AsteroidsSimulation* asteroids, G
     }
 
 
-    CreateMeshes();
     InitializeTextureData();
     if (m_BindingMode == BindingMode::Mutable)
     {
         // Bind the corresponding texture to the asteroids's SRB
-        for (size_t srb = 0; srb < NUM_ASTEROIDS; ++srb)
+        for (size_t srb = 0; srb < mNumAsteroids; ++srb)
         {
             auto staticData = &mAsteroids->StaticData()[srb];
             mAsteroidsSRBs[srb]->GetVariableByName(SHADER_TYPE_PIXEL, "Tex")->Set(mTextureSRVs[staticData->textureIndex]);
@@ -631,13 +725,13 @@ Asteroids::Asteroids(const Settings& settings, AsteroidsSimulation* asteroids, G
             mAsteroidsSRBs[srb]->GetVariableByName(SHADER_TYPE_PIXEL, "Tex")->Set(mTextureSRVs[srb]);
         }
     }
-    else if (m_BindingMode == BindingMode::Bindless)
+    else if (UseBindlessResources())
     {
         // Bind all textures to every subset's SRB. The textures will be dynamically indexed in the shader.
         IDeviceObject* SRVArray[NUM_UNIQUE_TEXTURES];
         for (Uint32 t = 0; t < NUM_UNIQUE_TEXTURES; ++t)
             SRVArray[t] = mTextureSRVs[t];
-        for (Uint32 i = 0; i < mNumSubsets; ++i)
+        for (size_t i = 0; i < mAsteroidsSRBs.size(); ++i)
         {
             mAsteroidsSRBs[i]->GetVariableByName(SHADER_TYPE_PIXEL, "Tex")->SetArray(SRVArray, 0, NUM_UNIQUE_TEXTURES);
             mAsteroidsSRBs[i]->GetVariableByName(SHADER_TYPE_VERTEX, "g_Data")->Set(mAsteroidsDataBuffers[i]->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
@@ -685,6 +779,15 @@ void Asteroids::CreateMeshes()
         data.pData    = asteroidMeshes->vertices.data();
         data.DataSize = desc.Size;
 
+        std::vector<PackedVertex> packedVertices;
+        if (mQuantizedVertices)
+        {
+            mPositionScale = QuantizeVertices(asteroidMeshes->vertices, &packedVertices);
+            desc.Size      = (Uint32)packedVertices.size() * sizeof(packedVertices[0]);
+            data.pData     = packedVertices.data();
+            data.DataSize  = desc.Size;
+        }
+
         mDevice->CreateBuffer(desc, &data, &mVertexBuffer);
         Barriers.emplace_back(mVertexBuffer, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_VERTEX_BUFFER, STATE_TRANSITION_FLAG_UPDATE_STATE);
     }
@@ -806,12 +909,9 @@ void Asteroids::CreateGUIResources()
         auto path    = control->TextureFile();
         if (path.length() > 0 && mSpriteTextures.find(path) == mSpriteTextures.end())
         {
-
-            TextureLoadInfo loadInfo;
-            loadInfo.IsSRGB = true;
-            loadInfo.Name   = "Sprite texture";
             RefCntAutoPtr<ITexture> spriteTexture;
-            CreateTextureFromFile(path.c_str(), loadInfo, mDevice, &spriteTexture);
+            if (!CreateTextureFromDDSFile(mDevice, path.c_str(), "Sprite texture", true, &spriteTexture))
+                LOG_ERROR_AND_THROW("Failed to load sprite texture '", path, "'");
             auto* pSRV = spriteTexture->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
             pSRV->SetSampler(mSamplerState);
             mSpriteTextures[control->TextureFile()] = pSRV;
@@ -830,11 +930,7 @@ void Asteroids::WorkerThreadFunc(Asteroids* pThis, Uint32 ThreadNum)
         if (SignalledValue < 0)
             return;
 
-        auto  SubsetSize   = NUM_ASTEROIDS / pThis->mNumSubsets;
-        auto  SubsetStart  = SubsetSize * (ThreadNum + 1);
-        auto& FrameAttribs = pThis->mFrameAttribs;
-
-        pThis->mAsteroids->Update(FrameAttribs.frameTime, FrameAttribs.camera->Eye(), *FrameAttribs.settings, SubsetStart, SubsetSize);
+        pThis->UpdateChunks(1 + ThreadNum);
 
         // Increment number of completed threads
         ++pThis->m_NumThreadsCompleted;
@@ -843,17 +939,94 @@ void Asteroids::WorkerThreadFunc(Asteroids* pThis, Uint32 ThreadNum)
         // Wait for RenderSubsets signal
         pThis->mRenderSubsetsSignal.Wait();
 
-        pThis->RenderSubset(1 + ThreadNum, pThis->mDeferredCtxt[ThreadNum], *FrameAttribs.camera, SubsetStart, SubsetSize);
-
-        RefCntAutoPtr<ICommandList> pCmdList;
-        pThis->mCmdLists[ThreadNum].Release();
-        pThis->mDeferredCtxt[ThreadNum]->FinishCommandList(&pThis->mCmdLists[ThreadNum]);
+        pThis->RenderChunks(1 + ThreadNum, pThis->mDeferredCtxt[ThreadNum]);
 
         // Increment number of completed threads
         ++pThis->m_NumThreadsCompleted;
     }
 }
 
+void Asteroids::UpdateChunks(Uint32 ThreadId)
+{
+    const auto& FrameAttribs = mFrameAttribs;
+    const auto  ChunkSize    = mUpdateChunkSize;
+
+    LONG64 StartCounter, EndCounter;
+    QueryPerformanceCounter((LARGE_INTEGER*)&StartCounter);
+    for (;;)
+    {
+        const Uint32 Start = mUpdateCursor.fetch_add(ChunkSize);
+        if (Start >= mNumAsteroids)
+            break;
+        const Uint32 Count = std::min(ChunkSize, mNumAsteroids - Start);
+        mAsteroids->Update(FrameAttribs.frameTime, FrameAttribs.camera->Eye(), *FrameAttribs.settings, Start, Count);
+    }
+    QueryPerformanceCounter((LARGE_INTEGER*)&EndCounter);
+    mThreadPerfCounters[ThreadId].UpdateBusyTicks = EndCounter - StartCounter;
+}
+
+void Asteroids::RenderChunks(Uint32 ThreadId, IDeviceContext* pCtx)
+{
+    const auto& FrameAttribs = mFrameAttribs;
+    const auto  ChunkSize    = mRenderChunkSize;
+    const bool  IsDeferred   = pCtx->GetDesc().IsDeferred;
+
+    LONG64 StartCounter, EndCounter;
+    QueryPerformanceCounter((LARGE_INTEGER*)&StartCounter);
+    for (;;)
+    {
+        const Uint32 Start = mRenderCursor.fetch_add(ChunkSize);
+        if (Start >= mNumAsteroids)
+            break;
+        const Uint32 Count = std::min(ChunkSize, mNumAsteroids - Start);
+        if (m_BindingMode == BindingMode::MultiDrawIndirect)
+        {
+            // Threads only write draw commands and instance data. The entire belt
+            // is drawn by the main thread.
+            WriteIndirectDrawCommands(Start, Count);
+            continue;
+        }
+
+        RenderSubset(ThreadId, pCtx, *FrameAttribs.camera, Start, Count);
+
+        // Chunks recorded by the main thread go directly to the immediate context.
+        // Command lists from deferred contexts are stored by chunk index, so that they are
+        // submitted in the same order every frame regardless of which thread recorded them.
+        if (IsDeferred)
+            pCtx->FinishCommandList(&mCmdLists[Start / ChunkSize]);
+    }
+    QueryPerformanceCounter((LARGE_INTEGER*)&EndCounter);
+    mThreadPerfCounters[ThreadId].RenderBusyTicks = EndCounter - StartCounter;
+}
+
+void Asteroids::AdjustChunkSizes(LONG64 UpdateBusyTicks, LONG64 RenderBusyTicks)
+{
+    // Exponentially smooth the per-asteroid cost measured in the last frame to avoid
+    // reacting to occasional spikes
+    constexpr float Alpha = 0.1f;
+    if (mUpdateTicksPerAsteroid == 0)
+    {
+        mUpdateTicksPerAsteroid = static_cast<float>(UpdateBusyTicks) / mNumAsteroids;
+        mRenderTicksPerAsteroid = static_cast<float>(RenderBusyTicks) / mNumAsteroids;
+    }
+    else
+    {
+        mUpdateTicksPerAsteroid += Alpha * (static_cast<float>(UpdateBusyTicks) / mNumAsteroids - mUpdateTicksPerAsteroid);
+        mRenderTicksPerAsteroid += Alpha * (static_cast<float>(RenderBusyTicks) / mNumAsteroids - mRenderTicksPerAsteroid);
+    }
+
+    const auto MinChunkSize     = std::min(Uint32{MIN_CHUNK_SIZE}, mMaxChunkSize);
+    const auto ComputeChunkSize = [&](float TicksPerAsteroid, Uint32 TargetTimeUS) {
+        if (TicksPerAsteroid <= 0)
+            return mMaxChunkSize;
+        const auto TargetTicks = static_cast<float>(mPerfCounterFreq) * static_cast<float>(TargetTimeUS) * 1e-6f;
+        const auto ChunkSize   = static_cast<Uint32>(std::min(TargetTicks / TicksPerAsteroid, static_cast<float>(mMaxChunkSize)));
+        return std::max(ChunkSize, MinChunkSize);
+    };
+    mUpdateChunkSize = ComputeChunkSize(mUpdateTicksPerAsteroid, UPDATE_CHUNK_TARGET_TIME_US);
+    mRenderChunkSize = ComputeChunkSize(mRenderTicksPerAsteroid, RENDER_CHUNK_TARGET_TIME_US);
+}
+
 void Asteroids::RenderSubset(Uint32             SubsetNum,
                              IDeviceContext*    pCtx,
                              const OrbitCamera& camera,
@@ -903,16 +1076,37 @@ void Asteroids::RenderSubset(Uint32             SubsetNum,
 
         // Commit and verify resources
         pCtx->CommitShaderResources(mAsteroidsSRBs[SubsetNum], RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+        ++mThreadPerfCounters[SubsetNum].NumSRBCommits;
+
+        // No need to update the constant buffer or commit resources per draw in bindless mode
+        for (UINT drawIdx = startIdx; drawIdx < startIdx + numAsteroids; ++drawIdx)
+        {
+            const auto staticData  = &staticAsteroidData[drawIdx];
+            const auto dynamicData = &dynamicAsteroidData[drawIdx];
+
+            DrawIndexedAttribs attribs(dynamicData->indexCount, VT_UINT16, DRAW_FLAG_VERIFY_ALL);
+            attribs.FirstIndexLocation = dynamicData->indexStart;
+            attribs.BaseVertex         = staticData->vertexStart;
+            // It is very important to specify this flag to make sure the engine does not do extra
+            // work processing buffers that stay intact.
+            attribs.Flags |= DRAW_FLAG_DYNAMIC_RESOURCE_BUFFERS_INTACT;
+            attribs.FirstInstanceLocation = drawIdx - startIdx;
+
+            pCtx->DrawIndexed(attribs);
+        }
+        return;
     }
 
-    const auto& viewProjection = camera.ViewProjection();
-    auto        pVar           = m_BindingMode == BindingMode::Dynamic ? mAsteroidsSRBs[SubsetNum]->GetVariableByName(SHADER_TYPE_PIXEL, "Tex") : nullptr;
-    for (UINT drawIdx = startIdx; drawIdx < startIdx + numAsteroids; ++drawIdx)
+    SortChunk(SubsetNum, startIdx, numAsteroids);
+
+    const auto& viewProjection  = camera.ViewProjection();
+    auto        pVar            = m_BindingMode == BindingMode::Dynamic ? mAsteroidsSRBs[SubsetNum]->GetVariableByName(SHADER_TYPE_PIXEL, "Tex") : nullptr;
+    auto        CommittedTexIdx = ~0u;
+    for (auto drawIdx : mSortedAsteroids[SubsetNum])
     {
         const auto staticData  = &staticAsteroidData[drawIdx];
         const auto dynamicData = &dynamicAsteroidData[drawIdx];
 
-        if (m_BindingMode != BindingMode::Bindless)
         {
             MapHelper<DrawConstantBuffer> drawConstants(pCtx, mDrawConstantBuffer, MAP_WRITE, MAP_FLAG_DISCARD);
             XMStoreFloat4x4(&drawConstants->mWorld, dynamicData->world);
@@ -920,77 +1114,362 @@ void Asteroids::RenderSubset(Uint32             SubsetNum,
             drawConstants->mSurfaceColor = staticData->surfaceColor;
             drawConstants->mDeepColor    = staticData->deepColor;
         }
-        // No need to update the buffer in bindless mode
 
-        if (m_BindingMode == BindingMode::Dynamic)
-        {
-            pVar->Set(mTextureSRVs[staticData->textureIndex]);
-            pCtx->CommitShaderResources(mAsteroidsSRBs[SubsetNum], RESOURCE_STATE_TRANSITION_MODE_VERIFY);
-        }
-        else if (m_BindingMode == BindingMode::Mutable)
-        {
-            pCtx->CommitShaderResources(mAsteroidsSRBs[drawIdx], RESOURCE_STATE_TRANSITION_MODE_VERIFY);
-        }
-        else if (m_BindingMode == BindingMode::TextureMutable)
+        // Asteroids are sorted by texture, so resources only need to be committed
+        // when the texture changes
+        if (staticData->textureIndex != CommittedTexIdx)
         {
-            pCtx->CommitShaderResources(mAsteroidsSRBs[staticData->textureIndex], RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+            if (m_BindingMode == BindingMode::Dynamic)
+            {
+                pVar->Set(mTextureSRVs[staticData->textureIndex]);
+                pCtx->CommitShaderResources(mAsteroidsSRBs[SubsetNum], RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+            }
+            else if (m_BindingMode == BindingMode::Mutable)
+            {
+                // All asteroids in the bucket reference the same texture, so the SRB of the first
+                // one can be used for the entire bucket
+                pCtx->CommitShaderResources(mAsteroidsSRBs[drawIdx], RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+            }
+            else if (m_BindingMode == BindingMode::TextureMutable)
+            {
+                pCtx->CommitShaderResources(mAsteroidsSRBs[staticData->textureIndex], RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+            }
+            CommittedTexIdx = staticData->textureIndex;
+            ++mThreadPerfCounters[SubsetNum].NumSRBCommits;
         }
 
         DrawIndexedAttribs attribs(dynamicData->indexCount, VT_UINT16, DRAW_FLAG_VERIFY_ALL);
         attribs.FirstIndexLocation = dynamicData->indexStart;
         attribs.BaseVertex         = staticData->vertexStart;
+        pCtx->DrawIndexed(attribs);
+    }
+}
+
+void Asteroids::WriteIndirectDrawCommands(Uint32 startIdx, Uint32 numAsteroids)
+{
+    auto staticAsteroidData  = mAsteroids->StaticData();
+    auto dynamicAsteroidData = mAsteroids->DynamicData();
+
+    for (UINT drawIdx = startIdx; drawIdx < startIdx + numAsteroids; ++drawIdx)
+    {
+        const auto staticData  = &staticAsteroidData[drawIdx];
+        const auto dynamicData = &dynamicAsteroidData[drawIdx];
+
+        auto& asteroidData = mMappedAsteroidData[drawIdx];
+        XMStoreFloat4x4(&asteroidData.mWorld, dynamicData->world);
+        asteroidData.mSurfaceColor = staticData->surfaceColor;
+        asteroidData.mDeepColor    = staticData->deepColor;
+        asteroidData.mTextureIndex = staticData->textureIndex;
+
+        auto& drawArgs                 = mMappedDrawArgs[drawIdx];
+        drawArgs.NumIndices            = dynamicData->indexCount;
+        drawArgs.NumInstances          = 1;
+        drawArgs.FirstIndexLocation    = dynamicData->indexStart;
+        drawArgs.BaseVertex            = staticData->vertexStart;
+        drawArgs.FirstInstanceLocation = drawIdx;
+    }
+}
+
+void Asteroids::DrawAsteroidsIndirect()
+{
+    StateTransitionDesc Barriers[] = {
+        {mDrawArgsBuffer, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_INDIRECT_ARGUMENT, STATE_TRANSITION_FLAG_UPDATE_STATE},
+        {mAsteroidsDataBuffers[0], RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_SHADER_RESOURCE, STATE_TRANSITION_FLAG_UPDATE_STATE},
+        {mDrawArgsCounterBuffer, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_INDIRECT_ARGUMENT, STATE_TRANSITION_FLAG_UPDATE_STATE},
+    };
+    mDeviceCtxt->TransitionResourceStates(mDrawArgsCounterBuffer ? 3 : 2, Barriers);
+
+    auto* pRTV = mSwapChain->GetCurrentBackBufferRTV();
+    auto* pDSV = mSwapChain->GetDepthBufferDSV();
+    mDeviceCtxt->SetRenderTargets(1, &pRTV, pDSV, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+    mDeviceCtxt->SetPipelineState(mAsteroidsPSO);
+
+    IBuffer* ia_buffers[] = {mVertexBuffer, mInstanceIDBuffer};
+    mDeviceCtxt->SetVertexBuffers(0, _countof(ia_buffers), ia_buffers, nullptr, RESOURCE_STATE_TRANSITION_MODE_VERIFY, SET_VERTEX_BUFFERS_FLAG_NONE);
+    mDeviceCtxt->SetIndexBuffer(mIndexBuffer, 0, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+    mDeviceCtxt->CommitShaderResources(mAsteroidsSRBs[0], RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+    ++mThreadPerfCounters[0].NumSRBCommits;
+
+    DrawIndexedIndirectAttribs drawAttribs;
+    drawAttribs.IndexType                        = VT_UINT16;
+    drawAttribs.pAttribsBuffer                   = mDrawArgsBuffer;
+    drawAttribs.DrawArgsStride                   = sizeof(IndexedIndirectDrawArgs);
+    drawAttribs.AttribsBufferStateTransitionMode = RESOURCE_STATE_TRANSITION_MODE_VERIFY;
+    drawAttribs.Flags                            = DRAW_FLAG_VERIFY_ALL;
+    if (mDrawArgsCounterBuffer)
+    {
+        // The number of draws is written by the simulation shader
+        drawAttribs.DrawCount                        = mNumAsteroids;
+        drawAttribs.pCounterBuffer                   = mDrawArgsCounterBuffer;
+        drawAttribs.CounterBufferStateTransitionMode = RESOURCE_STATE_TRANSITION_MODE_VERIFY;
+        mDeviceCtxt->DrawIndexedIndirect(drawAttribs);
+    }
+    else
+    {
+        // Without native multi-draw-indirect support, the engine emulates the call by issuing
+        // a separate draw for every command
+        drawAttribs.DrawCount = mNumAsteroids;
+        mDeviceCtxt->DrawIndexedIndirect(drawAttribs);
+    }
+}
+
+void Asteroids::CreateGPUSimulationResources(IShaderSourceInputStreamFactory* pShaderSourceFactory)
+{
+    const auto& Features = mDevice->GetDeviceInfo().Features;
+    // Compact the draw commands of visible asteroids if the GPU can take the draw count from a buffer
+    const bool AppendDrawArgs = Features.NativeMultiDrawIndirect && Features.DrawIndirectCounterBuffer;
 
-        if (m_BindingMode == BindingMode::Bindless)
+    {
+        std::vector<AsteroidSimulationData> SimData(mNumAsteroids);
+        auto                                staticAsteroidData = mAsteroids->StaticData();
+        for (Uint32 i = 0; i < mNumAsteroids; ++i)
         {
-            // It is very important to specify this flag to make sure the engine does not do extra
-            // work processing buffers that stay intact.
-            attribs.Flags |= DRAW_FLAG_DYNAMIC_RESOURCE_BUFFERS_INTACT;
-            attribs.FirstInstanceLocation = drawIdx - startIdx;
+            XMStoreFloat3(&SimData[i].mSpinAxis, staticAsteroidData[i].spinAxis);
+            SimData[i].mSpinVelocity  = staticAsteroidData[i].spinVelocity;
+            SimData[i].mOrbitVelocity = staticAsteroidData[i].orbitVelocity;
+            SimData[i].mScale         = staticAsteroidData[i].scale;
+            SimData[i].mVertexStart   = staticAsteroidData[i].vertexStart;
         }
 
-        pCtx->DrawIndexed(attribs);
+        BufferDesc desc;
+        desc.Name              = "Asteroids simulation buffer";
+        desc.Usage             = USAGE_IMMUTABLE;
+        desc.BindFlags         = BIND_SHADER_RESOURCE;
+        desc.Mode              = BUFFER_MODE_STRUCTURED;
+        desc.ElementByteStride = static_cast<Uint32>(sizeof(AsteroidSimulationData));
+        desc.Size              = desc.ElementByteStride * mNumAsteroids;
+        BufferData Data{SimData.data(), desc.Size};
+        mDevice->CreateBuffer(desc, &Data, &mAsteroidsSimulationBuffer);
+    }
+
+    {
+        BufferDesc desc;
+        desc.Name           = "Simulation constant buffer";
+        desc.Usage          = USAGE_DYNAMIC;
+        desc.BindFlags      = BIND_UNIFORM_BUFFER;
+        desc.CPUAccessFlags = CPU_ACCESS_WRITE;
+        desc.Size           = sizeof(SimulationConstantBuffer);
+        mDevice->CreateBuffer(desc, nullptr, &mSimulationConstantBuffer);
+    }
+
+    {
+        BufferDesc desc;
+        desc.Name      = "Asteroids draw args buffer";
+        desc.Usage     = USAGE_DEFAULT;
+        desc.BindFlags = BIND_INDIRECT_DRAW_ARGS | BIND_UNORDERED_ACCESS;
+        desc.Mode      = BUFFER_MODE_RAW;
+        desc.Size      = static_cast<Uint64>(sizeof(IndexedIndirectDrawArgs)) * mNumAsteroids;
+        mDevice->CreateBuffer(desc, nullptr, &mDrawArgsBuffer);
+
+        if (AppendDrawArgs)
+        {
+            desc.Name = "Asteroids draw args counter buffer";
+            desc.Size = sizeof(Uint32) * 4;
+            mDevice->CreateBuffer(desc, nullptr, &mDrawArgsCounterBuffer);
+        }
     }
+
+    {
+        ShaderCreateInfo attribs;
+        attribs.Desc                       = {"Asteroids simulation CS", SHADER_TYPE_COMPUTE, true};
+        attribs.EntryPoint                 = "asteroid_sim_cs";
+        attribs.FilePath                   = "asteroid_sim_cs.csh";
+        attribs.SourceLanguage             = SHADER_SOURCE_LANGUAGE_HLSL;
+        attribs.pShaderSourceStreamFactory = pShaderSourceFactory;
+
+        ShaderMacroHelper Macros;
+        Macros.AddShaderMacro("THREAD_GROUP_SIZE", SimulationThreadGroupSize);
+        if (AppendDrawArgs)
+            Macros.AddShaderMacro("APPEND_DRAW_ARGS", 1);
+        attribs.Macros = Macros;
+
+        RefCntAutoPtr<IShader> cs;
+        mDevice->CreateShader(attribs, &cs);
+
+        ComputePipelineStateCreateInfo PSOCreateInfo;
+        PSOCreateInfo.PSODesc.Name                               = "Asteroids simulation PSO";
+        PSOCreateInfo.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_STATIC;
+        PSOCreateInfo.pCS                                        = cs;
+        mDevice->CreateComputePipelineState(PSOCreateInfo, &mSimulationPSO);
+
+        mSimulationPSO->GetStaticVariableByName(SHADER_TYPE_COMPUTE, "SimulationConstants")->Set(mSimulationConstantBuffer);
+        mSimulationPSO->GetStaticVariableByName(SHADER_TYPE_COMPUTE, "g_SimulationData")->Set(mAsteroidsSimulationBuffer->GetDefaultView(BUFFER_VIEW_SHADER_RESOURCE));
+        mSimulationPSO->GetStaticVariableByName(SHADER_TYPE_COMPUTE, "g_AsteroidData")->Set(mAsteroidsDataBuffers[0]->GetDefaultView(BUFFER_VIEW_UNORDERED_ACCESS));
+        mSimulationPSO->GetStaticVariableByName(SHADER_TYPE_COMPUTE, "g_DrawArgs")->Set(mDrawArgsBuffer->GetDefaultView(BUFFER_VIEW_UNORDERED_ACCESS));
+        if (mDrawArgsCounterBuffer)
+            mSimulationPSO->GetStaticVariableByName(SHADER_TYPE_COMPUTE, "g_DrawArgsCounter")->Set(mDrawArgsCounterBuffer->GetDefaultView(BUFFER_VIEW_UNORDERED_ACCESS));
+        mSimulationPSO->CreateShaderResourceBinding(&mSimulationSRB, true);
+    }
+
+    UploadAsteroidsToGPU();
 }
 
-void Asteroids::Render(float frameTime, const OrbitCamera& camera, const Settings& settings)
+void Asteroids::UploadAsteroidsToGPU()
 {
-    mFrameAttribs.frameTime = frameTime;
-    mFrameAttribs.camera    = &camera;
-    mFrameAttribs.settings  = &settings;
+    // Initialize GPU-side state from the current state of the CPU simulation
+    auto staticAsteroidData  = mAsteroids->StaticData();
+    auto dynamicAsteroidData = mAsteroids->DynamicData();
 
-    // Clear the render target
-    float clearcol[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-    auto* pRTV        = mSwapChain->GetCurrentBackBufferRTV();
-    auto* pDSV        = mSwapChain->GetDepthBufferDSV();
-    mDeviceCtxt->SetRenderTargets(1, &pRTV, pDSV, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-    mDeviceCtxt->ClearRenderTarget(pRTV, clearcol, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
-    mDeviceCtxt->ClearDepthStencil(pDSV, CLEAR_DEPTH_FLAG, 0.0f, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    std::vector<AsteroidData> Data(mNumAsteroids);
+    for (Uint32 i = 0; i < mNumAsteroids; ++i)
+    {
+        XMStoreFloat4x4(&Data[i].mWorld, dynamicAsteroidData[i].world);
+        Data[i].mSurfaceColor = staticAsteroidData[i].surfaceColor;
+        Data[i].mDeepColor    = staticAsteroidData[i].deepColor;
+        Data[i].mTextureIndex = staticAsteroidData[i].textureIndex;
+    }
+    mDeviceCtxt->UpdateBuffer(mAsteroidsDataBuffers[0], 0, static_cast<Uint64>(sizeof(AsteroidData)) * mNumAsteroids, Data.data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+}
+
+void Asteroids::DispatchGPUSimulation(float frameTime, const OrbitCamera& camera, bool animate)
+{
+    {
+        MapHelper<SimulationConstantBuffer> constants(mDeviceCtxt, mSimulationConstantBuffer, MAP_WRITE, MAP_FLAG_DISCARD);
+        XMStoreFloat4x4(&constants->mViewProjection, camera.ViewProjection());
+        XMStoreFloat4(&constants->mCameraEye, camera.Eye());
+        constants->mFrameTime         = frameTime;
+        constants->mNumAsteroids      = mNumAsteroids;
+        constants->mMaxSubdiv         = mAsteroids->SubdivCount();
+        constants->mAnimate           = animate ? 1 : 0;
+        constants->mMinSubdivSizeLog2 = std::log2f(SIM_MIN_SUBDIV_SIZE);
+        constants->mMaxMeshRadius     = SIM_MAX_MESH_RADIUS;
+        for (Uint32 i = 0; i < mAsteroids->SubdivCount() + 2; ++i)
+            constants->mIndexOffsets[i] = mAsteroids->IndexOffsets()[i];
+    }
+
+    if (mDrawArgsCounterBuffer)
+    {
+        const Uint32 Zero = 0;
+        mDeviceCtxt->UpdateBuffer(mDrawArgsCounterBuffer, 0, sizeof(Zero), &Zero, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    }
+
+    mDeviceCtxt->SetPipelineState(mSimulationPSO);
+    mDeviceCtxt->CommitShaderResources(mSimulationSRB, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    DispatchComputeAttribs attribs{(mNumAsteroids + SimulationThreadGroupSize - 1) / SimulationThreadGroupSize, 1, 1};
+    mDeviceCtxt->DispatchCompute(attribs);
+}
+
+void Asteroids::SimulateAndDrawOnGPU(float frameTime, const OrbitCamera& camera, const Settings& settings)
+{
+    DispatchGPUSimulation(frameTime, camera, settings.animate);
 
     LONG64 currCounter;
     QueryPerformanceCounter((LARGE_INTEGER*)&currCounter);
-    mUpdateTicks = currCounter;
+    mUpdateTicks      = currCounter - mUpdateTicks;
+    mUpdatePhaseTicks = mUpdateTicks;
+    mRenderTicks      = currCounter;
 
-    auto SubsetSize = NUM_ASTEROIDS / mNumSubsets;
+    DrawAsteroidsIndirect();
 
-    if (m_BindingMode == BindingMode::Bindless)
+    QueryPerformanceCounter((LARGE_INTEGER*)&currCounter);
+    mRenderPhaseTicks = currCounter - mRenderTicks;
+
+    mThreadPerfCounters[0].UpdateBusyTicks = mUpdatePhaseTicks;
+    mThreadPerfCounters[0].RenderBusyTicks = mRenderPhaseTicks;
+}
+
+bool Asteroids::VerifyGPUSimulation(Uint32 NumSteps, float TimeStep, const OrbitCamera& camera, const Settings& settings)
+{
+    if (m_BindingMode != BindingMode::GPUDriven)
     {
-        // Write view-projection matrix into the buffer
-        const auto& viewProjection = camera.ViewProjection();
-        mDeviceCtxt->UpdateBuffer(mDrawConstantBuffer, 0, sizeof(DirectX::XMFLOAT4X4), (void*)&viewProjection, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-        // Explicitly transition the buffer to CONSTANT_BUFFER state
-        StateTransitionDesc Barrier{mDrawConstantBuffer, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_CONSTANT_BUFFER, STATE_TRANSITION_FLAG_UPDATE_STATE};
-        mDeviceCtxt->TransitionResourceStates(1, &Barrier);
+        LOG_ERROR_MESSAGE("GPU simulation is not available");
+        return false;
+    }
+
+    UploadAsteroidsToGPU();
+    for (Uint32 step = 0; step < NumSteps; ++step)
+        DispatchGPUSimulation(TimeStep, camera, true);
+
+    // Reference simulation
+    Settings cpuSettings = settings;
+    cpuSettings.animate  = true;
+    for (Uint32 step = 0; step < NumSteps; ++step)
+        mAsteroids->Update(TimeStep, camera.Eye(), cpuSettings);
+
+    RefCntAutoPtr<IBuffer> pStagingBuffer;
+    {
+        BufferDesc desc;
+        desc.Name           = "Asteroids data readback buffer";
+        desc.Usage          = USAGE_STAGING;
+        desc.CPUAccessFlags = CPU_ACCESS_READ;
+        desc.Size           = static_cast<Uint64>(sizeof(AsteroidData)) * mNumAsteroids;
+        mDevice->CreateBuffer(desc, nullptr, &pStagingBuffer);
+    }
+    mDeviceCtxt->CopyBuffer(mAsteroidsDataBuffers[0], 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION,
+                            pStagingBuffer, 0, pStagingBuffer->GetDesc().Size, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    mDeviceCtxt->WaitForIdle();
+
+    // Both simulations accumulate rotations in single precision, so allow for a small relative error
+    constexpr float Tolerance = 1e-3f;
+
+    float  MaxError      = 0;
+    Uint32 NumMismatches = 0;
+    {
+        MapHelper<AsteroidData> gpuData(mDeviceCtxt, pStagingBuffer, MAP_READ, MAP_FLAG_NONE);
+        auto                    dynamicAsteroidData = mAsteroids->DynamicData();
+        for (Uint32 i = 0; i < mNumAsteroids; ++i)
+        {
+            DirectX::XMFLOAT4X4 cpuWorld;
+            XMStoreFloat4x4(&cpuWorld, dynamicAsteroidData[i].world);
+
+            bool Match = true;
+            for (int r = 0; r < 4; ++r)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    const auto Error = std::abs(gpuData[i].mWorld.m[r][c] - cpuWorld.m[r][c]) / std::max(1.f, std::abs(cpuWorld.m[r][c]));
+                    MaxError         = std::max(MaxError, Error);
+                    Match            = Match && Error <= Tolerance;
+                }
+            }
+            if (!Match)
+                ++NumMismatches;
+        }
     }
 
+    std::cout << "GPU simulation verification: " << NumSteps << " steps, " << mNumAsteroids << " asteroids, "
+              << NumMismatches << " mismatches, max relative error " << MaxError << std::endl;
+
+    return NumMismatches == 0;
+}
+
+void Asteroids::SortChunk(Uint32 ThreadId, Uint32 startIdx, Uint32 numAsteroids)
+{
+    auto staticAsteroidData  = mAsteroids->StaticData();
+    auto dynamicAsteroidData = mAsteroids->DynamicData();
+
+    const auto GetBucket = [&](Uint32 i) {
+        VERIFY_EXPR(staticAsteroidData[i].textureIndex < NUM_UNIQUE_TEXTURES && dynamicAsteroidData[i].subdiv <= MESH_MAX_SUBDIV_LEVELS);
+        return staticAsteroidData[i].textureIndex * (MESH_MAX_SUBDIV_LEVELS + 1) + dynamicAsteroidData[i].subdiv;
+    };
+
+    // Counting sort by texture, then by LOD
+    Uint32 BucketOffsets[NUM_DRAW_BUCKETS + 1] = {};
+    for (Uint32 i = startIdx; i < startIdx + numAsteroids; ++i)
+        ++BucketOffsets[GetBucket(i) + 1];
+    for (Uint32 b = 1; b <= NUM_DRAW_BUCKETS; ++b)
+        BucketOffsets[b] += BucketOffsets[b - 1];
+
+    auto& SortedAsteroids = mSortedAsteroids[ThreadId];
+    SortedAsteroids.resize(numAsteroids);
+    for (Uint32 i = startIdx; i < startIdx + numAsteroids; ++i)
+        SortedAsteroids[BucketOffsets[GetBucket(i)]++] = i;
+}
+
+void Asteroids::UpdateAndRenderSubsets(const Settings& settings)
+{
+    LONG64 currCounter;
+
+    mUpdateCursor = 0;
     if (settings.multithreadedRendering)
     {
         m_NumThreadsCompleted = 0;
         mUpdateSubsetsSignal.Trigger(true);
     }
 
-    // Update all subsets in this thread when multithreadedRendering is false
-    for (Uint32 i = 0; i < (!settings.multithreadedRendering ? mNumSubsets : 1); ++i)
-        mAsteroids->Update(frameTime, camera.Eye(), settings, SubsetSize * i, SubsetSize);
+    // Main thread pulls update chunks along with the worker threads, or processes
+    // all of them when multithreadedRendering is false
+    UpdateChunks(0);
 
     if (settings.multithreadedRendering)
     {
@@ -1002,10 +1481,23 @@ void Asteroids::Render(float frameTime, const OrbitCamera& camera, const Setting
     }
 
     QueryPerformanceCounter((LARGE_INTEGER*)&currCounter);
-    mUpdateTicks = currCounter - mUpdateTicks;
+    mUpdateTicks      = currCounter - mUpdateTicks;
+    mUpdatePhaseTicks = mUpdateTicks;
 
     mRenderTicks = currCounter;
 
+    // In multi-draw-indirect mode, the asteroid data and draw args buffers stay mapped while the threads fill them
+    MapHelper<AsteroidData>            mappedAsteroidData;
+    MapHelper<IndexedIndirectDrawArgs> mappedDrawArgs;
+    if (m_BindingMode == BindingMode::MultiDrawIndirect)
+    {
+        mappedAsteroidData.Map(mDeviceCtxt, mAsteroidsDataBuffers[0], MAP_WRITE, MAP_FLAG_DISCARD);
+        mappedDrawArgs.Map(mDeviceCtxt, mDrawArgsBuffer, MAP_WRITE, MAP_FLAG_DISCARD);
+        mMappedAsteroidData = mappedAsteroidData;
+        mMappedDrawArgs     = mappedDrawArgs;
+    }
+
+    mRenderCursor = 0;
     if (settings.multithreadedRendering)
     {
         // Signal RenderSubsets
@@ -1013,9 +1505,8 @@ void Asteroids::Render(float frameTime, const OrbitCamera& camera, const Setting
         mRenderSubsetsSignal.Trigger(true);
     }
 
-    // Render all subsets in this thread when multithreadedRendering is false
-    for (Uint32 i = 0; i < (!settings.multithreadedRendering ? mNumSubsets : 1); ++i)
-        RenderSubset(i, mDeviceCtxt, camera, SubsetSize * i, SubsetSize);
+    // Main thread records its chunks directly into the immediate context
+    RenderChunks(0, mDeviceCtxt);
 
     if (settings.multithreadedRendering)
     {
@@ -1025,10 +1516,19 @@ void Asteroids::Render(float frameTime, const OrbitCamera& camera, const Setting
         // Reset mRenderSubsetsSignal while all threads are waiting for mUpdateSubsetsSignal
         mRenderSubsetsSignal.Reset();
 
-        mCmdListPtrs.resize(mCmdLists.size());
-        for (size_t i = 0; i < mCmdLists.size(); ++i)
-            mCmdListPtrs[i] = mCmdLists[i];
-        mDeviceCtxt->ExecuteCommandLists(static_cast<Uint32>(mCmdListPtrs.size()), mCmdListPtrs.data());
+        QueryPerformanceCounter((LARGE_INTEGER*)&currCounter);
+        mRenderPhaseTicks = currCounter - mRenderTicks;
+
+        // Submit command lists in chunk order. Chunks recorded by the main thread
+        // have no command lists.
+        mCmdListPtrs.clear();
+        for (auto& cmdList : mCmdLists)
+        {
+            if (cmdList)
+                mCmdListPtrs.push_back(cmdList);
+        }
+        if (!mCmdListPtrs.empty())
+            mDeviceCtxt->ExecuteCommandLists(static_cast<Uint32>(mCmdListPtrs.size()), mCmdListPtrs.data());
 
         for (auto& cmdList : mCmdLists)
         {
@@ -1038,6 +1538,68 @@ void Asteroids::Render(float frameTime, const OrbitCamera& camera, const Setting
             cmdList.Release();
         }
     }
+    else
+    {
+        QueryPerformanceCounter((LARGE_INTEGER*)&currCounter);
+        mRenderPhaseTicks = currCounter - mRenderTicks;
+    }
+
+    if (m_BindingMode == BindingMode::MultiDrawIndirect)
+    {
+        mappedAsteroidData.Unmap();
+        mappedDrawArgs.Unmap();
+        mMappedAsteroidData = nullptr;
+        mMappedDrawArgs     = nullptr;
+        DrawAsteroidsIndirect();
+    }
+
+    {
+        LONG64 UpdateBusyTicks = 0;
+        LONG64 RenderBusyTicks = 0;
+        for (const auto& Counters : mThreadPerfCounters)
+        {
+            UpdateBusyTicks += Counters.UpdateBusyTicks;
+            RenderBusyTicks += Counters.RenderBusyTicks;
+        }
+        AdjustChunkSizes(UpdateBusyTicks, RenderBusyTicks);
+    }
+}
+
+void Asteroids::Render(float frameTime, const OrbitCamera& camera, const Settings& settings)
+{
+    mFrameAttribs.frameTime = frameTime;
+    mFrameAttribs.camera    = &camera;
+    mFrameAttribs.settings  = &settings;
+
+    // Clear the render target
+    float clearcol[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    auto* pRTV        = mSwapChain->GetCurrentBackBufferRTV();
+    auto* pDSV        = mSwapChain->GetDepthBufferDSV();
+    mDeviceCtxt->SetRenderTargets(1, &pRTV, pDSV, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    mDeviceCtxt->ClearRenderTarget(pRTV, clearcol, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+    mDeviceCtxt->ClearDepthStencil(pDSV, CLEAR_DEPTH_FLAG, 0.0f, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+
+    LONG64 currCounter;
+    QueryPerformanceCounter((LARGE_INTEGER*)&currCounter);
+    mUpdateTicks = currCounter;
+
+    if (UseBindlessResources())
+    {
+        // Write view-projection matrix into the buffer
+        const auto& viewProjection = camera.ViewProjection();
+        mDeviceCtxt->UpdateBuffer(mDrawConstantBuffer, 0, sizeof(DirectX::XMFLOAT4X4), (void*)&viewProjection, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        // Explicitly transition the buffer to CONSTANT_BUFFER state
+        StateTransitionDesc Barrier{mDrawConstantBuffer, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_CONSTANT_BUFFER, STATE_TRANSITION_FLAG_UPDATE_STATE};
+        mDeviceCtxt->TransitionResourceStates(1, &Barrier);
+    }
+
+    for (auto& Counters : mThreadPerfCounters)
+        Counters = {};
+
+    if (m_BindingMode == BindingMode::GPUDriven)
+        SimulateAndDrawOnGPU(frameTime, camera, settings);
+    else
+        UpdateAndRenderSubsets(settings);
 
     // Call FinishFrame() to release dynamic resources allocated by deferred contexts
     // IMPORTANT: we must wait until the command lists are submitted for execution
@@ -1124,4 +1686,24 @@ void Asteroids::GetPerfCounters(float& UpdateTime, float& RenderTime)
     RenderTime = (float)mRenderTicks / (float)mPerfCounterFreq;
 }
 
+Uint32 Asteroids::GetNumSRBCommits() const
+{
+    Uint32 NumCommits = 0;
+    for (const auto& Counters : mThreadPerfCounters)
+        NumCommits += Counters.NumSRBCommits;
+    return NumCommits;
+}
+
+void Asteroids::GetWorkerPerfCounters(std::vector<WorkerPerfCounters>& Counters)
+{
+    Counters.resize(mThreadPerfCounters.size());
+    const auto PhaseTicks = mUpdatePhaseTicks + mRenderPhaseTicks;
+    for (size_t i = 0; i < mThreadPerfCounters.size(); ++i)
+    {
+        const auto BusyTicks = mThreadPerfCounters[i].UpdateBusyTicks + mThreadPerfCounters[i].RenderBusyTicks;
+        Counters[i].BusyTime = (float)BusyTicks / (float)mPerfCounterFreq;
+        Counters[i].IdleTime = (float)std::max(PhaseTicks - BusyTicks, LONG64{0}) / (float)mPerfCounterFreq;
+    }
+}
+
 } // namespace AsteroidsDE
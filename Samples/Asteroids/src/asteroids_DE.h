@@ -28,6 +28,8 @@
 
 namespace AsteroidsDE {
 
+struct AsteroidData;
+
 class Asteroids {
 public:
     Asteroids(const Settings &settings, AsteroidsSimulation* asteroids, GUI* gui, HWND hWnd, Diligent::RENDER_DEVICE_TYPE DevType);
@@ -39,6 +41,23 @@ public:
 
     void GetPerfCounters(float &UpdateTime, float &RenderTime);
 
+    struct WorkerPerfCounters
+    {
+        float BusyTime = 0;
+        float IdleTime = 0;
+    };
+    // Returns busy/idle time of every thread (main thread first) during the last frame's
+    // update and render phases
+    void GetWorkerPerfCounters(std::vector<WorkerPerfCounters>& Counters);
+
+    // Returns the number of CommitShaderResources calls made to render the asteroids in the last frame
+    Diligent::Uint32 GetNumSRBCommits() const;
+
+    // Runs NumSteps steps of the GPU simulation and the same number of steps of the CPU simulation
+    // with a fixed time step, reads back the asteroid transforms and compares them.
+    // Only available in GPU-driven mode.
+    bool VerifyGPUSimulation(Diligent::Uint32 NumSteps, float TimeStep, const OrbitCamera& camera, const Settings& settings);
+
 private:
     void CreateMeshes();
     void InitializeTextureData();
@@ -51,9 +70,40 @@ private:
         Dynamic = 0,
         Mutable,
         TextureMutable,
-        Bindless
+        Bindless,
+        // Draw commands and instance data for the entire belt are written to GPU buffers by the
+        // worker threads and the asteroids are rendered with a single multi-draw-indirect call
+        MultiDrawIndirect,
+        // Asteroids are simulated, culled and LOD-selected by a compute shader that writes
+        // indirect draw arguments. The CPU only dispatches the work.
+        GPUDriven
     }m_BindingMode = BindingMode::TextureMutable;
 
+    // Bindless, multi-draw-indirect and GPU-driven modes read asteroid data from the structured
+    // buffer and index textures dynamically in the shader
+    bool UseBindlessResources() const
+    {
+        return m_BindingMode == BindingMode::Bindless || DrawEntireBelt();
+    }
+    // The entire belt is drawn with a single indirect draw call
+    bool DrawEntireBelt() const
+    {
+        return m_BindingMode == BindingMode::MultiDrawIndirect || m_BindingMode == BindingMode::GPUDriven;
+    }
+
+    void UpdateAndRenderSubsets(const Settings& settings);
+    void WriteIndirectDrawCommands(Diligent::Uint32 startIdx, Diligent::Uint32 numAsteroids);
+    void DrawAsteroidsIndirect();
+
+    void CreateGPUSimulationResources(Diligent::IShaderSourceInputStreamFactory* pShaderSourceFactory);
+    void UploadAsteroidsToGPU();
+    void DispatchGPUSimulation(float frameTime, const OrbitCamera& camera, bool animate);
+    void SimulateAndDrawOnGPU(float frameTime, const OrbitCamera& camera, const Settings& settings);
+
+    // Asteroid vertices use PackedVertex format, positions need to be scaled by mPositionScale
+    bool  mQuantizedVertices = false;
+    float mPositionScale     = 1.0f;
+
     AsteroidsSimulation*        mAsteroids = nullptr;
     GUI*                        mGUI = nullptr;
 
@@ -61,6 +111,7 @@ private:
     Diligent::RefCntAutoPtr<Diligent::IRenderDevice>  mDevice;
     Diligent::RefCntAutoPtr<Diligent::IDeviceContext>  mDeviceCtxt;
     std::vector< Diligent::RefCntAutoPtr<Diligent::IDeviceContext> > mDeferredCtxt;
+    // One command list per render chunk, submitted in chunk order
     std::vector< Diligent::RefCntAutoPtr<Diligent::ICommandList> > mCmdLists;
     std::vector< Diligent::ICommandList* > mCmdListPtrs;
     
@@ -75,6 +126,40 @@ private:
     std::atomic_int m_NumThreadsCompleted;
     static void WorkerThreadFunc(Asteroids *pThis, Diligent::Uint32 ThreadNum);
 
+    // Asteroids are not split into fixed subsets. Instead, every thread pulls chunks of
+    // mUpdateChunkSize/mRenderChunkSize asteroids from the shared cursors until the whole
+    // range is processed. Chunk sizes are adjusted every frame based on the measured cost.
+    std::atomic_uint mUpdateCursor{0};
+    std::atomic_uint mRenderCursor{0};
+    Diligent::Uint32 mUpdateChunkSize = 0;
+    Diligent::Uint32 mRenderChunkSize = 0;
+    Diligent::Uint32 mMaxChunkSize    = 0;
+    // Number of asteroids in the belt, see Settings::numAsteroids
+    Diligent::Uint32 mNumAsteroids = 0;
+    float            mUpdateTicksPerAsteroid = 0;
+    float            mRenderTicksPerAsteroid = 0;
+
+    void UpdateChunks(Diligent::Uint32 ThreadId);
+    void RenderChunks(Diligent::Uint32 ThreadId, Diligent::IDeviceContext* pCtx);
+    void AdjustChunkSizes(LONG64 UpdateBusyTicks, LONG64 RenderBusyTicks);
+
+    struct ThreadPerfCounters
+    {
+        LONG64 UpdateBusyTicks = 0;
+        LONG64 RenderBusyTicks = 0;
+        Diligent::Uint32 NumSRBCommits = 0;
+    };
+    // Every thread only writes its own element
+    std::vector<ThreadPerfCounters> mThreadPerfCounters;
+    LONG64 mUpdatePhaseTicks = 0, mRenderPhaseTicks = 0;
+
+    // In non-bindless modes, asteroids of every chunk are bucketed by texture and LOD so that
+    // every SRB is committed once per bucket rather than once per asteroid.
+    enum { NUM_DRAW_BUCKETS = NUM_UNIQUE_TEXTURES * (MESH_MAX_SUBDIV_LEVELS + 1) };
+    // Per-thread scratch space for the sorted asteroid indices
+    std::vector<std::vector<Diligent::Uint32>> mSortedAsteroids;
+    void SortChunk(Diligent::Uint32 ThreadId, Diligent::Uint32 startIdx, Diligent::Uint32 numAsteroids);
+
     struct FrameAttribs
     {
         float frameTime;
@@ -87,6 +172,30 @@ private:
     Diligent::RefCntAutoPtr<Diligent::IBuffer>  mInstanceIDBuffer;
     std::vector<Diligent::RefCntAutoPtr<Diligent::IBuffer>>  mAsteroidsDataBuffers;
     Diligent::RefCntAutoPtr<Diligent::IBuffer>  mDrawConstantBuffer;
+    Diligent::RefCntAutoPtr<Diligent::IBuffer>  mDrawArgsBuffer;
+    struct IndexedIndirectDrawArgs
+    {
+        Diligent::Uint32 NumIndices;
+        Diligent::Uint32 NumInstances;
+        Diligent::Uint32 FirstIndexLocation;
+        Diligent::Uint32 BaseVertex;
+        Diligent::Uint32 FirstInstanceLocation;
+    };
+    // Asteroid data and draw args buffers mapped by the main thread for the duration of the
+    // render phase. All threads write directly into the mapped memory.
+    AsteroidData*            mMappedAsteroidData = nullptr;
+    IndexedIndirectDrawArgs* mMappedDrawArgs     = nullptr;
+
+    // GPU-driven mode resources. In this mode, mAsteroidsDataBuffers[0] is the GPU-side asteroid
+    // state that is updated by the simulation shader and read by the vertex shader.
+    Diligent::RefCntAutoPtr<Diligent::IBuffer>  mAsteroidsSimulationBuffer;
+    Diligent::RefCntAutoPtr<Diligent::IBuffer>  mSimulationConstantBuffer;
+    // When not null, draw commands of visible asteroids are compacted by the simulation
+    // shader and this buffer holds their count
+    Diligent::RefCntAutoPtr<Diligent::IBuffer>  mDrawArgsCounterBuffer;
+    Diligent::RefCntAutoPtr<Diligent::IPipelineState>  mSimulationPSO;
+    Diligent::RefCntAutoPtr<Diligent::IShaderResourceBinding> mSimulationSRB;
+
     Diligent::RefCntAutoPtr<Diligent::IBuffer>  mSpriteVertexBuffer;
     Diligent::RefCntAutoPtr<Diligent::IBuffer>  mSkyboxConstantBuffer;
     Diligent::RefCntAutoPtr<Diligent::IBuffer>  mSkyboxVertexBuffer;
@@ -12,6 +12,9 @@
 #include "noise.h"
 #include <map>
 #include <random>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
 using namespace DirectX;
 
@@ -239,6 +242,8 @@ void CreateAsteroidsFromGeospheres(Mesh *outMesh,
 
     Mesh baseMesh;
     CreateGeospheres(&baseMesh, subdivLevelCount, outSubdivIndexOffsets);
+    // All mesh instances share the indices and vertex order, so it is enough to optimize the base mesh
+    OptimizeGeospheresInPlace(&baseMesh, subdivLevelCount, outSubdivIndexOffsets);
 
     // Per unique mesh
     *vertexCountPerMesh = (unsigned int)baseMesh.vertices.size();
@@ -276,6 +281,252 @@ void CreateAsteroidsFromGeospheres(Mesh *outMesh,
 }
 
 
+float ComputeACMR(const IndexType* indices, size_t indexCount, unsigned int cacheSize)
+{
+    assert(indexCount % 3 == 0); // trilist
+    if (indexCount == 0)
+        return 0.0f;
+
+    // FIFO cache: the order of the entries only matters for eviction, which always happens at head
+    std::vector<IndexType> cache(cacheSize);
+    size_t head = 0;
+    size_t cachedCount = 0;
+    size_t misses = 0;
+    for (size_t i = 0; i < indexCount; ++i) {
+        auto v = indices[i];
+        if (std::find(cache.begin(), cache.begin() + cachedCount, v) == cache.begin() + cachedCount) {
+            ++misses;
+            cache[head] = v;
+            head = (head + 1) % cacheSize;
+            cachedCount = std::min(cachedCount + 1, size_t{cacheSize});
+        }
+    }
+    return (float)misses / (float)(indexCount / 3);
+}
+
+
+namespace
+{
+
+// Scoring function parameters from the original paper
+const float CacheDecayPower   = 1.5f;
+const float LastTriScore      = 0.75f;
+const float ValenceBoostScale = 2.0f;
+const float ValenceBoostPower = 0.5f;
+
+float VertexCacheScore(int cachePosition, unsigned int remainingTriangles, unsigned int cacheSize)
+{
+    if (remainingTriangles == 0)
+        return -1.0f;
+
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // Vertices of the last triangle get a fixed score to not favor strips over fans
+            score = LastTriScore;
+        } else {
+            float scaler = 1.0f / (float)(cacheSize - 3);
+            score = std::pow(1.0f - (float)(cachePosition - 3) * scaler, CacheDecayPower);
+        }
+    }
+    // Prefer vertices with few triangles left so that they can leave the cache for good
+    score += ValenceBoostScale * std::pow((float)remainingTriangles, -ValenceBoostPower);
+    return score;
+}
+
+short PackSnorm16(float value)
+{
+    value = std::max(-1.0f, std::min(1.0f, value));
+    return (short)std::lround(value * 32767.0f);
+}
+
+} // namespace
+
+
+void OptimizeVertexCacheInPlace(IndexType* indices, size_t indexCount, unsigned int cacheSize)
+{
+    assert(indexCount % 3 == 0); // trilist
+    assert(cacheSize > 3);
+    size_t triangles = indexCount / 3;
+    if (triangles == 0)
+        return;
+
+    size_t vertexCount = size_t{*std::max_element(indices, indices + indexCount)} + 1;
+
+    // Build vertex -> triangle adjacency. The first remainingTriangles[v] entries of every vertex's
+    // range hold the triangles that are not emitted yet.
+    std::vector<unsigned int> remainingTriangles(vertexCount, 0);
+    for (size_t i = 0; i < indexCount; ++i) {
+        ++remainingTriangles[indices[i]];
+    }
+    std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        adjacencyOffsets[v+1] = adjacencyOffsets[v] + remainingTriangles[v];
+    }
+    std::vector<unsigned int> adjacency(indexCount);
+    {
+        std::vector<unsigned int> fillOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < indexCount; ++i) {
+            adjacency[fillOffsets[indices[i]]++] = (unsigned int)(i / 3);
+        }
+    }
+
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        vertexScores[v] = VertexCacheScore(-1, remainingTriangles[v], cacheSize);
+    }
+
+    std::vector<float> triangleScores(triangles);
+    for (size_t t = 0; t < triangles; ++t) {
+        triangleScores[t] = vertexScores[indices[t*3+0]] + vertexScores[indices[t*3+1]] + vertexScores[indices[t*3+2]];
+    }
+    std::vector<bool> triangleEmitted(triangles, false);
+
+    std::vector<IndexType> newIndices;
+    newIndices.reserve(indexCount);
+    std::vector<IndexType> cache;
+    std::vector<IndexType> newCache;
+    cache.reserve(cacheSize + 3);
+    newCache.reserve(cacheSize + 3);
+
+    const size_t noTriangle = std::numeric_limits<size_t>::max();
+    size_t bestTriangle = noTriangle;
+    for (size_t emitted = 0; emitted < triangles; ++emitted) {
+        if (bestTriangle == noTriangle) {
+            // None of the cached vertices has triangles left - start over from the best remaining triangle
+            float bestScore = -std::numeric_limits<float>::max();
+            for (size_t t = 0; t < triangles; ++t) {
+                if (!triangleEmitted[t] && triangleScores[t] > bestScore) {
+                    bestScore = triangleScores[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        IndexType tri[3] = {indices[bestTriangle*3+0], indices[bestTriangle*3+1], indices[bestTriangle*3+2]};
+        newIndices.insert(newIndices.end(), tri, tri + 3);
+        triangleEmitted[bestTriangle] = true;
+
+        for (auto v : tri) {
+            auto begin = adjacency.begin() + adjacencyOffsets[v];
+            auto end = begin + remainingTriangles[v];
+            auto it = std::find(begin, end, (unsigned int)bestTriangle);
+            if (it != end) {
+                *it = *(end - 1);
+                --remainingTriangles[v];
+            }
+        }
+
+        // Move the vertices of the emitted triangle to the front of the LRU cache
+        newCache.assign(tri, tri + 3);
+        for (auto v : cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                newCache.push_back(v);
+        }
+        for (size_t i = 0; i < newCache.size(); ++i) {
+            auto v = newCache[i];
+            vertexScores[v] = VertexCacheScore(i < cacheSize ? (int)i : -1, remainingTriangles[v], cacheSize);
+        }
+
+        // Only triangles that use the touched vertices change their scores
+        bestTriangle = noTriangle;
+        float bestScore = -std::numeric_limits<float>::max();
+        for (auto v : newCache) {
+            for (unsigned int a = 0; a < remainingTriangles[v]; ++a) {
+                auto t = adjacency[adjacencyOffsets[v] + a];
+                triangleScores[t] = vertexScores[indices[t*3+0]] + vertexScores[indices[t*3+1]] + vertexScores[indices[t*3+2]];
+                if (triangleScores[t] > bestScore) {
+                    bestScore = triangleScores[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        newCache.resize(std::min(newCache.size(), size_t{cacheSize}));
+        std::swap(cache, newCache);
+    }
+
+    std::copy(newIndices.begin(), newIndices.end(), indices);
+}
+
+
+void OptimizeVertexFetchInPlace(std::vector<IndexType>* indices, size_t vertexCount, std::vector<IndexType>* outRemap)
+{
+    const size_t unassigned = std::numeric_limits<size_t>::max();
+    std::vector<size_t> remap(vertexCount, unassigned);
+
+    size_t nextVertex = 0;
+    for (auto &index : *indices) {
+        if (remap[index] == unassigned)
+            remap[index] = nextVertex++;
+        index = (IndexType)remap[index];
+    }
+    // Unreferenced vertices go to the end
+    for (auto &newIndex : remap) {
+        if (newIndex == unassigned)
+            newIndex = nextVertex++;
+    }
+
+    outRemap->assign(remap.begin(), remap.end());
+}
+
+
+void OptimizeGeospheresInPlace(Mesh *outMesh, unsigned int subdivLevelCount, const unsigned int* subdivIndexOffsets)
+{
+    for (unsigned int i = 0; i <= subdivLevelCount; ++i) {
+        OptimizeVertexCacheInPlace(outMesh->indices.data() + subdivIndexOffsets[i], subdivIndexOffsets[i+1] - subdivIndexOffsets[i]);
+    }
+
+    // Every subdiv level references all vertices of its own consecutive range, so the first-reference
+    // order keeps the vertices of each level within the level's range
+    std::vector<IndexType> remap;
+    OptimizeVertexFetchInPlace(&outMesh->indices, outMesh->vertices.size(), &remap);
+
+    std::vector<Vertex> vertices(outMesh->vertices.size());
+    for (size_t v = 0; v < vertices.size(); ++v) {
+        vertices[remap[v]] = outMesh->vertices[v];
+    }
+    std::swap(outMesh->vertices, vertices);
+}
+
+
+float QuantizeVertices(const std::vector<Vertex>& vertices, std::vector<PackedVertex>* outVertices)
+{
+    float maxCoord = 0.0f;
+    for (auto &v : vertices) {
+        maxCoord = std::max(maxCoord, std::max(std::abs(v.x), std::max(std::abs(v.y), std::abs(v.z))));
+    }
+    float positionScale = maxCoord > 0.0f ? maxCoord : 1.0f;
+    float invPositionScale = 1.0f / positionScale;
+
+    outVertices->resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i) {
+        const auto &v = vertices[i];
+        auto &p = (*outVertices)[i];
+
+        p.x = PackSnorm16(v.x * invPositionScale);
+        p.y = PackSnorm16(v.y * invPositionScale);
+        p.z = PackSnorm16(v.z * invPositionScale);
+        p.w = 0;
+
+        // Project the normal onto the octahedron and fold the lower hemisphere over the diagonals
+        float n = 1.0f / (std::abs(v.nx) + std::abs(v.ny) + std::abs(v.nz));
+        float ox = v.nx * n;
+        float oy = v.ny * n;
+        if (v.nz < 0.0f) {
+            float fx = (1.0f - std::abs(oy)) * (ox >= 0.0f ? 1.0f : -1.0f);
+            float fy = (1.0f - std::abs(ox)) * (oy >= 0.0f ? 1.0f : -1.0f);
+            ox = fx;
+            oy = fy;
+        }
+        p.nx = PackSnorm16(ox);
+        p.ny = PackSnorm16(oy);
+    }
+
+    return positionScale;
+}
+
+
 void CreateSkyboxMesh(std::vector<SkyboxVertex>* outVertices)
 {
     // See http://msdn.microsoft.com/en-us/library/windows/desktop/bb204881(v=vs.85).aspx
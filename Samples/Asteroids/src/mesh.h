@@ -59,6 +59,38 @@ void CreateAsteroidsFromGeospheres(Mesh *outMesh,
                                    unsigned int rngSeed,
                                    unsigned int* outSubdivIndexOffsets, unsigned int* vertexCountPerMesh);
 
+// Simulates a FIFO post-transform vertex cache of the given size and returns the average cache miss
+// ratio (ACMR), i.e. the number of vertex shader invocations per triangle
+float ComputeACMR(const IndexType* indices, size_t indexCount, unsigned int cacheSize = 16);
+
+// Reorders triangles of a trilist to improve post-transform vertex cache locality
+// (see Tom Forsyth, "Linear-Speed Vertex Cache Optimisation")
+void OptimizeVertexCacheInPlace(IndexType* indices, size_t indexCount, unsigned int cacheSize = 32);
+
+// Renumbers vertices in the order they are first referenced by the indices so that vertex fetches
+// are sequential. outRemap receives the new index of every vertex.
+void OptimizeVertexFetchInPlace(std::vector<IndexType>* indices, size_t vertexCount, std::vector<IndexType>* outRemap);
+
+// Runs both of the above on every subdiv level of the geospheres mesh. Vertices of a subdiv level
+// stay within the level's range, so the offsets remain valid.
+void OptimizeGeospheresInPlace(Mesh *outMesh, unsigned int subdivLevelCount, const unsigned int* subdivIndexOffsets);
+
+
+// Quantized vertex: positions are 16-bit SNORM scaled by the position scale, normals are
+// octahedral-encoded 16-bit SNORM. 12 bytes instead of 24.
+struct PackedVertex
+{
+    short x;
+    short y;
+    short z;
+    short w; // Unused
+    short nx;
+    short ny;
+};
+
+// Returns the position scale that needs to be applied to the decoded positions
+float QuantizeVertices(const std::vector<Vertex>& vertices, std::vector<PackedVertex>* outVertices);
+
 
 struct SkyboxVertex
 {
@@ -0,0 +1,89 @@
+// Copyright 2014 Intel Corporation All Rights Reserved
+//
+// Intel makes no representations about the suitability of this software for any purpose.
+// THIS SOFTWARE IS PROVIDED ""AS IS."" INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES,
+// EXPRESS OR IMPLIED, AND ALL LIABILITY, INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES,
+// FOR THE USE OF THIS SOFTWARE, INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY
+// RIGHTS, AND INCLUDING THE WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+// Intel does not assume any responsibility for any errors which may appear in this software
+// nor any responsibility to update it.
+
+// Checks the post-transform vertex cache optimization of the asteroid meshes. For every subdiv
+// level, the average cache miss ratio (ACMR) after the triangle reorder must not exceed the ACMR
+// of the subdivision order and must stay below a fixed bound. Returns a non-zero exit code on failure.
+
+#include <cstdio>
+#include <vector>
+
+#include "settings.h"
+#include "mesh.h"
+
+// The subdivision order gives ~0.78-0.93 and the reorder brings every level to ~0.60-0.72
+static const float MAX_OPTIMIZED_ACMR = 0.75f;
+
+// Indices are 16-bit, so the combined geospheres mesh runs out of indices beyond this level
+static const unsigned int MAX_TESTED_SUBDIV_LEVELS = 6;
+
+static bool CheckLevels(const char* name, const Mesh& original, const Mesh& optimized,
+                        const unsigned int* indexOffsets, unsigned int subdivLevelCount)
+{
+    bool passed = true;
+    for (unsigned int i = 0; i <= subdivLevelCount; ++i) {
+        auto indexCount = indexOffsets[i+1] - indexOffsets[i];
+        auto before = ComputeACMR(original.indices.data() + indexOffsets[i], indexCount);
+        auto after = ComputeACMR(optimized.indices.data() + indexOffsets[i], indexCount);
+        printf("%-24s %6u %6u %10.4f %10.4f\n", name, subdivLevelCount, i, before, after);
+
+        if (after > before) {
+            fprintf(stderr, "error: %s, subdiv level %u: ACMR increased from %f to %f\n", name, i, before, after);
+            passed = false;
+        }
+        if (after >= MAX_OPTIMIZED_ACMR) {
+            fprintf(stderr, "error: %s, subdiv level %u: ACMR %f is not below %f\n", name, i, after, MAX_OPTIMIZED_ACMR);
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+
+int main()
+{
+    bool passed = true;
+    printf("%-24s %6s %6s %10s %10s\n", "mesh", "levels", "level", "before", "after");
+
+    // Geospheres optimized in place
+    for (unsigned int subdivLevelCount = 0; subdivLevelCount <= MAX_TESTED_SUBDIV_LEVELS; ++subdivLevelCount) {
+        Mesh original;
+        std::vector<unsigned int> indexOffsets(size_t{subdivLevelCount} + 2);
+        CreateGeospheres(&original, subdivLevelCount, indexOffsets.data());
+
+        Mesh optimized(original);
+        OptimizeGeospheresInPlace(&optimized, subdivLevelCount, indexOffsets.data());
+
+        passed &= CheckLevels("geospheres", original, optimized, indexOffsets.data(), subdivLevelCount);
+    }
+
+    // Asteroid meshes exactly as the simulation creates them
+    {
+        Mesh original;
+        std::vector<unsigned int> originalOffsets(MESH_MAX_SUBDIV_LEVELS + 2);
+        CreateGeospheres(&original, MESH_MAX_SUBDIV_LEVELS, originalOffsets.data());
+
+        Mesh asteroids;
+        std::vector<unsigned int> indexOffsets(MESH_MAX_SUBDIV_LEVELS + 2);
+        unsigned int vertexCountPerMesh = 0;
+        CreateAsteroidsFromGeospheres(&asteroids, MESH_MAX_SUBDIV_LEVELS, MESH_MAX_SUBDIV_LEVELS, 1337,
+                                      indexOffsets.data(), &vertexCountPerMesh);
+
+        if (indexOffsets != originalOffsets) {
+            fprintf(stderr, "error: asteroid meshes have different subdiv level offsets than the geospheres\n");
+            passed = false;
+        } else {
+            passed &= CheckLevels("asteroids", original, asteroids, indexOffsets.data(), MESH_MAX_SUBDIV_LEVELS);
+        }
+    }
+
+    printf(passed ? "PASSED\n" : "FAILED\n");
+    return passed ? 0 : 1;
+}
@@ -31,6 +31,10 @@ enum { MESH_MAX_SUBDIV_LEVELS = 3 }; // 4x polys for each step.
 #define SIM_ORBIT_RADIUS 450.f
 #define SIM_DISC_RADIUS  120.f
 #define SIM_MIN_SCALE    0.2f
+// Asteroid meshes are displaced geospheres with radius in [0.3, 1.2] before scaling
+#define SIM_MAX_MESH_RADIUS 1.2f
+// Relative screen size at which the coarsest LOD is used (see AsteroidsSimulation::Update)
+#define SIM_MIN_SUBDIV_SIZE 0.0019f
 
 // In FLIP swap chains the compositor owns one of your buffers at any given point
 // Thus to run unconstrained (>vsync) frame rates, you need 3 buffers
@@ -44,6 +48,13 @@ enum { NUM_FRAMES_TO_BUFFER = 3 };
 // Also effectively max thread parallelism
 enum { NUM_SUBSETS = 4 };
 
+// In Diligent modes, asteroids are updated and rendered in chunks that threads pull from a shared
+// queue. Chunk sizes are chosen so that a chunk takes roughly this time (in microseconds).
+// Smaller chunks balance the load better, larger chunks reduce the per-chunk overhead.
+enum { UPDATE_CHUNK_TARGET_TIME_US = 100 };
+enum { RENDER_CHUNK_TARGET_TIME_US = 250 };
+enum { MIN_CHUNK_SIZE = 64 };
+
 // Buffer size for dynamic sprite data
 enum { MAX_SPRITE_VERTICES_PER_FRAME = 6 * 1024 };
 
@@ -75,7 +86,7 @@ struct Settings
         DiligentVulkan
     }mode = DiligentD3D11;
        
-    int resourceBindingMode = 3;  // Only for DiligentD3D12 and DiligentVk modes
+    int resourceBindingMode = 3;  // Only for DiligentD3D12 and DiligentVk modes, see AsteroidsDE::Asteroids::BindingMode
 
     bool lockFrameRate = false;
     bool animate = true;
@@ -87,6 +98,17 @@ struct Settings
     bool multithreadedRendering = true;
 #endif
 
+    // If non-zero, runs the given number of GPU simulation steps, compares the results
+    // with the CPU simulation and exits
+    unsigned int verifyGPUSimulationSteps = 0;
+
+    // Number of asteroids in the belt (Diligent modes only). Native D3D11 and D3D12 modes size
+    // their resources with NUM_ASTEROIDS and are disabled when a different count is requested.
+    unsigned int numAsteroids = NUM_ASTEROIDS;
+
+    // Use 16-bit positions and octahedral normals for the asteroid meshes (Diligent modes only)
+    bool quantizeVertices = true;
+
     bool submitRendering = true;
     bool executeIndirect = false;
     bool warp = false;
@@ -141,7 +141,7 @@ void AsteroidsSimulation::Update(float frameTime, DirectX::XMVECTOR cameraEye, c
     bool animate = settings.animate;
 
     // TODO: This constant should really depend on resolution and/or be configurable...
-    static const float minSubdivSizeLog2 = std::log2f(0.0019f);
+    static const float minSubdivSizeLog2 = std::log2f(SIM_MIN_SUBDIV_SIZE);
 
     size_t last = count ? startIndex + count : mAsteroidDynamic.size();
     for (size_t i = startIndex; i < last; ++i) {
@@ -164,6 +164,7 @@ void AsteroidsSimulation::Update(float frameTime, DirectX::XMVECTOR cameraEye, c
 
         // TODO: Ignore/cull/force lowest subdiv if offscreen?
         
+        dynamicData.subdiv = subdiv;
         dynamicData.indexStart = mIndexOffsets[subdiv];
         dynamicData.indexCount = mIndexOffsets[subdiv+1] - dynamicData.indexStart;
     }
@@ -27,6 +27,7 @@ struct AsteroidDynamic
     // These depend on chosen subdiv level, hence are not constant
     unsigned int indexStart;
     unsigned int indexCount;
+    unsigned int subdiv;
 };
 
 struct AsteroidStatic
@@ -80,9 +81,17 @@ public:
 
     unsigned int GetTextureMipLevels()const{return mTextureMipLevels;}
 
+    // Index offsets of every subdiv level, SubdivCount() + 2 elements
+    const unsigned int* IndexOffsets() const { return mIndexOffsets.data(); }
+    unsigned int SubdivCount() const { return mSubdivCount; }
+
     const AsteroidStatic* StaticData() const { return mAsteroidStatic.data(); }
     const AsteroidDynamic* DynamicData() const { return mAsteroidDynamic.data(); }
 
+    // Snapshot of the animated state, e.g. to replay the same simulation several times
+    std::vector<AsteroidDynamic> SaveDynamicData() const { return mAsteroidDynamic; }
+    void RestoreDynamicData(const std::vector<AsteroidDynamic>& data) { mAsteroidDynamic = data; }
+
     // Can optionally provide a range of asteroids to update; count = 0 => to the end
     // This is useful for multithreading
     void Update(float frameTime, DirectX::XMVECTOR cameraEye, const Settings& settings,
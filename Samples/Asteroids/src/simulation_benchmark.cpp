@@ -0,0 +1,229 @@
+// Copyright 2014 Intel Corporation All Rights Reserved
+//
+// Intel makes no representations about the suitability of this software for any purpose.
+// THIS SOFTWARE IS PROVIDED ""AS IS."" INTEL SPECIFICALLY DISCLAIMS ALL WARRANTIES,
+// EXPRESS OR IMPLIED, AND ALL LIABILITY, INCLUDING CONSEQUENTIAL AND OTHER INDIRECT DAMAGES,
+// FOR THE USE OF THIS SOFTWARE, INCLUDING LIABILITY FOR INFRINGEMENT OF ANY PROPRIETARY
+// RIGHTS, AND INCLUDING THE WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+// Intel does not assume any responsibility for any errors which may appear in this software
+// nor any responsibility to update it.
+
+// Headless benchmark of AsteroidsSimulation::Update(). Runs a fixed number of fixed-timestep
+// updates for every combination of asteroid and thread counts and reports the cost per asteroid
+// and the scaling efficiency. The final state is checksummed, and all thread counts must
+// produce identical results.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "settings.h"
+#include "simulation.h"
+
+using namespace DirectX;
+
+// Threads update their own static range of asteroids and wait for each other after every step,
+// the same way the renderer's worker threads do
+class SpinBarrier
+{
+public:
+    explicit SpinBarrier(unsigned int threadCount) : mThreadCount(threadCount) {}
+
+    void Wait()
+    {
+        auto generation = mGeneration.load();
+        if (mArrived.fetch_add(1) + 1 == mThreadCount) {
+            mArrived.store(0);
+            mGeneration.fetch_add(1);
+        } else {
+            while (mGeneration.load() == generation)
+                std::this_thread::yield();
+        }
+    }
+
+private:
+    const unsigned int mThreadCount;
+    std::atomic_uint   mArrived{0};
+    std::atomic_uint   mGeneration{0};
+};
+
+
+static double RunSteps(AsteroidsSimulation& simulation, unsigned int asteroidCount, unsigned int threadCount,
+                       unsigned int steps, float timeStep, XMVECTOR cameraEye, const Settings& settings)
+{
+    SpinBarrier barrier(threadCount);
+
+    auto worker = [&](unsigned int thread) {
+        size_t start = size_t{asteroidCount} * thread / threadCount;
+        size_t end   = size_t{asteroidCount} * (thread + 1) / threadCount;
+        for (unsigned int step = 0; step < steps; ++step) {
+            if (end > start)
+                simulation.Update(timeStep, cameraEye, settings, start, end - start);
+            barrier.Wait();
+        }
+    };
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < threadCount; ++t)
+        threads.emplace_back(worker, t);
+    worker(0);
+    for (auto& t : threads)
+        t.join();
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::nano>(endTime - startTime).count();
+}
+
+
+// FNV-1a over the world matrices and selected LODs
+static uint64_t ComputeChecksum(const AsteroidsSimulation& simulation, unsigned int asteroidCount)
+{
+    uint64_t hash = 14695981039346656037ull;
+    auto hashBytes = [&hash](const void* data, size_t size) {
+        auto bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    };
+
+    auto dynamicData = simulation.DynamicData();
+    for (unsigned int i = 0; i < asteroidCount; ++i) {
+        XMFLOAT4X4 world;
+        XMStoreFloat4x4(&world, dynamicData[i].world);
+        hashBytes(&world, sizeof(world));
+        hashBytes(&dynamicData[i].subdiv, sizeof(dynamicData[i].subdiv));
+    }
+    return hash;
+}
+
+
+static std::vector<unsigned int> ParseList(const char* str)
+{
+    std::vector<unsigned int> values;
+    while (*str) {
+        char* end = nullptr;
+        auto value = strtoul(str, &end, 10);
+        if (end == str || value == 0)
+            return {};
+        values.push_back((unsigned int)value);
+        str = *end == ',' ? end + 1 : end;
+    }
+    return values;
+}
+
+
+int main(int argc, char** argv)
+{
+    unsigned int steps = 100;
+    float timeStep = 1.0f / 60.0f;
+    std::vector<unsigned int> asteroidCounts = {NUM_ASTEROIDS};
+    std::vector<unsigned int> threadCounts;
+    bool checkExpected = false;
+    uint64_t expectedChecksum = 0;
+
+    for (unsigned int t = 1; t <= std::max(std::thread::hardware_concurrency(), 1u); t *= 2)
+        threadCounts.push_back(t);
+
+    for (int a = 1; a < argc; ++a) {
+        if (_stricmp(argv[a], "-steps") == 0 && a + 1 < argc) {
+            steps = (unsigned int)atoi(argv[++a]);
+        } else if (_stricmp(argv[a], "-timestep") == 0 && a + 1 < argc) {
+            timeStep = (float)atof(argv[++a]);
+        } else if (_stricmp(argv[a], "-asteroids") == 0 && a + 1 < argc) {
+            asteroidCounts = ParseList(argv[++a]);
+        } else if (_stricmp(argv[a], "-threads") == 0 && a + 1 < argc) {
+            threadCounts = ParseList(argv[++a]);
+        } else if (_stricmp(argv[a], "-checksum") == 0 && a + 1 < argc) {
+            checkExpected = true;
+            expectedChecksum = strtoull(argv[++a], nullptr, 16);
+        } else {
+            fprintf(stderr, "error: unrecognized argument '%s'\n", argv[a]);
+            fprintf(stderr, "usage: AsteroidsSimBenchmark [options]\n");
+            fprintf(stderr, "options:\n");
+            fprintf(stderr, "  -steps [count]\n");
+            fprintf(stderr, "  -timestep [seconds]\n");
+            fprintf(stderr, "  -asteroids [count,count,...]\n");
+            fprintf(stderr, "  -threads [count,count,...]\n");
+            fprintf(stderr, "  -checksum [hex] (only with a single asteroid count)\n");
+            return -1;
+        }
+    }
+
+    if (steps == 0 || asteroidCounts.empty() || threadCounts.empty()) {
+        fprintf(stderr, "error: step, asteroid and thread counts must be positive\n");
+        return -1;
+    }
+    if (checkExpected && asteroidCounts.size() != 1) {
+        fprintf(stderr, "error: -checksum requires a single asteroid count\n");
+        return -1;
+    }
+
+    Settings settings;
+    settings.animate = true;
+    // Eye position of the initial view of the demo, see ResetCameraView() and OrbitCamera::UpdateData()
+    float cameraRadius = SIM_ORBIT_RADIUS + SIM_DISC_RADIUS + 10.f;
+    float longAngle = 4.50f;
+    float latAngle = 1.45f;
+    XMVECTOR cameraEye = XMVectorSet(
+        cameraRadius * std::sin(latAngle) * std::cos(longAngle),
+        cameraRadius * std::cos(latAngle),
+        cameraRadius * std::sin(latAngle) * std::sin(longAngle),
+        0.0f);
+
+    bool passed = true;
+    for (auto asteroidCount : asteroidCounts) {
+        AsteroidsSimulation simulation(1337, asteroidCount, NUM_UNIQUE_MESHES, MESH_MAX_SUBDIV_LEVELS, NUM_UNIQUE_TEXTURES);
+        auto initialState = simulation.SaveDynamicData();
+
+        printf("\n%u asteroids, %u steps of %g s\n", asteroidCount, steps, timeStep);
+        printf("%8s %20s %10s %12s %16s\n", "threads", "ns/asteroid/step", "speedup", "efficiency", "checksum");
+
+        double baseTime = 0.0;
+        unsigned int baseThreads = 0;
+        uint64_t referenceChecksum = 0;
+        for (auto threadCount : threadCounts) {
+            simulation.RestoreDynamicData(initialState);
+            // Warm up caches and let the threads spin up
+            RunSteps(simulation, asteroidCount, threadCount, 1, timeStep, cameraEye, settings);
+            simulation.RestoreDynamicData(initialState);
+
+            auto time = RunSteps(simulation, asteroidCount, threadCount, steps, timeStep, cameraEye, settings);
+            auto checksum = ComputeChecksum(simulation, asteroidCount);
+
+            if (baseThreads == 0) {
+                baseTime = time;
+                baseThreads = threadCount;
+                referenceChecksum = checksum;
+            }
+            double speedup = baseTime / time;
+            double efficiency = speedup * baseThreads / threadCount;
+
+            printf("%8u %20.2f %10.2f %11.1f%% %016llx\n", threadCount, time / (double(asteroidCount) * steps),
+                   speedup, efficiency * 100.0, (unsigned long long)checksum);
+
+            if (checksum != referenceChecksum) {
+                fprintf(stderr, "error: %u threads changed the result of the simulation\n", threadCount);
+                passed = false;
+            }
+        }
+
+        if (checkExpected && referenceChecksum != expectedChecksum) {
+            fprintf(stderr, "error: checksum %016llx does not match expected %016llx\n",
+                    (unsigned long long)referenceChecksum, (unsigned long long)expectedChecksum);
+            passed = false;
+        }
+    }
+
+    return passed ? 0 : 1;
+}
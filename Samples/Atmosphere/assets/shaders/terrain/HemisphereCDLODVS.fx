@@ -0,0 +1,18 @@
+#include "HemisphereVSCommon.fxh"
+#include "TerrainCDLOD.fxh"
+
+void HemisphereCDLODVS(in float2 f2GridPos : ATTRIB0,
+                       in float4 f4NodeRect : ATTRIB1,
+                       in float4 f4MorphParams : ATTRIB2,
+                       out float4 f4PosPS : SV_Position,
+                       out HemisphereVSOutput VSOut
+                       // IMPORTANT: non-system generated pixel shader input
+                       // arguments must have the exact same name as vertex shader 
+                       // outputs and must go in the same order.
+                      )
+{
+    float3 f3PosWS;
+    float2 f2MaskUV0;
+    GetCDLODVertex(f2GridPos, f4NodeRect, f4MorphParams, f3PosWS, f2MaskUV0);
+    ComputeHemisphereVSOutput(f3PosWS, f2MaskUV0, f4PosPS, VSOut);
+}
@@ -0,0 +1,19 @@
+#include "HostSharedTerrainStructs.fxh"
+#include "TerrainShadersCommon.fxh"
+#include "TerrainCDLOD.fxh"
+
+cbuffer cbCameraAttribs
+{
+    CameraAttribs g_CameraAttribs;
+}
+
+void HemisphereCDLODZOnlyVS(in float2 f2GridPos : ATTRIB0,
+                            in float4 f4NodeRect : ATTRIB1,
+                            in float4 f4MorphParams : ATTRIB2,
+                            out float4 f4PosPS : SV_Position)
+{
+    float3 f3PosWS;
+    float2 f2MaskUV0;
+    GetCDLODVertex(f2GridPos, f4NodeRect, f4MorphParams, f3PosWS, f2MaskUV0);
+    f4PosPS = mul( float4(f3PosWS,1.0), g_CameraAttribs.mViewProj);
+}
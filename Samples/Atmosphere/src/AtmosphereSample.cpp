@@ -37,6 +37,7 @@
 #include "../imGuIZMO.quat/imGuIZMO.h"
 #include "PlatformMisc.hpp"
 #include "ImGuiUtils.hpp"
+#include "FileSystem.hpp"
 
 namespace Diligent
 {
@@ -55,6 +56,8 @@ void AtmosphereSample::ModifyEngineInitInfo(const ModifyEngineInitInfoAttribs& A
 
     Attribs.EngineCI.Features.ComputeShaders = DEVICE_FEATURE_STATE_ENABLED;
     Attribs.EngineCI.Features.DepthClamp     = DEVICE_FEATURE_STATE_OPTIONAL;
+    // Every shadow cascade except the first one is recorded on its own deferred context
+    Attribs.EngineCI.NumDeferredContexts = MaxShadowCascades - 1;
 }
 
 void AtmosphereSample::Initialize(const SampleInitInfo& InitInfo)
@@ -101,7 +104,8 @@ void AtmosphereSample::Initialize(const SampleInitInfo& InitInfo)
     m_f3CustomMieBeta         = m_PPAttribs.f4CustomMieBeta;
     m_f3CustomOzoneAbsoprtion = m_PPAttribs.f4CustomOzoneAbsorption;
 
-    m_strRawDEMDataFile       = "Terrain\\HeightMap.tif";
+    // Use the tiled elevation file produced by AtmosphereElevationConverter if it is available
+    m_strRawDEMDataFile       = FileSystem::FileExists("Terrain\\HeightMap.elev") ? "Terrain\\HeightMap.elev" : "Terrain\\HeightMap.tif";
     m_strMtrlMaskFile         = "Terrain\\Mask.png";
     m_strTileTexPaths[0]      = "Terrain\\Tiles\\gravel_DM.dds";
     m_strTileTexPaths[1]      = "Terrain\\Tiles\\grass_DM.dds";
@@ -161,6 +165,8 @@ void AtmosphereSample::Initialize(const SampleInitInfo& InitInfo)
                              m_pLightSctrPP->GetMediaAttribsCB());
 
     CreateShadowMap();
+
+    StartShadowWorkerThreads(std::min(m_pDeferredContexts.size(), size_t{MaxShadowCascades - 1}));
 }
 
 void AtmosphereSample::UpdateUI()
@@ -189,11 +195,33 @@ void AtmosphereSample::UpdateUI()
                 }
             }
 
-            if (ImGui::SliderInt("Num cascades", &m_TerrainRenderParams.m_iNumShadowCascades, 1, 8))
+            if (ImGui::SliderInt("Num cascades", &m_TerrainRenderParams.m_iNumShadowCascades, 1, MaxShadowCascades))
                 CreateShadowMap();
 
             ImGui::Checkbox("Visualize cascades", &m_ShadowSettings.bVisualizeCascades);
 
+            ImGui::Checkbox("Cache cascades", &m_ShadowSettings.bCacheCascades);
+            if (m_ShadowSettings.bCacheCascades)
+            {
+                ImGui::SliderFloat("Update threshold", &m_ShadowSettings.fCascadeUpdateThreshold, 0.f, 0.1f);
+                ImGui::HelpMarker("Camera movement relative to the cascade extent after which a cascade is re-rendered");
+            }
+            ImGui::Text("Cascades refreshed: %d / %d", m_NumRefreshedCascades, m_TerrainRenderParams.m_iNumShadowCascades);
+
+            ImGui::TreePop();
+        }
+
+        ImGui::SetNextItemOpen(false, ImGuiCond_FirstUseEver);
+        if (ImGui::TreeNode("Terrain"))
+        {
+            ImGui::Checkbox("CDLOD terrain", &m_TerrainRenderParams.m_bUseCDLOD);
+            if (m_TerrainRenderParams.m_bUseCDLOD)
+            {
+                ImGui::SliderFloat("LOD pixel error", &m_TerrainRenderParams.m_fCDLODPixelError, 0.5f, 16.f);
+                const auto& Stats = m_EarthHemisphere.GetCDLODStatistics();
+                ImGui::Text("Patches: %u, triangles: %u", Stats.NumPatches, Stats.NumTriangles);
+            }
+
             ImGui::TreePop();
         }
 
@@ -471,6 +499,7 @@ void AtmosphereSample::UpdateUI()
 
 AtmosphereSample::~AtmosphereSample()
 {
+    StopShadowWorkerThreads();
 }
 
 void AtmosphereSample::CreateShadowMap()
@@ -495,6 +524,7 @@ void AtmosphereSample::CreateShadowMap()
     SMMgrInitInfo.pComparisonSampler = m_pComparisonSampler;
 
     m_ShadowMapMgr.Initialize(m_pDevice, nullptr, SMMgrInitInfo);
+    InvalidateShadowCascades();
 }
 
 void AtmosphereSample::RenderShadowMap(IDeviceContext* pContext,
@@ -532,31 +562,252 @@ void AtmosphereSample::RenderShadowMap(IDeviceContext* pContext,
         };
     m_ShadowMapMgr.DistributeCascades(DistrInfo, ShadowAttribs);
 
-    // Render cascades
-    for (int iCascade = 0; iCascade < m_TerrainRenderParams.m_iNumShadowCascades; ++iCascade)
+    const int NumCascades = m_TerrainRenderParams.m_iNumShadowCascades;
+    VERIFY_EXPR(NumCascades <= MaxShadowCascades);
+
+    // Upload new terrain geometry and transition the resources on the immediate context
+    // so that the cascades can be recorded in parallel.
+    m_EarthHemisphere.Update(pContext, m_TerrainRenderParams);
+
+    SelectShadowCascadesToRefresh(ShadowAttribs);
+    ShadowAttribs.mWorldToLightView = m_CachedShadowAttribs.mWorldToLightView;
+
+    const auto& WorldToLightViewSpaceMatr = m_PackMatrixRowMajor ?
+        ShadowAttribs.mWorldToLightView :
+        ShadowAttribs.mWorldToLightView.Transpose();
+    for (int iCascade = 0; iCascade < NumCascades; ++iCascade)
+    {
+        if (m_RefreshCascade[iCascade])
+        {
+            m_CascadeViewProj[iCascade] = WorldToLightViewSpaceMatr * m_ShadowMapMgr.GetCascadeTranform(iCascade).Proj;
+
+            m_CachedShadowAttribs.Cascades[iCascade]                 = ShadowAttribs.Cascades[iCascade];
+            m_CachedShadowAttribs.mWorldToShadowMapUVDepth[iCascade] = ShadowAttribs.mWorldToShadowMapUVDepth[iCascade];
+            m_CachedShadowAttribs.fCascadeCamSpaceZEnd[iCascade]     = ShadowAttribs.fCascadeCamSpaceZEnd[iCascade];
+        }
+        else
+        {
+            // Shaders must sample the cascade with the transform it was rendered with
+            ShadowAttribs.Cascades[iCascade]                 = m_CachedShadowAttribs.Cascades[iCascade];
+            ShadowAttribs.mWorldToShadowMapUVDepth[iCascade] = m_CachedShadowAttribs.mWorldToShadowMapUVDepth[iCascade];
+            ShadowAttribs.fCascadeCamSpaceZEnd[iCascade]     = m_CachedShadowAttribs.fCascadeCamSpaceZEnd[iCascade];
+        }
+    }
+
+    if (m_NumRefreshedCascades == 0)
+        return;
+
+    if (m_ShadowWorkerThreads.empty() || m_NumRefreshedCascades == 1)
+    {
+        for (int iCascade = 0; iCascade < NumCascades; ++iCascade)
+        {
+            if (m_RefreshCascade[iCascade])
+                RenderShadowCascade(pContext, iCascade, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        }
+        return;
+    }
+
+    // Deferred contexts can't transition the shadow map, so they only verify its state
+    StateTransitionDesc Barrier{m_ShadowMapMgr.GetSRV()->GetTexture(), RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_DEPTH_WRITE, STATE_TRANSITION_FLAG_UPDATE_STATE};
+    pContext->TransitionResourceStates(1, &Barrier);
+
+    m_NumShadowThreadsCompleted.store(0);
+    m_RenderCascadesSignal.Trigger(true);
+
+    if (m_RefreshCascade[0])
+        RenderShadowCascade(pContext, 0, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+
+    m_ExecuteCascadesSignal.Wait(true, 1);
+
+    // Command lists are executed in cascade order
+    m_CascadeCmdListPtrs.clear();
+    for (auto& pCmdList : m_CascadeCmdLists)
+    {
+        if (pCmdList)
+            m_CascadeCmdListPtrs.push_back(pCmdList);
+    }
+    if (!m_CascadeCmdListPtrs.empty())
+        pContext->ExecuteCommandLists(static_cast<Uint32>(m_CascadeCmdListPtrs.size()), m_CascadeCmdListPtrs.data());
+
+    for (auto& pCmdList : m_CascadeCmdLists)
+    {
+        // Command lists hold references to the resources they use
+        pCmdList.Release();
+    }
+
+    m_NumShadowThreadsReady.store(0);
+    m_GotoNextFrameSignal.Trigger(true);
+}
+
+void AtmosphereSample::InvalidateShadowCascades()
+{
+    m_CascadeValid.fill(false);
+}
+
+void AtmosphereSample::SelectShadowCascadesToRefresh(const ShadowMapAttribs& ShadowAttribs)
+{
+    const int NumCascades = m_TerrainRenderParams.m_iNumShadowCascades;
+
+    // Changes to the terrain geometry or LOD affect every cascade. CDLOD casters must match the
+    // rendered terrain, so their LOD must not drift too far from the one selected for the camera.
+    if (!m_ShadowSettings.bCacheCascades ||
+        m_f3CachedLightDir != m_f3LightDir ||
+        m_CachedTerrainRevision != m_EarthHemisphere.GetGeometryRevision() ||
+        m_CachedTerrainParams.m_bUseCDLOD != m_TerrainRenderParams.m_bUseCDLOD ||
+        (m_TerrainRenderParams.m_bUseCDLOD &&
+         (m_CachedTerrainParams.m_fCDLODPixelError != m_TerrainRenderParams.m_fCDLODPixelError ||
+          m_CachedTerrainParams.m_fLODScreenScale != m_TerrainRenderParams.m_fLODScreenScale ||
+          length(m_f3CameraPos - m_f3CachedCameraPos) > m_EarthHemisphere.GetCDLODFinestMorphRange() * CDLODCameraMoveThreshold)))
     {
-        auto* pCascadeDSV = m_ShadowMapMgr.GetCascadeDSV(iCascade);
+        InvalidateShadowCascades();
+    }
+
+    bool bRefreshAll = false;
+    for (int iCascade = 0; iCascade < NumCascades; ++iCascade)
+        bRefreshAll = bRefreshAll || !m_CascadeValid[iCascade];
 
-        m_pImmediateContext->SetRenderTargets(0, nullptr, pCascadeDSV, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-        m_pImmediateContext->ClearDepthStencil(pCascadeDSV, CLEAR_DEPTH_FLAG, 1.f, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    // When the camera moves or turns, the cascade snaps to a new position in light space. A cached
+    // cascade becomes stale when it is shifted or resized by a fraction of its extent.
+    auto IsStale = [&](int iCascade) {
+        const auto& NewCascade = ShadowAttribs.Cascades[iCascade];
+        const auto& OldCascade = m_CachedShadowAttribs.Cascades[iCascade];
 
-        const auto CascadeProjMatr = m_ShadowMapMgr.GetCascadeTranform(iCascade).Proj;
+        const float fNewExtent = 2.f / NewCascade.f4LightSpaceScale.x;
+        const float fOldExtent = 2.f / OldCascade.f4LightSpaceScale.x;
+        const float fThreshold = fOldExtent * m_ShadowSettings.fCascadeUpdateThreshold;
 
-        const auto& WorldToLightViewSpaceMatr = m_PackMatrixRowMajor ?
-            ShadowAttribs.mWorldToLightView :
-            ShadowAttribs.mWorldToLightView.Transpose();
+        const float2 f2NewCenter{-NewCascade.f4LightSpaceScaledBias.x / NewCascade.f4LightSpaceScale.x, -NewCascade.f4LightSpaceScaledBias.y / NewCascade.f4LightSpaceScale.y};
+        const float2 f2OldCenter{-OldCascade.f4LightSpaceScaledBias.x / OldCascade.f4LightSpaceScale.x, -OldCascade.f4LightSpaceScaledBias.y / OldCascade.f4LightSpaceScale.y};
+        return length(f2NewCenter - f2OldCenter) > fThreshold || std::abs(fNewExtent - fOldExtent) > fThreshold;
+    };
 
-        const auto WorldToLightProjSpaceMatr = WorldToLightViewSpaceMatr * CascadeProjMatr;
+    m_RefreshCascade.fill(false);
+    if (bRefreshAll)
+    {
+        // All cascades share the light view transform, so cascades rendered for different
+        // light directions can't be mixed
+        for (int iCascade = 0; iCascade < NumCascades; ++iCascade)
+            m_RefreshCascade[iCascade] = true;
+        m_CachedShadowAttribs.mWorldToLightView = ShadowAttribs.mWorldToLightView;
+        m_f3CachedCameraPos                     = m_f3CameraPos;
+    }
+    else
+    {
+        for (int iCascade = 0; iCascade < std::min(NumCascades, FirstStaggeredCascade); ++iCascade)
+            m_RefreshCascade[iCascade] = IsStale(iCascade);
 
+        // Distant cascades cover large areas and slowly become stale, so at most one of them
+        // is re-rendered per frame
+        const int NumStaggeredCascades = NumCascades - FirstStaggeredCascade;
+        for (int i = 0; i < NumStaggeredCascades; ++i)
         {
-            MapHelper<CameraAttribs> CamAttribs(m_pImmediateContext, m_pcbCameraAttribs, MAP_WRITE, MAP_FLAG_DISCARD);
-            WriteShaderMatrix(&CamAttribs->mViewProj, WorldToLightProjSpaceMatr, !m_PackMatrixRowMajor);
+            const int iCascade = FirstStaggeredCascade + (m_NextStaggeredCascade - FirstStaggeredCascade + i) % NumStaggeredCascades;
+            if (IsStale(iCascade))
+            {
+                m_RefreshCascade[iCascade] = true;
+                m_NextStaggeredCascade     = iCascade + 1 < NumCascades ? iCascade + 1 : FirstStaggeredCascade;
+                break;
+            }
         }
+    }
+
+    m_NumRefreshedCascades = 0;
+    for (int iCascade = 0; iCascade < NumCascades; ++iCascade)
+    {
+        if (m_RefreshCascade[iCascade])
+        {
+            m_CascadeValid[iCascade] = true;
+            ++m_NumRefreshedCascades;
+        }
+    }
+
+    m_f3CachedLightDir      = m_f3LightDir;
+    m_CachedTerrainRevision = m_EarthHemisphere.GetGeometryRevision();
+    m_CachedTerrainParams   = m_TerrainRenderParams;
+}
+
+void AtmosphereSample::RenderShadowCascade(IDeviceContext* pContext, int iCascade, RESOURCE_STATE_TRANSITION_MODE StateTransitionMode)
+{
+    // Deferred contexts start in default state, so everything must be bound in every context
+    auto* pCascadeDSV = m_ShadowMapMgr.GetCascadeDSV(iCascade);
+    pContext->SetRenderTargets(0, nullptr, pCascadeDSV, StateTransitionMode);
+    pContext->ClearDepthStencil(pCascadeDSV, CLEAR_DEPTH_FLAG, 1.f, 0, StateTransitionMode);
+
+    {
+        // Dynamic buffers must be mapped in every context that uses them
+        MapHelper<CameraAttribs> CamAttribs(pContext, m_pcbCameraAttribs, MAP_WRITE, MAP_FLAG_DISCARD);
+        WriteShaderMatrix(&CamAttribs->mViewProj, m_CascadeViewProj[iCascade], !m_PackMatrixRowMajor);
+    }
+
+    m_EarthHemisphere.RenderZOnly(pContext, m_f3CameraPos, m_CascadeViewProj[iCascade], StateTransitionMode);
+}
 
-        m_EarthHemisphere.Render(m_pImmediateContext, m_TerrainRenderParams, m_f3CameraPos, WorldToLightProjSpaceMatr, nullptr, nullptr, nullptr, true);
+void AtmosphereSample::StartShadowWorkerThreads(size_t NumThreads)
+{
+    m_ShadowWorkerThreads.resize(NumThreads);
+    for (Uint32 t = 0; t < m_ShadowWorkerThreads.size(); ++t)
+    {
+        m_ShadowWorkerThreads[t] = std::thread(ShadowWorkerThreadFunc, this, t);
+    }
+    m_CascadeCmdLists.resize(NumThreads);
+}
+
+void AtmosphereSample::StopShadowWorkerThreads()
+{
+    m_RenderCascadesSignal.Trigger(true, -1);
+
+    for (auto& thread : m_ShadowWorkerThreads)
+    {
+        thread.join();
     }
+    m_RenderCascadesSignal.Reset();
+    m_ShadowWorkerThreads.clear();
+    m_CascadeCmdLists.clear();
 }
 
+void AtmosphereSample::ShadowWorkerThreadFunc(AtmosphereSample* pThis, Uint32 ThreadNum)
+{
+    IDeviceContext* pDeferredCtx     = pThis->m_pDeferredContexts[ThreadNum];
+    const int       NumWorkerThreads = static_cast<int>(pThis->m_ShadowWorkerThreads.size());
+    const int       iCascade         = static_cast<int>(ThreadNum) + 1;
+    for (;;)
+    {
+        auto SignaledValue = pThis->m_RenderCascadesSignal.Wait(true, NumWorkerThreads);
+        if (SignaledValue < 0)
+            return;
+
+        // Threads whose cascade is not used or is up to date have nothing to record
+        if (iCascade < pThis->m_TerrainRenderParams.m_iNumShadowCascades && pThis->m_RefreshCascade[iCascade])
+        {
+            pDeferredCtx->Begin(0);
+            pThis->RenderShadowCascade(pDeferredCtx, iCascade, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+
+            RefCntAutoPtr<ICommandList> pCmdList;
+            pDeferredCtx->FinishCommandList(&pCmdList);
+            pThis->m_CascadeCmdLists[ThreadNum] = pCmdList;
+        }
+
+        {
+            const auto NumThreadsCompleted = pThis->m_NumShadowThreadsCompleted.fetch_add(1) + 1;
+            if (NumThreadsCompleted == NumWorkerThreads)
+                pThis->m_ExecuteCascadesSignal.Trigger();
+        }
+
+        pThis->m_GotoNextFrameSignal.Wait(true, NumWorkerThreads);
+
+        // Dynamic allocations of the deferred context may only be released after the
+        // command list has been submitted. In Metal backend, FinishFrame must be called
+        // from the thread that recorded the commands.
+        pDeferredCtx->FinishFrame();
+
+        pThis->m_NumShadowThreadsReady.fetch_add(1);
+        // All threads must get here before the next frame starts, otherwise one thread could
+        // go through the loop twice while m_GotoNextFrameSignal is still triggered.
+        while (pThis->m_NumShadowThreadsReady.load() < NumWorkerThreads)
+            std::this_thread::yield();
+        VERIFY_EXPR(!pThis->m_GotoNextFrameSignal.IsTriggered());
+    }
+}
 
 // Render a frame
 void AtmosphereSample::Render()
@@ -582,6 +833,9 @@ void AtmosphereSample::Render()
     // m_iFirstCascade must be initialized before calling RenderShadowMap()!
     m_PPAttribs.iFirstCascadeToRayMarch = std::min(m_PPAttribs.iFirstCascadeToRayMarch, m_TerrainRenderParams.m_iNumShadowCascades - 1);
 
+    // Screen-space size of a unit-length object at unit distance, used to select CDLOD ranges
+    m_TerrainRenderParams.m_fLODScreenScale = static_cast<float>(m_pSwapChain->GetDesc().Height) * 0.5f * m_mCameraProj._22;
+
     RenderShadowMap(m_pImmediateContext, LightAttrs, m_mCameraView, m_mCameraProj);
 
     LightAttrs.ShadowAttribs.bVisualizeCascades = m_ShadowSettings.bVisualizeCascades ? TRUE : FALSE;
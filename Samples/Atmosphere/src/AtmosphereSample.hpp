@@ -27,12 +27,18 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #include "SampleBase.hpp"
 #include "BasicMath.hpp"
 #include "EarthHemisphere.hpp"
 #include "ElevationDataSource.hpp"
 #include "EpipolarLightScattering.hpp"
 #include "ShadowMapManager.hpp"
+#include "ThreadSignal.hpp"
 
 namespace Diligent
 {
@@ -59,6 +65,13 @@ private:
                          LightAttribs&   LightAttribs,
                          const float4x4& mCameraView,
                          const float4x4& mCameraProj);
+    void RenderShadowCascade(IDeviceContext* pContext, int iCascade, RESOURCE_STATE_TRANSITION_MODE StateTransitionMode);
+    void SelectShadowCascadesToRefresh(const ShadowMapAttribs& ShadowAttribs);
+    void InvalidateShadowCascades();
+
+    void        StartShadowWorkerThreads(size_t NumThreads);
+    void        StopShadowWorkerThreads();
+    static void ShadowWorkerThreadFunc(AtmosphereSample* pThis, Uint32 ThreadNum);
 
     float3 m_f3LightDir = {-0.554699242f, -0.0599640049f, -0.829887390f};
 
@@ -77,10 +90,46 @@ private:
         float  fCascadePartitioningFactor = 0.95f;
         bool   bVisualizeCascades         = false;
         int    iFixedFilterSize           = 5;
+        bool   bCacheCascades             = true;
+        // Shift of the cascade, relative to its extent, after which a cached cascade is re-rendered
+        float  fCascadeUpdateThreshold    = 0.02f;
     } m_ShadowSettings;
 
     RefCntAutoPtr<ISampler> m_pComparisonSampler;
 
+    static constexpr int MaxShadowCascades = 8;
+
+    std::array<float4x4, MaxShadowCascades> m_CascadeViewProj;
+
+    // Terrain is static, so a cascade is only re-rendered when the light direction or the terrain
+    // changes, or when the camera movement shifts the cascade too far from where it was rendered.
+    // Cascades starting from FirstStaggeredCascade are refreshed one per frame.
+    static constexpr int FirstStaggeredCascade = 2;
+
+    // CDLOD casters are selected for the camera position, so with CDLOD terrain all cascades are
+    // re-rendered once the camera moves by this fraction of the finest morph range
+    static constexpr float CDLODCameraMoveThreshold = 0.25f;
+
+    std::array<bool, MaxShadowCascades> m_CascadeValid   = {};
+    std::array<bool, MaxShadowCascades> m_RefreshCascade = {};
+    ShadowMapAttribs                    m_CachedShadowAttribs;
+    float3                              m_f3CachedLightDir;
+    RenderingParams                     m_CachedTerrainParams;
+    Uint32                              m_CachedTerrainRevision = 0;
+    float3                              m_f3CachedCameraPos;
+    int                                 m_NextStaggeredCascade  = FirstStaggeredCascade;
+    int                                 m_NumRefreshedCascades  = 0;
+
+    // Cascade 0 is rendered by the main thread, worker thread i records cascade i+1 on deferred context i
+    Threading::Signal                        m_RenderCascadesSignal;
+    Threading::Signal                        m_ExecuteCascadesSignal;
+    Threading::Signal                        m_GotoNextFrameSignal;
+    std::atomic_int                          m_NumShadowThreadsCompleted{0};
+    std::atomic_int                          m_NumShadowThreadsReady{0};
+    std::vector<std::thread>                 m_ShadowWorkerThreads;
+    std::vector<RefCntAutoPtr<ICommandList>> m_CascadeCmdLists;
+    std::vector<ICommandList*>               m_CascadeCmdListPtrs;
+
     RenderingParams                m_TerrainRenderParams;
     EpipolarLightScatteringAttribs m_PPAttribs;
 
@@ -46,6 +46,7 @@
 #include <algorithm>
 #include <cfloat>
 #include <array>
+#include <memory>
 
 #include "EarthHemisphere.hpp"
 
@@ -59,6 +60,7 @@ namespace Diligent
 } // namespace Diligent
 
 #include "ElevationDataSource.hpp"
+#include "ParallelFor.hpp"
 #include "MapHelper.hpp"
 #include "GraphicsAccessories.hpp"
 #include "GraphicsUtilities.h"
@@ -204,34 +206,61 @@ private:
 typedef TriStrip<Uint32, StdIndexGenerator> StdTriStrip32;
 
 
-void ComputeVertexHeight(HemisphereVertex&          Vertex,
-                         class ElevationDataSource* pDataSource,
-                         float                      fSamplingStep,
-                         float                      fSampleScale)
-{
-    float3& f3PosWS = Vertex.f3WorldPos;
+// Number of quads along the edge of the CDLOD patch
+static constexpr Uint32 CDLODPatchQuads = 32;
 
-    float fCol   = f3PosWS.x / fSamplingStep;
-    float fRow   = f3PosWS.z / fSamplingStep;
-    float fDispl = pDataSource->GetInterpolatedHeight(fCol, fRow);
-    int   iColOffset, iRowOffset;
-    pDataSource->GetOffsets(iColOffset, iRowOffset);
-    Vertex.f2MaskUV0.x = (fCol + (float)iColOffset + 0.5f) / (float)pDataSource->GetNumCols();
-    Vertex.f2MaskUV0.y = (fRow + (float)iRowOffset + 0.5f) / (float)pDataSource->GetNumRows();
+// Maps the [-1,1]x[-1,1] domain onto the hemisphere the same way GenerateRingGeometry() does.
+// Returns the position relative to the Earth center.
+float3 DomainToSphere(const float2& f2Domain, float fEarthRadius)
+{
+    float fDX             = std::abs(f2Domain.x);
+    float fDZ             = std::abs(f2Domain.y);
+    float fMaxD           = std::max(fDX, fDZ);
+    float fMinD           = std::min(fDX, fDZ);
+    float fTan            = fMaxD > 0 ? fMinD / fMaxD : 0;
+    float fDirectionScale = 1 / std::sqrt(1 + fTan * fTan);
+
+    float3 f3Pos;
+    f3Pos.x = f2Domain.x * fDirectionScale;
+    f3Pos.z = f2Domain.y * fDirectionScale;
+    f3Pos.y = std::sqrt(std::max(0.f, 1.f - (f3Pos.x * f3Pos.x + f3Pos.z * f3Pos.z)));
+    return f3Pos * fEarthRadius;
+}
 
-    float3 f3SphereNormal = normalize(f3PosWS);
-    f3PosWS += f3SphereNormal * fDispl * fSampleScale;
+// Returns true if the point is hidden behind the sphere of the given radius centered at the origin.
+// See "Horizon culling" by P. Cozzi.
+bool IsBelowHorizon(const float3& f3CameraPos, const float3& f3Point, float fOccluderRadius)
+{
+    const float3 f3Camera  = f3CameraPos / fOccluderRadius;
+    const float3 f3CamToPt = f3Point / fOccluderRadius - f3Camera;
+    const float  fVhSqr    = dot(f3Camera, f3Camera) - 1.f;
+    const float  fVtDotVc  = -dot(f3CamToPt, f3Camera);
+    const float  fVtLenSqr = dot(f3CamToPt, f3CamToPt);
+    return fVhSqr > 0 && fVtDotVc > fVhSqr && fVtDotVc * fVtDotVc / fVtLenSqr > fVhSqr;
 }
 
 
+struct RingMeshData
+{
+    std::vector<Uint32> IB;
+    BoundBox            BndBox;
+};
+
+// CPU-side geometry of one ring that is generated on the background thread
+struct RingGeometryData
+{
+    int                           iRing = 0;
+    std::vector<HemisphereVertex> VB;
+    std::vector<RingMeshData>     Meshes;
+    std::vector<RingMeshData>     FillMeshes;
+};
+
 class RingMeshBuilder
 {
 public:
-    RingMeshBuilder(IRenderDevice*                       pDevice,
-                    const std::vector<HemisphereVertex>& VB,
+    RingMeshBuilder(const std::vector<HemisphereVertex>& VB,
                     int                                  iGridDimenion,
-                    std::vector<RingSectorMesh>&         RingMeshes) :
-        m_pDevice(pDevice),
+                    std::vector<RingMeshData>&           RingMeshes) :
         m_RingMeshes(RingMeshes),
         m_VB(VB),
         m_iGridDimenion(iGridDimenion)
@@ -244,28 +273,13 @@ public:
                     int                          iNumRows,
                     enum QUAD_TRIANGULATION_TYPE QuadTriangType)
     {
-        m_RingMeshes.push_back(RingSectorMesh());
+        m_RingMeshes.push_back(RingMeshData());
         auto& CurrMesh = m_RingMeshes.back();
 
-        std::vector<Uint32> IB;
-        StdTriStrip32       TriStrip(IB, StdIndexGenerator(m_iGridDimenion));
+        auto&         IB = CurrMesh.IB;
+        StdTriStrip32 TriStrip(IB, StdIndexGenerator(m_iGridDimenion));
         TriStrip.AddStrip(iBaseIndex, iStartCol, iStartRow, iNumCols, iNumRows, QuadTriangType);
 
-        CurrMesh.uiNumIndices = (Uint32)IB.size();
-
-        // Prepare buffer description
-        BufferDesc IndexBufferDesc;
-        IndexBufferDesc.Name      = "Ring mesh index buffer";
-        IndexBufferDesc.Size      = (Uint32)(IB.size() * sizeof(IB[0]));
-        IndexBufferDesc.BindFlags = BIND_INDEX_BUFFER;
-        IndexBufferDesc.Usage     = USAGE_IMMUTABLE;
-        BufferData IBInitData;
-        IBInitData.pData    = IB.data();
-        IBInitData.DataSize = IndexBufferDesc.Size;
-        // Create the buffer
-        m_pDevice->CreateBuffer(IndexBufferDesc, &IBInitData, &CurrMesh.pIndBuff);
-        VERIFY(CurrMesh.pIndBuff, "Failed to create index buffer");
-
         // Compute bounding box
         auto& BB = CurrMesh.BndBox;
         BB.Max   = float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
@@ -280,48 +294,67 @@ public:
     }
 
 private:
-    RefCntAutoPtr<IRenderDevice>         m_pDevice;
-    std::vector<RingSectorMesh>&         m_RingMeshes;
+    std::vector<RingMeshData>&           m_RingMeshes;
     const std::vector<HemisphereVertex>& m_VB;
     const int                            m_iGridDimenion;
 };
 
+void CreateRingSectorMesh(IRenderDevice* pDevice, const RingMeshData& MeshData, RingSectorMesh& Mesh)
+{
+    Mesh.uiNumIndices = (Uint32)MeshData.IB.size();
+    Mesh.BndBox       = MeshData.BndBox;
+
+    // Prepare buffer description
+    BufferDesc IndexBufferDesc;
+    IndexBufferDesc.Name      = "Ring mesh index buffer";
+    IndexBufferDesc.Size      = (Uint32)(MeshData.IB.size() * sizeof(MeshData.IB[0]));
+    IndexBufferDesc.BindFlags = BIND_INDEX_BUFFER;
+    IndexBufferDesc.Usage     = USAGE_IMMUTABLE;
+    BufferData IBInitData;
+    IBInitData.pData    = MeshData.IB.data();
+    IBInitData.DataSize = IndexBufferDesc.Size;
+    // Create the buffer
+    pDevice->CreateBuffer(IndexBufferDesc, &IBInitData, &Mesh.pIndBuff);
+    VERIFY(Mesh.pIndBuff, "Failed to create index buffer");
+}
+
 
-void GenerateSphereGeometry(IRenderDevice*                 pDevice,
-                            const float                    fEarthRadius,
-                            int                            iGridDimension,
-                            const int                      iNumRings,
-                            class ElevationDataSource*     pDataSource,
-                            float                          fSamplingStep,
-                            float                          fSampleScale,
-                            std::vector<HemisphereVertex>& VB,
-                            std::vector<RingSectorMesh>&   SphereMeshes)
+// Generates vertices and indices of one ring. Ring 0 is the finest one and covers the
+// entire center of the hemisphere. Every other ring has a hole in the middle that is
+// covered by the next finer ring or, until that one is ready, by the fill meshes.
+void GenerateRingGeometry(int                              iRing,
+                          int                              iNumRings,
+                          int                              iGridDimension,
+                          const float                      fEarthRadius,
+                          const class ElevationDataSource* pDataSource,
+                          float                            fSamplingStep,
+                          float                            fSampleScale,
+                          RingGeometryData&                Ring)
 {
-    if ((iGridDimension - 1) % 4 != 0)
-    {
-        iGridDimension = RenderingParams().m_iRingDimension;
-        UNEXPECTED("Grid dimension must be 4k+1. Defaulting to ", iGridDimension);
-    }
+    VERIFY((iGridDimension - 1) % 4 == 0, "Grid dimension must be 4k+1");
     const int iGridMidst = (iGridDimension - 1) / 2;
     const int iGridQuart = (iGridDimension - 1) / 4;
 
-    //const int iLargestGridScale = iGridDimension << (iNumRings-1);
+    Ring.iRing = iRing;
+    auto& VB   = Ring.VB;
+    VB.resize(static_cast<size_t>(iGridDimension) * static_cast<size_t>(iGridDimension));
 
-    RingMeshBuilder RingMeshBuilder(pDevice, VB, iGridDimension, SphereMeshes);
+    int iColOffset, iRowOffset;
+    pDataSource->GetOffsets(iColOffset, iRowOffset);
 
-    int iStartRing = 0;
-    VB.reserve((iNumRings - iStartRing) * iGridDimension * iGridDimension);
-    for (int iRing = iStartRing; iRing < iNumRings; ++iRing)
-    {
-        int iCurrGridStart = (int)VB.size();
-        VB.resize(VB.size() + static_cast<size_t>(iGridDimension) * static_cast<size_t>(iGridDimension));
-        float fGridScale = 1.f / (float)(1 << (iNumRings - 1 - iRing));
-        // Fill vertex buffer
-        for (int iRow = 0; iRow < iGridDimension; ++iRow)
+    float fGridScale = 1.f / (float)(1 << (iNumRings - 1 - iRing));
+
+    // Rows are independent, so they are generated in parallel. Heights of every row
+    // are sampled with a single batched call.
+    ParallelFor(static_cast<Uint32>(iGridDimension), 4, [&](Uint32 StartRow, Uint32 EndRow) {
+        std::vector<float2> ColRow(iGridDimension);
+        std::vector<float>  Displ(iGridDimension);
+        for (int iRow = static_cast<int>(StartRow); iRow < static_cast<int>(EndRow); ++iRow)
+        {
+            auto* pRowVerts = &VB[static_cast<size_t>(iRow) * iGridDimension];
             for (int iCol = 0; iCol < iGridDimension; ++iCol)
             {
-                auto& CurrVert = VB[iCurrGridStart + iCol + iRow * iGridDimension];
-                auto& f3Pos    = CurrVert.f3WorldPos;
+                auto& f3Pos = pRowVerts[iCol].f3WorldPos;
 
                 f3Pos.x = static_cast<float>(iCol) / static_cast<float>(iGridDimension - 1);
                 f3Pos.z = static_cast<float>(iRow) / static_cast<float>(iGridDimension - 1);
@@ -348,220 +381,144 @@ void GenerateSphereGeometry(IRenderDevice*                 pDevice,
                 f3Pos.z *= fEarthRadius;
                 f3Pos.y *= fEarthRadius;
 
-                ComputeVertexHeight(CurrVert, pDataSource, fSamplingStep, fSampleScale);
-                f3Pos.y -= fEarthRadius;
+                ColRow[iCol] = float2{f3Pos.x / fSamplingStep, f3Pos.z / fSamplingStep};
             }
 
-        // Align vertices on the outer boundary
-        if (iRing < iNumRings - 1)
-        {
-            for (int i = 1; i < iGridDimension - 1; i += 2)
+            pDataSource->GetInterpolatedHeights(ColRow.data(), Displ.data(), ColRow.size());
+
+            for (int iCol = 0; iCol < iGridDimension; ++iCol)
             {
-                // Top & bottom boundaries
-                for (int iRow = 0; iRow < iGridDimension; iRow += iGridDimension - 1)
-                {
-                    const auto& V0 = VB[iCurrGridStart + i - 1 + iRow * iGridDimension].f3WorldPos;
-                    auto&       V1 = VB[iCurrGridStart + i + 0 + iRow * iGridDimension].f3WorldPos;
-                    const auto& V2 = VB[iCurrGridStart + i + 1 + iRow * iGridDimension].f3WorldPos;
-                    V1             = (V0 + V2) / 2.f;
-                }
+                auto& CurrVert = pRowVerts[iCol];
+                auto& f3Pos    = CurrVert.f3WorldPos;
 
-                // Left & right boundaries
-                for (int iCol = 0; iCol < iGridDimension; iCol += iGridDimension - 1)
-                {
-                    const auto& V0 = VB[iCurrGridStart + iCol + (i - 1) * iGridDimension].f3WorldPos;
-                    auto&       V1 = VB[iCurrGridStart + iCol + (i + 0) * iGridDimension].f3WorldPos;
-                    const auto& V2 = VB[iCurrGridStart + iCol + (i + 1) * iGridDimension].f3WorldPos;
-                    V1             = (V0 + V2) / 2.f;
-                }
+                CurrVert.f2MaskUV0.x = (ColRow[iCol].x + (float)iColOffset + 0.5f) / (float)pDataSource->GetNumCols();
+                CurrVert.f2MaskUV0.y = (ColRow[iCol].y + (float)iRowOffset + 0.5f) / (float)pDataSource->GetNumRows();
+
+                float3 f3SphereNormal = normalize(f3Pos);
+                f3Pos += f3SphereNormal * Displ[iCol] * fSampleScale;
+                f3Pos.y -= fEarthRadius;
             }
         }
+    });
 
-
-        // Generate indices for the current ring
-        if (iRing == 0)
-        {
-            // clang-format off
-            RingMeshBuilder.CreateMesh(iCurrGridStart, 0,                   0, iGridMidst+1, iGridMidst+1, QUAD_TRIANG_TYPE_00_TO_11);
-            RingMeshBuilder.CreateMesh(iCurrGridStart, iGridMidst,          0, iGridMidst+1, iGridMidst+1, QUAD_TRIANG_TYPE_01_TO_10);
-            RingMeshBuilder.CreateMesh(iCurrGridStart, 0,          iGridMidst, iGridMidst+1, iGridMidst+1, QUAD_TRIANG_TYPE_01_TO_10);
-            RingMeshBuilder.CreateMesh(iCurrGridStart, iGridMidst, iGridMidst, iGridMidst+1, iGridMidst+1, QUAD_TRIANG_TYPE_00_TO_11);
-            // clang-format on
-        }
-        else
+    // Align vertices on the outer boundary
+    if (iRing < iNumRings - 1)
+    {
+        for (int i = 1; i < iGridDimension - 1; i += 2)
         {
-            // clang-format off
-            RingMeshBuilder.CreateMesh(iCurrGridStart,            0,            0,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_00_TO_11);
-            RingMeshBuilder.CreateMesh(iCurrGridStart,   iGridQuart,            0,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_00_TO_11);
-
-            RingMeshBuilder.CreateMesh(iCurrGridStart,   iGridMidst,            0,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_01_TO_10);
-            RingMeshBuilder.CreateMesh(iCurrGridStart, iGridQuart*3,            0,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_01_TO_10);
-                                       
-            RingMeshBuilder.CreateMesh(iCurrGridStart,            0,   iGridQuart,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_00_TO_11);
-            RingMeshBuilder.CreateMesh(iCurrGridStart,            0,   iGridMidst,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_01_TO_10);
-                                       
-            RingMeshBuilder.CreateMesh(iCurrGridStart, iGridQuart*3,   iGridQuart,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_01_TO_10);
-            RingMeshBuilder.CreateMesh(iCurrGridStart, iGridQuart*3,   iGridMidst,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_00_TO_11);
-
-            RingMeshBuilder.CreateMesh(iCurrGridStart,            0, iGridQuart*3,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_01_TO_10);
-            RingMeshBuilder.CreateMesh(iCurrGridStart,   iGridQuart, iGridQuart*3,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_01_TO_10);
-
-            RingMeshBuilder.CreateMesh(iCurrGridStart,   iGridMidst, iGridQuart*3,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_00_TO_11);
-            RingMeshBuilder.CreateMesh(iCurrGridStart, iGridQuart*3, iGridQuart*3,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_00_TO_11);
-            // clang-format on
-        }
-    }
+            // Top & bottom boundaries
+            for (int iRow = 0; iRow < iGridDimension; iRow += iGridDimension - 1)
+            {
+                const auto& V0 = VB[i - 1 + iRow * iGridDimension].f3WorldPos;
+                auto&       V1 = VB[i + 0 + iRow * iGridDimension].f3WorldPos;
+                const auto& V2 = VB[i + 1 + iRow * iGridDimension].f3WorldPos;
+                V1             = (V0 + V2) / 2.f;
+            }
 
-    // We do not need per-vertex normals as we use normal map to shade terrain
-    // Sphere tangent vertex are computed in the shader
-#if 0
-    // Compute normals
-    const float3 *pV0 = nullptr;
-    const float3 *pV1 = &VB[ IB[0] ].f3WorldPos;
-    const float3 *pV2 = &VB[ IB[1] ].f3WorldPos;
-    float fSign = +1;
-    for(Uint32 Ind=2; Ind < m_uiIndicesInIndBuff; ++Ind)
-    {
-        fSign = -fSign;
-        pV0 = pV1;
-        pV1 = pV2;
-        pV2 =  &VB[ IB[Ind] ].f3WorldPos;
-        float3 Rib0 = *pV0 - *pV1;
-        float3 Rib1 = *pV1 - *pV2;
-        float3 TriN;
-        D3DXVec3Cross(&TriN, &Rib0, &Rib1);
-        float fLength = D3DXVec3Length(&TriN);
-        if( fLength > 0.1 )
-        {
-            TriN /= fLength*fSign;
-            for(int i=-2; i <= 0; ++i)
-                VB[ IB[Ind+i] ].f3Normal += TriN;
+            // Left & right boundaries
+            for (int iCol = 0; iCol < iGridDimension; iCol += iGridDimension - 1)
+            {
+                const auto& V0 = VB[iCol + (i - 1) * iGridDimension].f3WorldPos;
+                auto&       V1 = VB[iCol + (i + 0) * iGridDimension].f3WorldPos;
+                const auto& V2 = VB[iCol + (i + 1) * iGridDimension].f3WorldPos;
+                V1             = (V0 + V2) / 2.f;
+            }
         }
     }
-    for(auto VBIt=VB.begin(); VBIt != VB.end(); ++VBIt)
+
+    // Generate indices for the ring
+    RingMeshBuilder RingMeshBuilder(VB, iGridDimension, Ring.Meshes);
+    if (iRing == 0)
     {
-        float fLength = D3DXVec3Length(&VBIt->f3Normal);
-        if( fLength > 1 )
-            VBIt->f3Normal /= fLength;
+        // clang-format off
+        RingMeshBuilder.CreateMesh(0, 0,                   0, iGridMidst+1, iGridMidst+1, QUAD_TRIANG_TYPE_00_TO_11);
+        RingMeshBuilder.CreateMesh(0, iGridMidst,          0, iGridMidst+1, iGridMidst+1, QUAD_TRIANG_TYPE_01_TO_10);
+        RingMeshBuilder.CreateMesh(0, 0,          iGridMidst, iGridMidst+1, iGridMidst+1, QUAD_TRIANG_TYPE_01_TO_10);
+        RingMeshBuilder.CreateMesh(0, iGridMidst, iGridMidst, iGridMidst+1, iGridMidst+1, QUAD_TRIANG_TYPE_00_TO_11);
+        // clang-format on
     }
-
-    // Adjust normals on boundaries
-    for(int iRing = iStartRing; iRing < iNumRings-1; ++iRing)
+    else
     {
-        int iCurrGridStart = (iRing-iStartRing) * iGridDimension*iGridDimension;
-        int iNextGridStart = (iRing-iStartRing+1) * iGridDimension*iGridDimension;
-        for(int i=0; i < iGridDimension; i+=2)
-        {
-            for(int Bnd=0; Bnd < 2; ++Bnd)
-            {
-                const int CurrGridOffsets[] = {0, iGridDimension-1};
-                const int NextGridPffsets[] = {iGridQuart, iGridQuart*3};
-                // Left and right boundaries
-                {
-                    auto &CurrGridN = VB[iCurrGridStart + CurrGridOffsets[Bnd] + i*iGridDimension].f3Normal;
-                    auto &NextGridN = VB[iNextGridStart + NextGridPffsets[Bnd] + (iGridQuart+i/2)*iGridDimension].f3Normal;
-                    auto NewN = CurrGridN + NextGridN;
-                    D3DXVec3Normalize(&NewN, &NewN);
-                    CurrGridN = NextGridN = NewN;
-                    if( i > 1 )
-                    {
-                        auto &PrevCurrGridN = VB[iCurrGridStart + CurrGridOffsets[Bnd] + (i-2)*iGridDimension].f3Normal;
-                        auto MiddleN = PrevCurrGridN + NewN;
-                        D3DXVec3Normalize( &VB[iCurrGridStart + CurrGridOffsets[Bnd] + (i-1)*iGridDimension].f3Normal, &MiddleN);
-                    }
-                }
-
-                // Bottom and top boundaries
-                {
-                    auto &CurrGridN = VB[iCurrGridStart +                i + CurrGridOffsets[Bnd]*iGridDimension].f3Normal;
-                    auto &NextGridN = VB[iNextGridStart + (iGridQuart+i/2) + NextGridPffsets[Bnd]*iGridDimension].f3Normal;
-                    auto NewN = CurrGridN + NextGridN;
-                    D3DXVec3Normalize(&NewN, &NewN);
-                    CurrGridN = NextGridN = NewN;
-                    if( i > 1 )
-                    {
-                        auto &PrevCurrGridN = VB[iCurrGridStart + (i-2) + CurrGridOffsets[Bnd]*iGridDimension].f3Normal;
-                        auto MiddleN = PrevCurrGridN + NewN;
-                        D3DXVec3Normalize( &VB[iCurrGridStart + (i-1) + CurrGridOffsets[Bnd]*iGridDimension].f3Normal, &MiddleN);
-                    }
-                }
-            }
-        }
+        // clang-format off
+        RingMeshBuilder.CreateMesh(0,            0,            0,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_00_TO_11);
+        RingMeshBuilder.CreateMesh(0,   iGridQuart,            0,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_00_TO_11);
+
+        RingMeshBuilder.CreateMesh(0,   iGridMidst,            0,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_01_TO_10);
+        RingMeshBuilder.CreateMesh(0, iGridQuart*3,            0,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_01_TO_10);
+
+        RingMeshBuilder.CreateMesh(0,            0,   iGridQuart,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_00_TO_11);
+        RingMeshBuilder.CreateMesh(0,            0,   iGridMidst,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_01_TO_10);
+
+        RingMeshBuilder.CreateMesh(0, iGridQuart*3,   iGridQuart,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_01_TO_10);
+        RingMeshBuilder.CreateMesh(0, iGridQuart*3,   iGridMidst,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_00_TO_11);
+
+        RingMeshBuilder.CreateMesh(0,            0, iGridQuart*3,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_01_TO_10);
+        RingMeshBuilder.CreateMesh(0,   iGridQuart, iGridQuart*3,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_01_TO_10);
+
+        RingMeshBuilder.CreateMesh(0,   iGridMidst, iGridQuart*3,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_00_TO_11);
+        RingMeshBuilder.CreateMesh(0, iGridQuart*3, iGridQuart*3,   iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_00_TO_11);
+        // clang-format on
+
+        // The hole is triangulated the same way as ring 0
+        RingMeshBuilder FillMeshBuilder(VB, iGridDimension, Ring.FillMeshes);
+        // clang-format off
+        FillMeshBuilder.CreateMesh(0, iGridQuart, iGridQuart, iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_00_TO_11);
+        FillMeshBuilder.CreateMesh(0, iGridMidst, iGridQuart, iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_01_TO_10);
+        FillMeshBuilder.CreateMesh(0, iGridQuart, iGridMidst, iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_01_TO_10);
+        FillMeshBuilder.CreateMesh(0, iGridMidst, iGridMidst, iGridQuart+1, iGridQuart+1, QUAD_TRIANG_TYPE_00_TO_11);
+        // clang-format on
     }
-#endif
+
+    // We do not need per-vertex normals as we use normal map to shade terrain
+    // Sphere tangent vertex are computed in the shader
 }
 
 
-void EarthHemsiphere::RenderNormalMap(IRenderDevice*  pDevice,
-                                      IDeviceContext* pContext,
-                                      const Uint16*   pHeightMap,
-                                      size_t          HeightMapStride,
-                                      int             iHeightMapDim,
-                                      ITexture*       ptex2DNormalMap)
+void EarthHemsiphere::RenderNormalMap(IRenderDevice*             pDevice,
+                                      IDeviceContext*            pContext,
+                                      const ElevationDataSource* pDataSource,
+                                      ITexture*                  ptex2DNormalMap)
 {
     TextureDesc HeightMapDesc;
     HeightMapDesc.Name      = "Height map texture";
     HeightMapDesc.Type      = RESOURCE_DIM_TEX_2D;
-    HeightMapDesc.Width     = iHeightMapDim;
-    HeightMapDesc.Height    = iHeightMapDim;
+    HeightMapDesc.Width     = pDataSource->GetNumCols();
+    HeightMapDesc.Height    = pDataSource->GetNumRows();
     HeightMapDesc.Format    = TEX_FORMAT_R16_UINT;
-    HeightMapDesc.Usage     = USAGE_IMMUTABLE;
+    HeightMapDesc.Usage     = USAGE_DEFAULT;
     HeightMapDesc.BindFlags = BIND_SHADER_RESOURCE;
-    HeightMapDesc.MipLevels = ComputeMipLevelsCount(HeightMapDesc.Width, HeightMapDesc.Height);
-
-    // Stack all coarse mip levels on top of each other with the same stride
-    //    __________
-    //   |__|__     |
-    //   |     |    |
-    //   |_____|____|
-    //   |          |
-    //   |          |
-    //   |          |
-    //   |__________|
-    std::vector<Uint16> CoarseMipLevels;
-    CoarseMipLevels.resize(static_cast<size_t>(iHeightMapDim) / 2 * iHeightMapDim);
-
-    std::vector<TextureSubResData> InitData(HeightMapDesc.MipLevels);
-    InitData[0].pData            = pHeightMap;
-    InitData[0].Stride           = (Uint32)HeightMapStride * sizeof(pHeightMap[0]);
-    const Uint16* pFinerMipLevel = pHeightMap;
-    Uint16*       pCurrMipLevel  = &CoarseMipLevels[0];
-    size_t        FinerMipStride = HeightMapStride;
-    size_t        CurrMipStride  = iHeightMapDim / 2;
-    for (Uint32 uiMipLevel = 1; uiMipLevel < HeightMapDesc.MipLevels; ++uiMipLevel)
-    {
-        const auto MipProps = GetMipLevelProperties(HeightMapDesc, uiMipLevel);
-        for (size_t Row = 0; Row < MipProps.LogicalHeight; ++Row)
+    HeightMapDesc.MipLevels = pDataSource->GetNumMipLevels();
+    VERIFY_EXPR(HeightMapDesc.MipLevels == ComputeMipLevelsCount(HeightMapDesc.Width, HeightMapDesc.Height));
+
+    RefCntAutoPtr<ITexture> ptex2DHeightMap;
+    pDevice->CreateTexture(HeightMapDesc, nullptr, &ptex2DHeightMap);
+    VERIFY(ptex2DHeightMap, "Failed to create height map texture");
+
+    // All mip levels are precomputed by the data source. The entire texture is uploaded, as the normal
+    // map and the CDLOD vertex shaders sample the whole terrain. Tiles are copied straight from the
+    // tiled data, so no intermediate copy of the level is made.
+    const Uint32 TileSize = pDataSource->GetTileSize();
+    for (Uint32 uiMipLevel = 0; uiMipLevel < HeightMapDesc.MipLevels; ++uiMipLevel)
+    {
+        const auto& MipLevel = pDataSource->GetMipLevel(uiMipLevel);
+        for (Uint32 TileY = 0; TileY < MipLevel.NumTilesY; ++TileY)
         {
-            for (size_t Col = 0; Col < MipProps.LogicalWidth; ++Col)
+            for (Uint32 TileX = 0; TileX < MipLevel.NumTilesX; ++TileX)
             {
-                int iAverageHeight = 0;
-                for (size_t i = 0; i < 2; ++i)
-                {
-                    for (size_t j = 0; j < 2; ++j)
-                    {
-                        iAverageHeight += pFinerMipLevel[(Col * 2 + i) + (Row * 2 + j) * size_t{FinerMipStride}];
-                    }
-                }
-                pCurrMipLevel[Col + Row * CurrMipStride] = (Uint16)(iAverageHeight >> 2);
+                TextureSubResData SubresData;
+                SubresData.pData  = pDataSource->GetTile(TileX, TileY, uiMipLevel);
+                SubresData.Stride = Uint64{TileSize} * sizeof(Uint16);
+
+                Box TileBox;
+                TileBox.MinX = TileX * TileSize;
+                TileBox.MaxX = std::min(TileBox.MinX + TileSize, MipLevel.Width);
+                TileBox.MinY = TileY * TileSize;
+                TileBox.MaxY = std::min(TileBox.MinY + TileSize, MipLevel.Height);
+                pContext->UpdateTexture(ptex2DHeightMap, uiMipLevel, 0, TileBox, SubresData, RESOURCE_STATE_TRANSITION_MODE_NONE, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
             }
         }
-
-        InitData[uiMipLevel].pData  = pCurrMipLevel;
-        InitData[uiMipLevel].Stride = (Uint32)CurrMipStride * sizeof(*pCurrMipLevel);
-        pFinerMipLevel              = pCurrMipLevel;
-        FinerMipStride              = CurrMipStride;
-        pCurrMipLevel += MipProps.LogicalHeight * CurrMipStride;
-        CurrMipStride = iHeightMapDim / 2; // Same stride for all mips
     }
 
-    RefCntAutoPtr<ITexture> ptex2DHeightMap;
-    TextureData             HeigtMapInitData;
-    HeigtMapInitData.pSubResources   = InitData.data();
-    HeigtMapInitData.NumSubresources = (Uint32)InitData.size();
-    pDevice->CreateTexture(HeightMapDesc, &HeigtMapInitData, &ptex2DHeightMap);
-    VERIFY(ptex2DHeightMap, "Failed to create height map texture");
-
     m_pResMapping->AddResource("g_tex2DElevationMap", ptex2DHeightMap->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE), true);
 
     RefCntAutoPtr<IBuffer> pcbNMGenerationAttribs;
@@ -603,8 +560,7 @@ void EarthHemsiphere::RenderNormalMap(IRenderDevice*  pDevice,
         pContext->Draw(DrawAttrs);
     }
 
-    // Remove elevation map from resource mapping to release the resource
-    m_pResMapping->RemoveResourceByName("g_tex2DElevationMap");
+    // Elevation map stays in the resource mapping as it is also sampled by the CDLOD vertex shaders
 }
 
 
@@ -641,9 +597,6 @@ void EarthHemsiphere::Create(class ElevationDataSource* pDataSource,
         CreateRenderStateNotationLoader({m_pDevice, pRSNParser, pCompoundFactory}, &m_pRSNLoader);
     }
 
-    const Uint16* pHeightMap;
-    size_t        HeightMapPitch;
-    pDataSource->GetDataPtr(pHeightMap, HeightMapPitch);
     Uint32 iHeightMapDim = pDataSource->GetNumCols();
     VERIFY_EXPR(iHeightMapDim == pDataSource->GetNumRows());
 
@@ -708,7 +661,8 @@ void EarthHemsiphere::Create(class ElevationDataSource* pDataSource,
 
     m_pDevice->CreateSampler(Sam_ComparisonLinearClamp, &m_pComparisonSampler);
 
-    RenderNormalMap(pDevice, pContext, pHeightMap, HeightMapPitch, iHeightMapDim, ptex2DNormalMap);
+    RenderNormalMap(pDevice, pContext, pDataSource, ptex2DNormalMap);
+    CreateCDLODResources(pDevice, pContext, pDataSource);
 
     {
         auto ShaderCallback = MakeCallback([&](ShaderCreateInfo& ShaderCI, SHADER_TYPE ShaderType, bool& IsAddToCache) {
@@ -723,37 +677,411 @@ void EarthHemsiphere::Create(class ElevationDataSource* pDataSource,
         m_pRSNLoader->LoadPipelineState({"Render Hemisphere Z Only", PIPELINE_TYPE_GRAPHICS, false, PipelineCallback, PipelineCallback, ShaderCallback, ShaderCallback}, &m_pHemisphereZOnlyPSO);
         m_pHemisphereZOnlyPSO->BindStaticResources(SHADER_TYPE_VERTEX | SHADER_TYPE_PIXEL, m_pResMapping, BIND_SHADER_RESOURCES_VERIFY_ALL_RESOLVED);
         m_pHemisphereZOnlyPSO->CreateShaderResourceBinding(&m_pHemisphereZOnlySRB, true);
+
+        m_pRSNLoader->LoadPipelineState({"Render Hemisphere CDLOD Z Only", PIPELINE_TYPE_GRAPHICS, false, PipelineCallback, PipelineCallback, ShaderCallback, ShaderCallback}, &m_pHemisphereCDLODZOnlyPSO);
+        m_pHemisphereCDLODZOnlyPSO->BindStaticResources(SHADER_TYPE_VERTEX | SHADER_TYPE_PIXEL, m_pResMapping, BIND_SHADER_RESOURCES_VERIFY_ALL_RESOLVED);
+        m_pHemisphereCDLODZOnlyPSO->CreateShaderResourceBinding(&m_pHemisphereCDLODZOnlySRB, true);
     }
 
-    std::vector<HemisphereVertex> VB;
-    GenerateSphereGeometry(pDevice, Diligent::AirScatteringAttribs().fEarthRadius, m_Params.m_iRingDimension, m_Params.m_iNumRings, pDataSource, m_Params.m_TerrainAttribs.m_fElevationSamplingInterval, m_Params.m_TerrainAttribs.m_fElevationScale, VB, m_SphereMeshes);
-
-    BufferDesc VBDesc;
-    VBDesc.Name      = "Hemisphere vertex buffer";
-    VBDesc.Size      = static_cast<Uint64>(VB.size() * sizeof(VB[0]));
-    VBDesc.Usage     = USAGE_IMMUTABLE;
-    VBDesc.BindFlags = BIND_VERTEX_BUFFER;
-    BufferData VBInitData;
-    VBInitData.pData    = VB.data();
-    VBInitData.DataSize = VBDesc.Size;
-    pDevice->CreateBuffer(VBDesc, &VBInitData, &m_pVertBuff);
-    VERIFY(m_pVertBuff, "Failed to create VB");
+    if ((m_Params.m_iRingDimension - 1) % 4 != 0)
+    {
+        m_Params.m_iRingDimension = RenderingParams().m_iRingDimension;
+        UNEXPECTED("Grid dimension must be 4k+1. Defaulting to ", m_Params.m_iRingDimension);
+    }
+
+    // Rings are generated on a background thread from the coarsest to the finest one, and
+    // are uploaded by Render() as soon as they are ready
+    const int   iNumRings         = m_Params.m_iNumRings;
+    const int   iGridDimension    = m_Params.m_iRingDimension;
+    const float fEarthRadius      = AirScatteringAttribs().fEarthRadius;
+    const float fSamplingInterval = m_Params.m_TerrainAttribs.m_fElevationSamplingInterval;
+    const float fElevationScale   = m_Params.m_TerrainAttribs.m_fElevationScale;
+
+    m_Rings.resize(iNumRings);
+    m_iFinestReadyRing        = iNumRings;
+    m_RingGenerationStartTime = std::chrono::high_resolution_clock::now();
+    m_RingGenerationThread    = std::thread{[this, pDataSource, iNumRings, iGridDimension, fEarthRadius, fSamplingInterval, fElevationScale]() {
+        for (int iRing = iNumRings - 1; iRing >= 0 && !m_bStopRingGeneration; --iRing)
+        {
+            auto pRing = std::make_unique<RingGeometryData>();
+            GenerateRingGeometry(iRing, iNumRings, iGridDimension, fEarthRadius, pDataSource, fSamplingInterval, fElevationScale, *pRing);
+
+            std::lock_guard<std::mutex> Lock{m_ReadyRingsMtx};
+            m_ReadyRings.emplace_back(std::move(pRing));
+        }
+    }};
 }
 
-void EarthHemsiphere::Render(IDeviceContext*        pContext,
-                             const RenderingParams& NewParams,
-                             const float3&          vCameraPosition,
-                             const float4x4&        CameraViewProjMatrix,
-                             ITextureView*          pShadowMapSRV,
-                             ITextureView*          pPrecomputedNetDensitySRV,
-                             ITextureView*          pAmbientSkylightSRV,
-                             bool                   bZOnlyPass)
+EarthHemsiphere::EarthHemsiphere() :
+    m_ValidShaders(0)
+{}
+
+EarthHemsiphere::~EarthHemsiphere()
+{
+    m_bStopRingGeneration = true;
+    if (m_RingGenerationThread.joinable())
+        m_RingGenerationThread.join();
+}
+
+void EarthHemsiphere::UploadReadyRings(IDeviceContext* pContext)
+{
+    std::vector<std::unique_ptr<RingGeometryData>> ReadyRings;
+    {
+        std::lock_guard<std::mutex> Lock{m_ReadyRingsMtx};
+        ReadyRings.swap(m_ReadyRings);
+    }
+    if (ReadyRings.empty())
+        return;
+
+    for (const auto& pRingData : ReadyRings)
+    {
+        auto& Ring = m_Rings[pRingData->iRing];
+
+        BufferDesc VBDesc;
+        VBDesc.Name      = "Hemisphere ring vertex buffer";
+        VBDesc.Size      = static_cast<Uint64>(pRingData->VB.size() * sizeof(pRingData->VB[0]));
+        VBDesc.Usage     = USAGE_IMMUTABLE;
+        VBDesc.BindFlags = BIND_VERTEX_BUFFER;
+        BufferData VBInitData;
+        VBInitData.pData    = pRingData->VB.data();
+        VBInitData.DataSize = VBDesc.Size;
+        m_pDevice->CreateBuffer(VBDesc, &VBInitData, &Ring.pVertBuff);
+        VERIFY(Ring.pVertBuff, "Failed to create VB");
+
+        Ring.Meshes.resize(pRingData->Meshes.size());
+        for (size_t i = 0; i < pRingData->Meshes.size(); ++i)
+            CreateRingSectorMesh(m_pDevice, pRingData->Meshes[i], Ring.Meshes[i]);
+
+        Ring.FillMeshes.resize(pRingData->FillMeshes.size());
+        for (size_t i = 0; i < pRingData->FillMeshes.size(); ++i)
+            CreateRingSectorMesh(m_pDevice, pRingData->FillMeshes[i], Ring.FillMeshes[i]);
+
+        // Depth-only passes recorded on deferred contexts only verify the states
+        std::vector<StateTransitionDesc> Barriers;
+        Barriers.emplace_back(Ring.pVertBuff, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_VERTEX_BUFFER, STATE_TRANSITION_FLAG_UPDATE_STATE);
+        for (const auto* pMeshes : {&Ring.Meshes, &Ring.FillMeshes})
+        {
+            for (const auto& Mesh : *pMeshes)
+                Barriers.emplace_back(Mesh.pIndBuff, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_INDEX_BUFFER, STATE_TRANSITION_FLAG_UPDATE_STATE);
+        }
+        pContext->TransitionResourceStates(static_cast<Uint32>(Barriers.size()), Barriers.data());
+
+        // Rings are generated from the coarsest to the finest one
+        VERIFY_EXPR(pRingData->iRing == m_iFinestReadyRing - 1);
+        m_iFinestReadyRing = pRingData->iRing;
+    }
+    ++m_GeometryRevision;
+
+    const auto ElapsedMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_RingGenerationStartTime).count();
+    if (m_iFinestReadyRing == 0)
+    {
+        LOG_INFO_MESSAGE("Terrain geometry reached full detail in ", ElapsedMs, " ms");
+        m_RingGenerationThread.join();
+    }
+    else if (m_iFinestReadyRing + static_cast<int>(ReadyRings.size()) == static_cast<int>(m_Rings.size()))
+    {
+        LOG_INFO_MESSAGE("First terrain ring is ready in ", ElapsedMs, " ms");
+    }
+}
+
+void EarthHemsiphere::CreateCDLODResources(IRenderDevice* pDevice, IDeviceContext* pContext, const ElevationDataSource* pDataSource)
+{
+    // All patches are instances of the same regular grid
+    std::vector<float2> PatchVerts;
+    PatchVerts.reserve((CDLODPatchQuads + 1) * (CDLODPatchQuads + 1));
+    for (Uint32 Row = 0; Row <= CDLODPatchQuads; ++Row)
+    {
+        for (Uint32 Col = 0; Col <= CDLODPatchQuads; ++Col)
+            PatchVerts.emplace_back(static_cast<float>(Col), static_cast<float>(Row));
+    }
+
+    std::vector<Uint16> PatchInds;
+    PatchInds.reserve(CDLODPatchQuads * CDLODPatchQuads * 6);
+    for (Uint32 Row = 0; Row < CDLODPatchQuads; ++Row)
+    {
+        for (Uint32 Col = 0; Col < CDLODPatchQuads; ++Col)
+        {
+            const Uint16 V00 = static_cast<Uint16>(Col + Row * (CDLODPatchQuads + 1));
+            const Uint16 V10 = static_cast<Uint16>(V00 + 1);
+            const Uint16 V01 = static_cast<Uint16>(V00 + CDLODPatchQuads + 1);
+            const Uint16 V11 = static_cast<Uint16>(V01 + 1);
+            // Same winding as the ring meshes
+            PatchInds.insert(PatchInds.end(), {V00, V01, V10, V10, V01, V11});
+        }
+    }
+    m_CDLODPatchNumIndices = static_cast<Uint32>(PatchInds.size());
+
+    {
+        BufferDesc VBDesc;
+        VBDesc.Name      = "CDLOD patch vertex buffer";
+        VBDesc.Size      = static_cast<Uint64>(PatchVerts.size() * sizeof(PatchVerts[0]));
+        VBDesc.Usage     = USAGE_IMMUTABLE;
+        VBDesc.BindFlags = BIND_VERTEX_BUFFER;
+        BufferData VBInitData{PatchVerts.data(), VBDesc.Size};
+        pDevice->CreateBuffer(VBDesc, &VBInitData, &m_pCDLODPatchVB);
+        VERIFY(m_pCDLODPatchVB, "Failed to create CDLOD patch VB");
+    }
+
+    {
+        BufferDesc IBDesc;
+        IBDesc.Name      = "CDLOD patch index buffer";
+        IBDesc.Size      = static_cast<Uint64>(PatchInds.size() * sizeof(PatchInds[0]));
+        IBDesc.Usage     = USAGE_IMMUTABLE;
+        IBDesc.BindFlags = BIND_INDEX_BUFFER;
+        BufferData IBInitData{PatchInds.data(), IBDesc.Size};
+        pDevice->CreateBuffer(IBDesc, &IBInitData, &m_pCDLODPatchIB);
+        VERIFY(m_pCDLODPatchIB, "Failed to create CDLOD patch IB");
+    }
+
+    // clang-format off
+    StateTransitionDesc Barriers[] =
+    {
+        {m_pCDLODPatchVB, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_VERTEX_BUFFER, STATE_TRANSITION_FLAG_UPDATE_STATE},
+        {m_pCDLODPatchIB, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_INDEX_BUFFER,  STATE_TRANSITION_FLAG_UPDATE_STATE}
+    };
+    // clang-format on
+    pContext->TransitionResourceStates(_countof(Barriers), Barriers);
+
+    CreateUniformBuffer(pDevice, sizeof(CDLODAttribs), "CDLOD Attribs CB", &m_pcbCDLODAttribs);
+    m_pResMapping->AddResource("cbCDLODAttribs", m_pcbCDLODAttribs, true);
+
+    const float fEarthRadius      = AirScatteringAttribs().fEarthRadius;
+    const float fSamplingInterval = m_Params.m_TerrainAttribs.m_fElevationSamplingInterval;
+    const int   iMaxElevationMip  = static_cast<int>(pDataSource->GetNumMipLevels()) - 1;
+
+    m_CDLODAttribs.m_fEarthRadius        = fEarthRadius;
+    m_CDLODAttribs.m_fPatchQuads         = static_cast<float>(CDLODPatchQuads);
+    m_CDLODAttribs.m_iElevationMapWidth  = static_cast<int>(pDataSource->GetNumCols());
+    m_CDLODAttribs.m_iElevationMapHeight = static_cast<int>(pDataSource->GetNumRows());
+    m_CDLODAttribs.m_iMaxElevationMip    = iMaxElevationMip;
+    pDataSource->GetOffsets(m_CDLODAttribs.m_iColOffset, m_CDLODAttribs.m_iRowOffset);
+
+    // The global elevation range is used to bound all nodes
+    m_fMinDisplacement = static_cast<float>(pDataSource->GetGlobalMinElevation()) * m_Params.m_TerrainAttribs.m_fElevationScale;
+    m_fMaxDisplacement = static_cast<float>(pDataSource->GetGlobalMaxElevation()) * m_Params.m_TerrainAttribs.m_fElevationScale;
+
+    // The root node covers the entire [-1,1]x[-1,1] domain. Subdivide until the finest
+    // patch has approximately one vertex per elevation sample.
+    const float fLeafWorldSize = static_cast<float>(CDLODPatchQuads) * fSamplingInterval;
+    int         NumLevels      = 1;
+    while (NumLevels < 24 && 2.f * fEarthRadius / static_cast<float>(1 << (NumLevels - 1)) > fLeafWorldSize)
+        ++NumLevels;
+
+    m_CDLODLevels.resize(NumLevels);
+    for (int iLevel = 0; iLevel < NumLevels; ++iLevel)
+    {
+        auto& Level       = m_CDLODLevels[iLevel];
+        Level.fDomainSize = 2.f / static_cast<float>(1 << (NumLevels - 1 - iLevel));
+        Level.fWorldSize  = Level.fDomainSize * fEarthRadius;
+
+        // Select the mip level whose sampling interval matches the patch vertex spacing
+        const float fSamplesPerQuad = Level.fWorldSize / static_cast<float>(CDLODPatchQuads) / fSamplingInterval;
+        Level.iElevationMip         = clamp(static_cast<int>(std::floor(std::log2(std::max(fSamplesPerQuad, 1.f)))), 0, iMaxElevationMip);
+    }
+}
+
+void EarthHemsiphere::SelectCDLODNodes(const float2&                    f2NodeOrigin,
+                                       int                              iLevel,
+                                       const float3&                    f3CameraPos,
+                                       const ViewFrustumExt&            ViewFrustum,
+                                       FRUSTUM_PLANE_FLAGS              FrustumPlanes,
+                                       bool                             bHorizonCulling,
+                                       bool                             bFullyVisible,
+                                       std::vector<CDLODPatchInstance>& Instances) const
+{
+    const auto& Level        = m_CDLODLevels[iLevel];
+    const float fEarthRadius = m_CDLODAttribs.m_fEarthRadius;
+
+    // Bound the displaced surface of the node using a 3x3 grid of points
+    float3 f3GridPoints[3][3];
+    for (int j = 0; j < 3; ++j)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            const float2 f2Domain = f2NodeOrigin + float2{static_cast<float>(i), static_cast<float>(j)} * (Level.fDomainSize * 0.5f);
+            f3GridPoints[j][i]    = DomainToSphere(f2Domain, fEarthRadius);
+        }
+    }
+
+    BoundBox BndBox{float3{+FLT_MAX, +FLT_MAX, +FLT_MAX}, float3{-FLT_MAX, -FLT_MAX, -FLT_MAX}};
+    float    fMaxChordSqr = 0;
+    for (int j = 0; j < 3; ++j)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            const float3& f3Pos    = f3GridPoints[j][i];
+            const float3  f3Normal = normalize(f3Pos);
+            for (float fDispl : {m_fMinDisplacement, m_fMaxDisplacement})
+            {
+                float3 f3PosWS = f3Pos + f3Normal * fDispl;
+                f3PosWS.y -= fEarthRadius;
+                BndBox.Min = std::min(BndBox.Min, f3PosWS);
+                BndBox.Max = std::max(BndBox.Max, f3PosWS);
+            }
+            if (i < 2)
+                fMaxChordSqr = std::max(fMaxChordSqr, dot(f3GridPoints[j][i + 1] - f3Pos, f3GridPoints[j][i + 1] - f3Pos));
+            if (j < 2)
+                fMaxChordSqr = std::max(fMaxChordSqr, dot(f3GridPoints[j + 1][i] - f3Pos, f3GridPoints[j + 1][i] - f3Pos));
+        }
+    }
+    // The sphere bulges between the grid points by at most the sagitta of the chord
+    const float fSagitta = fMaxChordSqr / (8.f * fEarthRadius);
+    BndBox.Min -= float3{fSagitta, fSagitta, fSagitta};
+    BndBox.Max += float3{fSagitta, fSagitta, fSagitta};
+
+    // Children of a fully visible node are fully visible too
+    if (!bFullyVisible)
+    {
+        const auto Visibility = GetBoxVisibility(ViewFrustum, BndBox, FrustumPlanes);
+        if (Visibility == BoxVisibility::Invisible)
+            return;
+        bFullyVisible = Visibility == BoxVisibility::FullyVisible;
+    }
+
+    // Cull the node if all corners of its box are hidden behind the lowest terrain surface
+    if (bHorizonCulling)
+    {
+        const float3 f3EarthCenter{0, -fEarthRadius, 0};
+        const float  fOccluderRadius = fEarthRadius + std::min(m_fMinDisplacement, 0.f);
+        bool         bBelowHorizon   = true;
+        for (int iCorner = 0; iCorner < 8 && bBelowHorizon; ++iCorner)
+        {
+            const float3 f3Corner{
+                (iCorner & 0x01) ? BndBox.Max.x : BndBox.Min.x,
+                (iCorner & 0x02) ? BndBox.Max.y : BndBox.Min.y,
+                (iCorner & 0x04) ? BndBox.Max.z : BndBox.Min.z,
+            };
+            bBelowHorizon = IsBelowHorizon(f3CameraPos - f3EarthCenter, f3Corner - f3EarthCenter, fOccluderRadius);
+        }
+        if (bBelowHorizon)
+            return;
+    }
+
+    // Subdivide the node if any part of it is within the range of the finer level
+    if (iLevel > 0)
+    {
+        const float3 f3ClosestPt = std::max(BndBox.Min, std::min(f3CameraPos, BndBox.Max));
+        if (length(f3ClosestPt - f3CameraPos) < m_CDLODLevels[iLevel - 1].fRange)
+        {
+            const float fChildSize = Level.fDomainSize * 0.5f;
+            for (int iChild = 0; iChild < 4; ++iChild)
+            {
+                const float2 f2ChildOrigin = f2NodeOrigin + float2{static_cast<float>(iChild & 0x01), static_cast<float>(iChild >> 1)} * fChildSize;
+                SelectCDLODNodes(f2ChildOrigin, iLevel - 1, f3CameraPos, ViewFrustum, FrustumPlanes, bHorizonCulling, bFullyVisible, Instances);
+            }
+            return;
+        }
+    }
+
+    CDLODPatchInstance Instance;
+    Instance.f4NodeRect    = float4{f2NodeOrigin.x, f2NodeOrigin.y, Level.fDomainSize, static_cast<float>(Level.iElevationMip)};
+    Instance.f4MorphParams = float4{Level.fMorphStart, Level.fRange, 0, 0};
+    Instances.push_back(Instance);
+}
+
+void EarthHemsiphere::UpdateCDLODRanges()
+{
+    // Level i is used up to the distance from which the vertex spacing of level i+1 projects
+    // to no more than the allowed pixel error. The range is also kept at least twice the node
+    // size so that neighboring nodes never differ by more than one level.
+    const float fRangeScale = m_Params.m_fLODScreenScale / std::max(m_Params.m_fCDLODPixelError, 0.1f);
+    float       fPrevRange  = 0;
+    for (size_t iLevel = 0; iLevel < m_CDLODLevels.size(); ++iLevel)
+    {
+        auto& Level = m_CDLODLevels[iLevel];
+        if (iLevel + 1 < m_CDLODLevels.size())
+        {
+            const float fCoarserSpacing = m_CDLODLevels[iLevel + 1].fWorldSize / static_cast<float>(CDLODPatchQuads);
+            Level.fRange                = std::max({fCoarserSpacing * fRangeScale, Level.fWorldSize * 2.f, fPrevRange * 2.f});
+            Level.fMorphStart           = fPrevRange + (Level.fRange - fPrevRange) * 0.7f;
+        }
+        else
+        {
+            // There is no coarser level to morph to
+            Level.fRange      = 1e+20f;
+            Level.fMorphStart = 1e+20f;
+        }
+        fPrevRange = Level.fRange;
+    }
+
+    m_CDLODAttribs.m_fElevationScale            = m_Params.m_TerrainAttribs.m_fElevationScale;
+    m_CDLODAttribs.m_fElevationSamplingInterval = m_Params.m_TerrainAttribs.m_fElevationSamplingInterval;
+}
+
+void EarthHemsiphere::RenderCDLOD(IDeviceContext*                pContext,
+                                  const float3&                  vCameraPosition,
+                                  const ViewFrustumExt&          ViewFrustum,
+                                  bool                           bZOnlyPass,
+                                  RESOURCE_STATE_TRANSITION_MODE StateTransitionMode)
+{
+    // Depth-only passes may run concurrently and use their own node list
+    std::vector<CDLODPatchInstance>  ZOnlyInstances;
+    std::vector<CDLODPatchInstance>& Instances = bZOnlyPass ? ZOnlyInstances : m_CDLODInstances;
+
+    // Terrain hidden behind the horizon may still cast shadows onto the visible terrain,
+    // so horizon culling is only used for the camera pass.
+    Instances.clear();
+    SelectCDLODNodes(float2{-1, -1}, static_cast<int>(m_CDLODLevels.size()) - 1, vCameraPosition, ViewFrustum,
+                     bZOnlyPass ? FRUSTUM_PLANE_FLAG_OPEN_NEAR : FRUSTUM_PLANE_FLAG_FULL_FRUSTUM, !bZOnlyPass, false, Instances);
+
+    const Uint32 NumInstances = static_cast<Uint32>(Instances.size());
+    if (!bZOnlyPass)
+    {
+        m_CDLODStats.NumPatches   = NumInstances;
+        m_CDLODStats.NumTriangles = NumInstances * m_CDLODPatchNumIndices / 3;
+    }
+    if (NumInstances == 0)
+        return;
+
+    // Dynamic buffers are mapped independently in every context. The pass keeps its own
+    // reference, so the buffer it maps stays alive if another pass grows it.
+    RefCntAutoPtr<IBuffer> pInstanceBuffer;
+    {
+        std::lock_guard<std::mutex> Lock{m_CDLODInstanceBufferMtx};
+        if (NumInstances > m_CDLODInstanceCapacity)
+        {
+            m_CDLODInstanceCapacity = std::max(NumInstances, m_CDLODInstanceCapacity * 2);
+            m_pCDLODInstanceBuffer.Release();
+
+            BufferDesc InstBuffDesc;
+            InstBuffDesc.Name           = "CDLOD instance buffer";
+            InstBuffDesc.Size           = Uint64{m_CDLODInstanceCapacity} * sizeof(CDLODPatchInstance);
+            InstBuffDesc.Usage          = USAGE_DYNAMIC;
+            InstBuffDesc.BindFlags      = BIND_VERTEX_BUFFER;
+            InstBuffDesc.CPUAccessFlags = CPU_ACCESS_WRITE;
+            m_pDevice->CreateBuffer(InstBuffDesc, nullptr, &m_pCDLODInstanceBuffer);
+            VERIFY(m_pCDLODInstanceBuffer, "Failed to create CDLOD instance buffer");
+        }
+        pInstanceBuffer = m_pCDLODInstanceBuffer;
+    }
+
+    {
+        MapHelper<CDLODPatchInstance> MappedInstances(pContext, pInstanceBuffer, MAP_WRITE, MAP_FLAG_DISCARD);
+        memcpy(MappedInstances, Instances.data(), NumInstances * sizeof(CDLODPatchInstance));
+    }
+
+    {
+        MapHelper<CDLODAttribs> Attribs(pContext, m_pcbCDLODAttribs, MAP_WRITE, MAP_FLAG_DISCARD);
+        *Attribs                  = m_CDLODAttribs;
+        Attribs->f4MorphCameraPos = float4{vCameraPosition, 1};
+    }
+
+    IBuffer* ppBuffers[] = {m_pCDLODPatchVB, pInstanceBuffer};
+    pContext->SetVertexBuffers(0, _countof(ppBuffers), ppBuffers, nullptr, StateTransitionMode, SET_VERTEX_BUFFERS_FLAG_RESET);
+    pContext->SetIndexBuffer(m_pCDLODPatchIB, 0, StateTransitionMode);
+
+    DrawIndexedAttribs DrawAttrs{m_CDLODPatchNumIndices, VT_UINT16, DRAW_FLAG_VERIFY_ALL, NumInstances};
+    pContext->DrawIndexed(DrawAttrs);
+}
+
+void EarthHemsiphere::Update(IDeviceContext* pContext, const RenderingParams& NewParams)
 {
     if (m_Params.m_iNumShadowCascades != NewParams.m_iNumShadowCascades ||
         m_Params.m_bBestCascadeSearch != NewParams.m_bBestCascadeSearch ||
         m_Params.m_FilterAcrossShadowCascades != NewParams.m_FilterAcrossShadowCascades ||
         m_Params.m_FixedShadowFilterSize != NewParams.m_FixedShadowFilterSize ||
-        m_Params.DstRTVFormat != NewParams.DstRTVFormat)
+        m_Params.DstRTVFormat != NewParams.DstRTVFormat ||
+        m_Params.m_bUseCDLOD != NewParams.m_bUseCDLOD)
     {
         m_pHemispherePSO.Release();
         m_pHemisphereSRB.Release();
@@ -761,6 +1089,77 @@ void EarthHemsiphere::Render(IDeviceContext*        pContext,
 
     m_Params = NewParams;
 
+    UploadReadyRings(pContext);
+
+    if (m_Params.m_bUseCDLOD)
+    {
+        UpdateCDLODRanges();
+        pContext->TransitionShaderResources(m_pHemisphereCDLODZOnlySRB);
+    }
+}
+
+void EarthHemsiphere::RenderZOnly(IDeviceContext*                pContext,
+                                  const float3&                  vCameraPosition,
+                                  const float4x4&                CameraViewProjMatrix,
+                                  RESOURCE_STATE_TRANSITION_MODE StateTransitionMode)
+{
+    ViewFrustumExt ViewFrustum;
+    auto           DevType = m_pDevice->GetDeviceInfo().Type;
+    ExtractViewFrustumPlanesFromMatrix(CameraViewProjMatrix, ViewFrustum, DevType == RENDER_DEVICE_TYPE_D3D11 || DevType == RENDER_DEVICE_TYPE_D3D12);
+
+    if (m_Params.m_bUseCDLOD)
+    {
+        pContext->SetPipelineState(m_pHemisphereCDLODZOnlyPSO);
+        pContext->CommitShaderResources(m_pHemisphereCDLODZOnlySRB, StateTransitionMode);
+        RenderCDLOD(pContext, vCameraPosition, ViewFrustum, true, StateTransitionMode);
+        return;
+    }
+
+    pContext->SetPipelineState(m_pHemisphereZOnlyPSO);
+    pContext->CommitShaderResources(m_pHemisphereZOnlySRB, StateTransitionMode);
+
+    auto DrawMeshes = [&](const std::vector<RingSectorMesh>& Meshes) {
+        for (const auto& Mesh : Meshes)
+        {
+            if (GetBoxVisibility(ViewFrustum, Mesh.BndBox, FRUSTUM_PLANE_FLAG_OPEN_NEAR) != BoxVisibility::Invisible)
+            {
+                pContext->SetIndexBuffer(Mesh.pIndBuff, 0, StateTransitionMode);
+                DrawIndexedAttribs DrawAttrs(Mesh.uiNumIndices, VT_UINT32, DRAW_FLAG_VERIFY_ALL);
+                pContext->DrawIndexed(DrawAttrs);
+            }
+        }
+    };
+
+    for (int iRing = m_iFinestReadyRing; iRing < static_cast<int>(m_Rings.size()); ++iRing)
+    {
+        const auto& Ring = m_Rings[iRing];
+
+        IBuffer* ppBuffers[1] = {Ring.pVertBuff};
+        pContext->SetVertexBuffers(0, 1, ppBuffers, nullptr, StateTransitionMode, SET_VERTEX_BUFFERS_FLAG_RESET);
+
+        DrawMeshes(Ring.Meshes);
+        if (iRing == m_iFinestReadyRing)
+            DrawMeshes(Ring.FillMeshes);
+    }
+}
+
+void EarthHemsiphere::Render(IDeviceContext*        pContext,
+                             const RenderingParams& NewParams,
+                             const float3&          vCameraPosition,
+                             const float4x4&        CameraViewProjMatrix,
+                             ITextureView*          pShadowMapSRV,
+                             ITextureView*          pPrecomputedNetDensitySRV,
+                             ITextureView*          pAmbientSkylightSRV,
+                             bool                   bZOnlyPass)
+{
+    Update(pContext, NewParams);
+
+    if (bZOnlyPass)
+    {
+        RenderZOnly(pContext, vCameraPosition, CameraViewProjMatrix, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        return;
+    }
+
 #if 0
     if( GetAsyncKeyState(VK_F9) )
     {
@@ -795,7 +1194,8 @@ void EarthHemsiphere::Render(IDeviceContext*        pContext,
             GraphicsPipelineCI.GraphicsPipeline.RTVFormats[0]    = m_Params.DstRTVFormat;
             GraphicsPipelineCI.GraphicsPipeline.NumRenderTargets = 1;
         });
-        m_pRSNLoader->LoadPipelineState({"RenderHemisphere", PIPELINE_TYPE_GRAPHICS, false, PipelineCallback, PipelineCallback, ShaderCallback, ShaderCallback}, &m_pHemispherePSO);
+        const char* PSOName = m_Params.m_bUseCDLOD ? "Render Hemisphere CDLOD" : "RenderHemisphere";
+        m_pRSNLoader->LoadPipelineState({PSOName, PIPELINE_TYPE_GRAPHICS, false, PipelineCallback, PipelineCallback, ShaderCallback, ShaderCallback}, &m_pHemispherePSO);
 
         m_pHemispherePSO->BindStaticResources(SHADER_TYPE_VERTEX | SHADER_TYPE_PIXEL, m_pResMapping, BIND_SHADER_RESOURCES_VERIFY_ALL_RESOLVED);
         m_pHemispherePSO->CreateShaderResourceBinding(&m_pHemisphereSRB, true);
@@ -833,34 +1233,45 @@ void EarthHemsiphere::Render(IDeviceContext*        pContext,
 	pd3dImmediateContext->PSSetSamplers(0, _countof(pSamplers), pSamplers);
 #endif
 
-    IBuffer* ppBuffers[1] = {m_pVertBuff};
-    pContext->SetVertexBuffers(0, 1, ppBuffers, nullptr, RESOURCE_STATE_TRANSITION_MODE_TRANSITION, SET_VERTEX_BUFFERS_FLAG_RESET);
+    pShadowMapSRV->SetSampler(m_pComparisonSampler);
+    pContext->SetPipelineState(m_pHemispherePSO);
 
-    if (bZOnlyPass)
-    {
-        pContext->SetPipelineState(m_pHemisphereZOnlyPSO);
-        pContext->CommitShaderResources(m_pHemisphereZOnlySRB, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-    }
-    else
-    {
-        pShadowMapSRV->SetSampler(m_pComparisonSampler);
-        pContext->SetPipelineState(m_pHemispherePSO);
+    m_pHemisphereSRB->GetVariableByName(SHADER_TYPE_VERTEX, "g_tex2DOccludedNetDensityToAtmTop")->Set(pPrecomputedNetDensitySRV);
+    m_pHemisphereSRB->GetVariableByName(SHADER_TYPE_VERTEX, "g_tex2DAmbientSkylight")->Set(pAmbientSkylightSRV);
+    m_pHemisphereSRB->GetVariableByName(SHADER_TYPE_PIXEL, "g_tex2DShadowMap")->Set(pShadowMapSRV);
 
-        m_pHemisphereSRB->GetVariableByName(SHADER_TYPE_VERTEX, "g_tex2DOccludedNetDensityToAtmTop")->Set(pPrecomputedNetDensitySRV);
-        m_pHemisphereSRB->GetVariableByName(SHADER_TYPE_VERTEX, "g_tex2DAmbientSkylight")->Set(pAmbientSkylightSRV);
-        m_pHemisphereSRB->GetVariableByName(SHADER_TYPE_PIXEL, "g_tex2DShadowMap")->Set(pShadowMapSRV);
+    pContext->CommitShaderResources(m_pHemisphereSRB, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
 
-        pContext->CommitShaderResources(m_pHemisphereSRB, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    if (m_Params.m_bUseCDLOD)
+    {
+        RenderCDLOD(pContext, vCameraPosition, ViewFrustum, false, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        return;
     }
 
-    for (auto MeshIt = m_SphereMeshes.begin(); MeshIt != m_SphereMeshes.end(); ++MeshIt)
-    {
-        if (GetBoxVisibility(ViewFrustum, MeshIt->BndBox, bZOnlyPass ? FRUSTUM_PLANE_FLAG_OPEN_NEAR : FRUSTUM_PLANE_FLAG_FULL_FRUSTUM) != BoxVisibility::Invisible)
+    auto DrawMeshes = [&](const std::vector<RingSectorMesh>& Meshes) {
+        for (auto MeshIt = Meshes.begin(); MeshIt != Meshes.end(); ++MeshIt)
         {
-            pContext->SetIndexBuffer(MeshIt->pIndBuff, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-            DrawIndexedAttribs DrawAttrs(MeshIt->uiNumIndices, VT_UINT32, DRAW_FLAG_VERIFY_ALL);
-            pContext->DrawIndexed(DrawAttrs);
+            if (GetBoxVisibility(ViewFrustum, MeshIt->BndBox, FRUSTUM_PLANE_FLAG_FULL_FRUSTUM) != BoxVisibility::Invisible)
+            {
+                pContext->SetIndexBuffer(MeshIt->pIndBuff, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+                DrawIndexedAttribs DrawAttrs(MeshIt->uiNumIndices, VT_UINT32, DRAW_FLAG_VERIFY_ALL);
+                pContext->DrawIndexed(DrawAttrs);
+            }
         }
+    };
+
+    // Draw the rings that are ready so far
+    for (int iRing = m_iFinestReadyRing; iRing < static_cast<int>(m_Rings.size()); ++iRing)
+    {
+        const auto& Ring = m_Rings[iRing];
+
+        IBuffer* ppBuffers[1] = {Ring.pVertBuff};
+        pContext->SetVertexBuffers(0, 1, ppBuffers, nullptr, RESOURCE_STATE_TRANSITION_MODE_TRANSITION, SET_VERTEX_BUFFERS_FLAG_RESET);
+
+        DrawMeshes(Ring.Meshes);
+        // Cover the hole in the middle until the next finer ring is ready
+        if (iRing == m_iFinestReadyRing)
+            DrawMeshes(Ring.FillMeshes);
     }
 }
 
@@ -45,6 +45,12 @@
 
 #pragma once
 
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "RenderDevice.h"
@@ -90,6 +96,13 @@ struct RenderingParams
     int            m_iRowOffset                 = 924;
     TEXTURE_FORMAT DstRTVFormat                 = TEX_FORMAT_R11G11B10_FLOAT;
     TEXTURE_FORMAT ShadowMapFormat              = TEX_FORMAT_D32_FLOAT;
+
+    // Render the terrain with the CDLOD quadtree instead of the static rings
+    bool  m_bUseCDLOD        = false;
+    float m_fCDLODPixelError = 2.f;
+    // Size in pixels of a unit-length object at a unit distance from the camera,
+    // i.e. half the viewport height times the projection y scale
+    float m_fLODScreenScale = 1000.f;
 };
 
 struct RingSectorMesh
@@ -101,12 +114,22 @@ struct RingSectorMesh
         uiNumIndices(0) {}
 };
 
+struct HemisphereRing
+{
+    RefCntAutoPtr<IBuffer>      pVertBuff;
+    std::vector<RingSectorMesh> Meshes;
+    // Meshes that cover the hole in the middle of the ring while the next finer ring is not ready
+    std::vector<RingSectorMesh> FillMeshes;
+};
+
+struct RingGeometryData;
+
 // This class renders the adaptive model using DX11 API
 class EarthHemsiphere
 {
 public:
-    EarthHemsiphere(void) :
-        m_ValidShaders(0) {}
+    EarthHemsiphere();
+    ~EarthHemsiphere();
 
     // clang-format off
     EarthHemsiphere             (const EarthHemsiphere&) = delete;
@@ -115,7 +138,13 @@ public:
     EarthHemsiphere& operator = (EarthHemsiphere&&)      = delete;
     // clang-format on
 
-    // Renders the model
+    // Applies new rendering parameters and uploads the terrain rings that are ready.
+    // Transitions the resources used by the depth-only pass to the required states, so
+    // it must be called on the immediate context before RenderZOnly() is recorded on
+    // deferred contexts.
+    void Update(IDeviceContext* pContext, const RenderingParams& NewParams);
+
+    // Renders the model. Calls Update() first.
     void Render(IDeviceContext*        pContext,
                 const RenderingParams& NewParams,
                 const float3&          vCameraPosition,
@@ -125,7 +154,16 @@ public:
                 ITextureView*          pAmbientSkylightSRV,
                 bool                   bZOnlyPass);
 
-    // Creates device resources
+    // Renders the depth of the model. Does not modify the hemisphere state, so several passes
+    // may be recorded concurrently on different contexts. Camera attribs buffer must be mapped
+    // in pContext beforehand.
+    void RenderZOnly(IDeviceContext*                pContext,
+                     const float3&                  vCameraPosition,
+                     const float4x4&                CameraViewProjMatrix,
+                     RESOURCE_STATE_TRANSITION_MODE StateTransitionMode);
+
+    // Creates device resources. Terrain rings are generated on a background thread
+    // that reads the data source, so it must outlive this object.
     void Create(class ElevationDataSource* pDataSource,
                 const RenderingParams&     Params,
                 IRenderDevice*             pDevice,
@@ -142,13 +180,52 @@ public:
         NUM_TILE_TEXTURES = 1 + 4
     }; // One base material + 4 masked materials
 
+    struct CDLODStatistics
+    {
+        Uint32 NumPatches   = 0;
+        Uint32 NumTriangles = 0;
+    };
+    // Statistics of the last CDLOD pass that rendered to the color buffer
+    const CDLODStatistics& GetCDLODStatistics() const { return m_CDLODStats; }
+
+    // Incremented every time Update() uploads new terrain geometry
+    Uint32 GetGeometryRevision() const { return m_GeometryRevision; }
+
+    // Width of the distance band in which the finest CDLOD level morphs to the next one. Node
+    // selection and morph factors only change slightly while the camera moves by a fraction of it.
+    float GetCDLODFinestMorphRange() const
+    {
+        return m_CDLODLevels.size() > 1 ? m_CDLODLevels[0].fRange - m_CDLODLevels[0].fMorphStart : FLT_MAX;
+    }
+
 private:
-    void RenderNormalMap(IRenderDevice*  pd3dDevice,
-                         IDeviceContext* pd3dImmediateContext,
-                         const Uint16*   pHeightMap,
-                         size_t          HeightMapPitch,
-                         int             HeightMapDim,
-                         ITexture*       ptex2DNormalMap);
+    struct CDLODPatchInstance;
+
+    void CreateCDLODResources(IRenderDevice* pDevice, IDeviceContext* pContext, const class ElevationDataSource* pDataSource);
+
+    void UpdateCDLODRanges();
+
+    void SelectCDLODNodes(const float2&                    f2NodeOrigin,
+                          int                              iLevel,
+                          const float3&                    f3CameraPos,
+                          const ViewFrustumExt&            ViewFrustum,
+                          FRUSTUM_PLANE_FLAGS              FrustumPlanes,
+                          bool                             bHorizonCulling,
+                          bool                             bFullyVisible,
+                          std::vector<CDLODPatchInstance>& Instances) const;
+
+    void RenderCDLOD(IDeviceContext*                pContext,
+                     const float3&                  vCameraPosition,
+                     const ViewFrustumExt&          ViewFrustum,
+                     bool                           bZOnlyPass,
+                     RESOURCE_STATE_TRANSITION_MODE StateTransitionMode);
+
+    void UploadReadyRings(IDeviceContext* pContext);
+
+    void RenderNormalMap(IRenderDevice*                   pd3dDevice,
+                         IDeviceContext*                  pd3dImmediateContext,
+                         const class ElevationDataSource* pDataSource,
+                         ITexture*                        ptex2DNormalMap);
 
     RenderingParams m_Params;
 
@@ -157,7 +234,6 @@ private:
     RefCntAutoPtr<IRenderStateNotationLoader> m_pRSNLoader;
 
     RefCntAutoPtr<IBuffer>      m_pcbTerrainAttribs;
-    RefCntAutoPtr<IBuffer>      m_pVertBuff;
     RefCntAutoPtr<ITextureView> m_ptex2DNormalMapSRV, m_ptex2DMtrlMaskSRV;
 
     RefCntAutoPtr<ITextureView> m_ptex2DTilesSRV[NUM_TILE_TEXTURES];
@@ -171,7 +247,51 @@ private:
     RefCntAutoPtr<IShaderResourceBinding> m_pHemisphereSRB;
     RefCntAutoPtr<ISampler>               m_pComparisonSampler;
 
-    std::vector<RingSectorMesh> m_SphereMeshes;
+    // Ring 0 is the finest one. Rings [m_iFinestReadyRing, m_Rings.size()) are ready for rendering.
+    std::vector<HemisphereRing> m_Rings;
+    int                         m_iFinestReadyRing = 0;
+    Uint32                      m_GeometryRevision = 0;
+
+    std::thread                                    m_RingGenerationThread;
+    std::atomic_bool                               m_bStopRingGeneration{false};
+    std::mutex                                     m_ReadyRingsMtx;
+    std::vector<std::unique_ptr<RingGeometryData>> m_ReadyRings;
+    std::chrono::high_resolution_clock::time_point m_RingGenerationStartTime;
+
+    struct CDLODPatchInstance
+    {
+        // xy - node origin in the [-1,1]x[-1,1] domain, z - node size, w - elevation mip level
+        float4 f4NodeRect;
+        // x - morph start distance, y - morph end distance
+        float4 f4MorphParams;
+    };
+
+    struct CDLODLevelInfo
+    {
+        float fDomainSize   = 0; // Node size in the domain
+        float fWorldSize    = 0; // Approximate node size in world space
+        float fRange        = 0; // Distance up to which the level is used
+        float fMorphStart   = 0; // Distance at which vertices start morphing to the coarser level
+        int   iElevationMip = 0;
+    };
+
+    RefCntAutoPtr<IBuffer>                m_pCDLODPatchVB;
+    RefCntAutoPtr<IBuffer>                m_pCDLODPatchIB;
+    // Depth-only passes may grow the instance buffer concurrently
+    std::mutex                            m_CDLODInstanceBufferMtx;
+    RefCntAutoPtr<IBuffer>                m_pCDLODInstanceBuffer;
+    RefCntAutoPtr<IBuffer>                m_pcbCDLODAttribs;
+    RefCntAutoPtr<IPipelineState>         m_pHemisphereCDLODZOnlyPSO;
+    RefCntAutoPtr<IShaderResourceBinding> m_pHemisphereCDLODZOnlySRB;
+
+    Uint32                          m_CDLODPatchNumIndices  = 0;
+    Uint32                          m_CDLODInstanceCapacity = 0;
+    std::vector<CDLODLevelInfo>     m_CDLODLevels; // Level 0 is the finest one
+    std::vector<CDLODPatchInstance> m_CDLODInstances; // Nodes selected by the color pass
+    CDLODStatistics                 m_CDLODStats;
+    CDLODAttribs                    m_CDLODAttribs;
+    float                           m_fMinDisplacement = 0;
+    float                           m_fMaxDisplacement = 0;
 
     Uint32 m_ValidShaders;
 };
@@ -0,0 +1,67 @@
+/*
+ *  Copyright 2019-2022 Diligent Graphics LLC
+ *  Copyright 2015-2019 Egor Yusov
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+// Offline converter of 16-bit height map images to the tiled elevation format
+// that ElevationDataSource memory-maps at run time.
+
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+
+#include "ElevationDataSource.hpp"
+
+int main(int argc, char** argv)
+{
+    if (argc < 3 || argc > 4)
+    {
+        printf("Usage: AtmosphereElevationConverter <source height map> <destination .elev file> [tile size]\n");
+        return 1;
+    }
+
+    Diligent::Uint32 TileSize = 128;
+    if (argc == 4)
+        TileSize = static_cast<Diligent::Uint32>(atoi(argv[3]));
+
+    if (!Diligent::ElevationDataSource::ConvertToTiledFormat(argv[1], argv[2], TileSize))
+        return 1;
+
+    // Validate the result the same way the sample loads it
+    try
+    {
+        Diligent::ElevationDataSource DataSource{argv[2]};
+        printf("%s: %ux%u samples, %u mip levels, %ux%u tiles, elevation range [%u, %u]\n", argv[2],
+               DataSource.GetNumCols(), DataSource.GetNumRows(), DataSource.GetNumMipLevels(),
+               DataSource.GetTileSize(), DataSource.GetTileSize(),
+               Diligent::Uint32{DataSource.GetGlobalMinElevation()}, Diligent::Uint32{DataSource.GetGlobalMaxElevation()});
+    }
+    catch (const std::exception&)
+    {
+        return 1;
+    }
+
+    return 0;
+}
@@ -45,108 +45,484 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define ELEVATION_DATA_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#    include <arm_neon.h>
+#    define ELEVATION_DATA_NEON 1
+#endif
+
+#if PLATFORM_WIN32
+#    include "WinHPreface.h"
+#    include <Windows.h>
+#    include "WinHPostface.h"
+#elif PLATFORM_LINUX || PLATFORM_MACOS || PLATFORM_ANDROID || PLATFORM_IOS || PLATFORM_TVOS
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#    define ELEVATION_DATA_POSIX_MMAP 1
+#endif
 
 #include "ElevationDataSource.hpp"
+#include "ParallelFor.hpp"
 #include "FileWrapper.hpp"
+#include "FileSystem.hpp"
 #include "DataBlobImpl.hpp"
 #include "Image.h"
 #include "BasicFileStream.hpp"
 #include "TextureUtilities.h"
 #include "GraphicsAccessories.hpp"
+#include "Align.hpp"
+#include "PlatformMisc.hpp"
+#include "StringTools.hpp"
 
 namespace Diligent
 {
 
-// Creates data source from the specified raw data file
-ElevationDataSource::ElevationDataSource(const Char* strSrcDemFile) :
-    m_iNumLevels(0),
-    m_iPatchSize(128),
-    m_iColOffset(0),
-    m_iRowOffset(0)
+namespace
+{
+
+void ComputeMinMaxElevation(const Uint16* pData, size_t NumSamples, Uint16& MinElev, Uint16& MaxElev)
+{
+    VERIFY_EXPR(NumSamples > 0);
+    size_t i = 0;
+
+    MinElev = pData[0];
+    MaxElev = pData[0];
+#if ELEVATION_DATA_SSE2
+    if (NumSamples >= 8)
+    {
+        // SSE2 only has signed 16-bit min/max, so flip the sign bit to preserve the unsigned order
+        const __m128i SignBit = _mm_set1_epi16(static_cast<short>(0x8000));
+
+        __m128i Min = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pData)), SignBit);
+        __m128i Max = Min;
+        for (i = 8; i + 8 <= NumSamples; i += 8)
+        {
+            __m128i Elev = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pData + i)), SignBit);
+            Min          = _mm_min_epi16(Min, Elev);
+            Max          = _mm_max_epi16(Max, Elev);
+        }
+
+        alignas(16) Uint16 MinLanes[8];
+        alignas(16) Uint16 MaxLanes[8];
+        _mm_store_si128(reinterpret_cast<__m128i*>(MinLanes), _mm_xor_si128(Min, SignBit));
+        _mm_store_si128(reinterpret_cast<__m128i*>(MaxLanes), _mm_xor_si128(Max, SignBit));
+        MinElev = *std::min_element(std::begin(MinLanes), std::end(MinLanes));
+        MaxElev = *std::max_element(std::begin(MaxLanes), std::end(MaxLanes));
+    }
+#elif ELEVATION_DATA_NEON
+    if (NumSamples >= 8)
+    {
+        uint16x8_t Min = vld1q_u16(pData);
+        uint16x8_t Max = Min;
+        for (i = 8; i + 8 <= NumSamples; i += 8)
+        {
+            uint16x8_t Elev = vld1q_u16(pData + i);
+            Min             = vminq_u16(Min, Elev);
+            Max             = vmaxq_u16(Max, Elev);
+        }
+
+        Uint16 MinLanes[8];
+        Uint16 MaxLanes[8];
+        vst1q_u16(MinLanes, Min);
+        vst1q_u16(MaxLanes, Max);
+        MinElev = *std::min_element(std::begin(MinLanes), std::end(MinLanes));
+        MaxElev = *std::max_element(std::begin(MaxLanes), std::end(MaxLanes));
+    }
+#endif
+    for (; i < NumSamples; ++i)
+    {
+        MinElev = std::min(MinElev, pData[i]);
+        MaxElev = std::max(MaxElev, pData[i]);
+    }
+}
+
+// Averages 2x2 blocks of two finer level rows into one coarse level row
+void DownsampleRow(const Uint16* pFinerRow0, const Uint16* pFinerRow1, Uint16* pDstRow, size_t Width)
+{
+    size_t Col = 0;
+#if ELEVATION_DATA_SSE2
+    const __m128i LowWordMask = _mm_set1_epi32(0xFFFF);
+    for (; Col + 8 <= Width; Col += 8)
+    {
+        // Sum horizontal pairs in 32-bit lanes: the sum of four samples exceeds 16 bits
+        auto SumPairs = [LowWordMask](const Uint16* pSrc) {
+            __m128i Src = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pSrc));
+            return _mm_add_epi32(_mm_and_si128(Src, LowWordMask), _mm_srli_epi32(Src, 16));
+        };
+        __m128i Avg0 = _mm_srli_epi32(_mm_add_epi32(SumPairs(pFinerRow0 + Col * 2), SumPairs(pFinerRow1 + Col * 2)), 2);
+        __m128i Avg1 = _mm_srli_epi32(_mm_add_epi32(SumPairs(pFinerRow0 + Col * 2 + 8), SumPairs(pFinerRow1 + Col * 2 + 8)), 2);
+        // Sign-extend the 16-bit results so that the signed saturating pack keeps them intact
+        Avg0 = _mm_srai_epi32(_mm_slli_epi32(Avg0, 16), 16);
+        Avg1 = _mm_srai_epi32(_mm_slli_epi32(Avg1, 16), 16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pDstRow + Col), _mm_packs_epi32(Avg0, Avg1));
+    }
+#elif ELEVATION_DATA_NEON
+    for (; Col + 4 <= Width; Col += 4)
+    {
+        uint32x4_t Sum = vaddq_u32(vpaddlq_u16(vld1q_u16(pFinerRow0 + Col * 2)), vpaddlq_u16(vld1q_u16(pFinerRow1 + Col * 2)));
+        vst1_u16(pDstRow + Col, vshrn_n_u32(Sum, 2));
+    }
+#endif
+    for (; Col < Width; ++Col)
+    {
+        int iAverageHeight = pFinerRow0[Col * 2] + pFinerRow0[Col * 2 + 1] + pFinerRow1[Col * 2] + pFinerRow1[Col * 2 + 1];
+        pDstRow[Col]       = (Uint16)(iAverageHeight >> 2);
+    }
+}
+
+bool IsTiledElevationFile(const Char* strFilePath)
 {
+    const char*  Ext    = ".elev";
+    const size_t ExtLen = strlen(Ext);
+    const size_t Len    = strlen(strFilePath);
+    return Len > ExtLen && StrCmpNoCase(strFilePath + Len - ExtLen, Ext) == 0;
+}
 
-#if 1
+// Loads the 16-bit height map image and converts it to the tiled elevation format
+RefCntAutoPtr<IDataBlob> BuildTiledElevationData(const Char* strSrcDemFile, Uint32 TileSize)
+{
     RefCntAutoPtr<Image> pHeightMap;
     CreateImageFromFile(strSrcDemFile, &pHeightMap);
+    if (!pHeightMap)
+    {
+        LOG_ERROR_MESSAGE("Failed to load height map image '", strSrcDemFile, "'");
+        return {};
+    }
 
     const auto& ImgInfo    = pHeightMap->GetDesc();
     auto*       pImageData = pHeightMap->GetData();
+    if (ImgInfo.ComponentType != VT_UINT16 || ImgInfo.NumComponents != 1)
+    {
+        LOG_ERROR_MESSAGE("Unexpected format of height map image '", strSrcDemFile, "': 16-bit single-channel image is expected");
+        return {};
+    }
+
     // Calculate minimal number of columns and rows
     // in the form 2^n+1 that encompass the data
-    m_iNumCols = 1;
-    m_iNumRows = 1;
-    while (m_iNumCols + 1 < ImgInfo.Width || m_iNumRows + 1 < ImgInfo.Height)
+    Uint32 NumCols = 1;
+    Uint32 NumRows = 1;
+    while (NumCols + 1 < ImgInfo.Width || NumRows + 1 < ImgInfo.Height)
+    {
+        NumCols *= 2;
+        NumRows *= 2;
+    }
+    NumCols++;
+    NumRows++;
+
+    TextureDesc LevelsDesc;
+    LevelsDesc.Type      = RESOURCE_DIM_TEX_2D;
+    LevelsDesc.Width     = NumCols;
+    LevelsDesc.Height    = NumRows;
+    LevelsDesc.Format    = TEX_FORMAT_R16_UINT;
+    LevelsDesc.MipLevels = ComputeMipLevelsCount(NumCols, NumRows);
+
+    std::vector<TiledElevationLevel> Levels(LevelsDesc.MipLevels);
+
+    const size_t TileDataSize = size_t{TileSize} * TileSize * sizeof(Uint16);
+    // Keep tiles page-aligned so that every tile is paged in with the minimal number of page faults
+    size_t DataOffset = AlignUp(sizeof(TiledElevationHeader) + sizeof(TiledElevationLevel) * Levels.size(), size_t{4096});
+    for (Uint32 Level = 0; Level < LevelsDesc.MipLevels; ++Level)
     {
-        m_iNumCols *= 2;
-        m_iNumRows *= 2;
+        const auto MipProps = GetMipLevelProperties(LevelsDesc, Level);
+
+        auto& MipLevel      = Levels[Level];
+        MipLevel.Width      = MipProps.LogicalWidth;
+        MipLevel.Height     = MipProps.LogicalHeight;
+        MipLevel.NumTilesX  = (MipLevel.Width + TileSize - 1) / TileSize;
+        MipLevel.NumTilesY  = (MipLevel.Height + TileSize - 1) / TileSize;
+        MipLevel.DataOffset = DataOffset;
+        DataOffset += size_t{MipLevel.NumTilesX} * MipLevel.NumTilesY * TileDataSize;
     }
 
-    m_iNumLevels = 1;
-    while ((m_iPatchSize << (m_iNumLevels - 1)) < (int)m_iNumCols ||
-           (m_iPatchSize << (m_iNumLevels - 1)) < (int)m_iNumRows)
-        m_iNumLevels++;
+    auto pData = DataBlobImpl::Create(DataOffset);
+    auto pDst  = static_cast<Uint8*>(pData->GetDataPtr());
+    // Tiles are fully overwritten below, only the header area needs to be cleared
+    memset(pDst, 0, static_cast<size_t>(Levels[0].DataOffset));
 
-    m_iNumCols++;
-    m_iNumRows++;
-    m_iStride = (m_iNumCols + 1) & (-2);
+    // Load the data and duplicate the last row and column
+    std::vector<Uint16> FinerLevel(size_t{NumCols} * NumRows);
+    const auto*         pSrcImgData = static_cast<const Uint8*>(pImageData->GetDataPtr());
+    ParallelFor(NumRows, 64, [&](Uint32 StartRow, Uint32 EndRow) {
+        for (Uint32 Row = StartRow; Row < EndRow; ++Row)
+        {
+            const auto* pSrcRow = reinterpret_cast<const Uint16*>(pSrcImgData + size_t{std::min(Row, ImgInfo.Height - 1)} * ImgInfo.RowStride);
+            auto*       pDstRow = &FinerLevel[size_t{Row} * NumCols];
+            memcpy(pDstRow, pSrcRow, size_t{ImgInfo.Width} * sizeof(Uint16));
+            std::fill(pDstRow + ImgInfo.Width, pDstRow + NumCols, pSrcRow[ImgInfo.Width - 1]);
+        }
+    });
 
-    // Load the data
-    m_TheHeightMap.resize(size_t{m_iStride} * size_t{m_iNumRows});
+    TiledElevationHeader Header;
+    Header.NumCols   = NumCols;
+    Header.NumRows   = NumRows;
+    Header.TileSize  = TileSize;
+    Header.NumLevels = LevelsDesc.MipLevels;
 
-    VERIFY(ImgInfo.ComponentType == VT_UINT16 && ImgInfo.NumComponents == 1, "Unexpected scanline size: 16-bit single-channel image is expected");
-    auto* pSrcImgData = reinterpret_cast<Uint8*>(pImageData->GetDataPtr());
-    for (size_t row = 0; row < ImgInfo.Height; row++, pSrcImgData += ImgInfo.RowStride)
     {
-        memcpy(&m_TheHeightMap[row * m_iStride], pSrcImgData, size_t{ImgInfo.Width} * size_t{GetValueSize(ImgInfo.ComponentType)});
+        // Every thread reduces its own rows, then the partial results are combined
+        std::vector<std::pair<Uint16, Uint16>> RowsMinMax(NumRows);
+        ParallelFor(NumRows, 64, [&](Uint32 StartRow, Uint32 EndRow) {
+            for (Uint32 Row = StartRow; Row < EndRow; ++Row)
+                ComputeMinMaxElevation(&FinerLevel[size_t{Row} * NumCols], NumCols, RowsMinMax[Row].first, RowsMinMax[Row].second);
+        });
+        Header.MinElevation = RowsMinMax[0].first;
+        Header.MaxElevation = RowsMinMax[0].second;
+        for (const auto& MinMax : RowsMinMax)
+        {
+            Header.MinElevation = std::min(Header.MinElevation, MinMax.first);
+            Header.MaxElevation = std::max(Header.MaxElevation, MinMax.second);
+        }
     }
 
-    // Duplicate the last row and column
-    for (Uint32 iRow = 0; iRow < ImgInfo.Height; iRow++)
-        for (Uint32 iCol = ImgInfo.Width; iCol < m_iNumCols; iCol++)
-            GetElevSample(iCol, iRow) = GetElevSample((ImgInfo.Width - 1), iRow);
+    memcpy(pDst, &Header, sizeof(Header));
+    memcpy(pDst + sizeof(Header), Levels.data(), sizeof(TiledElevationLevel) * Levels.size());
 
-    for (Uint32 iCol = 0; iCol < m_iNumCols; iCol++)
-        for (Uint32 iRow = ImgInfo.Height; iRow < m_iNumRows; iRow++)
-            GetElevSample(iCol, iRow) = GetElevSample(iCol, ImgInfo.Height - 1);
-
-#else
-    m_iStride  = 2048;
-    m_iNumRows = m_iNumCols = 2048;
-    m_iNumLevels            = 5;
-    m_TheHeightMap.resize(m_iStride * m_iNumRows);
-    for (Uint32 j = 0; j < m_iNumRows; ++j)
+    std::vector<Uint16> CurrLevel;
+    for (Uint32 Level = 0; Level < LevelsDesc.MipLevels; ++Level)
     {
-        for (Uint32 i = 0; i < m_iNumCols; ++i)
+        const auto& MipLevel = Levels[Level];
+        if (Level > 0)
         {
-            float x = (float)i / (float)m_iNumRows;
-            float y = (float)j / (float)m_iNumCols;
-            float A = 1;
-            float F = 1;
-            float h = 0;
-            for (int Octave = 0; Octave < 8; ++Octave, A *= 0.7f, F *= 1.8f)
+            // Every coarse level sample is the average of the 2x2 finer level samples
+            const Uint32 FinerWidth = Levels[Level - 1].Width;
+            CurrLevel.resize(size_t{MipLevel.Width} * MipLevel.Height);
+            ParallelFor(MipLevel.Height, 64, [&](Uint32 StartRow, Uint32 EndRow) {
+                for (size_t Row = StartRow; Row < EndRow; ++Row)
+                {
+                    DownsampleRow(&FinerLevel[(Row * 2 + 0) * FinerWidth],
+                                  &FinerLevel[(Row * 2 + 1) * FinerWidth],
+                                  &CurrLevel[Row * MipLevel.Width],
+                                  MipLevel.Width);
+                }
+            });
+            std::swap(FinerLevel, CurrLevel);
+        }
+
+        // Split the level into tiles, replicating the last row and column into the padding
+        ParallelFor(MipLevel.NumTilesY, 1, [&](Uint32 StartTileY, Uint32 EndTileY) {
+            for (Uint32 TileY = StartTileY; TileY < EndTileY; ++TileY)
             {
-                h += A * (sin(x * F) * sin(y * 1.5f * F) + 0.5f * (sin((x + y) * 1.3f * F) + cos((x * y) * 1.7f * F)));
-                h = fabs(h - 0.5f);
+                auto* pTile = reinterpret_cast<Uint16*>(pDst + MipLevel.DataOffset) + size_t{TileY} * MipLevel.NumTilesX * TileSize * TileSize;
+                for (Uint32 TileX = 0; TileX < MipLevel.NumTilesX; ++TileX, pTile += size_t{TileSize} * TileSize)
+                {
+                    const Uint32 StartCol   = TileX * TileSize;
+                    const Uint32 NumSrcCols = std::min(TileSize, MipLevel.Width - StartCol);
+                    for (Uint32 y = 0; y < TileSize; ++y)
+                    {
+                        const Uint32  Row     = std::min(TileY * TileSize + y, MipLevel.Height - 1);
+                        const Uint16* pSrcRow = &FinerLevel[size_t{Row} * MipLevel.Width + StartCol];
+                        Uint16*       pDstRow = pTile + size_t{y} * TileSize;
+                        memcpy(pDstRow, pSrcRow, NumSrcCols * sizeof(Uint16));
+                        std::fill(pDstRow + NumSrcCols, pDstRow + TileSize, pSrcRow[NumSrcCols - 1]);
+                    }
+                }
             }
-            h = fabs(h) * 32000.f;
-            h = std::min(h, (float)std::numeric_limits<Uint16>::max());
+        });
+    }
 
-            GetElevSample(i, j) = (Uint16)h;
+    return RefCntAutoPtr<IDataBlob>{pData.RawPtr()};
+}
+
+} // namespace
+
+bool ElevationDataSource::ConvertToTiledFormat(const Char* strSrcDemFile, const Char* strDstFile, Uint32 TileSize)
+{
+    if (TileSize == 0 || !IsPowerOfTwo(TileSize))
+    {
+        LOG_ERROR_MESSAGE("Tile size (", TileSize, ") must be a power of two");
+        return false;
+    }
+
+    auto pData = BuildTiledElevationData(strSrcDemFile, TileSize);
+    if (!pData)
+        return false;
+
+    FileWrapper pFile{strDstFile, EFileAccessMode::Overwrite};
+    if (!pFile)
+    {
+        LOG_ERROR_MESSAGE("Failed to create tiled elevation file '", strDstFile, "'");
+        return false;
+    }
+
+    if (!pFile->Write(pData->GetDataPtr(), pData->GetSize()))
+    {
+        LOG_ERROR_MESSAGE("Failed to write tiled elevation file '", strDstFile, "'");
+        return false;
+    }
+
+    return true;
+}
+
+// Creates data source from the specified raw data file
+ElevationDataSource::ElevationDataSource(const Char* strSrcDemFile) :
+    m_iNumLevels(0),
+    m_iPatchSize(128),
+    m_iColOffset(0),
+    m_iRowOffset(0)
+{
+    if (IsTiledElevationFile(strSrcDemFile))
+    {
+        if (!MapFile(strSrcDemFile))
+        {
+            // Files that can't be mapped (e.g. packed into the application bundle) are read into memory
+            FileWrapper pFile{strSrcDemFile};
+            if (!pFile)
+                LOG_ERROR_AND_THROW("Failed to open elevation data file '", strSrcDemFile, "'");
+
+            m_pDataBlob = DataBlobImpl::Create();
+            if (!pFile->Read(m_pDataBlob))
+                LOG_ERROR_AND_THROW("Failed to read elevation data file '", strSrcDemFile, "'");
         }
     }
-#endif
+    else
+    {
+        m_pDataBlob = BuildTiledElevationData(strSrcDemFile, static_cast<Uint32>(m_iPatchSize));
+        if (!m_pDataBlob)
+            LOG_ERROR_AND_THROW("Failed to create elevation data from '", strSrcDemFile, "'");
+    }
 
-    m_GlobalMinElevation = m_TheHeightMap[0];
-    m_GlobalMaxElevation = m_TheHeightMap[0];
-    for (auto Elev : m_TheHeightMap)
+    if (m_pDataBlob)
     {
-        m_GlobalMinElevation = std::min(m_GlobalMinElevation, Elev);
-        m_GlobalMaxElevation = std::max(m_GlobalMaxElevation, Elev);
+        m_pFileData = static_cast<const Uint8*>(m_pDataBlob->GetDataPtr());
+        m_FileSize  = m_pDataBlob->GetSize();
     }
+
+    InitFromTiledData(strSrcDemFile);
 }
 
 ElevationDataSource::~ElevationDataSource(void)
 {
+    UnmapFile();
+}
+
+void ElevationDataSource::InitFromTiledData(const Char* strSrcDemFile)
+{
+    TiledElevationHeader Header;
+    if (m_FileSize < sizeof(Header))
+        LOG_ERROR_AND_THROW("Elevation data file '", strSrcDemFile, "' is too small");
+    memcpy(&Header, m_pFileData, sizeof(Header));
+
+    if (Header.Magic != TiledElevationHeader::MagicNumber || Header.Version != TiledElevationHeader::FormatVersion)
+        LOG_ERROR_AND_THROW("'", strSrcDemFile, "' is not a tiled elevation file or its version is not supported");
+
+    if (Header.NumCols < 2 || Header.NumRows < 2 || Header.NumLevels == 0 || Header.TileSize == 0 || !IsPowerOfTwo(Header.TileSize))
+        LOG_ERROR_AND_THROW("Tiled elevation file '", strSrcDemFile, "' is corrupted");
+
+    if (m_FileSize < sizeof(Header) + sizeof(TiledElevationLevel) * Header.NumLevels)
+        LOG_ERROR_AND_THROW("Tiled elevation file '", strSrcDemFile, "' is truncated");
+
+    m_Levels.resize(Header.NumLevels);
+    memcpy(m_Levels.data(), m_pFileData + sizeof(Header), sizeof(TiledElevationLevel) * m_Levels.size());
+
+    const size_t TileDataSize = size_t{Header.TileSize} * Header.TileSize * sizeof(Uint16);
+    for (const auto& MipLevel : m_Levels)
+    {
+        if (MipLevel.NumTilesX * Header.TileSize < MipLevel.Width ||
+            MipLevel.NumTilesY * Header.TileSize < MipLevel.Height ||
+            MipLevel.DataOffset % alignof(Uint16) != 0 ||
+            MipLevel.DataOffset + size_t{MipLevel.NumTilesX} * MipLevel.NumTilesY * TileDataSize > m_FileSize)
+        {
+            LOG_ERROR_AND_THROW("Tiled elevation file '", strSrcDemFile, "' is corrupted");
+        }
+    }
+    if (m_Levels[0].Width != Header.NumCols || m_Levels[0].Height != Header.NumRows)
+        LOG_ERROR_AND_THROW("Tiled elevation file '", strSrcDemFile, "' is corrupted");
+
+    m_iNumCols           = Header.NumCols;
+    m_iNumRows           = Header.NumRows;
+    m_iPatchSize         = static_cast<int>(Header.TileSize);
+    m_TileShift          = PlatformMisc::GetMSB(Header.TileSize);
+    m_GlobalMinElevation = Header.MinElevation;
+    m_GlobalMaxElevation = Header.MaxElevation;
+
+    m_iNumLevels = 1;
+    while ((m_iPatchSize << (m_iNumLevels - 1)) < (int)m_iNumCols - 1 ||
+           (m_iPatchSize << (m_iNumLevels - 1)) < (int)m_iNumRows - 1)
+        m_iNumLevels++;
+}
+
+bool ElevationDataSource::MapFile(const Char* strFilePath)
+{
+    String FilePath{strFilePath};
+    std::replace(FilePath.begin(), FilePath.end(), FileSystem::SlashSymbol == '/' ? '\\' : '/', FileSystem::SlashSymbol);
+
+#if PLATFORM_WIN32
+    HANDLE hFile = CreateFileA(FilePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER FileSize = {};
+    if (!GetFileSizeEx(hFile, &FileSize) || FileSize.QuadPart == 0)
+    {
+        CloseHandle(hFile);
+        return false;
+    }
+
+    HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    // The view keeps the mapping alive, so the handles are not needed once it is created
+    CloseHandle(hFile);
+    if (hMapping == nullptr)
+        return false;
+
+    m_pFileData = static_cast<const Uint8*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+    CloseHandle(hMapping);
+    if (m_pFileData == nullptr)
+        return false;
+
+    m_FileSize = static_cast<size_t>(FileSize.QuadPart);
+    m_IsMapped = true;
+    return true;
+#elif ELEVATION_DATA_POSIX_MMAP
+    int fd = open(FilePath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat FileStat = {};
+    if (fstat(fd, &FileStat) != 0 || FileStat.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* pData = mmap(nullptr, static_cast<size_t>(FileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    if (pData == MAP_FAILED)
+        return false;
+
+    // Tiles are accessed in arbitrary order, so read-ahead only wastes memory
+    madvise(pData, static_cast<size_t>(FileStat.st_size), MADV_RANDOM);
+
+    m_pFileData = static_cast<const Uint8*>(pData);
+    m_FileSize  = static_cast<size_t>(FileStat.st_size);
+    m_IsMapped  = true;
+    return true;
+#else
+    (void)FilePath;
+    return false;
+#endif
+}
+
+void ElevationDataSource::UnmapFile()
+{
+    if (!m_IsMapped)
+        return;
+
+#if PLATFORM_WIN32
+    UnmapViewOfFile(m_pFileData);
+#elif ELEVATION_DATA_POSIX_MMAP
+    munmap(const_cast<Uint8*>(m_pFileData), m_FileSize);
+#endif
+    m_pFileData = nullptr;
+    m_FileSize  = 0;
+    m_IsMapped  = false;
 }
 
 Uint16 ElevationDataSource::GetGlobalMinElevation() const
@@ -171,14 +547,11 @@ int MirrorCoord(int iCoord, int iDim)
     return iCoord;
 }
 
-inline Uint16& ElevationDataSource::GetElevSample(Int32 i, Int32 j)
-{
-    return m_TheHeightMap[i + j * m_iStride];
-}
-
 inline Uint16 ElevationDataSource::GetElevSample(Int32 i, Int32 j) const
 {
-    return m_TheHeightMap[i + j * m_iStride];
+    const Uint32  TileMask = (1u << m_TileShift) - 1u;
+    const Uint16* pTile    = GetTile(static_cast<Uint32>(i) >> m_TileShift, static_cast<Uint32>(j) >> m_TileShift);
+    return pTile[(static_cast<Uint32>(i) & TileMask) + ((static_cast<Uint32>(j) & TileMask) << m_TileShift)];
 }
 
 float ElevationDataSource::GetInterpolatedHeight(float fCol, float fRow, int iStep) const
@@ -233,10 +606,88 @@ float3 ElevationDataSource::ComputeSurfaceNormal(float fCol, float fRow, float f
     return Normal;
 }
 
-void ElevationDataSource::GetDataPtr(const Uint16*& pDataPtr, size_t& Pitch)
+void ElevationDataSource::GetInterpolatedHeights(const float2* pColRow, float* pHeights, size_t NumSamples, int iStep) const
 {
-    pDataPtr = &m_TheHeightMap[0];
-    Pitch    = m_iStride;
+    size_t i = 0;
+#if ELEVATION_DATA_SSE2 || ELEVATION_DATA_NEON
+    if (iStep == 1)
+    {
+        // Samples are processed in groups of four: integer coordinates and weights are computed
+        // with SIMD, the 2x2 footprints are gathered with scalar loads, and the bilinear
+        // interpolation is SIMD again.
+        alignas(16) Int32 Cols[4];
+        alignas(16) Int32 Rows[4];
+        alignas(16) float H[4][4]; // H00, H10, H01, H11 of every sample
+        for (; i + 4 <= NumSamples; i += 4)
+        {
+#    if ELEVATION_DATA_SSE2
+            const __m128 One = _mm_set1_ps(1.f);
+            const __m128 V0  = _mm_loadu_ps(&pColRow[i].x);
+            const __m128 V1  = _mm_loadu_ps(&pColRow[i + 2].x);
+            const __m128 Col = _mm_shuffle_ps(V0, V1, _MM_SHUFFLE(2, 0, 2, 0));
+            const __m128 Row = _mm_shuffle_ps(V0, V1, _MM_SHUFFLE(3, 1, 3, 1));
+
+            // SSE2 has no floor instruction, so truncate and correct negative values
+            __m128 Col0 = _mm_cvtepi32_ps(_mm_cvttps_epi32(Col));
+            __m128 Row0 = _mm_cvtepi32_ps(_mm_cvttps_epi32(Row));
+            Col0        = _mm_sub_ps(Col0, _mm_and_ps(_mm_cmpgt_ps(Col0, Col), One));
+            Row0        = _mm_sub_ps(Row0, _mm_and_ps(_mm_cmpgt_ps(Row0, Row), One));
+
+            const __m128 HWeight = _mm_sub_ps(Col, Col0);
+            const __m128 VWeight = _mm_sub_ps(Row, Row0);
+            _mm_store_si128(reinterpret_cast<__m128i*>(Cols), _mm_add_epi32(_mm_cvttps_epi32(Col0), _mm_set1_epi32(m_iColOffset)));
+            _mm_store_si128(reinterpret_cast<__m128i*>(Rows), _mm_add_epi32(_mm_cvttps_epi32(Row0), _mm_set1_epi32(m_iRowOffset)));
+#    else
+            const float32x4_t   One    = vdupq_n_f32(1.f);
+            const float32x4x2_t ColRow = vld2q_f32(&pColRow[i].x);
+
+            // Truncate and correct negative values
+            float32x4_t Col0 = vcvtq_f32_s32(vcvtq_s32_f32(ColRow.val[0]));
+            float32x4_t Row0 = vcvtq_f32_s32(vcvtq_s32_f32(ColRow.val[1]));
+            Col0             = vsubq_f32(Col0, vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(Col0, ColRow.val[0]), vreinterpretq_u32_f32(One))));
+            Row0             = vsubq_f32(Row0, vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(Row0, ColRow.val[1]), vreinterpretq_u32_f32(One))));
+
+            const float32x4_t HWeight = vsubq_f32(ColRow.val[0], Col0);
+            const float32x4_t VWeight = vsubq_f32(ColRow.val[1], Row0);
+            vst1q_s32(Cols, vaddq_s32(vcvtq_s32_f32(Col0), vdupq_n_s32(m_iColOffset)));
+            vst1q_s32(Rows, vaddq_s32(vcvtq_s32_f32(Row0), vdupq_n_s32(m_iRowOffset)));
+#    endif
+
+            for (int Lane = 0; Lane < 4; ++Lane)
+            {
+                int iCol0 = Cols[Lane];
+                int iRow0 = Rows[Lane];
+                int iCol1 = iCol0 + 1;
+                int iRow1 = iRow0 + 1;
+                // Only the samples at the map borders need to be mirrored
+                if (iCol0 < 0 || iRow0 < 0 || iCol1 >= static_cast<int>(m_iNumCols) || iRow1 >= static_cast<int>(m_iNumRows))
+                {
+                    iCol0 = MirrorCoord(iCol0, m_iNumCols);
+                    iCol1 = MirrorCoord(iCol1, m_iNumCols);
+                    iRow0 = MirrorCoord(iRow0, m_iNumRows);
+                    iRow1 = MirrorCoord(iRow1, m_iNumRows);
+                }
+                H[0][Lane] = GetElevSample(iCol0, iRow0);
+                H[1][Lane] = GetElevSample(iCol1, iRow0);
+                H[2][Lane] = GetElevSample(iCol0, iRow1);
+                H[3][Lane] = GetElevSample(iCol1, iRow1);
+            }
+
+            // Same operation order as in GetInterpolatedHeight()
+#    if ELEVATION_DATA_SSE2
+            const __m128 H0 = _mm_add_ps(_mm_mul_ps(_mm_load_ps(H[0]), _mm_sub_ps(One, HWeight)), _mm_mul_ps(_mm_load_ps(H[1]), HWeight));
+            const __m128 H1 = _mm_add_ps(_mm_mul_ps(_mm_load_ps(H[2]), _mm_sub_ps(One, HWeight)), _mm_mul_ps(_mm_load_ps(H[3]), HWeight));
+            _mm_storeu_ps(pHeights + i, _mm_add_ps(_mm_mul_ps(H0, _mm_sub_ps(One, VWeight)), _mm_mul_ps(H1, VWeight)));
+#    else
+            const float32x4_t H0 = vaddq_f32(vmulq_f32(vld1q_f32(H[0]), vsubq_f32(One, HWeight)), vmulq_f32(vld1q_f32(H[1]), HWeight));
+            const float32x4_t H1 = vaddq_f32(vmulq_f32(vld1q_f32(H[2]), vsubq_f32(One, HWeight)), vmulq_f32(vld1q_f32(H[3]), HWeight));
+            vst1q_f32(pHeights + i, vaddq_f32(vmulq_f32(H0, vsubq_f32(One, VWeight)), vmulq_f32(H1, VWeight)));
+#    endif
+        }
+    }
+#endif
+    for (; i < NumSamples; ++i)
+        pHeights[i] = GetInterpolatedHeight(pColRow[i].x, pColRow[i].y, iStep);
 }
 
 } // namespace Diligent
@@ -49,19 +49,67 @@
 
 #include "BasicTypes.h"
 #include "BasicMath.hpp"
+#include "RefCntAutoPtr.hpp"
+#include "DataBlob.h"
 
 namespace Diligent
 {
 
+// Tiled elevation file layout:
+//
+//   TiledElevationHeader
+//   TiledElevationLevel[NumLevels]
+//   tiles of level 0, tiles of level 1, ...
+//
+// Every level is split into TileSize x TileSize tiles of 16-bit samples stored row by row.
+// Tiles on the right and bottom borders are padded by replicating the last column/row.
+// Level sizes follow the texture mip chain rules (see GetMipLevelProperties()), and every
+// coarse level is the 2x2 box-filtered version of the previous one.
+struct TiledElevationHeader
+{
+    static constexpr Uint32 MagicNumber   = 0x56454C45; // 'ELEV'
+    static constexpr Uint32 FormatVersion = 1;
+
+    Uint32 Magic        = MagicNumber;
+    Uint32 Version      = FormatVersion;
+    Uint32 NumCols      = 0;
+    Uint32 NumRows      = 0;
+    Uint32 TileSize     = 0;
+    Uint32 NumLevels    = 0;
+    Uint16 MinElevation = 0;
+    Uint16 MaxElevation = 0;
+    Uint32 Padding      = 0;
+};
+static_assert(sizeof(TiledElevationHeader) == 32, "Unexpected tiled elevation header size");
+
+struct TiledElevationLevel
+{
+    Uint32 Width     = 0;
+    Uint32 Height    = 0;
+    Uint32 NumTilesX = 0;
+    Uint32 NumTilesY = 0;
+    // Offset of the first tile from the beginning of the file, in bytes
+    Uint64 DataOffset = 0;
+};
+static_assert(sizeof(TiledElevationLevel) == 24, "Unexpected tiled elevation level size");
+
 // Class implementing elevation data source
 class ElevationDataSource
 {
 public:
-    // Creates data source from the specified raw data file
+    // Creates data source from the specified file. Files with the .elev extension are
+    // memory-mapped tiled elevation files. Any other file is decoded as a 16-bit
+    // single-channel image and tiled in memory.
     ElevationDataSource(const Char* strSrcDemFile);
     virtual ~ElevationDataSource(void);
 
-    void GetDataPtr(const Uint16*& pDataPtr, size_t& Pitch);
+    // clang-format off
+    ElevationDataSource           (const ElevationDataSource&) = delete;
+    ElevationDataSource& operator=(const ElevationDataSource&) = delete;
+    // clang-format on
+
+    // Converts a 16-bit height map image to the tiled elevation format
+    static bool ConvertToTiledFormat(const Char* strSrcDemFile, const Char* strDstFile, Uint32 TileSize = 128);
 
     // Returns minimal height of the whole terrain
     Uint16 GetGlobalMinElevation() const;
@@ -85,12 +133,33 @@ public:
 
     float3 ComputeSurfaceNormal(float fCol, float fRow, float fSampleSpacing, float fHeightScale, int iStep = 1) const;
 
+    // Batched version of GetInterpolatedHeight() that processes NumSamples (column, row) pairs
+    // at once. The results are identical to the per-sample function. The method is thread-safe.
+    void GetInterpolatedHeights(const float2* pColRow, float* pHeights, size_t NumSamples, int iStep = 1) const;
+
     unsigned int GetNumCols() const { return m_iNumCols; }
     unsigned int GetNumRows() const { return m_iNumRows; }
 
+    Uint32 GetNumMipLevels() const { return static_cast<Uint32>(m_Levels.size()); }
+    Uint32 GetTileSize() const { return static_cast<Uint32>(m_iPatchSize); }
+
+    const TiledElevationLevel& GetMipLevel(Uint32 Level) const { return m_Levels[Level]; }
+
+    // Returns TileSize x TileSize samples of the tile at the given mip level
+    const Uint16* GetTile(Uint32 TileX, Uint32 TileY, Uint32 Level = 0) const
+    {
+        const auto& MipLevel = m_Levels[Level];
+        VERIFY_EXPR(TileX < MipLevel.NumTilesX && TileY < MipLevel.NumTilesY);
+        const size_t TileIdx = TileX + size_t{TileY} * MipLevel.NumTilesX;
+        return reinterpret_cast<const Uint16*>(m_pFileData + MipLevel.DataOffset) + TileIdx * m_iPatchSize * m_iPatchSize;
+    }
+
 private:
-    inline Uint16  GetElevSample(Int32 i, Int32 j) const;
-    inline Uint16& GetElevSample(Int32 i, Int32 j);
+    inline Uint16 GetElevSample(Int32 i, Int32 j) const;
+
+    bool MapFile(const Char* strFilePath);
+    void UnmapFile();
+    void InitFromTiledData(const Char* strSrcDemFile);
 
     Uint16 m_GlobalMinElevation = 0;
     Uint16 m_GlobalMaxElevation = 0;
@@ -100,12 +169,19 @@ private:
     int m_iColOffset = 0;
     int m_iRowOffset = 0;
 
-    // The whole terrain height map
-    std::vector<Uint16> m_TheHeightMap;
+    // Tiled elevation data: either the mapped file, or the blob below
+    const Uint8* m_pFileData = nullptr;
+    size_t       m_FileSize  = 0;
+    bool         m_IsMapped  = false;
+    Uint32       m_TileShift = 0;
+
+    // Tiled data of a source image or of a file that could not be mapped
+    RefCntAutoPtr<IDataBlob> m_pDataBlob;
+
+    std::vector<TiledElevationLevel> m_Levels;
 
     Uint32 m_iNumCols = 0;
     Uint32 m_iNumRows = 0;
-    Uint32 m_iStride  = 0;
 };
 
 } // namespace Diligent
@@ -0,0 +1,185 @@
+/*
+ *  Copyright 2019-2022 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "BasicTypes.h"
+
+namespace Diligent
+{
+
+// Persistent worker threads shared by all ParallelFor() calls. The workers are created on first
+// use and sleep between the calls. Several threads may run jobs at the same time, e.g. the main
+// thread and the terrain ring generation thread.
+class ParallelForPool
+{
+public:
+    static ParallelForPool& GetInstance()
+    {
+        static ParallelForPool Pool;
+        return Pool;
+    }
+
+    // Returns the number of worker threads plus the calling thread
+    Uint32 GetNumThreads() const { return static_cast<Uint32>(m_Workers.size()) + 1; }
+
+    // Runs Job(0) ... Job(NumJobs - 1) on the workers and the calling thread and
+    // returns when all jobs are complete.
+    void Run(Uint32 NumJobs, const std::function<void(Uint32)>& Job)
+    {
+        Batch ThisBatch{Job, NumJobs};
+        {
+            std::lock_guard<std::mutex> Lock{m_Mtx};
+            m_Batches.push_back(&ThisBatch);
+        }
+        m_WakeUpCV.notify_all();
+
+        // The calling thread only runs the jobs of its own batch
+        for (Uint32 JobIdx = ThisBatch.NextJob++; JobIdx < NumJobs; JobIdx = ThisBatch.NextJob++)
+        {
+            Job(JobIdx);
+            CompleteJob(ThisBatch);
+        }
+
+        std::unique_lock<std::mutex> Lock{m_Mtx};
+        m_JobCompletedCV.wait(Lock, [&]() { return ThisBatch.NumCompleted == NumJobs; });
+        // Workers that found the batch exhausted may not have removed it yet
+        auto it = std::find(m_Batches.begin(), m_Batches.end(), &ThisBatch);
+        if (it != m_Batches.end())
+            m_Batches.erase(it);
+    }
+
+    ~ParallelForPool()
+    {
+        {
+            std::lock_guard<std::mutex> Lock{m_Mtx};
+            m_Stop = true;
+        }
+        m_WakeUpCV.notify_all();
+        for (auto& Worker : m_Workers)
+            Worker.join();
+    }
+
+    // clang-format off
+    ParallelForPool           (const ParallelForPool&) = delete;
+    ParallelForPool& operator=(const ParallelForPool&) = delete;
+    // clang-format on
+
+private:
+    struct Batch
+    {
+        const std::function<void(Uint32)>& Job;
+        const Uint32                       NumJobs;
+
+        std::atomic<Uint32> NextJob{0};
+        // Protected by m_Mtx
+        Uint32 NumCompleted = 0;
+    };
+
+    ParallelForPool()
+    {
+        const Uint32 NumWorkers = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+        m_Workers.reserve(NumWorkers);
+        for (Uint32 t = 0; t < NumWorkers; ++t)
+            m_Workers.emplace_back(&ParallelForPool::WorkerThreadFunc, this);
+    }
+
+    void CompleteJob(Batch& B)
+    {
+        bool AllJobsCompleted = false;
+        {
+            // The batch owner may return as soon as the last job is complete, so the
+            // batch must not be accessed after the mutex is released
+            std::lock_guard<std::mutex> Lock{m_Mtx};
+            AllJobsCompleted = ++B.NumCompleted == B.NumJobs;
+        }
+        if (AllJobsCompleted)
+            m_JobCompletedCV.notify_all();
+    }
+
+    void WorkerThreadFunc()
+    {
+        std::unique_lock<std::mutex> Lock{m_Mtx};
+        for (;;)
+        {
+            m_WakeUpCV.wait(Lock, [this]() { return m_Stop || !m_Batches.empty(); });
+            if (m_Stop)
+                return;
+
+            // Jobs are only taken while the mutex is held so that the batch can't be
+            // released by its owner in the meantime
+            Batch*       pBatch = m_Batches.front();
+            const Uint32 JobIdx = pBatch->NextJob++;
+            if (JobIdx >= pBatch->NumJobs)
+            {
+                m_Batches.pop_front();
+                continue;
+            }
+
+            Lock.unlock();
+            pBatch->Job(JobIdx);
+            CompleteJob(*pBatch);
+            Lock.lock();
+        }
+    }
+
+    std::vector<std::thread> m_Workers;
+
+    std::mutex              m_Mtx;
+    std::condition_variable m_WakeUpCV;
+    std::condition_variable m_JobCompletedCV;
+    std::deque<Batch*>      m_Batches;
+    bool                    m_Stop = false;
+};
+
+// Splits [0, NumItems) into contiguous ranges and processes them on the threads of ParallelForPool.
+// Handler(Start, End) must only write data that belongs to its range.
+template <typename HandlerType>
+void ParallelFor(Uint32 NumItems, Uint32 MinItemsPerThread, HandlerType&& Handler)
+{
+    auto&        Pool    = ParallelForPool::GetInstance();
+    const Uint32 NumJobs = std::max(std::min(Pool.GetNumThreads(), NumItems / std::max(MinItemsPerThread, 1u)), 1u);
+    if (NumJobs == 1)
+    {
+        Handler(0u, NumItems);
+        return;
+    }
+
+    Pool.Run(NumJobs, [&](Uint32 JobIdx) {
+        Handler(static_cast<Uint32>(Uint64{NumItems} * JobIdx / NumJobs), static_cast<Uint32>(Uint64{NumItems} * (JobIdx + 1) / NumJobs));
+    });
+}
+
+} // namespace Diligent
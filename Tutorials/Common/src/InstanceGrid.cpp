@@ -0,0 +1,274 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *  Copyright 2015-2019 Egor Yusov
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+
+#include <algorithm>
+#include <cmath>
+
+#include "InstanceGrid.hpp"
+#include "MapHelper.hpp"
+#include "GraphicsUtilities.h"
+#include "ShaderMacroHelper.hpp"
+
+namespace Diligent
+{
+
+namespace InstanceGrid
+{
+
+namespace
+{
+
+// The functions below must match generate_instances.csh
+
+constexpr Uint32 NumRandomValues = 8;
+
+// PCG hash, see https://www.reedbeta.com/blog/hash-functions-for-gpu-rendering/
+Uint32 PCGHash(Uint32 Value)
+{
+    const Uint32 State = Value * 747796405u + 2891336453u;
+    const Uint32 Word  = ((State >> ((State >> 28u) + 4u)) ^ State) * 277803737u;
+    return (Word >> 22u) ^ Word;
+}
+
+Uint32 RandomUint(Uint32 Seed, Uint32 InstId, Uint32 ValueInd)
+{
+    return PCGHash(PCGHash(Seed) + InstId * NumRandomValues + ValueInd);
+}
+
+float RandomFloat(Uint32 Seed, Uint32 InstId, Uint32 ValueInd, float Min, float Max)
+{
+    // Use 24 bits so that the value in [0, 1) is exactly representable as float
+    const float Unorm = static_cast<float>(RandomUint(Seed, InstId, ValueInd) >> 8u) * (1.f / 16777216.f);
+    return Min + (Max - Min) * Unorm;
+}
+
+} // namespace
+
+InstanceAttribs GetInstanceAttribs(Uint32 GridSize, Uint32 InstId, Uint32 NumTextures, Uint32 Seed)
+{
+    const Uint32 x = InstId / (GridSize * GridSize);
+    const Uint32 y = (InstId / GridSize) % GridSize;
+    const Uint32 z = InstId % GridSize;
+
+    const float fGridSize = static_cast<float>(GridSize);
+
+    InstanceAttribs Attribs;
+    // Add random offset from central position in the grid
+    Attribs.Offset.x = 2.f * (static_cast<float>(x) + 0.5f + RandomFloat(Seed, InstId, 0, -0.15f, +0.15f)) / fGridSize - 1.f;
+    Attribs.Offset.y = 2.f * (static_cast<float>(y) + 0.5f + RandomFloat(Seed, InstId, 1, -0.15f, +0.15f)) / fGridSize - 1.f;
+    Attribs.Offset.z = 2.f * (static_cast<float>(z) + 0.5f + RandomFloat(Seed, InstId, 2, -0.15f, +0.15f)) / fGridSize - 1.f;
+    // Random scale
+    Attribs.Scale = 0.6f / fGridSize * RandomFloat(Seed, InstId, 3, 0.3f, 1.0f);
+    // Random rotation
+    Attribs.Angles.x = RandomFloat(Seed, InstId, 4, -PI_F, +PI_F);
+    Attribs.Angles.y = RandomFloat(Seed, InstId, 5, -PI_F, +PI_F);
+    Attribs.Angles.z = RandomFloat(Seed, InstId, 6, -PI_F, +PI_F);
+    // Texture array index
+    Attribs.TextureInd = NumTextures > 0 ? RandomUint(Seed, InstId, 7) % NumTextures : 0;
+
+    return Attribs;
+}
+
+float4x4 GetInstanceMatrix(const InstanceAttribs& Attribs)
+{
+    float4x4 Rotation = float4x4::RotationX(Attribs.Angles.x);
+    Rotation *= float4x4::RotationY(Attribs.Angles.y);
+    Rotation *= float4x4::RotationZ(Attribs.Angles.z);
+
+    const float Scale = Attribs.Scale;
+    return Rotation * float4x4::Scale(Scale, Scale, Scale) * float4x4::Translation(Attribs.Offset.x, Attribs.Offset.y, Attribs.Offset.z);
+}
+
+
+GPUGenerator::GPUGenerator(IRenderDevice*                   pDevice,
+                           IShaderSourceInputStreamFactory* pShaderSourceFactory,
+                           const char*                      CSFilePath,
+                           Uint32                           InstanceSize) :
+    m_InstanceSize{InstanceSize}
+{
+    VERIFY(InstanceSize >= sizeof(float4x4) && InstanceSize % sizeof(float) == 0, "Instance size must be a multiple of 4 and include the matrix");
+
+    ShaderCreateInfo ShaderCI;
+    ShaderCI.SourceLanguage             = SHADER_SOURCE_LANGUAGE_HLSL;
+    ShaderCI.pShaderSourceStreamFactory = pShaderSourceFactory;
+    ShaderCI.Desc.ShaderType            = SHADER_TYPE_COMPUTE;
+    ShaderCI.Desc.Name                  = "Generate instances CS";
+    ShaderCI.EntryPoint                 = "main";
+    ShaderCI.FilePath                   = CSFilePath;
+
+    ShaderMacroHelper Macros;
+    Macros.AddShaderMacro("THREAD_GROUP_SIZE", ThreadGroupSize);
+    Macros.AddShaderMacro("INSTANCE_STRIDE", InstanceSize / static_cast<Uint32>(sizeof(float)));
+    ShaderCI.Macros = Macros;
+
+    RefCntAutoPtr<IShader> pCS;
+    pDevice->CreateShader(ShaderCI, &pCS);
+    if (!pCS)
+        return;
+
+    // The instance buffer may be recreated, so it is bound through a mutable variable
+    // clang-format off
+    ShaderResourceVariableDesc Vars[] =
+    {
+        {SHADER_TYPE_COMPUTE, "Constants",   SHADER_RESOURCE_VARIABLE_TYPE_STATIC},
+        {SHADER_TYPE_COMPUTE, "g_Instances", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}
+    };
+    // clang-format on
+
+    ComputePipelineStateCreateInfo PSOCreateInfo;
+    PSOCreateInfo.PSODesc.Name                        = "Generate instances PSO";
+    PSOCreateInfo.PSODesc.ResourceLayout.Variables    = Vars;
+    PSOCreateInfo.PSODesc.ResourceLayout.NumVariables = _countof(Vars);
+    PSOCreateInfo.pCS                                 = pCS;
+    pDevice->CreateComputePipelineState(PSOCreateInfo, &m_pPSO);
+    if (!m_pPSO)
+        return;
+
+    CreateUniformBuffer(pDevice, sizeof(Uint32) * 4, "Generate instances constants", &m_pConstants);
+    m_pPSO->GetStaticVariableByName(SHADER_TYPE_COMPUTE, "Constants")->Set(m_pConstants);
+}
+
+bool GPUGenerator::IsSupported(IRenderDevice* pDevice)
+{
+    return pDevice->GetDeviceInfo().Features.ComputeShaders == DEVICE_FEATURE_STATE_ENABLED;
+}
+
+void GPUGenerator::Generate(IDeviceContext* pContext, IBuffer* pInstanceBuffer, Uint32 GridSize, Uint32 NumTextures, Uint32 Seed)
+{
+    if (!m_pPSO)
+        return;
+
+    const Uint32 NumInstances = GridSize * GridSize * GridSize;
+    VERIFY((pInstanceBuffer->GetDesc().BindFlags & BufferBindFlags) == BufferBindFlags && pInstanceBuffer->GetDesc().Mode == BufferMode,
+           "Instance buffer must be created with GPUGenerator::BufferBindFlags and GPUGenerator::BufferMode");
+    if (Uint64{NumInstances} * m_InstanceSize > pInstanceBuffer->GetDesc().Size)
+    {
+        LOG_ERROR_MESSAGE("Instance buffer '", pInstanceBuffer->GetDesc().Name, "' is too small for ", NumInstances, " instances");
+        return;
+    }
+
+    if (m_pBoundBuffer != pInstanceBuffer)
+    {
+        // The shader writes instance data as individual floats
+        BufferViewDesc ViewDesc;
+        ViewDesc.Name                 = "Instance buffer UAV";
+        ViewDesc.ViewType             = BUFFER_VIEW_UNORDERED_ACCESS;
+        ViewDesc.Format.ValueType     = VT_FLOAT32;
+        ViewDesc.Format.NumComponents = 1;
+
+        RefCntAutoPtr<IBufferView> pUAV;
+        pInstanceBuffer->CreateView(ViewDesc, &pUAV);
+
+        m_pSRB.Release();
+        m_pPSO->CreateShaderResourceBinding(&m_pSRB, true);
+        m_pSRB->GetVariableByName(SHADER_TYPE_COMPUTE, "g_Instances")->Set(pUAV);
+        m_pBoundBuffer = pInstanceBuffer;
+    }
+
+    {
+        MapHelper<Uint32> Constants(pContext, m_pConstants, MAP_WRITE, MAP_FLAG_DISCARD);
+        Constants[0] = GridSize;
+        Constants[1] = NumTextures;
+        Constants[2] = Seed;
+        Constants[3] = 0;
+    }
+
+    // Transition the resources explicitly so that committing the SRB only needs to verify the states
+    StateTransitionDesc Barriers[] = {
+        {m_pConstants, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_CONSTANT_BUFFER, STATE_TRANSITION_FLAG_UPDATE_STATE},
+        {pInstanceBuffer, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_UNORDERED_ACCESS, STATE_TRANSITION_FLAG_UPDATE_STATE},
+    };
+    pContext->TransitionResourceStates(_countof(Barriers), Barriers);
+
+    pContext->SetPipelineState(m_pPSO);
+    pContext->CommitShaderResources(m_pSRB, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+
+    DispatchComputeAttribs DispatchAttribs{(NumInstances + ThreadGroupSize - 1) / ThreadGroupSize, 1, 1};
+    pContext->DispatchCompute(DispatchAttribs);
+
+    // Make the data visible to the input assembler
+    StateTransitionDesc VBBarrier{pInstanceBuffer, RESOURCE_STATE_UNORDERED_ACCESS, RESOURCE_STATE_VERTEX_BUFFER, STATE_TRANSITION_FLAG_UPDATE_STATE};
+    pContext->TransitionResourceStates(1, &VBBarrier);
+}
+
+
+Uint32 VerifyInstanceBuffer(IRenderDevice*  pDevice,
+                            IDeviceContext* pContext,
+                            IBuffer*        pInstanceBuffer,
+                            const void*     pRefData,
+                            Uint32          NumInstances,
+                            Uint32          InstanceSize,
+                            float           Tolerance,
+                            float&          MaxError)
+{
+    MaxError = 0;
+
+    const Uint64 DataSize = Uint64{NumInstances} * InstanceSize;
+
+    BufferDesc StagingDesc;
+    StagingDesc.Name           = "Instance data readback buffer";
+    StagingDesc.Usage          = USAGE_STAGING;
+    StagingDesc.CPUAccessFlags = CPU_ACCESS_READ;
+    StagingDesc.Size           = DataSize;
+
+    RefCntAutoPtr<IBuffer> pStagingBuffer;
+    pDevice->CreateBuffer(StagingDesc, nullptr, &pStagingBuffer);
+    if (!pStagingBuffer)
+        return NumInstances;
+
+    pContext->CopyBuffer(pInstanceBuffer, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION,
+                         pStagingBuffer, 0, DataSize, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    pContext->WaitForIdle();
+
+    MapHelper<float> GPUData(pContext, pStagingBuffer, MAP_READ, MAP_FLAG_NONE);
+    if (!GPUData)
+        return NumInstances;
+
+    const auto*  pRefValues    = static_cast<const float*>(pRefData);
+    const Uint32 NumComponents = InstanceSize / static_cast<Uint32>(sizeof(float));
+
+    Uint32 NumMismatches = 0;
+    for (Uint32 Inst = 0; Inst < NumInstances; ++Inst)
+    {
+        bool Match = true;
+        for (Uint32 c = 0; c < NumComponents; ++c)
+        {
+            const size_t Idx   = size_t{Inst} * NumComponents + c;
+            const float  Error = std::abs(GPUData[Idx] - pRefValues[Idx]);
+            MaxError           = std::max(MaxError, Error);
+            // NaN compares false and is counted as mismatch
+            Match = Match && Error <= Tolerance;
+        }
+        if (!Match)
+            ++NumMismatches;
+    }
+
+    return NumMismatches;
+}
+
+} // namespace InstanceGrid
+
+} // namespace Diligent
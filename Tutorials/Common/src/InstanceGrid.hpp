@@ -0,0 +1,110 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *  Copyright 2015-2019 Egor Yusov
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+
+#pragma once
+
+#include "RenderDevice.h"
+#include "DeviceContext.h"
+#include "Buffer.h"
+#include "PipelineState.h"
+#include "RefCntAutoPtr.hpp"
+#include "BasicMath.hpp"
+
+namespace Diligent
+{
+
+// Randomly perturbed grid of cube instances used by the instancing tutorials.
+// Random values are produced by a counter-based hash of the seed, the instance index and the value
+// index rather than by a sequential generator. This way every instance can be computed independently,
+// and the CPU and the compute shader (see generate_instances.csh) produce the same instances.
+namespace InstanceGrid
+{
+
+struct InstanceAttribs
+{
+    float3 Offset;
+    float  Scale = 1;
+    float3 Angles; // Rotation angles around X, Y and Z axes
+    Uint32 TextureInd = 0;
+};
+
+// Instances are enumerated in x, y, z order with z changing fastest:
+// InstId = (x * GridSize + y) * GridSize + z
+InstanceAttribs GetInstanceAttribs(Uint32 GridSize, Uint32 InstId, Uint32 NumTextures, Uint32 Seed);
+
+// Combines rotation, scale and translation of the instance
+float4x4 GetInstanceMatrix(const InstanceAttribs& Attribs);
+
+
+// Generates instance data in the compute shader directly in the instance buffer.
+class GPUGenerator
+{
+public:
+    // InstanceSize is the size of one instance in bytes: a float4x4 matrix, optionally
+    // followed by the texture index stored as float.
+    GPUGenerator(IRenderDevice*                   pDevice,
+                 IShaderSourceInputStreamFactory* pShaderSourceFactory,
+                 const char*                      CSFilePath,
+                 Uint32                           InstanceSize);
+
+    // Whether the device supports the compute path
+    static bool IsSupported(IRenderDevice* pDevice);
+
+    // Bind flags and mode the instance buffer must be created with to be written by the generator
+    static constexpr BIND_FLAGS  BufferBindFlags = BIND_VERTEX_BUFFER | BIND_UNORDERED_ACCESS;
+    static constexpr BUFFER_MODE BufferMode      = BUFFER_MODE_FORMATTED;
+
+    // Writes GridSize^3 instances to the beginning of the buffer. The buffer is explicitly
+    // transitioned to the unordered access state before the dispatch and to the vertex buffer
+    // state after it.
+    void Generate(IDeviceContext* pContext, IBuffer* pInstanceBuffer, Uint32 GridSize, Uint32 NumTextures, Uint32 Seed);
+
+private:
+    static constexpr Uint32 ThreadGroupSize = 64;
+
+    const Uint32 m_InstanceSize;
+
+    RefCntAutoPtr<IPipelineState>         m_pPSO;
+    RefCntAutoPtr<IBuffer>                m_pConstants;
+    RefCntAutoPtr<IShaderResourceBinding> m_pSRB;
+    RefCntAutoPtr<IBuffer>                m_pBoundBuffer;
+};
+
+// Reads the first NumInstances instances of the buffer back and compares them with the reference
+// data. Returns the number of instances with at least one component that differs by more than
+// Tolerance. MaxError receives the largest absolute difference.
+Uint32 VerifyInstanceBuffer(IRenderDevice*  pDevice,
+                            IDeviceContext* pContext,
+                            IBuffer*        pInstanceBuffer,
+                            const void*     pRefData,
+                            Uint32          NumInstances,
+                            Uint32          InstanceSize,
+                            float           Tolerance,
+                            float&          MaxError);
+
+} // namespace InstanceGrid
+
+} // namespace Diligent
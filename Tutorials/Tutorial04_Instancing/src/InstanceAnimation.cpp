@@ -0,0 +1,278 @@
+/*
+ *  Copyright 2019-2022 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include "InstanceAnimation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define INSTANCE_ANIMATION_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#    include <arm_neon.h>
+#    define INSTANCE_ANIMATION_NEON 1
+#endif
+
+namespace Diligent
+{
+
+void InstanceAnimationData::Resize(Uint32 Count)
+{
+    NumInstances = Count;
+
+    // Pad the arrays so that the last batch can always be loaded with full-width SIMD loads
+    const size_t PaddedCount = (size_t{Count} + 3) & ~size_t{3};
+    for (auto& Row : Basis)
+    {
+        for (auto& Column : Row)
+            Column.assign(PaddedCount, 0.f);
+    }
+    for (auto& Component : Translation)
+        Component.assign(PaddedCount, 0.f);
+    Phase.assign(PaddedCount, 0.f);
+    Speed.assign(PaddedCount, 0.f);
+}
+
+void InstanceAnimationData::SetInstance(Uint32 Inst, const float4x4& InstBasis, const float3& InstTranslation, float InstPhase, float InstSpeed)
+{
+    VERIFY_EXPR(Inst < NumInstances);
+    for (int r = 0; r < 3; ++r)
+    {
+        for (int c = 0; c < 3; ++c)
+            Basis[r][c][Inst] = InstBasis[r][c];
+    }
+    Translation[0][Inst] = InstTranslation.x;
+    Translation[1][Inst] = InstTranslation.y;
+    Translation[2][Inst] = InstTranslation.z;
+    Phase[Inst]          = InstPhase;
+    Speed[Inst]          = InstSpeed;
+}
+
+namespace
+{
+
+// The same kernel is instantiated for scalars and SIMD vectors through these overloads
+
+template <typename T>
+inline T Set1(float f);
+template <typename T>
+inline T Load(const float* p);
+
+template <>
+inline float Set1<float>(float f) { return f; }
+template <>
+inline float Load<float>(const float* p) { return *p; }
+
+inline float Add(float a, float b) { return a + b; }
+inline float Sub(float a, float b) { return a - b; }
+inline float Mul(float a, float b) { return a * b; }
+inline float Min(float a, float b) { return std::min(a, b); }
+inline float Max(float a, float b) { return std::max(a, b); }
+inline float Floor(float f) { return std::floor(f); }
+
+#if INSTANCE_ANIMATION_SSE2
+
+using Vec4 = __m128;
+
+template <>
+inline Vec4 Set1<Vec4>(float f) { return _mm_set1_ps(f); }
+template <>
+inline Vec4 Load<Vec4>(const float* p) { return _mm_loadu_ps(p); }
+
+inline Vec4 Add(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+inline Vec4 Sub(Vec4 a, Vec4 b) { return _mm_sub_ps(a, b); }
+inline Vec4 Mul(Vec4 a, Vec4 b) { return _mm_mul_ps(a, b); }
+inline Vec4 Min(Vec4 a, Vec4 b) { return _mm_min_ps(a, b); }
+inline Vec4 Max(Vec4 a, Vec4 b) { return _mm_max_ps(a, b); }
+
+inline Vec4 Floor(Vec4 v)
+{
+    // SSE2 has no floor instruction, so truncate and correct negative values
+    const Vec4 Trunc = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+    return _mm_sub_ps(Trunc, _mm_and_ps(_mm_cmpgt_ps(Trunc, v), _mm_set1_ps(1.f)));
+}
+
+inline void StoreMatrices(float* pDst, Vec4 Rows[4][4], bool Stream)
+{
+    // Rows[r] holds row r of four matrices in SoA layout. Transpose every row to get
+    // the rows of individual matrices.
+    for (int r = 0; r < 4; ++r)
+        _MM_TRANSPOSE4_PS(Rows[r][0], Rows[r][1], Rows[r][2], Rows[r][3]);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int r = 0; r < 4; ++r)
+        {
+            if (Stream)
+                _mm_stream_ps(pDst + i * 16 + r * 4, Rows[r][i]);
+            else
+                _mm_storeu_ps(pDst + i * 16 + r * 4, Rows[r][i]);
+        }
+    }
+}
+
+#elif INSTANCE_ANIMATION_NEON
+
+using Vec4 = float32x4_t;
+
+template <>
+inline Vec4 Set1<Vec4>(float f) { return vdupq_n_f32(f); }
+template <>
+inline Vec4 Load<Vec4>(const float* p) { return vld1q_f32(p); }
+
+inline Vec4 Add(Vec4 a, Vec4 b) { return vaddq_f32(a, b); }
+inline Vec4 Sub(Vec4 a, Vec4 b) { return vsubq_f32(a, b); }
+inline Vec4 Mul(Vec4 a, Vec4 b) { return vmulq_f32(a, b); }
+inline Vec4 Min(Vec4 a, Vec4 b) { return vminq_f32(a, b); }
+inline Vec4 Max(Vec4 a, Vec4 b) { return vmaxq_f32(a, b); }
+
+inline Vec4 Floor(Vec4 v)
+{
+    const Vec4 Trunc = vcvtq_f32_s32(vcvtq_s32_f32(v));
+    return vsubq_f32(Trunc, vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(Trunc, v), vreinterpretq_u32_f32(vdupq_n_f32(1.f)))));
+}
+
+inline void StoreMatrices(float* pDst, Vec4 Rows[4][4], bool /*Stream*/)
+{
+    for (int r = 0; r < 4; ++r)
+    {
+        // (x0 x1 x2 x3), (y0 y1 y2 y3), (z0 z1 z2 z3), (w0 w1 w2 w3) -> (x0 y0 z0 w0), ...
+        const float32x4x2_t XZ = vzipq_f32(Rows[r][0], Rows[r][2]);
+        const float32x4x2_t YW = vzipq_f32(Rows[r][1], Rows[r][3]);
+        const float32x4x2_t Lo = vzipq_f32(XZ.val[0], YW.val[0]);
+        const float32x4x2_t Hi = vzipq_f32(XZ.val[1], YW.val[1]);
+        vst1q_f32(pDst + 0 * 16 + r * 4, Lo.val[0]);
+        vst1q_f32(pDst + 1 * 16 + r * 4, Lo.val[1]);
+        vst1q_f32(pDst + 2 * 16 + r * 4, Hi.val[0]);
+        vst1q_f32(pDst + 3 * 16 + r * 4, Hi.val[1]);
+    }
+}
+
+#endif
+
+// Wraps the angle to [-pi, pi]
+template <typename T>
+inline T WrapAngle(T x)
+{
+    const T n = Floor(Add(Mul(x, Set1<T>(0.5f / PI_F)), Set1<T>(0.5f)));
+    return Sub(x, Mul(n, Set1<T>(2.f * PI_F)));
+}
+
+// Sine of an angle in [-pi, pi]
+template <typename T>
+inline T SinWrapped(T x)
+{
+    // Reflect the angle into [-pi/2, pi/2] where sin(x) = sin(pi - x) = sin(-pi - x)
+    x = Min(x, Sub(Set1<T>(PI_F), x));
+    x = Max(x, Sub(Set1<T>(-PI_F), x));
+
+    // Taylor series up to x^11, the error is below 1e-7 in [-pi/2, pi/2]
+    const T x2 = Mul(x, x);
+    T       p  = Set1<T>(-1.f / 39916800.f);
+    p          = Add(Mul(p, x2), Set1<T>(1.f / 362880.f));
+    p          = Add(Mul(p, x2), Set1<T>(-1.f / 5040.f));
+    p          = Add(Mul(p, x2), Set1<T>(1.f / 120.f));
+    p          = Add(Mul(p, x2), Set1<T>(-1.f / 6.f));
+    p          = Add(Mul(p, x2), Set1<T>(1.f));
+    return Mul(p, x);
+}
+
+template <typename T>
+inline void SinCos(T x, T& s, T& c)
+{
+    s = SinWrapped(WrapAngle(x));
+    c = SinWrapped(WrapAngle(Add(x, Set1<T>(PI_F * 0.5f))));
+}
+
+// Computes rows of the world matrices of the instance(s) starting at Inst:
+//
+//                  | c  0 -s |   | B0 |   | c * B0 - s * B2 |
+//      RotY * B =  | 0  1  0 | * | B1 | = |       B1        |
+//                  | s  0  c |   | B2 |   | s * B0 + c * B2 |
+//
+template <typename T>
+inline void ComposeRows(const InstanceAnimationData& Data, T Time, size_t Inst, T Rows[4][4])
+{
+    T s, c;
+    SinCos(Add(Load<T>(&Data.Phase[Inst]), Mul(Load<T>(&Data.Speed[Inst]), Time)), s, c);
+
+    const T Zero = Set1<T>(0.f);
+    for (int col = 0; col < 3; ++col)
+    {
+        const T B0 = Load<T>(&Data.Basis[0][col][Inst]);
+        const T B1 = Load<T>(&Data.Basis[1][col][Inst]);
+        const T B2 = Load<T>(&Data.Basis[2][col][Inst]);
+
+        Rows[0][col] = Sub(Mul(c, B0), Mul(s, B2));
+        Rows[1][col] = B1;
+        Rows[2][col] = Add(Mul(s, B0), Mul(c, B2));
+        Rows[3][col] = Load<T>(&Data.Translation[col][Inst]);
+    }
+    Rows[0][3] = Zero;
+    Rows[1][3] = Zero;
+    Rows[2][3] = Zero;
+    Rows[3][3] = Set1<T>(1.f);
+}
+
+} // namespace
+
+void ComposeInstanceMatrices(const InstanceAnimationData& Data, float Time, Uint32 Start, Uint32 End, float4x4* pDstMatrices)
+{
+    VERIFY_EXPR(Start <= End && End <= Data.NumInstances);
+
+    Uint32 Inst = Start;
+
+#if INSTANCE_ANIMATION_SSE2 || INSTANCE_ANIMATION_NEON
+    const bool Stream = (reinterpret_cast<uintptr_t>(pDstMatrices + Start) & 15) == 0;
+    const Vec4 vTime  = Set1<Vec4>(Time);
+    for (; Inst + 4 <= End; Inst += 4)
+    {
+        Vec4 Rows[4][4];
+        ComposeRows(Data, vTime, Inst, Rows);
+        StoreMatrices(reinterpret_cast<float*>(pDstMatrices + Inst), Rows, Stream);
+    }
+#    if INSTANCE_ANIMATION_SSE2
+    if (Stream)
+        _mm_sfence();
+#    endif
+#endif
+
+    for (; Inst < End; ++Inst)
+    {
+        float Rows[4][4];
+        ComposeRows(Data, Time, Inst, Rows);
+        pDstMatrices[Inst] = float4x4{
+            Rows[0][0], Rows[0][1], Rows[0][2], Rows[0][3],
+            Rows[1][0], Rows[1][1], Rows[1][2], Rows[1][3],
+            Rows[2][0], Rows[2][1], Rows[2][2], Rows[2][3],
+            Rows[3][0], Rows[3][1], Rows[3][2], Rows[3][3],
+        };
+    }
+}
+
+} // namespace Diligent
@@ -0,0 +1,63 @@
+/*
+ *  Copyright 2019-2022 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "BasicMath.hpp"
+
+namespace Diligent
+{
+
+// Animation parameters of all instances in structure-of-arrays layout, so that the
+// matrices of several instances can be composed at once with SIMD instructions.
+// Every instance spins around its local Y axis:
+//
+//      World = RotationY(Phase + Speed * Time) * Basis + Translation,
+//
+// where Basis combines the random rotation and the scale of the instance.
+struct InstanceAnimationData
+{
+    std::vector<float> Basis[3][3]; // [Row][Column][Instance]
+    std::vector<float> Translation[3];
+    std::vector<float> Phase;
+    std::vector<float> Speed;
+
+    Uint32 NumInstances = 0;
+
+    void Resize(Uint32 Count);
+
+    // Only the upper-left 3x3 part of InstBasis is used
+    void SetInstance(Uint32 Inst, const float4x4& InstBasis, const float3& InstTranslation, float InstPhase, float InstSpeed);
+};
+
+// Writes the world matrices of instances [Start, End) to pDstMatrices[Start, End).
+// Uses streaming stores when the destination is 16-byte aligned, which is the best choice
+// for write-combined memory of mapped dynamic buffers.
+void ComposeInstanceMatrices(const InstanceAnimationData& Data, float Time, Uint32 Start, Uint32 End, float4x4* pDstMatrices);
+
+} // namespace Diligent
@@ -26,6 +26,9 @@
  */
 
 #include <random>
+#include <chrono>
+#include <thread>
+#include <algorithm>
 
 #include "Tutorial04_Instancing.hpp"
 #include "MapHelper.hpp"
@@ -34,6 +37,7 @@
 #include "ColorConversion.h"
 #include "../../Common/src/TexturedCube.hpp"
 #include "imgui.h"
+#include "CommandLineParser.hpp"
 
 namespace Diligent
 {
@@ -43,6 +47,60 @@ SampleBase* CreateSample()
     return new Tutorial04_Instancing();
 }
 
+namespace
+{
+
+std::vector<float4x4> ComputeInstanceData(Uint32 GridSize, Uint32 Seed)
+{
+    const Uint32 NumInstances = GridSize * GridSize * GridSize;
+
+    std::vector<float4x4> InstanceData(NumInstances);
+    for (Uint32 InstId = 0; InstId < NumInstances; ++InstId)
+    {
+        // Random offset, scale and rotation of the instance are computed from its index, which
+        // allows generating the same instances in the compute shader.
+        const auto Attribs   = InstanceGrid::GetInstanceAttribs(GridSize, InstId, 0, Seed);
+        InstanceData[InstId] = InstanceGrid::GetInstanceMatrix(Attribs);
+    }
+    return InstanceData;
+}
+
+} // namespace
+
+Tutorial04_Instancing::CommandLineStatus Tutorial04_Instancing::ProcessCommandLine(int argc, const char* const* argv)
+{
+    CommandLineParser ArgsParser{argc, argv};
+    ArgsParser.Parse("gpu_instances", m_GenerateOnGPU);
+    ArgsParser.Parse("verify_gpu_instances", m_VerifyGPUInstances);
+
+    return CommandLineStatus::OK;
+}
+
+void Tutorial04_Instancing::ModifyEngineInitInfo(const ModifyEngineInitInfoAttribs& Attribs)
+{
+    SampleBase::ModifyEngineInitInfo(Attribs);
+    // Compute shaders are only needed to generate instances on the GPU
+    Attribs.EngineCI.Features.ComputeShaders = DEVICE_FEATURE_STATE_OPTIONAL;
+    // In animated mode, the entire instance buffer (up to 128 MB for the largest grid) is
+    // allocated from the dynamic heap every frame, so the heap must hold several frames in flight.
+#if VULKAN_SUPPORTED
+    if (Attribs.DeviceType == RENDER_DEVICE_TYPE_VULKAN)
+    {
+        EngineVkCreateInfo& EngineVkCI = static_cast<EngineVkCreateInfo&>(Attribs.EngineCI);
+        EngineVkCI.DynamicHeapSize     = 512 << 20;
+        EngineVkCI.DynamicHeapPageSize = 4 << 20;
+    }
+#endif
+#if WEBGPU_SUPPORTED
+    if (Attribs.DeviceType == RENDER_DEVICE_TYPE_WEBGPU)
+    {
+        EngineWebGPUCreateInfo& EngineWgpuCI = static_cast<EngineWebGPUCreateInfo&>(Attribs.EngineCI);
+        EngineWgpuCI.DynamicHeapSize         = 512 << 20;
+        EngineWgpuCI.DynamicHeapPageSize     = 4 << 20;
+    }
+#endif
+}
+
 void Tutorial04_Instancing::CreatePipelineState()
 {
     // clang-format off
@@ -101,13 +159,35 @@ void Tutorial04_Instancing::CreatePipelineState()
 
 void Tutorial04_Instancing::CreateInstanceBuffer()
 {
+    m_InstanceBuffer.Release();
+
     // Create instance data buffer that will store transformation matrices
     BufferDesc InstBuffDesc;
-    InstBuffDesc.Name = "Instance data buffer";
-    // Use default usage as this buffer will only be updated when grid size changes
-    InstBuffDesc.Usage     = USAGE_DEFAULT;
+    InstBuffDesc.Name      = "Instance data buffer";
     InstBuffDesc.BindFlags = BIND_VERTEX_BUFFER;
-    InstBuffDesc.Size      = sizeof(float4x4) * MaxInstances;
+    if (m_AnimateInstances)
+    {
+        // Animated instances are rewritten every frame, so use dynamic buffer that is
+        // sized to the current grid to avoid wasting dynamic memory
+        const Uint64 NumInstances = static_cast<Uint64>(m_GridSize) * m_GridSize * m_GridSize;
+
+        InstBuffDesc.Usage          = USAGE_DYNAMIC;
+        InstBuffDesc.CPUAccessFlags = CPU_ACCESS_WRITE;
+        InstBuffDesc.Size           = sizeof(float4x4) * NumInstances;
+    }
+    else
+    {
+        // Use default usage as this buffer will only be updated when grid size changes
+        InstBuffDesc.Usage = USAGE_DEFAULT;
+        InstBuffDesc.Size  = sizeof(float4x4) * MaxInstances;
+        if (m_GPUGenerator)
+        {
+            // Allow the compute shader to write instance data directly to the buffer
+            InstBuffDesc.BindFlags         = InstanceGrid::GPUGenerator::BufferBindFlags;
+            InstBuffDesc.Mode              = InstanceGrid::GPUGenerator::BufferMode;
+            InstBuffDesc.ElementByteStride = sizeof(float);
+        }
+    }
     m_pDevice->CreateBuffer(InstBuffDesc, nullptr, &m_InstanceBuffer);
     PopulateInstanceBuffer();
 }
@@ -117,9 +197,41 @@ void Tutorial04_Instancing::UpdateUI()
     ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
     if (ImGui::Begin("Settings", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
     {
-        if (ImGui::SliderInt("Grid Size", &m_GridSize, 1, 32))
+        if (ImGui::Checkbox("Animate instances", &m_AnimateInstances))
+        {
+            m_GridSize = std::min(m_GridSize, MaxGridSize);
+            CreateInstanceBuffer();
+        }
+
+        if (ImGui::SliderInt("Grid Size", &m_GridSize, 1, m_AnimateInstances ? MaxAnimatedGridSize : MaxGridSize))
+        {
+            if (m_AnimateInstances)
+                CreateInstanceBuffer();
+            else
+                PopulateInstanceBuffer();
+        }
+
+        if (m_AnimateInstances)
+        {
+            ImGui::Text("Instances: %d", m_GridSize * m_GridSize * m_GridSize);
+            ImGui::Text("Update time: %.2f ms", m_UpdateTimeMs);
+            ImGui::Text("Instances/ms: %.0f", m_InstancesPerMs);
+        }
+        else if (m_GPUGenerator)
         {
-            PopulateInstanceBuffer();
+            if (ImGui::Checkbox("Generate on GPU", &m_GenerateOnGPU))
+            {
+                PopulateInstanceBuffer();
+            }
+
+            if (ImGui::Button("Verify GPU instances"))
+            {
+                VerifyGPUInstances();
+            }
+            if (m_Verification.Done)
+            {
+                ImGui::Text("%u instances, %u mismatches, max error %.2e", m_Verification.NumInstances, m_Verification.NumMismatches, m_Verification.MaxError);
+            }
         }
     }
     ImGui::End();
@@ -138,53 +250,220 @@ void Tutorial04_Instancing::Initialize(const SampleInitInfo& InitInfo)
     // Set cube texture SRV in the SRB
     m_SRB->GetVariableByName(SHADER_TYPE_PIXEL, "g_Texture")->Set(m_TextureSRV);
 
+    if (InstanceGrid::GPUGenerator::IsSupported(m_pDevice))
+    {
+        RefCntAutoPtr<IShaderSourceInputStreamFactory> pShaderSourceFactory;
+        m_pEngineFactory->CreateDefaultShaderSourceStreamFactory(nullptr, &pShaderSourceFactory);
+        m_GPUGenerator = std::make_unique<InstanceGrid::GPUGenerator>(m_pDevice, pShaderSourceFactory, "generate_instances.csh", Uint32{sizeof(float4x4)});
+    }
+    else if (m_GenerateOnGPU || m_VerifyGPUInstances)
+    {
+        LOG_WARNING_MESSAGE("Compute shaders are not supported by this device. Instances will be generated on the CPU.");
+        m_GenerateOnGPU      = false;
+        m_VerifyGPUInstances = false;
+    }
+
     CreateInstanceBuffer();
+
+    if (m_VerifyGPUInstances)
+        VerifyGPUInstances();
+
+    // Worker threads sleep until animated instances need to be updated
+    StartWorkerThreads(std::max(std::thread::hardware_concurrency(), 1u) - 1);
 }
 
 void Tutorial04_Instancing::PopulateInstanceBuffer()
 {
-    // Populate instance data buffer
-    const auto            zGridSize = static_cast<size_t>(m_GridSize);
-    std::vector<float4x4> InstanceData(zGridSize * zGridSize * zGridSize);
-
-    float fGridSize = static_cast<float>(m_GridSize);
+    const Uint32 NumInstances = static_cast<Uint32>(m_GridSize * m_GridSize * m_GridSize);
 
-    std::mt19937 gen; // Standard mersenne_twister_engine. Use default seed
-                      // to generate consistent distribution.
+    if (m_AnimateInstances)
+    {
+        std::mt19937 gen; // Standard mersenne_twister_engine. Use default seed
+                          // to generate consistent distribution.
 
-    std::uniform_real_distribution<float> scale_distr(0.3f, 1.0f);
-    std::uniform_real_distribution<float> offset_distr(-0.15f, +0.15f);
-    std::uniform_real_distribution<float> rot_distr(-PI_F, +PI_F);
+        std::uniform_real_distribution<float> phase_distr(-PI_F, +PI_F);
+        std::uniform_real_distribution<float> speed_distr(-2.f, +2.f);
 
-    float BaseScale = 0.6f / fGridSize;
-    int   instId    = 0;
-    for (int x = 0; x < m_GridSize; ++x)
-    {
-        for (int y = 0; y < m_GridSize; ++y)
+        m_AnimationData.Resize(NumInstances);
+        for (Uint32 InstId = 0; InstId < NumInstances; ++InstId)
         {
-            for (int z = 0; z < m_GridSize; ++z)
-            {
-                // Add random offset from central position in the grid
-                float xOffset = 2.f * (x + 0.5f + offset_distr(gen)) / fGridSize - 1.f;
-                float yOffset = 2.f * (y + 0.5f + offset_distr(gen)) / fGridSize - 1.f;
-                float zOffset = 2.f * (z + 0.5f + offset_distr(gen)) / fGridSize - 1.f;
-                // Random scale
-                float scale = BaseScale * scale_distr(gen);
-                // Random rotation
-                float4x4 rotation = float4x4::RotationX(rot_distr(gen));
-                rotation *= float4x4::RotationY(rot_distr(gen));
-                rotation *= float4x4::RotationZ(rot_distr(gen));
-                // Combine rotation, scale and translation
-                float4x4 matrix        = rotation * float4x4::Scale(scale, scale, scale) * float4x4::Translation(xOffset, yOffset, zOffset);
-                InstanceData[instId++] = matrix;
-            }
+            const auto Attribs = InstanceGrid::GetInstanceAttribs(m_GridSize, InstId, 0, InstanceSeed);
+            // Only the rotation and scale part of the matrix is used as the basis,
+            // the translation is applied separately by the animation kernel
+            m_AnimationData.SetInstance(InstId, InstanceGrid::GetInstanceMatrix(Attribs), Attribs.Offset, phase_distr(gen), speed_distr(gen));
         }
+
+        // The buffer will be written by UpdateAnimatedInstances() every frame
+        return;
+    }
+
+    if (m_GenerateOnGPU)
+    {
+        // The compute shader writes instance data directly to the instance buffer,
+        // so the only CPU work is a single dispatch
+        m_GPUGenerator->Generate(m_pImmediateContext, m_InstanceBuffer, static_cast<Uint32>(m_GridSize), 0, InstanceSeed);
+        return;
     }
+
+    // Populate instance data buffer
+    const auto InstanceData = ComputeInstanceData(static_cast<Uint32>(m_GridSize), InstanceSeed);
+
     // Update instance data buffer
     Uint32 DataSize = static_cast<Uint32>(sizeof(InstanceData[0]) * InstanceData.size());
     m_pImmediateContext->UpdateBuffer(m_InstanceBuffer, 0, DataSize, InstanceData.data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
 }
 
+void Tutorial04_Instancing::VerifyGPUInstances()
+{
+    if (!m_GPUGenerator || m_AnimateInstances)
+        return;
+
+    const auto InstanceData = ComputeInstanceData(static_cast<Uint32>(m_GridSize), InstanceSeed);
+    m_GPUGenerator->Generate(m_pImmediateContext, m_InstanceBuffer, static_cast<Uint32>(m_GridSize), 0, InstanceSeed);
+
+    // GPU sin and cos may be slightly less precise than the CPU ones
+    constexpr float Tolerance = 1e-4f;
+
+    m_Verification.Done          = true;
+    m_Verification.NumInstances  = static_cast<Uint32>(InstanceData.size());
+    m_Verification.NumMismatches = InstanceGrid::VerifyInstanceBuffer(m_pDevice, m_pImmediateContext, m_InstanceBuffer, InstanceData.data(),
+                                                                       m_Verification.NumInstances, sizeof(float4x4), Tolerance, m_Verification.MaxError);
+    if (m_Verification.NumMismatches == 0)
+    {
+        LOG_INFO_MESSAGE("GPU instance verification passed: ", m_Verification.NumInstances, " instances, max error ", m_Verification.MaxError);
+    }
+    else
+    {
+        LOG_ERROR_MESSAGE("GPU instance verification failed: ", m_Verification.NumMismatches, " of ", m_Verification.NumInstances,
+                          " instances differ, max error ", m_Verification.MaxError);
+    }
+
+    // Restore the CPU-generated data
+    if (!m_GenerateOnGPU)
+        PopulateInstanceBuffer();
+}
+
+Uint32 Tutorial04_Instancing::GetComposeRangeStart(Uint32 Range) const
+{
+    // Ranges are multiples of 4 so that every thread processes full SIMD batches
+    // except for the last one.
+    const Uint32 NumInstances = m_AnimationData.NumInstances;
+    return Range < m_NumComposeRanges ? static_cast<Uint32>(Uint64{NumInstances} * Range / m_NumComposeRanges) & ~3u : NumInstances;
+}
+
+void Tutorial04_Instancing::StartWorkerThreads(size_t NumThreads)
+{
+    m_WorkerThreads.resize(NumThreads);
+    for (Uint32 t = 0; t < m_WorkerThreads.size(); ++t)
+    {
+        m_WorkerThreads[t] = std::thread(WorkerThreadFunc, this, t);
+    }
+}
+
+void Tutorial04_Instancing::StopWorkerThreads()
+{
+    m_ComposeSignal.Trigger(true, -1);
+
+    for (auto& thread : m_WorkerThreads)
+    {
+        thread.join();
+    }
+    m_ComposeSignal.Reset();
+    m_WorkerThreads.clear();
+}
+
+Tutorial04_Instancing::~Tutorial04_Instancing()
+{
+    StopWorkerThreads();
+}
+
+void Tutorial04_Instancing::WorkerThreadFunc(Tutorial04_Instancing* pThis, Uint32 ThreadNum)
+{
+    const int NumWorkerThreads = static_cast<int>(pThis->m_WorkerThreads.size());
+    VERIFY_EXPR(NumWorkerThreads > 0);
+    for (;;)
+    {
+        // Wait for the signal
+        auto SignaledValue = pThis->m_ComposeSignal.Wait(true, NumWorkerThreads);
+        if (SignaledValue < 0)
+            return;
+
+        // Range 0 is composed by the main thread. Threads without a range only report completion.
+        const Uint32 Range = 1 + ThreadNum;
+        if (Range < pThis->m_NumComposeRanges)
+        {
+            ComposeInstanceMatrices(pThis->m_AnimationData, pThis->m_ComposeTime,
+                                    pThis->GetComposeRangeStart(Range), pThis->GetComposeRangeStart(Range + 1),
+                                    pThis->m_pMappedInstances);
+        }
+
+        {
+            // Atomically increment the number of completed threads
+            const auto NumThreadsCompleted = pThis->m_NumThreadsCompleted.fetch_add(1) + 1;
+            if (NumThreadsCompleted == NumWorkerThreads)
+                pThis->m_ComposeCompletedSignal.Trigger();
+        }
+
+        pThis->m_GotoNextFrameSignal.Wait(true, NumWorkerThreads);
+
+        pThis->m_NumThreadsReady.fetch_add(1);
+        // We must wait until all threads reach this point, because
+        // m_GotoNextFrameSignal must be unsignaled before we proceed to
+        // m_ComposeSignal to avoid one thread go through the loop twice in
+        // a row
+        while (pThis->m_NumThreadsReady.load() < NumWorkerThreads)
+            std::this_thread::yield();
+        VERIFY_EXPR(!pThis->m_GotoNextFrameSignal.IsTriggered());
+    }
+}
+
+void Tutorial04_Instancing::UpdateAnimatedInstances()
+{
+    const Uint32 NumInstances = m_AnimationData.NumInstances;
+
+    // Dynamic buffers must be mapped with MAP_FLAG_DISCARD every frame
+    MapHelper<float4x4> InstanceData(m_pImmediateContext, m_InstanceBuffer, MAP_WRITE, MAP_FLAG_DISCARD);
+    if (!InstanceData)
+        return;
+
+    // Small grids are not worth waking up the worker threads
+    constexpr Uint32 MinInstancesPerThread = 16384;
+
+    const Uint32 MaxRanges = static_cast<Uint32>(m_WorkerThreads.size()) + 1;
+    m_NumComposeRanges     = std::max(std::min(MaxRanges, NumInstances / MinInstancesPerThread), 1u);
+    m_ComposeTime          = static_cast<float>(m_AnimationTime);
+    m_pMappedInstances     = InstanceData;
+
+    // Only the matrix composition is timed, mapping and unmapping the buffer is excluded
+    const auto StartTime = std::chrono::high_resolution_clock::now();
+
+    const bool UseWorkers = m_NumComposeRanges > 1;
+    if (UseWorkers)
+    {
+        m_NumThreadsCompleted.store(0);
+        m_ComposeSignal.Trigger(true);
+    }
+
+    ComposeInstanceMatrices(m_AnimationData, m_ComposeTime, 0, GetComposeRangeStart(1), m_pMappedInstances);
+
+    if (UseWorkers)
+        m_ComposeCompletedSignal.Wait(true, 1);
+
+    const auto EndTime = std::chrono::high_resolution_clock::now();
+
+    if (UseWorkers)
+    {
+        m_NumThreadsReady.store(0);
+        m_GotoNextFrameSignal.Trigger(true);
+    }
+
+    m_pMappedInstances = nullptr;
+    InstanceData.Unmap();
+
+    m_UpdateTimeAccum     += std::chrono::duration<double, std::milli>(EndTime - StartTime).count();
+    m_UpdatedInstancesAcc += NumInstances;
+    ++m_UpdatedFramesAcc;
+}
 
 // Render a frame
 void Tutorial04_Instancing::Render()
@@ -208,6 +487,9 @@ void Tutorial04_Instancing::Render()
         CBConstants[1] = m_RotationMatrix;
     }
 
+    if (m_AnimateInstances)
+        UpdateAnimatedInstances();
+
     // Bind vertex, instance and index buffers
     const Uint64 offsets[] = {0, 0};
     IBuffer*     pBuffs[]  = {m_CubeVertexBuffer, m_InstanceBuffer};
@@ -234,6 +516,22 @@ void Tutorial04_Instancing::Update(double CurrTime, double ElapsedTime)
     SampleBase::Update(CurrTime, ElapsedTime);
     UpdateUI();
 
+    m_AnimationTime = CurrTime;
+
+    // Average the instance update statistics over half a second to get stable readings
+    if (CurrTime - m_StatsStartTime >= 0.5)
+    {
+        if (m_UpdatedFramesAcc > 0)
+        {
+            m_UpdateTimeMs   = m_UpdateTimeAccum / m_UpdatedFramesAcc;
+            m_InstancesPerMs = m_UpdateTimeAccum > 0 ? static_cast<double>(m_UpdatedInstancesAcc) / m_UpdateTimeAccum : 0;
+        }
+        m_UpdateTimeAccum     = 0;
+        m_UpdatedInstancesAcc = 0;
+        m_UpdatedFramesAcc    = 0;
+        m_StatsStartTime      = CurrTime;
+    }
+
     // Set cube view matrix
     float4x4 View = float4x4::RotationX(-0.6f) * float4x4::Translation(0.f, 0.f, 4.0f);
 
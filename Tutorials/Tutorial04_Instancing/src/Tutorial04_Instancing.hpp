@@ -27,8 +27,16 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
 #include "SampleBase.hpp"
 #include "BasicMath.hpp"
+#include "ThreadSignal.hpp"
+#include "InstanceAnimation.hpp"
+#include "../../Common/src/InstanceGrid.hpp"
 
 namespace Diligent
 {
@@ -36,6 +44,11 @@ namespace Diligent
 class Tutorial04_Instancing final : public SampleBase
 {
 public:
+    ~Tutorial04_Instancing() override;
+
+    virtual CommandLineStatus ProcessCommandLine(int argc, const char* const* argv) override final;
+
+    virtual void ModifyEngineInitInfo(const ModifyEngineInitInfoAttribs& Attribs) override final;
     virtual void Initialize(const SampleInitInfo& InitInfo) override final;
 
     virtual void Render() override final;
@@ -48,6 +61,12 @@ private:
     void CreateInstanceBuffer();
     void UpdateUI();
     void PopulateInstanceBuffer();
+    void UpdateAnimatedInstances();
+    void VerifyGPUInstances();
+    void StartWorkerThreads(size_t NumThreads);
+    void StopWorkerThreads();
+
+    static void WorkerThreadFunc(Tutorial04_Instancing* pThis, Uint32 ThreadNum);
 
     RefCntAutoPtr<IPipelineState>         m_pPSO;
     RefCntAutoPtr<IBuffer>                m_CubeVertexBuffer;
@@ -62,6 +81,49 @@ private:
     int                  m_GridSize   = 5;
     static constexpr int MaxGridSize  = 32;
     static constexpr int MaxInstances = MaxGridSize * MaxGridSize * MaxGridSize;
+
+    // In animated mode, instance matrices are recomputed every frame and written
+    // directly to the mapped dynamic instance buffer
+    bool                  m_AnimateInstances    = false;
+    static constexpr int  MaxAnimatedGridSize   = 128;
+    InstanceAnimationData m_AnimationData;
+    double                m_AnimationTime       = 0;
+    double                m_UpdateTimeAccum     = 0; // Total instance update time, in ms
+    Uint64                m_UpdatedInstancesAcc = 0;
+    Uint32                m_UpdatedFramesAcc    = 0;
+    double                m_StatsStartTime      = 0;
+    double                m_UpdateTimeMs        = 0;
+    double                m_InstancesPerMs      = 0;
+
+    // Persistent worker threads that compose the animated instance matrices. They are woken up
+    // every frame by m_ComposeSignal and write their ranges to m_pMappedInstances.
+    Threading::Signal        m_ComposeSignal;
+    Threading::Signal        m_ComposeCompletedSignal;
+    Threading::Signal        m_GotoNextFrameSignal;
+    std::atomic_int          m_NumThreadsCompleted{0};
+    std::atomic_int          m_NumThreadsReady{0};
+    std::vector<std::thread> m_WorkerThreads;
+    float4x4*                m_pMappedInstances = nullptr;
+    float                    m_ComposeTime      = 0;
+    Uint32                   m_NumComposeRanges = 1;
+
+    // First instance of the given compose range. The range ends where the next one starts.
+    Uint32 GetComposeRangeStart(Uint32 Range) const;
+
+    // Optional compute shader path that generates static instances directly in the instance buffer
+    std::unique_ptr<InstanceGrid::GPUGenerator> m_GPUGenerator;
+    bool                                        m_GenerateOnGPU      = false;
+    bool                                        m_VerifyGPUInstances = false; // Verify GPU instances on start-up
+    static constexpr Uint32                     InstanceSeed         = 0;
+
+    struct VerificationResult
+    {
+        bool   Done          = false;
+        Uint32 NumInstances  = 0;
+        Uint32 NumMismatches = 0;
+        float  MaxError      = 0;
+    };
+    VerificationResult m_Verification;
 };
 
 } // namespace Diligent
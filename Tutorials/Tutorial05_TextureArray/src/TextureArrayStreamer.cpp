@@ -0,0 +1,458 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+
+#include "TextureArrayStreamer.hpp"
+#include "TextureLoader.h"
+#include "TextureUtilities.h"
+#include "GraphicsUtilities.h"
+#include "GraphicsAccessories.hpp"
+#include "MapHelper.hpp"
+
+namespace Diligent
+{
+
+namespace
+{
+
+float3 GetLayerTint(Uint32 Layer, size_t NumSourceFiles)
+{
+    // Layers that directly correspond to the source files are not tinted
+    if (Layer < NumSourceFiles)
+        return float3{1, 1, 1};
+
+    // Distribute hues using the golden ratio
+    const float  Hue = std::fmod(static_cast<float>(Layer) * 0.618034f, 1.f) * 6.f;
+    const float3 PureColor{
+        clamp(std::abs(Hue - 3.f) - 1.f, 0.f, 1.f),
+        clamp(2.f - std::abs(Hue - 2.f), 0.f, 1.f),
+        clamp(2.f - std::abs(Hue - 4.f), 0.f, 1.f),
+    };
+    return lerp(float3{1, 1, 1}, PureColor, 0.6f);
+}
+
+// Copies mip levels [FirstMip, FirstMip + NumMips) of the image to the tightly packed buffer.
+// Color components of 8-bit formats are multiplied by the tint.
+void PackMips(ITextureLoader*      pLoader,
+              Uint32               FirstMip,
+              Uint32               NumMips,
+              const float3&        Tint,
+              std::vector<Uint8>&  Data,
+              std::vector<size_t>& MipOffsets)
+{
+    const auto& Desc       = pLoader->GetTextureDesc();
+    const auto& FmtAttribs = GetTextureFormatAttribs(Desc.Format);
+
+    const bool   ApplyTint = FmtAttribs.ComponentType != COMPONENT_TYPE_COMPRESSED && FmtAttribs.ComponentSize == 1 && FmtAttribs.NumComponents >= 3 && Tint != float3{1, 1, 1};
+    const Uint32 TexelSize = Uint32{FmtAttribs.ComponentSize} * Uint32{FmtAttribs.NumComponents};
+
+    Uint8 TintTable[3][256];
+    if (ApplyTint)
+    {
+        for (Uint32 c = 0; c < 3; ++c)
+        {
+            for (Uint32 i = 0; i < 256; ++i)
+                TintTable[c][i] = static_cast<Uint8>(static_cast<float>(i) * Tint[c] + 0.5f);
+        }
+    }
+
+    Data.clear();
+    MipOffsets.clear();
+    for (Uint32 Mip = FirstMip; Mip < FirstMip + NumMips; ++Mip)
+    {
+        const auto MipProps   = GetMipLevelProperties(Desc, Mip);
+        const auto SubresData = pLoader->GetSubresourceData(Mip, 0);
+        const auto RowSize    = static_cast<size_t>(MipProps.RowSize);
+        const auto NumRows    = static_cast<size_t>(MipProps.DepthSliceSize / MipProps.RowSize);
+
+        const size_t Offset = Data.size();
+        MipOffsets.push_back(Offset);
+        Data.resize(Offset + RowSize * NumRows);
+
+        for (size_t Row = 0; Row < NumRows; ++Row)
+        {
+            auto*       pDstRow = &Data[Offset + Row * RowSize];
+            const auto* pSrcRow = static_cast<const Uint8*>(SubresData.pData) + Row * SubresData.Stride;
+            memcpy(pDstRow, pSrcRow, RowSize);
+
+            if (ApplyTint)
+            {
+                for (size_t Texel = 0; Texel < RowSize; Texel += TexelSize)
+                {
+                    for (Uint32 c = 0; c < 3; ++c)
+                        pDstRow[Texel + c] = TintTable[c][pDstRow[Texel + c]];
+                }
+            }
+        }
+    }
+}
+
+Uint64 GetLayerSize(const TextureDesc& Desc, Uint32 FirstMip = 0)
+{
+    Uint64 Size = 0;
+    for (Uint32 Mip = FirstMip; Mip < Desc.MipLevels; ++Mip)
+        Size += GetMipLevelProperties(Desc, Mip).MipSize;
+    return Size;
+}
+
+} // namespace
+
+TextureArrayStreamer::TextureArrayStreamer(IRenderDevice* pDevice, const CreateInfo& CI) :
+    // clang-format off
+    m_SourceFiles       {CI.SourceFiles},
+    m_NumLayers         {CI.NumLayers},
+    m_LowResDim         {std::max(CI.LowResDim, 1u)},
+    m_MaxLoadsInFlight  {std::max(CI.MaxLoadsInFlight, 1u)},
+    m_MaxUploadsPerFrame{std::max(CI.MaxUploadsPerFrame, 1u)},
+    m_LayerState        (CI.NumLayers, LayerState::NotResident),
+    m_LayerSlot         (CI.NumLayers, -1),
+    m_LayerPriority     (CI.NumLayers, 0.f)
+// clang-format on
+{
+    VERIFY(!m_SourceFiles.empty(), "At least one source file is expected");
+
+    // Load every source image once to create the low-resolution layers
+    std::vector<RefCntAutoPtr<ITextureLoader>> Loaders(m_SourceFiles.size());
+    for (size_t i = 0; i < m_SourceFiles.size(); ++i)
+    {
+        TextureLoadInfo LoadInfo;
+        LoadInfo.IsSRGB = true;
+        CreateTextureLoaderFromFile(m_SourceFiles[i].c_str(), IMAGE_FILE_FORMAT_UNKNOWN, LoadInfo, &Loaders[i]);
+        if (!Loaders[i])
+        {
+            LOG_ERROR_MESSAGE("Failed to load texture '", m_SourceFiles[i], "'");
+            return;
+        }
+        if (i > 0 && !(Loaders[i]->GetTextureDesc() == Loaders[0]->GetTextureDesc()))
+        {
+            LOG_ERROR_MESSAGE("All textures must be same size and format. '", m_SourceFiles[i], "' does not match '", m_SourceFiles[0], "'");
+            return;
+        }
+    }
+    m_LayerDesc       = Loaders[0]->GetTextureDesc();
+    m_Stats.LayerSize = GetLayerSize(m_LayerDesc);
+
+    // Use the first mip level that is not larger than the low-resolution dimension
+    Uint32 LowResMip = 0;
+    while (LowResMip + 1 < m_LayerDesc.MipLevels && std::max(m_LayerDesc.Width, m_LayerDesc.Height) >> LowResMip > m_LowResDim)
+        ++LowResMip;
+
+    TextureDesc LowResDesc = m_LayerDesc;
+    LowResDesc.Name        = "Low-resolution texture array";
+    LowResDesc.Type        = RESOURCE_DIM_TEX_2D_ARRAY;
+    LowResDesc.Width       = std::max(m_LayerDesc.Width >> LowResMip, 1u);
+    LowResDesc.Height      = std::max(m_LayerDesc.Height >> LowResMip, 1u);
+    LowResDesc.MipLevels   = m_LayerDesc.MipLevels - LowResMip;
+    LowResDesc.ArraySize   = m_NumLayers;
+    LowResDesc.Usage       = USAGE_IMMUTABLE;
+    LowResDesc.BindFlags   = BIND_SHADER_RESOURCE;
+
+    std::vector<std::vector<Uint8>>  LayerData(m_NumLayers);
+    std::vector<std::vector<size_t>> LayerMipOffsets(m_NumLayers);
+    std::vector<TextureSubResData>   SubresData(size_t{LowResDesc.ArraySize} * LowResDesc.MipLevels);
+    for (Uint32 Layer = 0; Layer < m_NumLayers; ++Layer)
+    {
+        PackMips(Loaders[Layer % Loaders.size()], LowResMip, LowResDesc.MipLevels, GetLayerTint(Layer, m_SourceFiles.size()), LayerData[Layer], LayerMipOffsets[Layer]);
+        for (Uint32 Mip = 0; Mip < LowResDesc.MipLevels; ++Mip)
+        {
+            const auto MipProps = GetMipLevelProperties(LowResDesc, Mip);
+
+            SubresData[size_t{Layer} * LowResDesc.MipLevels + Mip] = TextureSubResData{LayerData[Layer].data() + LayerMipOffsets[Layer][Mip], MipProps.RowSize};
+        }
+    }
+    TextureData InitData{SubresData.data(), static_cast<Uint32>(SubresData.size())};
+
+    RefCntAutoPtr<ITexture> pLowResArray;
+    pDevice->CreateTexture(LowResDesc, &InitData, &pLowResArray);
+    if (!pLowResArray)
+        return;
+    m_pLowResArraySRV  = pLowResArray->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
+    m_Stats.LowResSize = GetLayerSize(LowResDesc) * m_NumLayers;
+
+    // The shader samples the low-resolution array with its own combined sampler
+    RefCntAutoPtr<ISampler> pSampler;
+    pDevice->CreateSampler(SamplerDesc{FILTER_TYPE_LINEAR, FILTER_TYPE_LINEAR, FILTER_TYPE_LINEAR, TEXTURE_ADDRESS_CLAMP, TEXTURE_ADDRESS_CLAMP, TEXTURE_ADDRESS_CLAMP}, &pSampler);
+    m_pLowResArraySRV->SetSampler(pSampler);
+
+    // Slot table is rewritten every frame
+    CreateUniformBuffer(pDevice, sizeof(int) * AlignUp(m_NumLayers, 4u), "Texture slot table", &m_pSlotTable);
+
+    m_LoaderThread = std::thread{&TextureArrayStreamer::LoaderThreadFunc, this};
+}
+
+TextureArrayStreamer::~TextureArrayStreamer()
+{
+    {
+        std::lock_guard<std::mutex> Lock{m_LoaderMtx};
+        m_StopLoader = true;
+    }
+    m_LoaderCondVar.notify_all();
+    if (m_LoaderThread.joinable())
+        m_LoaderThread.join();
+}
+
+void TextureArrayStreamer::SetBudget(IRenderDevice* pDevice, Uint64 BudgetInBytes)
+{
+    if (m_Stats.LayerSize == 0)
+        return;
+
+    const Uint32 NumSlots = static_cast<Uint32>(std::min(std::max(BudgetInBytes / m_Stats.LayerSize, Uint64{1}), Uint64{m_NumLayers}));
+    if (m_pSlotArray && NumSlots == m_Stats.NumSlots)
+        return;
+
+    TextureDesc SlotArrDesc = m_LayerDesc;
+    SlotArrDesc.Name        = "Streamed texture array";
+    SlotArrDesc.Type        = RESOURCE_DIM_TEX_2D_ARRAY;
+    SlotArrDesc.ArraySize   = NumSlots;
+    SlotArrDesc.Usage       = USAGE_DEFAULT;
+    SlotArrDesc.BindFlags   = BIND_SHADER_RESOURCE;
+
+    m_pSlotArraySRV.Release();
+    m_pSlotArray.Release();
+    pDevice->CreateTexture(SlotArrDesc, nullptr, &m_pSlotArray);
+    if (!m_pSlotArray)
+        return;
+    m_pSlotArraySRV = m_pSlotArray->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
+
+    // All resident layers are lost. Layers that are being loaded will be
+    // uploaded to the new array.
+    for (Uint32 Layer = 0; Layer < m_NumLayers; ++Layer)
+    {
+        if (m_LayerState[Layer] == LayerState::Resident)
+            m_LayerState[Layer] = LayerState::NotResident;
+        m_LayerSlot[Layer] = -1;
+    }
+    m_SlotLayer.assign(NumSlots, -1);
+    m_SlotLastUse.assign(NumSlots, 0);
+
+    m_Stats.NumSlots      = NumSlots;
+    m_Stats.NumResident   = 0;
+    m_Stats.SlotArraySize = m_Stats.LayerSize * NumSlots;
+}
+
+void TextureArrayStreamer::RequestLayer(Uint32 Layer, float ScreenSize)
+{
+    // Low-resolution layer is good enough for small objects
+    if (Layer >= m_NumLayers || ScreenSize <= static_cast<float>(m_LowResDim))
+        return;
+
+    if (m_LayerPriority[Layer] == 0)
+        m_RequestedLayers.push_back(Layer);
+    m_LayerPriority[Layer] = std::max(m_LayerPriority[Layer], ScreenSize);
+}
+
+int TextureArrayStreamer::FindSlot() const
+{
+    // Use free slot, or the least recently used slot that is not needed in the current frame
+    int BestSlot = -1;
+    for (Uint32 Slot = 0; Slot < m_SlotLayer.size(); ++Slot)
+    {
+        if (m_SlotLayer[Slot] < 0)
+            return static_cast<int>(Slot);
+
+        if (m_SlotLastUse[Slot] < m_FrameNumber && (BestSlot < 0 || m_SlotLastUse[Slot] < m_SlotLastUse[BestSlot]))
+            BestSlot = static_cast<int>(Slot);
+    }
+    return BestSlot;
+}
+
+void TextureArrayStreamer::UploadLayer(IDeviceContext* pContext, Uint32 Slot, const LoadedLayer& Layer)
+{
+    for (Uint32 Mip = 0; Mip < m_LayerDesc.MipLevels; ++Mip)
+    {
+        const auto MipProps = GetMipLevelProperties(m_LayerDesc, Mip);
+
+        Box               MipBox{0, MipProps.LogicalWidth, 0, MipProps.LogicalHeight};
+        TextureSubResData SubresData{Layer.Data.data() + Layer.MipOffsets[Mip], MipProps.RowSize};
+        pContext->UpdateTexture(m_pSlotArray, Mip, Slot, MipBox, SubresData, RESOURCE_STATE_TRANSITION_MODE_NONE, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    }
+}
+
+void TextureArrayStreamer::Update(IDeviceContext* pContext)
+{
+    if (!m_pSlotArray || !m_pSlotTable)
+        return;
+
+    // Layers requested in this frame are protected from eviction
+    for (Uint32 Layer : m_RequestedLayers)
+    {
+        if (m_LayerSlot[Layer] >= 0)
+            m_SlotLastUse[m_LayerSlot[Layer]] = m_FrameNumber;
+    }
+
+    // Upload a limited number of loaded layers per frame to avoid stalls
+    std::vector<LoadedLayer> LoadedLayers;
+    {
+        std::lock_guard<std::mutex> Lock{m_LoaderMtx};
+
+        const size_t NumLayersToUpload = std::min(m_LoadedLayers.size(), size_t{m_MaxUploadsPerFrame});
+        LoadedLayers.reserve(NumLayersToUpload);
+        std::move(m_LoadedLayers.begin(), m_LoadedLayers.begin() + NumLayersToUpload, std::back_inserter(LoadedLayers));
+        m_LoadedLayers.erase(m_LoadedLayers.begin(), m_LoadedLayers.begin() + NumLayersToUpload);
+    }
+
+    for (const auto& Loaded : LoadedLayers)
+    {
+        VERIFY_EXPR(m_NumLoading > 0 && m_LayerState[Loaded.Layer] == LayerState::Loading);
+        --m_NumLoading;
+
+        if (Loaded.Data.empty())
+        {
+            // Do not try to load the layer again
+            m_LayerState[Loaded.Layer] = LayerState::Failed;
+            continue;
+        }
+
+        const int Slot = FindSlot();
+        if (Slot < 0)
+        {
+            // All slots are taken by layers needed in this frame. The layer
+            // will be loaded again when it is requested and a slot is available.
+            m_LayerState[Loaded.Layer] = LayerState::NotResident;
+            continue;
+        }
+
+        const int EvictedLayer = m_SlotLayer[Slot];
+        if (EvictedLayer >= 0)
+        {
+            m_LayerSlot[EvictedLayer]  = -1;
+            m_LayerState[EvictedLayer] = LayerState::NotResident;
+            ++m_Stats.TotalEvicted;
+        }
+
+        UploadLayer(pContext, static_cast<Uint32>(Slot), Loaded);
+
+        m_SlotLayer[Slot]          = static_cast<int>(Loaded.Layer);
+        m_SlotLastUse[Slot]        = m_FrameNumber;
+        m_LayerSlot[Loaded.Layer]  = Slot;
+        m_LayerState[Loaded.Layer] = LayerState::Resident;
+        ++m_Stats.TotalLoaded;
+    }
+
+    // Load the missing layers that are largest on screen first
+    std::vector<Uint32> MissingLayers;
+    for (Uint32 Layer : m_RequestedLayers)
+    {
+        if (m_LayerState[Layer] == LayerState::NotResident)
+            MissingLayers.push_back(Layer);
+    }
+    std::sort(MissingLayers.begin(), MissingLayers.end(), [this](Uint32 Layer0, Uint32 Layer1) {
+        return m_LayerPriority[Layer0] > m_LayerPriority[Layer1];
+    });
+
+    // Do not load more layers than can be placed into the slots that are free or not needed in this frame
+    Uint32 NumAvailableSlots = 0;
+    for (Uint32 Slot = 0; Slot < m_SlotLayer.size(); ++Slot)
+    {
+        if (m_SlotLayer[Slot] < 0 || m_SlotLastUse[Slot] < m_FrameNumber)
+            ++NumAvailableSlots;
+    }
+
+    const Uint32 MaxNewLoads = std::min(m_MaxLoadsInFlight - std::min(m_NumLoading, m_MaxLoadsInFlight),
+                                        NumAvailableSlots - std::min(m_NumLoading, NumAvailableSlots));
+    const size_t NumNewLoads = std::min(MissingLayers.size(), size_t{MaxNewLoads});
+    if (NumNewLoads > 0)
+    {
+        {
+            std::lock_guard<std::mutex> Lock{m_LoaderMtx};
+            for (size_t i = 0; i < NumNewLoads; ++i)
+            {
+                m_LoadQueue.push_back(MissingLayers[i]);
+                m_LayerState[MissingLayers[i]] = LayerState::Loading;
+            }
+        }
+        m_NumLoading += static_cast<Uint32>(NumNewLoads);
+        m_LoaderCondVar.notify_one();
+    }
+
+    {
+        MapHelper<int> SlotTable{pContext, m_pSlotTable, MAP_WRITE, MAP_FLAG_DISCARD};
+        if (SlotTable)
+        {
+            for (Uint32 Layer = 0; Layer < m_NumLayers; ++Layer)
+                SlotTable[Layer] = m_LayerSlot[Layer];
+        }
+    }
+
+    m_Stats.NumResident  = static_cast<Uint32>(std::count_if(m_SlotLayer.begin(), m_SlotLayer.end(), [](int Layer) { return Layer >= 0; }));
+    m_Stats.NumLoading   = m_NumLoading;
+    m_Stats.NumRequested = static_cast<Uint32>(m_RequestedLayers.size());
+
+    for (Uint32 Layer : m_RequestedLayers)
+        m_LayerPriority[Layer] = 0;
+    m_RequestedLayers.clear();
+    ++m_FrameNumber;
+}
+
+bool TextureArrayStreamer::LoadLayer(Uint32 Layer, LoadedLayer& Result) const
+{
+    const auto& FilePath = m_SourceFiles[Layer % m_SourceFiles.size()];
+
+    TextureLoadInfo LoadInfo;
+    LoadInfo.IsSRGB = true;
+
+    RefCntAutoPtr<ITextureLoader> pLoader;
+    CreateTextureLoaderFromFile(FilePath.c_str(), IMAGE_FILE_FORMAT_UNKNOWN, LoadInfo, &pLoader);
+    if (!pLoader || !(pLoader->GetTextureDesc() == m_LayerDesc))
+    {
+        LOG_ERROR_MESSAGE("Failed to load texture layer ", Layer, " from '", FilePath, "'");
+        return false;
+    }
+
+    PackMips(pLoader, 0, m_LayerDesc.MipLevels, GetLayerTint(Layer, m_SourceFiles.size()), Result.Data, Result.MipOffsets);
+    return true;
+}
+
+void TextureArrayStreamer::LoaderThreadFunc()
+{
+    for (;;)
+    {
+        Uint32 Layer = 0;
+        {
+            std::unique_lock<std::mutex> Lock{m_LoaderMtx};
+            m_LoaderCondVar.wait(Lock, [this] { return m_StopLoader || !m_LoadQueue.empty(); });
+            if (m_StopLoader)
+                return;
+
+            Layer = m_LoadQueue.front();
+            m_LoadQueue.pop_front();
+        }
+
+        LoadedLayer Result;
+        Result.Layer = Layer;
+        if (!LoadLayer(Layer, Result))
+            Result.Data.clear();
+
+        std::lock_guard<std::mutex> Lock{m_LoaderMtx};
+        m_LoadedLayers.emplace_back(std::move(Result));
+    }
+}
+
+} // namespace Diligent
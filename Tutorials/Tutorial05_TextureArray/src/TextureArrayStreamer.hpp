@@ -0,0 +1,170 @@
+/*
+ *  Copyright 2019-2024 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RenderDevice.h"
+#include "DeviceContext.h"
+#include "RefCntAutoPtr.hpp"
+#include "BasicMath.hpp"
+
+namespace Diligent
+{
+
+// Streams the layers of a large virtual texture array into a fixed number of slots of a
+// full-resolution texture array, so that the memory used by the textures is bounded by the budget
+// regardless of the number of layers.
+//
+// * Low-resolution versions of all layers are always resident in a separate texture array and are
+//   used until the full-resolution layer is streamed in.
+// * Layers are loaded by a background thread and uploaded by the main thread, a few per frame.
+// * Every frame the application requests the layers it needs at full resolution. When there are
+//   no free slots, the least recently requested layer is evicted. Layers requested in the current
+//   frame are never evicted.
+// * Slot table buffer contains the slot of every layer, or -1 if the layer is not resident.
+//
+// Layer i is loaded from source file i % NumSourceFiles. Layers beyond the number of files are
+// tinted so that they are distinguishable.
+class TextureArrayStreamer
+{
+public:
+    struct CreateInfo
+    {
+        std::vector<std::string> SourceFiles;
+
+        // The total number of layers
+        Uint32 NumLayers = 256;
+
+        // Resolution of the always resident low-resolution layers
+        Uint32 LowResDim = 32;
+
+        // The maximum number of layers being loaded at the same time
+        Uint32 MaxLoadsInFlight = 4;
+
+        // The maximum number of layers uploaded to the GPU per frame
+        Uint32 MaxUploadsPerFrame = 2;
+    };
+
+    TextureArrayStreamer(IRenderDevice* pDevice, const CreateInfo& CI);
+    ~TextureArrayStreamer();
+
+    // clang-format off
+    TextureArrayStreamer           (const TextureArrayStreamer&) = delete;
+    TextureArrayStreamer& operator=(const TextureArrayStreamer&) = delete;
+    // clang-format on
+
+    // Recreates the full-resolution texture array with as many slots as fit into the budget.
+    // All layers become non-resident.
+    void SetBudget(IRenderDevice* pDevice, Uint64 BudgetInBytes);
+
+    // Requests the layer at full resolution for the current frame. ScreenSize is the size in pixels of
+    // the largest object that uses the layer. Layers that are not larger on screen than the
+    // low-resolution version are not loaded. Larger objects are given higher priority.
+    void RequestLayer(Uint32 Layer, float ScreenSize);
+
+    // Uploads the loaded layers, evicts unused layers, issues new load requests and writes the slot
+    // table. Must be called once per frame before the textures are used.
+    void Update(IDeviceContext* pContext);
+
+    ITextureView* GetSlotArraySRV() const { return m_pSlotArraySRV; }
+    ITextureView* GetLowResArraySRV() const { return m_pLowResArraySRV; }
+    IBuffer*      GetSlotTable() const { return m_pSlotTable; }
+
+    struct Statistics
+    {
+        Uint32 NumSlots      = 0;
+        Uint32 NumResident   = 0;
+        Uint32 NumLoading    = 0;
+        Uint32 NumRequested  = 0; // Layers requested in the last frame
+        Uint32 TotalLoaded   = 0;
+        Uint32 TotalEvicted  = 0;
+        Uint64 SlotArraySize = 0; // Memory used by the full-resolution array, in bytes
+        Uint64 LowResSize    = 0; // Memory used by the low-resolution array, in bytes
+        Uint64 LayerSize     = 0; // Size of one full-resolution layer with all mips, in bytes
+    };
+    const Statistics& GetStatistics() const { return m_Stats; }
+
+private:
+    struct LoadedLayer
+    {
+        Uint32              Layer = 0;
+        std::vector<Uint8>  Data;
+        std::vector<size_t> MipOffsets;
+    };
+
+    enum class LayerState : Uint8
+    {
+        NotResident,
+        Loading,
+        Resident,
+        Failed
+    };
+
+    void LoaderThreadFunc();
+    bool LoadLayer(Uint32 Layer, LoadedLayer& Result) const;
+    void UploadLayer(IDeviceContext* pContext, Uint32 Slot, const LoadedLayer& Layer);
+    int  FindSlot() const;
+
+    const std::vector<std::string> m_SourceFiles;
+    const Uint32                   m_NumLayers;
+    const Uint32                   m_LowResDim;
+    const Uint32                   m_MaxLoadsInFlight;
+    const Uint32                   m_MaxUploadsPerFrame;
+
+    TextureDesc m_LayerDesc; // Description of one full-resolution layer
+
+    RefCntAutoPtr<ITexture>     m_pSlotArray;
+    RefCntAutoPtr<ITextureView> m_pSlotArraySRV;
+    RefCntAutoPtr<ITextureView> m_pLowResArraySRV;
+    RefCntAutoPtr<IBuffer>      m_pSlotTable;
+
+    std::vector<LayerState> m_LayerState;
+    std::vector<int>        m_LayerSlot;       // Slot of every layer, or -1
+    std::vector<float>      m_LayerPriority;   // Screen size of the layer in the current frame
+    std::vector<Uint32>     m_RequestedLayers; // Layers requested in the current frame
+    std::vector<int>        m_SlotLayer;       // Layer in every slot, or -1
+    std::vector<Uint64>     m_SlotLastUse;     // The last frame the layer in the slot was requested
+    Uint64                  m_FrameNumber = 1;
+    Uint32                  m_NumLoading  = 0;
+
+    // Loader thread state
+    std::thread              m_LoaderThread;
+    std::mutex               m_LoaderMtx;
+    std::condition_variable  m_LoaderCondVar;
+    std::deque<Uint32>       m_LoadQueue;
+    std::vector<LoadedLayer> m_LoadedLayers;
+    bool                     m_StopLoader = false;
+
+    Statistics m_Stats;
+};
+
+} // namespace Diligent
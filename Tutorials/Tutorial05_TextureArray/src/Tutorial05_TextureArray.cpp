@@ -25,7 +25,8 @@
  *  of the possibility of such damages.
  */
 
-#include <random>
+#include <algorithm>
+#include <cmath>
 #include <string>
 
 #include "Tutorial05_TextureArray.hpp"
@@ -35,6 +36,7 @@
 #include "ColorConversion.h"
 #include "../../Common/src/TexturedCube.hpp"
 #include "imgui.h"
+#include "CommandLineParser.hpp"
 
 namespace Diligent
 {
@@ -53,8 +55,47 @@ struct InstanceData
     float    TextureInd = 0;
 };
 
+std::vector<InstanceData> ComputeInstanceData(Uint32 GridSize, Uint32 NumTextures, Uint32 Seed)
+{
+    const Uint32 NumInstances = GridSize * GridSize * GridSize;
+
+    std::vector<InstanceData> Instances(NumInstances);
+    for (Uint32 InstId = 0; InstId < NumInstances; ++InstId)
+    {
+        // Random offset, scale, rotation and texture of the instance are computed from its index,
+        // which allows generating the same instances in the compute shader.
+        const auto Attribs  = InstanceGrid::GetInstanceAttribs(GridSize, InstId, NumTextures, Seed);
+        auto&      CurrInst = Instances[InstId];
+        CurrInst.Matrix     = InstanceGrid::GetInstanceMatrix(Attribs);
+        // Texture array index
+        CurrInst.TextureInd = static_cast<float>(Attribs.TextureInd);
+    }
+    return Instances;
+}
+
 } // namespace
 
+Tutorial05_TextureArray::CommandLineStatus Tutorial05_TextureArray::ProcessCommandLine(int argc, const char* const* argv)
+{
+    CommandLineParser ArgsParser{argc, argv};
+    ArgsParser.Parse("gpu_instances", m_GenerateOnGPU);
+    ArgsParser.Parse("verify_gpu_instances", m_VerifyGPUInstances);
+    ArgsParser.Parse("textures", m_NumTextures);
+    ArgsParser.Parse("texture_budget", m_TextureBudgetMB);
+
+    m_NumTextures     = clamp(m_NumTextures, 1, MaxTextures);
+    m_TextureBudgetMB = std::max(m_TextureBudgetMB, 1);
+
+    return CommandLineStatus::OK;
+}
+
+void Tutorial05_TextureArray::ModifyEngineInitInfo(const ModifyEngineInitInfoAttribs& Attribs)
+{
+    SampleBase::ModifyEngineInitInfo(Attribs);
+    // Compute shaders are only needed to generate instances on the GPU
+    Attribs.EngineCI.Features.ComputeShaders = DEVICE_FEATURE_STATE_OPTIONAL;
+}
+
 void Tutorial05_TextureArray::CreatePipelineState()
 {
     // clang-format off
@@ -107,10 +148,17 @@ void Tutorial05_TextureArray::CreatePipelineState()
     // type (SHADER_RESOURCE_VARIABLE_TYPE_STATIC) will be used. Static variables
     // never change and are bound directly to the pipeline state object.
     m_pPSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_VSConstants);
+}
 
+void Tutorial05_TextureArray::CreateSRB()
+{
     // Since we are using mutable variable, we must create a shader resource binding object
     // http://diligentgraphics.com/2016/03/23/resource-binding-model-in-diligent-engine-2-0/
+    // The SRB is recreated when the streamed texture array is resized.
+    m_SRB.Release();
     m_pPSO->CreateShaderResourceBinding(&m_SRB, true);
+    // Set full-resolution texture array SRV in the SRB
+    m_SRB->GetVariableByName(SHADER_TYPE_PIXEL, "g_Texture")->Set(m_TextureStreamer->GetSlotArraySRV());
 }
 
 void Tutorial05_TextureArray::CreateInstanceBuffer()
@@ -122,53 +170,36 @@ void Tutorial05_TextureArray::CreateInstanceBuffer()
     InstBuffDesc.Usage     = USAGE_DEFAULT;
     InstBuffDesc.BindFlags = BIND_VERTEX_BUFFER;
     InstBuffDesc.Size      = sizeof(InstanceData) * MaxInstances;
+    if (m_GPUGenerator)
+    {
+        // Allow the compute shader to write instance data directly to the buffer
+        InstBuffDesc.BindFlags         = InstanceGrid::GPUGenerator::BufferBindFlags;
+        InstBuffDesc.Mode              = InstanceGrid::GPUGenerator::BufferMode;
+        InstBuffDesc.ElementByteStride = sizeof(float);
+    }
     m_pDevice->CreateBuffer(InstBuffDesc, nullptr, &m_InstanceBuffer);
     PopulateInstanceBuffer();
 }
 
-void Tutorial05_TextureArray::LoadTextures()
+void Tutorial05_TextureArray::CreateTextureStreamer()
 {
-    std::vector<RefCntAutoPtr<ITextureLoader>> TexLoaders(NumTextures);
-    // Load textures
-    for (int tex = 0; tex < NumTextures; ++tex)
-    {
-        // Create loader for the current texture
-        std::stringstream FileNameSS;
-        FileNameSS << "DGLogo" << tex << ".png";
-        const auto      FileName = FileNameSS.str();
-        TextureLoadInfo LoadInfo;
-        LoadInfo.IsSRGB = true;
-
-        CreateTextureLoaderFromFile(FileName.c_str(), IMAGE_FILE_FORMAT_UNKNOWN, LoadInfo, &TexLoaders[tex]);
-        VERIFY_EXPR(TexLoaders[tex]);
-        VERIFY(tex == 0 || TexLoaders[tex]->GetTextureDesc() == TexLoaders[0]->GetTextureDesc(), "All textures must be same size");
-    }
+    // Texture array layers are loaded from the source images in a round-robin fashion
+    constexpr int NumSourceTextures = 4;
 
-    auto TexArrDesc      = TexLoaders[0]->GetTextureDesc();
-    TexArrDesc.ArraySize = NumTextures;
-    TexArrDesc.Type      = RESOURCE_DIM_TEX_2D_ARRAY;
-    TexArrDesc.Usage     = USAGE_DEFAULT;
-    TexArrDesc.BindFlags = BIND_SHADER_RESOURCE;
+    TextureArrayStreamer::CreateInfo StreamerCI;
+    for (int tex = 0; tex < NumSourceTextures; ++tex)
+        StreamerCI.SourceFiles.emplace_back("DGLogo" + std::to_string(tex) + ".png");
+    StreamerCI.NumLayers = MaxTextures;
 
-    // Prepare initialization data
-    std::vector<TextureSubResData> SubresData(TexArrDesc.ArraySize * TexArrDesc.MipLevels);
-    for (Uint32 slice = 0; slice < TexArrDesc.ArraySize; ++slice)
-    {
-        for (Uint32 mip = 0; mip < TexArrDesc.MipLevels; ++mip)
-        {
-            SubresData[slice * TexArrDesc.MipLevels + mip] = TexLoaders[slice]->GetSubresourceData(mip, 0);
-        }
-    }
-    TextureData InitData{SubresData.data(), TexArrDesc.MipLevels * TexArrDesc.ArraySize};
+    m_TextureStreamer = std::make_unique<TextureArrayStreamer>(m_pDevice, StreamerCI);
 
-    // Create the texture array
-    RefCntAutoPtr<ITexture> pTexArray;
-    m_pDevice->CreateTexture(TexArrDesc, &InitData, &pTexArray);
+    // Low-resolution texture array and the slot table buffer never change and
+    // are bound directly to the pipeline state object
+    m_pPSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "g_LowResTexture")->Set(m_TextureStreamer->GetLowResArraySRV());
+    m_pPSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "SlotTable")->Set(m_TextureStreamer->GetSlotTable());
 
-    // Get shader resource view from the texture array
-    m_TextureSRV = pTexArray->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
-    // Set texture SRV in the SRB
-    m_SRB->GetVariableByName(SHADER_TYPE_PIXEL, "g_Texture")->Set(m_TextureSRV);
+    m_TextureStreamer->SetBudget(m_pDevice, static_cast<Uint64>(m_TextureBudgetMB) << 20);
+    CreateSRB();
 }
 
 void Tutorial05_TextureArray::UpdateUI()
@@ -180,6 +211,41 @@ void Tutorial05_TextureArray::UpdateUI()
         {
             PopulateInstanceBuffer();
         }
+
+        if (ImGui::SliderInt("Textures", &m_NumTextures, 1, MaxTextures))
+        {
+            PopulateInstanceBuffer();
+        }
+
+        if (ImGui::SliderInt("Texture budget, MB", &m_TextureBudgetMB, 4, 256))
+        {
+            m_TextureStreamer->SetBudget(m_pDevice, static_cast<Uint64>(m_TextureBudgetMB) << 20);
+            CreateSRB();
+        }
+        {
+            const auto& Stats = m_TextureStreamer->GetStatistics();
+            ImGui::Text("Resident layers: %u / %u", Stats.NumResident, Stats.NumSlots);
+            ImGui::Text("Requested: %u, loading: %u", Stats.NumRequested, Stats.NumLoading);
+            ImGui::Text("Loaded: %u, evicted: %u", Stats.TotalLoaded, Stats.TotalEvicted);
+            ImGui::Text("Memory: %.1f MB + %.1f MB low-res", static_cast<double>(Stats.SlotArraySize) / (1 << 20), static_cast<double>(Stats.LowResSize) / (1 << 20));
+        }
+
+        if (m_GPUGenerator)
+        {
+            if (ImGui::Checkbox("Generate on GPU", &m_GenerateOnGPU))
+            {
+                PopulateInstanceBuffer();
+            }
+
+            if (ImGui::Button("Verify GPU instances"))
+            {
+                VerifyGPUInstances();
+            }
+            if (m_Verification.Done)
+            {
+                ImGui::Text("%u instances, %u mismatches, max error %.2e", m_Verification.NumInstances, m_Verification.NumMismatches, m_Verification.MaxError);
+            }
+        }
     }
     ImGui::End();
 }
@@ -194,56 +260,85 @@ void Tutorial05_TextureArray::Initialize(const SampleInitInfo& InitInfo)
     m_CubeVertexBuffer = TexturedCube::CreateVertexBuffer(m_pDevice, TexturedCube::VERTEX_COMPONENT_FLAG_POS_UV);
     m_CubeIndexBuffer  = TexturedCube::CreateIndexBuffer(m_pDevice);
 
+    if (InstanceGrid::GPUGenerator::IsSupported(m_pDevice))
+    {
+        RefCntAutoPtr<IShaderSourceInputStreamFactory> pShaderSourceFactory;
+        m_pEngineFactory->CreateDefaultShaderSourceStreamFactory(nullptr, &pShaderSourceFactory);
+        m_GPUGenerator = std::make_unique<InstanceGrid::GPUGenerator>(m_pDevice, pShaderSourceFactory, "generate_instances.csh", Uint32{sizeof(InstanceData)});
+    }
+    else if (m_GenerateOnGPU || m_VerifyGPUInstances)
+    {
+        LOG_WARNING_MESSAGE("Compute shaders are not supported by this device. Instances will be generated on the CPU.");
+        m_GenerateOnGPU      = false;
+        m_VerifyGPUInstances = false;
+    }
+
     CreateInstanceBuffer();
-    LoadTextures();
+    CreateTextureStreamer();
+
+    if (m_VerifyGPUInstances)
+        VerifyGPUInstances();
 }
 
 void Tutorial05_TextureArray::PopulateInstanceBuffer()
 {
+    // Bounding spheres are always computed on the CPU as they are needed to request the textures
+    const Uint32 NumInstances = static_cast<Uint32>(m_GridSize * m_GridSize * m_GridSize);
+    m_InstanceBounds.resize(NumInstances);
+    for (Uint32 InstId = 0; InstId < NumInstances; ++InstId)
+    {
+        const auto Attribs = InstanceGrid::GetInstanceAttribs(static_cast<Uint32>(m_GridSize), InstId, static_cast<Uint32>(m_NumTextures), InstanceSeed);
+        auto&      Bounds  = m_InstanceBounds[InstId];
+        // Cube vertices are in [-1, 1] range
+        Bounds.Center     = Attribs.Offset;
+        Bounds.Radius     = Attribs.Scale * std::sqrt(3.f);
+        Bounds.TextureInd = Attribs.TextureInd;
+    }
+
+    if (m_GenerateOnGPU)
+    {
+        // The compute shader writes instance data directly to the instance buffer,
+        // so the only CPU work is a single dispatch
+        m_GPUGenerator->Generate(m_pImmediateContext, m_InstanceBuffer, static_cast<Uint32>(m_GridSize), static_cast<Uint32>(m_NumTextures), InstanceSeed);
+        return;
+    }
+
     // Populate instance data buffer
-    const auto                zGridSize = static_cast<size_t>(m_GridSize);
-    std::vector<InstanceData> InstanceData(zGridSize * zGridSize * zGridSize);
+    const auto InstanceData = ComputeInstanceData(static_cast<Uint32>(m_GridSize), static_cast<Uint32>(m_NumTextures), InstanceSeed);
+
+    // Update instance data buffer
+    Uint32 DataSize = static_cast<Uint32>(sizeof(InstanceData[0]) * InstanceData.size());
+    m_pImmediateContext->UpdateBuffer(m_InstanceBuffer, 0, DataSize, InstanceData.data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+}
 
-    float fGridSize = static_cast<float>(m_GridSize);
+void Tutorial05_TextureArray::VerifyGPUInstances()
+{
+    if (!m_GPUGenerator)
+        return;
 
-    std::mt19937 gen; // Standard mersenne_twister_engine. Use default seed
-                      // to generate consistent distribution.
+    const auto Instances = ComputeInstanceData(static_cast<Uint32>(m_GridSize), static_cast<Uint32>(m_NumTextures), InstanceSeed);
+    m_GPUGenerator->Generate(m_pImmediateContext, m_InstanceBuffer, static_cast<Uint32>(m_GridSize), static_cast<Uint32>(m_NumTextures), InstanceSeed);
 
-    std::uniform_real_distribution<float> scale_distr(0.3f, 1.0f);
-    std::uniform_real_distribution<float> offset_distr(-0.15f, +0.15f);
-    std::uniform_real_distribution<float> rot_distr(-PI_F, +PI_F);
-    std::uniform_int_distribution<Int32>  tex_distr(0, NumTextures - 1);
+    // GPU sin and cos may be slightly less precise than the CPU ones
+    constexpr float Tolerance = 1e-4f;
 
-    float BaseScale = 0.6f / fGridSize;
-    int   instId    = 0;
-    for (int x = 0; x < m_GridSize; ++x)
+    m_Verification.Done          = true;
+    m_Verification.NumInstances  = static_cast<Uint32>(Instances.size());
+    m_Verification.NumMismatches = InstanceGrid::VerifyInstanceBuffer(m_pDevice, m_pImmediateContext, m_InstanceBuffer, Instances.data(),
+                                                                       m_Verification.NumInstances, sizeof(InstanceData), Tolerance, m_Verification.MaxError);
+    if (m_Verification.NumMismatches == 0)
     {
-        for (int y = 0; y < m_GridSize; ++y)
-        {
-            for (int z = 0; z < m_GridSize; ++z)
-            {
-                // Add random offset from central position in the grid
-                float xOffset = 2.f * (x + 0.5f + offset_distr(gen)) / fGridSize - 1.f;
-                float yOffset = 2.f * (y + 0.5f + offset_distr(gen)) / fGridSize - 1.f;
-                float zOffset = 2.f * (z + 0.5f + offset_distr(gen)) / fGridSize - 1.f;
-                // Random scale
-                float scale = BaseScale * scale_distr(gen);
-                // Random rotation
-                float4x4 rotation = float4x4::RotationX(rot_distr(gen));
-                rotation *= float4x4::RotationY(rot_distr(gen));
-                rotation *= float4x4::RotationZ(rot_distr(gen));
-                // Combine rotation, scale and translation
-                float4x4 matrix   = rotation * float4x4::Scale(scale, scale, scale) * float4x4::Translation(xOffset, yOffset, zOffset);
-                auto&    CurrInst = InstanceData[instId++];
-                CurrInst.Matrix   = matrix;
-                // Texture array index
-                CurrInst.TextureInd = static_cast<float>(tex_distr(gen));
-            }
-        }
+        LOG_INFO_MESSAGE("GPU instance verification passed: ", m_Verification.NumInstances, " instances, max error ", m_Verification.MaxError);
     }
-    // Update instance data buffer
-    Uint32 DataSize = static_cast<Uint32>(sizeof(InstanceData[0]) * InstanceData.size());
-    m_pImmediateContext->UpdateBuffer(m_InstanceBuffer, 0, DataSize, InstanceData.data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    else
+    {
+        LOG_ERROR_MESSAGE("GPU instance verification failed: ", m_Verification.NumMismatches, " of ", m_Verification.NumInstances,
+                          " instances differ, max error ", m_Verification.MaxError);
+    }
+
+    // Restore the CPU-generated data
+    if (!m_GenerateOnGPU)
+        PopulateInstanceBuffer();
 }
 
 
@@ -262,6 +357,9 @@ void Tutorial05_TextureArray::Render()
     m_pImmediateContext->ClearRenderTarget(pRTV, ClearColor.Data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
     m_pImmediateContext->ClearDepthStencil(pDSV, CLEAR_DEPTH_FLAG, 1.f, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
 
+    // Upload the streamed texture layers and update the slot table
+    m_TextureStreamer->Update(m_pImmediateContext);
+
     {
         // Map the buffer and write current world-view-projection matrix
         MapHelper<float4x4> CBConstants(m_pImmediateContext, m_VSConstants, MAP_WRITE, MAP_FLAG_DISCARD);
@@ -306,9 +404,34 @@ void Tutorial05_TextureArray::Update(double CurrTime, double ElapsedTime)
 
     // Compute view-projection matrix
     m_ViewProjMatrix = View * SrfPreTransform * Proj;
+    m_ProjScale      = std::max(Proj._11, Proj._22);
 
     // Global rotation matrix
     m_RotationMatrix = float4x4::RotationY(static_cast<float>(CurrTime) * 1.0f) * float4x4::RotationX(-static_cast<float>(CurrTime) * 0.25f);
+
+    RequestVisibleTextures();
+}
+
+void Tutorial05_TextureArray::RequestVisibleTextures()
+{
+    const auto& SCDesc = m_pSwapChain->GetDesc();
+    // Converts the size in clip space at unit distance to pixels
+    const float PixelScale = 0.5f * static_cast<float>(std::max(SCDesc.Width, SCDesc.Height)) * m_ProjScale;
+
+    for (const auto& Bounds : m_InstanceBounds)
+    {
+        const float4 ClipPos = float4{Bounds.Center, 1} * m_ViewProjMatrix;
+        if (ClipPos.w + Bounds.Radius <= 0)
+            continue; // Behind the camera
+
+        // Conservative test of the bounding sphere against the side planes of the frustum
+        const float Extent = ClipPos.w + Bounds.Radius * m_ProjScale;
+        if (std::abs(ClipPos.x) > Extent || std::abs(ClipPos.y) > Extent)
+            continue;
+
+        const float ScreenSize = 2.f * Bounds.Radius * PixelScale / std::max(ClipPos.w, 0.1f);
+        m_TextureStreamer->RequestLayer(Bounds.TextureInd, ScreenSize);
+    }
 }
 
 } // namespace Diligent
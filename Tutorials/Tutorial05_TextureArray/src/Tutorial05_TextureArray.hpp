@@ -27,8 +27,13 @@
 
 #pragma once
 
+#include <memory>
+#include <vector>
+
 #include "SampleBase.hpp"
 #include "BasicMath.hpp"
+#include "../../Common/src/InstanceGrid.hpp"
+#include "TextureArrayStreamer.hpp"
 
 namespace Diligent
 {
@@ -36,6 +41,9 @@ namespace Diligent
 class Tutorial05_TextureArray final : public SampleBase
 {
 public:
+    virtual CommandLineStatus ProcessCommandLine(int argc, const char* const* argv) override final;
+
+    virtual void ModifyEngineInitInfo(const ModifyEngineInitInfoAttribs& Attribs) override final;
     virtual void Initialize(const SampleInitInfo& InitInfo) override final;
 
     virtual void Render() override final;
@@ -46,24 +54,58 @@ public:
 private:
     void CreatePipelineState();
     void CreateInstanceBuffer();
-    void LoadTextures();
+    void CreateTextureStreamer();
+    void CreateSRB();
     void UpdateUI();
     void PopulateInstanceBuffer();
+    void RequestVisibleTextures();
+    void VerifyGPUInstances();
 
     RefCntAutoPtr<IPipelineState>         m_pPSO;
     RefCntAutoPtr<IBuffer>                m_CubeVertexBuffer;
     RefCntAutoPtr<IBuffer>                m_CubeIndexBuffer;
     RefCntAutoPtr<IBuffer>                m_InstanceBuffer;
     RefCntAutoPtr<IBuffer>                m_VSConstants;
-    RefCntAutoPtr<ITextureView>           m_TextureSRV;
     RefCntAutoPtr<IShaderResourceBinding> m_SRB;
 
     float4x4             m_ViewProjMatrix;
     float4x4             m_RotationMatrix;
+    float                m_ProjScale  = 1;
     int                  m_GridSize   = 5;
     static constexpr int MaxGridSize  = 32;
     static constexpr int MaxInstances = MaxGridSize * MaxGridSize * MaxGridSize;
-    static constexpr int NumTextures  = 4;
+
+    // Must match MAX_TEXTURES in cube_inst.psh
+    static constexpr int MaxTextures   = 256;
+    int                  m_NumTextures = MaxTextures;
+
+    // Only the texture array layers used by visible instances are kept at full resolution
+    std::unique_ptr<TextureArrayStreamer> m_TextureStreamer;
+    int                                   m_TextureBudgetMB = 32;
+
+    // Bounding spheres of the instances used to request the textures
+    struct InstanceBounds
+    {
+        float3 Center;
+        float  Radius     = 0;
+        Uint32 TextureInd = 0;
+    };
+    std::vector<InstanceBounds> m_InstanceBounds;
+
+    // Optional compute shader path that generates instances directly in the instance buffer
+    std::unique_ptr<InstanceGrid::GPUGenerator> m_GPUGenerator;
+    bool                                        m_GenerateOnGPU      = false;
+    bool                                        m_VerifyGPUInstances = false; // Verify GPU instances on start-up
+    static constexpr Uint32                     InstanceSeed         = 0;
+
+    struct VerificationResult
+    {
+        bool   Done          = false;
+        Uint32 NumInstances  = 0;
+        Uint32 NumMismatches = 0;
+        float  MaxError      = 0;
+    };
+    VerificationResult m_Verification;
 };
 
 } // namespace Diligent
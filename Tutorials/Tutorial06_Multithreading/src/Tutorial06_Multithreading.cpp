@@ -28,6 +28,8 @@
 #include <random>
 #include <string>
 #include <algorithm>
+#include <chrono>
+#include <iterator>
 
 #include "Tutorial06_Multithreading.hpp"
 #include "MapHelper.hpp"
@@ -37,6 +39,12 @@
 #include "../../Common/src/TexturedCube.hpp"
 #include "imgui.h"
 #include "ImGuiUtils.hpp"
+#include "CommandLineParser.hpp"
+
+#if PLATFORM_LINUX
+#    include <pthread.h>
+#    include <sched.h>
+#endif
 
 namespace Diligent
 {
@@ -46,15 +54,67 @@ SampleBase* CreateSample()
     return new Tutorial06_Multithreading();
 }
 
+namespace
+{
+
+#if PLATFORM_LINUX
+// Pins the calling thread to the CoreInd-th core the process is allowed to run on
+void PinCurrentThread(Uint32 CoreInd)
+{
+    cpu_set_t ProcessCpus;
+    CPU_ZERO(&ProcessCpus);
+    if (sched_getaffinity(0, sizeof(ProcessCpus), &ProcessCpus) != 0)
+        return;
+
+    const int NumCpus = CPU_COUNT(&ProcessCpus);
+    if (NumCpus == 0)
+        return;
+
+    CoreInd %= static_cast<Uint32>(NumCpus);
+    for (int Cpu = 0; Cpu < CPU_SETSIZE; ++Cpu)
+    {
+        if (!CPU_ISSET(Cpu, &ProcessCpus))
+            continue;
+
+        if (CoreInd-- == 0)
+        {
+            cpu_set_t ThreadCpus;
+            CPU_ZERO(&ThreadCpus);
+            CPU_SET(Cpu, &ThreadCpus);
+            if (int Err = pthread_setaffinity_np(pthread_self(), sizeof(ThreadCpus), &ThreadCpus))
+                LOG_WARNING_MESSAGE("Failed to pin worker thread to CPU ", Cpu, ": error ", Err);
+            return;
+        }
+    }
+}
+#endif
+
+} // namespace
+
 Tutorial06_Multithreading::~Tutorial06_Multithreading()
 {
     StopWorkerThreads();
 }
 
+Tutorial06_Multithreading::CommandLineStatus Tutorial06_Multithreading::ProcessCommandLine(int argc, const char* const* argv)
+{
+    CommandLineParser ArgsParser{argc, argv};
+    ArgsParser.Parse("max_workers", m_NumDeferredContexts);
+    ArgsParser.Parse("workers", m_NumWorkerThreads);
+    ArgsParser.Parse("auto_workers", m_AutoWorkerCount);
+    ArgsParser.Parse("pin_threads", m_PinThreads);
+
+    return CommandLineStatus::OK;
+}
+
 void Tutorial06_Multithreading::ModifyEngineInitInfo(const ModifyEngineInitInfoAttribs& Attribs)
 {
     SampleBase::ModifyEngineInitInfo(Attribs);
+    // Deferred contexts are created once. The number of worker threads that use them
+    // can be changed at run time.
     Attribs.EngineCI.NumDeferredContexts = std::max(std::thread::hardware_concurrency() - 1, 2u);
+    if (m_NumDeferredContexts > 0)
+        Attribs.EngineCI.NumDeferredContexts = static_cast<Uint32>(m_NumDeferredContexts);
 #if VULKAN_SUPPORTED
     if (Attribs.DeviceType == RENDER_DEVICE_TYPE_VULKAN)
     {
@@ -88,6 +148,28 @@ void Tutorial06_Multithreading::CreatePipelineState(std::vector<StateTransitionD
 
     m_pPSO = TexturedCube::CreatePipelineState(CubePsoCI, m_ConvertPSOutputToGamma);
 
+    // clang-format off
+    // Pipeline state used in batched mode reads instance transformation matrix
+    // from the per-instance vertex buffer
+    LayoutElement InstLayoutElems[] =
+    {
+        // Per-instance data - second buffer slot
+        // Attribute 2 - first row
+        LayoutElement{2, 1, 4, VT_FLOAT32, False, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE},
+        // Attribute 3 - second row
+        LayoutElement{3, 1, 4, VT_FLOAT32, False, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE},
+        // Attribute 4 - third row
+        LayoutElement{4, 1, 4, VT_FLOAT32, False, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE},
+        // Attribute 5 - fourth row
+        LayoutElement{5, 1, 4, VT_FLOAT32, False, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE}
+    };
+    // clang-format on
+    CubePsoCI.VSFilePath             = "cube_inst.vsh";
+    CubePsoCI.ExtraLayoutElements    = InstLayoutElems;
+    CubePsoCI.NumExtraLayoutElements = _countof(InstLayoutElems);
+
+    m_pInstancedPSO = TexturedCube::CreatePipelineState(CubePsoCI, m_ConvertPSOutputToGamma);
+
     // Create dynamic uniform buffer that will store our transformation matrix
     // Dynamic buffers can be frequently updated by the CPU
     CreateUniformBuffer(m_pDevice, sizeof(float4x4) * 2, "VS constants CB", &m_VSConstants);
@@ -101,6 +183,7 @@ void Tutorial06_Multithreading::CreatePipelineState(std::vector<StateTransitionD
     // never change and are bound directly to the pipeline state object.
     m_pPSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_VSConstants);
     m_pPSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "InstanceData")->Set(m_InstanceConstants);
+    m_pInstancedPSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_VSConstants);
 }
 
 void Tutorial06_Multithreading::LoadTextures(std::vector<StateTransitionDesc>& Barriers)
@@ -127,6 +210,11 @@ void Tutorial06_Multithreading::LoadTextures(std::vector<StateTransitionDesc>& B
         // http://diligentgraphics.com/2016/03/23/resource-binding-model-in-diligent-engine-2-0/
         m_pPSO->CreateShaderResourceBinding(&m_SRB[tex], true);
         m_SRB[tex]->GetVariableByName(SHADER_TYPE_PIXEL, "g_Texture")->Set(m_TextureSRV[tex]);
+
+        // SRBs are not compatible between pipelines with different resource layouts,
+        // so the instanced pipeline needs its own set
+        m_pInstancedPSO->CreateShaderResourceBinding(&m_InstancedSRB[tex], true);
+        m_InstancedSRB[tex]->GetVariableByName(SHADER_TYPE_PIXEL, "g_Texture")->Set(m_TextureSRV[tex]);
     }
 }
 
@@ -135,17 +223,39 @@ void Tutorial06_Multithreading::UpdateUI()
     ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_FirstUseEver);
     if (ImGui::Begin("Settings", nullptr, ImGuiWindowFlags_AlwaysAutoResize))
     {
-        if (ImGui::SliderInt("Grid Size", &m_GridSize, 1, 32))
+        if (ImGui::SliderInt("Grid Size", &m_GridSize, 1, MaxGridSize))
         {
             PopulateInstanceData();
         }
         {
             ImGui::ScopedDisabler Disable(m_MaxThreads == 0);
-            if (ImGui::SliderInt("Worker Threads", &m_NumWorkerThreads, 0, m_MaxThreads))
             {
-                StopWorkerThreads();
-                StartWorkerThreads(m_NumWorkerThreads);
+                ImGui::ScopedDisabler DisableSlider(m_AutoWorkerCount);
+                if (ImGui::SliderInt("Worker Threads", &m_NumWorkerThreads, 0, m_MaxThreads))
+                {
+                    SetNumWorkerThreads(m_NumWorkerThreads);
+                }
+            }
+            if (ImGui::Checkbox("Auto worker count", &m_AutoWorkerCount))
+            {
+                m_AutoTuneStartTime = 0;
             }
+#if PLATFORM_LINUX
+            if (ImGui::Checkbox("Pin threads to cores", &m_PinThreads))
+            {
+                // Affinity is set when the threads start
+                SetNumWorkerThreads(m_NumWorkerThreads);
+            }
+#endif
+        }
+        ImGui::Checkbox("Batch instances", &m_BatchInstances);
+        ImGui::Text("Draws per frame: %u", m_DrawsPerFrame);
+        ImGui::Text("CPU record time: %.2f ms", m_RecordTimeMs);
+        ImGui::Text("Record wall time: %.2f ms", m_RecordWallTimeMs);
+        for (size_t i = 0; i < m_SubsetUtilization.size(); ++i)
+        {
+            const auto Label = i == 0 ? std::string{"Main thread"} : "Worker " + std::to_string(i - 1);
+            ImGui::ProgressBar(m_SubsetUtilization[i], ImVec2{200, 0}, Label.c_str());
         }
     }
 
@@ -157,7 +267,8 @@ void Tutorial06_Multithreading::Initialize(const SampleInitInfo& InitInfo)
     SampleBase::Initialize(InitInfo);
 
     m_MaxThreads       = static_cast<int>(m_pDeferredContexts.size());
-    m_NumWorkerThreads = std::min(4, m_MaxThreads);
+    m_NumWorkerThreads = clamp(m_NumWorkerThreads, 0, m_MaxThreads);
+    m_WallTimeByWorkerCount.assign(m_MaxThreads + 1, -1);
 
     std::vector<StateTransitionDesc> Barriers;
 
@@ -231,6 +342,82 @@ void Tutorial06_Multithreading::StartWorkerThreads(size_t NumThreads)
         m_WorkerThreads[t] = std::thread(WorkerThreadFunc, this, t);
     }
     m_CmdLists.resize(NumThreads);
+    m_SubsetStats.resize(NumThreads + 1);
+    m_SubsetRecordTimeAccum.assign(NumThreads + 1, 0);
+    CreateInstanceBuffers(static_cast<Uint32>(NumThreads + 1));
+}
+
+void Tutorial06_Multithreading::SetNumWorkerThreads(int NumThreads)
+{
+    // Threads are only running between the frames, so they can be safely restarted here.
+    // Deferred contexts are not recreated.
+    StopWorkerThreads();
+    StartWorkerThreads(NumThreads);
+}
+
+void Tutorial06_Multithreading::AdjustNumWorkerThreads(double CurrTime)
+{
+    // The load on the machine changes over time, so old measurements are periodically discarded.
+    // The current count is measured again right away, and only its two neighbors are probed.
+    if (m_AutoTuneStartTime == 0 || CurrTime - m_AutoTuneStartTime > 10)
+    {
+        std::fill(m_WallTimeByWorkerCount.begin(), m_WallTimeByWorkerCount.end(), -1.0);
+        m_AutoTuneStartTime = CurrTime;
+    }
+    m_WallTimeByWorkerCount[m_NumWorkerThreads] = m_RecordWallTimeMs;
+
+    // Find the fastest of the measured counts
+    int BestCount = m_NumWorkerThreads;
+    for (int Count = 0; Count <= m_MaxThreads; ++Count)
+    {
+        if (m_WallTimeByWorkerCount[Count] >= 0 && m_WallTimeByWorkerCount[Count] < m_WallTimeByWorkerCount[BestCount])
+            BestCount = Count;
+    }
+
+    // Probe the neighbors of the best count that have not been measured yet, so that the
+    // worker count never moves more than one step away from the best known one.
+    // Once both neighbors are measured, stay at the best count.
+    int NextCount = BestCount;
+    for (int Count : {BestCount - 1, BestCount + 1})
+    {
+        if (Count >= 0 && Count <= m_MaxThreads && m_WallTimeByWorkerCount[Count] < 0)
+        {
+            NextCount = Count;
+            break;
+        }
+    }
+
+    if (NextCount != m_NumWorkerThreads)
+    {
+        m_NumWorkerThreads = NextCount;
+        SetNumWorkerThreads(m_NumWorkerThreads);
+    }
+}
+
+void Tutorial06_Multithreading::CreateInstanceBuffers(Uint32 NumSubsets)
+{
+    // Every context writes to its own buffer. Since a dynamic buffer gets a new memory
+    // region every time it is mapped with MAP_FLAG_DISCARD, the buffer is only as large
+    // as the largest subset (the last subset also gets the remainder of the instances).
+    const Uint32 MaxSubsetSize = MaxInstances / NumSubsets + NumSubsets;
+
+    BufferDesc InstBuffDesc;
+    InstBuffDesc.Name           = "Instance batch buffer";
+    InstBuffDesc.Usage          = USAGE_DYNAMIC;
+    InstBuffDesc.BindFlags      = BIND_VERTEX_BUFFER;
+    InstBuffDesc.CPUAccessFlags = CPU_ACCESS_WRITE;
+    InstBuffDesc.Size           = sizeof(float4x4) * MaxSubsetSize;
+
+    std::vector<StateTransitionDesc> Barriers;
+    m_InstanceBuffers.resize(NumSubsets);
+    for (auto& pBuffer : m_InstanceBuffers)
+    {
+        pBuffer.Release();
+        m_pDevice->CreateBuffer(InstBuffDesc, nullptr, &pBuffer);
+        // Deferred contexts only verify the states, so explicitly transition the buffers
+        Barriers.emplace_back(pBuffer, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_VERTEX_BUFFER, STATE_TRANSITION_FLAG_UPDATE_STATE);
+    }
+    m_pImmediateContext->TransitionResourceStates(static_cast<Uint32>(Barriers.size()), Barriers.data());
 }
 
 void Tutorial06_Multithreading::StopWorkerThreads()
@@ -242,6 +429,7 @@ void Tutorial06_Multithreading::StopWorkerThreads()
         thread.join();
     }
     m_RenderSubsetSignal.Reset();
+    m_AllThreadsReadySignal.Reset();
     m_WorkerThreads.clear();
     m_CmdLists.clear();
 }
@@ -251,6 +439,14 @@ void Tutorial06_Multithreading::WorkerThreadFunc(Tutorial06_Multithreading* pThi
     // Every thread should use its own deferred context
     IDeviceContext* pDeferredCtx     = pThis->m_pDeferredContexts[ThreadNum];
     const int       NumWorkerThreads = static_cast<int>(pThis->m_WorkerThreads.size());
+#if PLATFORM_LINUX
+    if (pThis->m_PinThreads)
+    {
+        // Workers skip the first core to leave room for the main thread. The main thread
+        // itself is not pinned and may still be scheduled on any core.
+        PinCurrentThread(1 + ThreadNum);
+    }
+#endif
     for (;;)
     {
         // Wait for the signal
@@ -258,16 +454,22 @@ void Tutorial06_Multithreading::WorkerThreadFunc(Tutorial06_Multithreading* pThi
         if (SignaledValue < 0)
             return;
 
+        const auto StartTime = std::chrono::high_resolution_clock::now();
+
         pDeferredCtx->Begin(0);
 
         // Render current subset using the deferred context
-        pThis->RenderSubset(pDeferredCtx, 1 + ThreadNum);
+        const Uint32 NumDraws = pThis->RenderSubset(pDeferredCtx, 1 + ThreadNum);
 
         // Finish command list
         RefCntAutoPtr<ICommandList> pCmdList;
         pDeferredCtx->FinishCommandList(&pCmdList);
         pThis->m_CmdLists[ThreadNum] = pCmdList;
 
+        auto& Stats        = pThis->m_SubsetStats[1 + ThreadNum];
+        Stats.NumDraws     = NumDraws;
+        Stats.RecordTimeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - StartTime).count();
+
         {
             // Atomically increment the number of completed threads
             const auto NumThreadsCompleted = pThis->m_NumThreadsCompleted.fetch_add(1) + 1;
@@ -284,18 +486,21 @@ void Tutorial06_Multithreading::WorkerThreadFunc(Tutorial06_Multithreading* pThi
         //            thread that issued rendering commands.
         pDeferredCtx->FinishFrame();
 
-        pThis->m_NumThreadsReady.fetch_add(1);
         // We must wait until all threads reach this point, because
         // m_GotoNextFrameSignal must be unsignaled before we proceed to
         // RenderSubsetSignal to avoid one thread going through the loop twice in
-        // a row.
-        while (pThis->m_NumThreadsReady.load() < NumWorkerThreads)
-            std::this_thread::yield();
+        // a row. The threads block rather than spin so that they do not take
+        // the cores from other threads.
+        const auto NumThreadsReady = pThis->m_NumThreadsReady.fetch_add(1) + 1;
+        if (NumThreadsReady < NumWorkerThreads)
+            pThis->m_AllThreadsReadySignal.Wait(true, NumWorkerThreads - 1);
+        else if (NumWorkerThreads > 1)
+            pThis->m_AllThreadsReadySignal.Trigger(true);
         VERIFY_EXPR(!pThis->m_GotoNextFrameSignal.IsTriggered());
     }
 }
 
-void Tutorial06_Multithreading::RenderSubset(IDeviceContext* pCtx, Uint32 Subset)
+Uint32 Tutorial06_Multithreading::RenderSubset(IDeviceContext* pCtx, Uint32 Subset)
 {
     // Deferred contexts start in default state. We must bind everything to the context.
     // Render targets are set and transitioned to correct states by the main thread, here we only verify the states.
@@ -322,13 +527,17 @@ void Tutorial06_Multithreading::RenderSubset(IDeviceContext* pCtx, Uint32 Subset
     DrawAttrs.NumIndices = 36;
     DrawAttrs.Flags      = DRAW_FLAG_VERIFY_ALL;
 
-    // Set the pipeline state
-    pCtx->SetPipelineState(m_pPSO);
     Uint32 NumSubsets   = Uint32{1} + static_cast<Uint32>(m_WorkerThreads.size());
     Uint32 NumInstances = static_cast<Uint32>(m_InstanceData.size());
     Uint32 SusbsetSize  = NumInstances / NumSubsets;
     Uint32 StartInst    = SusbsetSize * Subset;
     Uint32 EndInst      = (Subset < NumSubsets - 1) ? SusbsetSize * (Subset + 1) : NumInstances;
+    if (m_BatchInstances)
+        return RenderInstanceBatches(pCtx, Subset, StartInst, EndInst);
+
+    // Set the pipeline state
+    pCtx->SetPipelineState(m_pPSO);
+    Uint32 NumDraws = 0;
     for (size_t inst = StartInst; inst < EndInst; ++inst)
     {
         const auto& CurrInstData = m_InstanceData[inst];
@@ -351,7 +560,69 @@ void Tutorial06_Multithreading::RenderSubset(IDeviceContext* pCtx, Uint32 Subset
         }
 
         pCtx->DrawIndexed(DrawAttrs);
+        ++NumDraws;
+    }
+    return NumDraws;
+}
+
+Uint32 Tutorial06_Multithreading::RenderInstanceBatches(IDeviceContext* pCtx, Uint32 Subset, Uint32 StartInst, Uint32 EndInst)
+{
+    if (StartInst == EndInst)
+        return 0;
+
+    // Sort the instances of the subset by texture using counting sort, so that
+    // every texture group occupies a contiguous range of the instance buffer
+    Uint32 GroupStart[NumTextures + 1] = {};
+    for (Uint32 inst = StartInst; inst < EndInst; ++inst)
+        ++GroupStart[m_InstanceData[inst].TextureInd + 1];
+    for (int tex = 0; tex < NumTextures; ++tex)
+        GroupStart[tex + 1] += GroupStart[tex];
+
+    IBuffer* pInstanceBuffer = m_InstanceBuffers[Subset];
+    {
+        // Every context writes to its own buffer, so no synchronization between threads is required
+        MapHelper<float4x4> InstData(pCtx, pInstanceBuffer, MAP_WRITE, MAP_FLAG_DISCARD);
+        if (InstData == nullptr)
+        {
+            LOG_ERROR_MESSAGE("Failed to map instance batch buffer");
+            return 0;
+        }
+
+        Uint32 GroupPos[NumTextures];
+        std::copy(std::begin(GroupStart), std::begin(GroupStart) + NumTextures, std::begin(GroupPos));
+        for (Uint32 inst = StartInst; inst < EndInst; ++inst)
+        {
+            const auto& CurrInstData = m_InstanceData[inst];
+            InstData[GroupPos[CurrInstData.TextureInd]++] = CurrInstData.Matrix;
+        }
+    }
+
+    pCtx->SetPipelineState(m_pInstancedPSO);
+
+    DrawIndexedAttribs DrawAttrs;
+    DrawAttrs.IndexType  = VT_UINT32;
+    DrawAttrs.NumIndices = 36;
+    DrawAttrs.Flags      = DRAW_FLAG_VERIFY_ALL;
+
+    IBuffer* pBuffs[] = {m_CubeVertexBuffer, pInstanceBuffer};
+    Uint32   NumDraws = 0;
+    for (int tex = 0; tex < NumTextures; ++tex)
+    {
+        const Uint32 NumGroupInstances = GroupStart[tex + 1] - GroupStart[tex];
+        if (NumGroupInstances == 0)
+            continue;
+
+        // Use the offset in the instance buffer rather than the first instance location
+        // as the latter is not supported by all devices
+        const Uint64 Offsets[] = {0, Uint64{GroupStart[tex]} * sizeof(float4x4)};
+        pCtx->SetVertexBuffers(0, _countof(pBuffs), pBuffs, Offsets, RESOURCE_STATE_TRANSITION_MODE_VERIFY, SET_VERTEX_BUFFERS_FLAG_RESET);
+        pCtx->CommitShaderResources(m_InstancedSRB[tex], RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+
+        DrawAttrs.NumInstances = NumGroupInstances;
+        pCtx->DrawIndexed(DrawAttrs);
+        ++NumDraws;
     }
+    return NumDraws;
 }
 
 // Render a frame
@@ -369,18 +640,32 @@ void Tutorial06_Multithreading::Render()
     m_pImmediateContext->ClearRenderTarget(pRTV, ClearColor.Data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
     m_pImmediateContext->ClearDepthStencil(pDSV, CLEAR_DEPTH_FLAG, 1.f, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
 
+    const auto RecordStartTime = std::chrono::high_resolution_clock::now();
     if (!m_WorkerThreads.empty())
     {
         m_NumThreadsCompleted.store(0);
         m_RenderSubsetSignal.Trigger(true);
     }
 
-    RenderSubset(m_pImmediateContext, 0);
+    m_SubsetStats[0].NumDraws     = RenderSubset(m_pImmediateContext, 0);
+    m_SubsetStats[0].RecordTimeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - RecordStartTime).count();
 
     if (!m_WorkerThreads.empty())
-    {
         m_ExecuteCommandListsSignal.Wait(true, 1);
 
+    // All command lists have been recorded at this point
+    m_RecordWallTimeAccum += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - RecordStartTime).count();
+    for (size_t i = 0; i < m_SubsetStats.size(); ++i)
+    {
+        const auto& Stats = m_SubsetStats[i];
+        m_RecordTimeAccum          += Stats.RecordTimeMs;
+        m_NumDrawsAccum            += Stats.NumDraws;
+        m_SubsetRecordTimeAccum[i] += Stats.RecordTimeMs;
+    }
+    ++m_NumFramesAccum;
+
+    if (!m_WorkerThreads.empty())
+    {
         m_CmdListPtrs.resize(m_CmdLists.size());
         for (Uint32 i = 0; i < m_CmdLists.size(); ++i)
             m_CmdListPtrs[i] = m_CmdLists[i];
@@ -405,6 +690,33 @@ void Tutorial06_Multithreading::Update(double CurrTime, double ElapsedTime)
     SampleBase::Update(CurrTime, ElapsedTime);
     UpdateUI();
 
+    // Average the recording statistics over half a second to get stable readings
+    if (CurrTime - m_StatsStartTime >= 0.5)
+    {
+        if (m_NumFramesAccum > 0)
+        {
+            m_RecordTimeMs     = m_RecordTimeAccum / m_NumFramesAccum;
+            m_RecordWallTimeMs = m_RecordWallTimeAccum / m_NumFramesAccum;
+            m_DrawsPerFrame    = static_cast<Uint32>(m_NumDrawsAccum / m_NumFramesAccum);
+
+            m_SubsetUtilization.resize(m_SubsetRecordTimeAccum.size());
+            for (size_t i = 0; i < m_SubsetRecordTimeAccum.size(); ++i)
+                m_SubsetUtilization[i] = m_RecordWallTimeAccum > 0 ? static_cast<float>(m_SubsetRecordTimeAccum[i] / m_RecordWallTimeAccum) : 0.f;
+        }
+        const bool HaveStats = m_NumFramesAccum > 0;
+
+        m_RecordTimeAccum     = 0;
+        m_RecordWallTimeAccum = 0;
+        m_NumDrawsAccum       = 0;
+        m_NumFramesAccum      = 0;
+        m_StatsStartTime      = CurrTime;
+        std::fill(m_SubsetRecordTimeAccum.begin(), m_SubsetRecordTimeAccum.end(), 0.0);
+
+        // Adjust the worker count only at the start of the new measurement window
+        if (m_AutoWorkerCount && m_MaxThreads > 0 && HaveStats)
+            AdjustNumWorkerThreads(CurrTime);
+    }
+
     // Set the cube view matrix
     float4x4 View = float4x4::RotationX(-0.6f) * float4x4::Translation(0.f, 0.f, 4.0f);
 
@@ -42,6 +42,8 @@ class Tutorial06_Multithreading final : public SampleBase
 {
 public:
     ~Tutorial06_Multithreading() override;
+    virtual CommandLineStatus ProcessCommandLine(int argc, const char* const* argv) override final;
+
     virtual void ModifyEngineInitInfo(const ModifyEngineInitInfoAttribs& Attribs) override final;
     virtual void Initialize(const SampleInitInfo& InitInfo) override final;
 
@@ -55,17 +57,23 @@ private:
     void LoadTextures(std::vector<StateTransitionDesc>& Barriers);
     void UpdateUI();
     void PopulateInstanceData();
+    void CreateInstanceBuffers(Uint32 NumSubsets);
 
     void StartWorkerThreads(size_t NumThreads);
     void StopWorkerThreads();
+    void SetNumWorkerThreads(int NumThreads);
+    void AdjustNumWorkerThreads(double CurrTime);
 
-    void RenderSubset(IDeviceContext* pCtx, Uint32 Subset);
+    // Returns the number of draw calls
+    Uint32 RenderSubset(IDeviceContext* pCtx, Uint32 Subset);
+    Uint32 RenderInstanceBatches(IDeviceContext* pCtx, Uint32 Subset, Uint32 StartInst, Uint32 EndInst);
 
     static void WorkerThreadFunc(Tutorial06_Multithreading* pThis, Uint32 ThreadNum);
 
     Threading::Signal        m_RenderSubsetSignal;
     Threading::Signal        m_ExecuteCommandListsSignal;
     Threading::Signal        m_GotoNextFrameSignal;
+    Threading::Signal        m_AllThreadsReadySignal;
     std::atomic_int          m_NumThreadsCompleted;
     std::atomic_int          m_NumThreadsReady;
     std::vector<std::thread> m_WorkerThreads;
@@ -84,12 +92,30 @@ private:
     RefCntAutoPtr<IShaderResourceBinding> m_SRB[NumTextures];
     RefCntAutoPtr<ITextureView>           m_TextureSRV[NumTextures];
 
-    float4x4 m_ViewProjMatrix;
-    float4x4 m_RotationMatrix;
-    int      m_GridSize = 5;
-
-    int m_MaxThreads       = 8;
-    int m_NumWorkerThreads = 4;
+    // In batched mode, every context writes the transforms of its subset sorted by
+    // texture to its own instance buffer and draws every texture group with one
+    // instanced draw call
+    bool                                  m_BatchInstances = false;
+    RefCntAutoPtr<IPipelineState>         m_pInstancedPSO;
+    RefCntAutoPtr<IShaderResourceBinding> m_InstancedSRB[NumTextures];
+    std::vector<RefCntAutoPtr<IBuffer>>   m_InstanceBuffers; // One buffer per subset
+
+    float4x4             m_ViewProjMatrix;
+    float4x4             m_RotationMatrix;
+    int                  m_GridSize   = 5;
+    static constexpr int MaxGridSize  = 32;
+    static constexpr int MaxInstances = MaxGridSize * MaxGridSize * MaxGridSize;
+
+    int  m_MaxThreads          = 8;
+    int  m_NumWorkerThreads    = 4;
+    int  m_NumDeferredContexts = 0; // 0 - use hardware_concurrency() - 1
+    bool m_PinThreads          = false;
+
+    // When enabled, the number of worker threads is adjusted at run time to minimize
+    // the recording wall time
+    bool                m_AutoWorkerCount   = false;
+    std::vector<double> m_WallTimeByWorkerCount; // Measured wall time for every worker count, or -1
+    double              m_AutoTuneStartTime = 0;
 
     struct InstanceData
     {
@@ -97,6 +123,28 @@ private:
         int      TextureInd = 0;
     };
     std::vector<InstanceData> m_InstanceData;
+
+    // Recording statistics of every subset in the current frame. Every thread only
+    // writes its own element.
+    struct SubsetStats
+    {
+        double RecordTimeMs = 0;
+        Uint32 NumDraws     = 0;
+    };
+    std::vector<SubsetStats> m_SubsetStats;
+
+    // Statistics averaged over half a second
+    double m_RecordTimeAccum     = 0; // Total recording time of all threads, in ms
+    double m_RecordWallTimeAccum = 0; // Time from the start of recording until all command lists are ready, in ms
+    Uint64 m_NumDrawsAccum       = 0;
+    Uint32 m_NumFramesAccum      = 0;
+    double m_StatsStartTime      = 0;
+    double m_RecordTimeMs        = 0;
+    double m_RecordWallTimeMs    = 0;
+    Uint32 m_DrawsPerFrame       = 0;
+
+    std::vector<double> m_SubsetRecordTimeAccum;
+    std::vector<float>  m_SubsetUtilization; // Fraction of the recording wall time every thread was busy
 };
 
 } // namespace Diligent
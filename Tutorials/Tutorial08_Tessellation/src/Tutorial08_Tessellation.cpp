@@ -25,10 +25,15 @@
  *  of the possibility of such damages.
  */
 
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
 #include "Tutorial08_Tessellation.hpp"
 #include "MapHelper.hpp"
 #include "GraphicsUtilities.h"
 #include "TextureUtilities.h"
+#include "TextureLoader.h"
 #include "ColorConversion.h"
 #include "ShaderMacroHelper.hpp"
 #include "imgui.h"
@@ -56,15 +61,94 @@ struct GlobalConstants
     float HeightScale;
     float LineWidth;
 
-    float  TessDensity;
-    int    AdaptiveTessellation;
-    float2 Dummy2;
+    float TessDensity;
+    int   AdaptiveTessellation;
+    int   PatchCulling;
+    float TriangleSize;
+
+    float3 CameraPos;
+    float  ScreenScale;
 
     float4x4 WorldView;
     float4x4 WorldViewProj;
     float4   ViewportSize;
 };
 
+// Computes minimum and maximum normalized height as well as the maximum slope of every block.
+// Texels that contribute to the bilinearly filtered heights along the block edges are included.
+std::vector<float4> ComputeBlockBounds(const TextureSubResData& HeightData,
+                                       TEXTURE_FORMAT           Format,
+                                       Uint32                   Width,
+                                       Uint32                   Height,
+                                       Uint32                   NumHorzBlocks,
+                                       Uint32                   NumVertBlocks)
+{
+    std::vector<float4> Bounds(size_t{NumHorzBlocks} * size_t{NumVertBlocks});
+
+    float NormScale = 0;
+    if (Format == TEX_FORMAT_R16_UNORM)
+        NormScale = 1.f / 65535.f;
+    else if (Format == TEX_FORMAT_R8_UNORM)
+        NormScale = 1.f / 255.f;
+
+    if (NormScale == 0)
+    {
+        LOG_WARNING_MESSAGE("Unexpected height map format ", GetTextureFormatAttribs(Format).Name,
+                            ". Conservative block bounds will be used, which effectively disables back-face culling.");
+        // The slope is large enough for the normal cone to cover all directions
+        std::fill(Bounds.begin(), Bounds.end(), float4{0, 1, 1e+6f, 0});
+        return Bounds;
+    }
+
+    const auto GetHeight = [&](Uint32 x, Uint32 y) {
+        const auto* pRow = static_cast<const Uint8*>(HeightData.pData) + size_t{y} * HeightData.Stride;
+        return Format == TEX_FORMAT_R16_UNORM ?
+            static_cast<float>(reinterpret_cast<const Uint16*>(pRow)[x]) * NormScale :
+            static_cast<float>(pRow[x]) * NormScale;
+    };
+
+    // Range of texels that affect the filtered heights in the [u0, u1] range
+    const auto GetTexelRange = [](Uint32 Block, Uint32 NumBlocks, Uint32 Size, Uint32& First, Uint32& Last) {
+        const auto u0 = static_cast<float>(Block) / static_cast<float>(NumBlocks) * static_cast<float>(Size) - 0.5f;
+        const auto u1 = static_cast<float>(Block + 1) / static_cast<float>(NumBlocks) * static_cast<float>(Size) - 0.5f;
+
+        First = static_cast<Uint32>(std::max(std::floor(u0), 0.f));
+        Last  = std::min(static_cast<Uint32>(std::max(std::floor(u1), 0.f)) + 1, Size - 1);
+    };
+
+    for (Uint32 by = 0; by < NumVertBlocks; ++by)
+    {
+        Uint32 y0, y1;
+        GetTexelRange(by, NumVertBlocks, Height, y0, y1);
+        for (Uint32 bx = 0; bx < NumHorzBlocks; ++bx)
+        {
+            Uint32 x0, x1;
+            GetTexelRange(bx, NumHorzBlocks, Width, x0, x1);
+
+            float MinH = 1, MaxH = 0;
+            // Maximum height derivatives along u and v, in normalized height units per UV unit
+            float MaxDu = 0, MaxDv = 0;
+            for (Uint32 y = y0; y <= y1; ++y)
+            {
+                for (Uint32 x = x0; x <= x1; ++x)
+                {
+                    const auto H = GetHeight(x, y);
+
+                    MinH = std::min(MinH, H);
+                    MaxH = std::max(MaxH, H);
+                    if (x < x1)
+                        MaxDu = std::max(MaxDu, std::abs(GetHeight(x + 1, y) - H) * static_cast<float>(Width));
+                    if (y < y1)
+                        MaxDv = std::max(MaxDv, std::abs(GetHeight(x, y + 1) - H) * static_cast<float>(Height));
+                }
+            }
+            Bounds[size_t{by} * NumHorzBlocks + bx] = float4{MinH, MaxH, std::sqrt(MaxDu * MaxDu + MaxDv * MaxDv), 0};
+        }
+    }
+
+    return Bounds;
+}
+
 } // namespace
 
 void Tutorial08_Tessellation::CreatePipelineStates()
@@ -259,17 +343,42 @@ void Tutorial08_Tessellation::CreatePipelineStates()
 void Tutorial08_Tessellation::LoadTextures()
 {
     {
-        // Load texture
+        // Load texture. Texture loader keeps the pixels on the CPU so that we can
+        // compute the block bounds used by the hull shader for patch culling.
         TextureLoadInfo loadInfo;
         loadInfo.IsSRGB = false;
         loadInfo.Name   = "Terrain height map";
+        RefCntAutoPtr<ITextureLoader> pHeightMapLoader;
+        CreateTextureLoaderFromFile("ps_height_1k.png", IMAGE_FILE_FORMAT_UNKNOWN, loadInfo, &pHeightMapLoader);
         RefCntAutoPtr<ITexture> HeightMap;
-        CreateTextureFromFile("ps_height_1k.png", loadInfo, m_pDevice, &HeightMap);
+        pHeightMapLoader->CreateTexture(m_pDevice, &HeightMap);
         const auto& HMDesc = HeightMap->GetDesc();
         m_HeightMapWidth   = HMDesc.Width;
         m_HeightMapHeight  = HMDesc.Height;
         // Get shader resource view from the texture
         m_HeightMapSRV = HeightMap->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
+
+        const Uint32 NumHorzBlocks = m_HeightMapWidth / m_BlockSize;
+        const Uint32 NumVertBlocks = m_HeightMapHeight / m_BlockSize;
+
+        const auto BlockBounds = ComputeBlockBounds(pHeightMapLoader->GetSubresourceData(0, 0), HMDesc.Format,
+                                                    m_HeightMapWidth, m_HeightMapHeight, NumHorzBlocks, NumVertBlocks);
+
+        TextureDesc BoundsDesc;
+        BoundsDesc.Name      = "Terrain block bounds";
+        BoundsDesc.Type      = RESOURCE_DIM_TEX_2D;
+        BoundsDesc.Width     = NumHorzBlocks;
+        BoundsDesc.Height    = NumVertBlocks;
+        BoundsDesc.Format    = TEX_FORMAT_RGBA32_FLOAT;
+        BoundsDesc.Usage     = USAGE_IMMUTABLE;
+        BoundsDesc.BindFlags = BIND_SHADER_RESOURCE;
+
+        TextureSubResData BoundsSubres{BlockBounds.data(), Uint64{NumHorzBlocks} * sizeof(float4)};
+        TextureData       BoundsData{&BoundsSubres, 1};
+
+        RefCntAutoPtr<ITexture> BlockBoundsTex;
+        m_pDevice->CreateTexture(BoundsDesc, &BoundsData, &BlockBoundsTex);
+        m_BlockBoundsSRV = BlockBoundsTex->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE);
     }
 
     {
@@ -288,6 +397,10 @@ void Tutorial08_Tessellation::LoadTextures()
     {
         if (m_pPSO[i])
         {
+            // Block bounds never change, so they are bound as a static variable that must be
+            // set before the SRB is created
+            m_pPSO[i]->GetStaticVariableByName(SHADER_TYPE_HULL, "g_BlockBounds")->Set(m_BlockBoundsSRV);
+
             m_pPSO[i]->CreateShaderResourceBinding(&m_SRB[i], true);
             // Set texture SRV in the SRB
             // clang-format off
@@ -306,10 +419,26 @@ void Tutorial08_Tessellation::UpdateUI()
     {
         ImGui::Checkbox("Animate", &m_Animate);
         ImGui::Checkbox("Adaptive tessellation", &m_AdaptiveTessellation);
+        ImGui::Checkbox("Patch culling", &m_PatchCulling);
         if (m_pPSO[1])
             ImGui::Checkbox("Wireframe", &m_Wireframe);
-        ImGui::SliderFloat("Tess density", &m_TessDensity, 1.f, 32.f);
+        if (m_AdaptiveTessellation)
+            ImGui::SliderFloat("Triangle size (px)", &m_TriangleSize, 1.f, 64.f);
+        else
+            ImGui::SliderFloat("Tess density", &m_TessDensity, 1.f, 32.f);
         ImGui::SliderFloat("Distance", &m_Distance, 1.f, 20.f);
+
+        if (m_pPipelineStatsQuery)
+        {
+            const Uint32 NumPatches = (m_HeightMapWidth / m_BlockSize) * (m_HeightMapHeight / m_BlockSize);
+            ImGui::Text("Patches: %u", NumPatches);
+            ImGui::Text("Tessellated triangles: %llu", static_cast<unsigned long long>(m_PipelineStatsData.ClippingInvocations));
+            ImGui::Text("DS invocations: %llu", static_cast<unsigned long long>(m_PipelineStatsData.DSInvocations));
+        }
+        else
+        {
+            ImGui::TextDisabled("Pipeline statistics queries are not supported");
+        }
     }
     ImGui::End();
 }
@@ -320,6 +449,8 @@ void Tutorial08_Tessellation::ModifyEngineInitInfo(const ModifyEngineInitInfoAtt
 
     Attribs.EngineCI.Features.Tessellation    = DEVICE_FEATURE_STATE_ENABLED;
     Attribs.EngineCI.Features.GeometryShaders = DEVICE_FEATURE_STATE_OPTIONAL;
+    // Pipeline statistics are used to report the number of tessellated triangles
+    Attribs.EngineCI.Features.PipelineStatisticsQueries = DEVICE_FEATURE_STATE_OPTIONAL;
 }
 
 void Tutorial08_Tessellation::Initialize(const SampleInitInfo& InitInfo)
@@ -328,6 +459,14 @@ void Tutorial08_Tessellation::Initialize(const SampleInitInfo& InitInfo)
 
     CreatePipelineStates();
     LoadTextures();
+
+    if (m_pDevice->GetDeviceInfo().Features.PipelineStatisticsQueries)
+    {
+        QueryDesc queryDesc;
+        queryDesc.Name = "Pipeline statistics query";
+        queryDesc.Type = QUERY_TYPE_PIPELINE_STATISTICS;
+        m_pPipelineStatsQuery.reset(new ScopedQueryHelper{m_pDevice, queryDesc, 2});
+    }
 }
 
 // Render a frame
@@ -364,6 +503,11 @@ void Tutorial08_Tessellation::Render()
 
         Consts->TessDensity          = m_TessDensity;
         Consts->AdaptiveTessellation = m_AdaptiveTessellation ? 1 : 0;
+        Consts->PatchCulling         = m_PatchCulling ? 1 : 0;
+        Consts->TriangleSize         = m_TriangleSize;
+
+        Consts->CameraPos   = m_CameraPos;
+        Consts->ScreenScale = m_ScreenScale;
 
         const auto& SCDesc   = m_pSwapChain->GetDesc();
         Consts->ViewportSize = float4(static_cast<float>(SCDesc.Width), static_cast<float>(SCDesc.Height), 1.f / static_cast<float>(SCDesc.Width), 1.f / static_cast<float>(SCDesc.Height));
@@ -381,7 +525,16 @@ void Tutorial08_Tessellation::Render()
     DrawAttribs DrawAttrs;
     DrawAttrs.NumVertices = NumHorzBlocks * NumVertBlocks;
     DrawAttrs.Flags       = DRAW_FLAG_VERIFY_ALL;
+
+    // Clipping invocations count the triangles generated by the tessellator that
+    // reach the rasterizer, so the query reports the tessellated triangle count.
+    if (m_pPipelineStatsQuery)
+        m_pPipelineStatsQuery->Begin(m_pImmediateContext);
+
     m_pImmediateContext->Draw(DrawAttrs);
+
+    if (m_pPipelineStatsQuery)
+        m_pPipelineStatsQuery->End(m_pImmediateContext, &m_PipelineStatsData, sizeof(m_PipelineStatsData));
 }
 
 void Tutorial08_Tessellation::Update(double CurrTime, double ElapsedTime)
@@ -411,6 +564,14 @@ void Tutorial08_Tessellation::Update(double CurrTime, double ElapsedTime)
 
     // Compute world-view-projection matrix
     m_WorldViewProjMatrix = m_WorldViewMatrix * Proj;
+
+    // Camera is at the origin of the view space, so its terrain-space position is
+    // the translation part of the inverse world-view matrix
+    const auto InvWorldView = m_WorldViewMatrix.Inverse();
+    m_CameraPos             = float3{InvWorldView._41, InvWorldView._42, InvWorldView._43};
+
+    // Size in pixels of the unit-length segment at the unit distance from the camera
+    m_ScreenScale = 0.5f * static_cast<float>(m_pSwapChain->GetDesc().Height) * Proj._22;
 }
 
 } // namespace Diligent
@@ -27,8 +27,11 @@
 
 #pragma once
 
+#include <memory>
+
 #include "SampleBase.hpp"
 #include "BasicMath.hpp"
+#include "ScopedQueryHelper.hpp"
 
 namespace Diligent
 {
@@ -54,9 +57,15 @@ private:
     RefCntAutoPtr<IBuffer>                m_ShaderConstants;
     RefCntAutoPtr<ITextureView>           m_HeightMapSRV;
     RefCntAutoPtr<ITextureView>           m_ColorMapSRV;
+    RefCntAutoPtr<ITextureView>           m_BlockBoundsSRV;
+
+    std::unique_ptr<ScopedQueryHelper> m_pPipelineStatsQuery;
+    QueryDataPipelineStatistics        m_PipelineStatsData;
 
     float4x4 m_WorldViewProjMatrix;
     float4x4 m_WorldViewMatrix;
+    float3   m_CameraPos;
+    float    m_ScreenScale = 1;
 
     bool  m_Animate              = true;
     bool  m_Wireframe            = false;
@@ -64,6 +73,8 @@ private:
     float m_TessDensity          = 32;
     float m_Distance             = 10.f;
     bool  m_AdaptiveTessellation = true;
+    bool  m_PatchCulling         = true;
+    float m_TriangleSize         = 8;
     int   m_BlockSize            = 32;
 
     unsigned int m_HeightMapWidth  = 0;
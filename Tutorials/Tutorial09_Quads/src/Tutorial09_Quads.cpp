@@ -31,6 +31,7 @@
 #include <algorithm>
 #include <limits>
 #include <cstdlib>
+#include <deque>
 
 #include "Tutorial09_Quads.hpp"
 #include "MapHelper.hpp"
@@ -44,6 +45,148 @@
 namespace Diligent
 {
 
+// Ring buffer that holds instance data of several frames. When the device supports CPU-writable
+// unified memory, the buffer is mapped once and stays mapped for its entire lifetime. Every frame
+// reserves a region of the ring that the contexts sub-allocate from with an atomic offset. The region
+// is reused once the fence signaled after the frame has been reached by the GPU.
+// Without unified memory, the ring falls back to a dynamic buffer that holds one frame and that every
+// context maps once per frame.
+class InstanceRingBuffer
+{
+public:
+    InstanceRingBuffer(IRenderDevice* pDevice, IDeviceContext* pImmediateCtx, Uint32 FrameSize, Uint32 NumFrames, size_t NumContexts) :
+        m_FrameSize{FrameSize}
+    {
+        m_IsPersistent = (pDevice->GetAdapterInfo().Memory.UnifiedMemoryCPUAccess & CPU_ACCESS_WRITE) != 0;
+
+        BufferDesc BuffDesc;
+        BuffDesc.Name           = "Instance ring buffer";
+        BuffDesc.Usage          = m_IsPersistent ? USAGE_UNIFIED : USAGE_DYNAMIC;
+        BuffDesc.BindFlags      = BIND_VERTEX_BUFFER;
+        BuffDesc.CPUAccessFlags = CPU_ACCESS_WRITE;
+        BuffDesc.Size           = m_IsPersistent ? Uint64{FrameSize} * NumFrames : FrameSize;
+        pDevice->CreateBuffer(BuffDesc, nullptr, &m_pBuffer);
+
+        StateTransitionDesc Barrier{m_pBuffer, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_VERTEX_BUFFER, STATE_TRANSITION_FLAG_UPDATE_STATE};
+        pImmediateCtx->TransitionResourceStates(1, &Barrier);
+
+        if (m_IsPersistent)
+        {
+            // The application synchronizes access to the ring with the fence
+            m_PersistentData.Map(pImmediateCtx, m_pBuffer, MAP_WRITE, MAP_FLAG_NO_OVERWRITE);
+
+            FenceDesc FDesc;
+            FDesc.Name = "Instance ring fence";
+            pDevice->CreateFence(FDesc, &m_pFence);
+        }
+        else
+        {
+            m_MappedData.resize(NumContexts);
+        }
+    }
+
+    // Reserves the region for the new frame. Must be called by the main thread before any context allocates.
+    void BeginFrame()
+    {
+        if (!m_IsPersistent)
+        {
+            m_FrameOffset.store(0);
+            return;
+        }
+
+        if (m_Head + m_FrameSize > m_pBuffer->GetDesc().Size)
+        {
+            m_Head = 0;
+            ++m_NumWraps;
+        }
+
+        // Wait until the GPU is done with all frames whose data overlap the new region
+        Uint64 WaitValue = 0;
+        for (const auto& Frame : m_FramesInFlight)
+        {
+            if (Frame.Start < m_Head + m_FrameSize && m_Head < Frame.End)
+                WaitValue = std::max(WaitValue, Frame.FenceValue);
+        }
+        if (WaitValue > m_pFence->GetCompletedValue())
+        {
+            m_pFence->Wait(WaitValue);
+            ++m_NumStalls;
+        }
+
+        const auto CompletedValue = m_pFence->GetCompletedValue();
+        while (!m_FramesInFlight.empty() && m_FramesInFlight.front().FenceValue <= CompletedValue)
+            m_FramesInFlight.pop_front();
+
+        m_FrameOffset.store(m_Head);
+    }
+
+    // Allocates Size bytes in the current frame region and returns the CPU address of the allocation.
+    // Offset receives the offset of the allocation in the buffer. Thread-safe.
+    Uint8* Allocate(IDeviceContext* pCtx, size_t CtxNum, Uint32 Size, Uint64& Offset)
+    {
+        Offset = m_FrameOffset.fetch_add(Size);
+        VERIFY(Offset + Size <= (m_IsPersistent ? m_Head : 0) + m_FrameSize, "Frame region of the instance ring is exceeded");
+
+        if (m_IsPersistent)
+            return static_cast<Uint8*>(m_PersistentData) + Offset;
+
+        // Every context gets its own copy of the dynamic buffer contents, so each one
+        // only writes its own allocation
+        auto& MappedData = m_MappedData[CtxNum];
+        MappedData.Map(pCtx, m_pBuffer, MAP_WRITE, MAP_FLAG_DISCARD);
+        return static_cast<Uint8*>(MappedData) + Offset;
+    }
+
+    // Must be called by the context after it has written all its allocations
+    void Release(size_t CtxNum)
+    {
+        if (!m_IsPersistent)
+            m_MappedData[CtxNum].Unmap();
+    }
+
+    // Must be called by the main thread after the command lists of all contexts have been submitted
+    void EndFrame(IDeviceContext* pImmediateCtx)
+    {
+        if (!m_IsPersistent)
+            return;
+
+        const auto FrameEnd = m_FrameOffset.load();
+        pImmediateCtx->EnqueueSignal(m_pFence, ++m_FenceValue);
+        m_FramesInFlight.push_back({m_FenceValue, m_Head, FrameEnd});
+        m_Head = FrameEnd;
+    }
+
+    IBuffer* GetBuffer() { return m_pBuffer; }
+    bool     IsPersistent() const { return m_IsPersistent; }
+    Uint32   GetNumWraps() const { return m_NumWraps; }
+    Uint32   GetNumStalls() const { return m_NumStalls; }
+
+private:
+    RefCntAutoPtr<IBuffer> m_pBuffer;
+    RefCntAutoPtr<IFence>  m_pFence;
+
+    const Uint32 m_FrameSize;
+    bool         m_IsPersistent = false;
+
+    MapHelper<Uint8>              m_PersistentData;
+    std::vector<MapHelper<Uint8>> m_MappedData;
+
+    std::atomic<Uint64> m_FrameOffset{0};
+    Uint64              m_Head       = 0;
+    Uint64              m_FenceValue = 0;
+
+    struct FrameRegion
+    {
+        Uint64 FenceValue;
+        Uint64 Start;
+        Uint64 End;
+    };
+    std::deque<FrameRegion> m_FramesInFlight;
+
+    Uint32 m_NumWraps  = 0;
+    Uint32 m_NumStalls = 0;
+};
+
 SampleBase* CreateSample()
 {
     return new Tutorial09_Quads();
@@ -69,6 +212,7 @@ Tutorial09_Quads::CommandLineStatus Tutorial09_Quads::ProcessCommandLine(int arg
     {
         m_NumWorkerThreads = clamp(m_NumWorkerThreads, 0, 128);
     }
+    ArgsParser.Parse("instance_ring", m_UseInstanceRing);
 
     return CommandLineStatus::OK;
 }
@@ -347,6 +491,8 @@ void Tutorial09_Quads::UpdateUI()
         {
             m_NumQuads = clamp(m_NumQuads, 1, MaxQuads);
             InitializeQuads();
+            if (m_UseInstanceRing)
+                CreateInstanceRing();
         }
         if (ImGui::InputInt("Batch Size", &m_BatchSize, 1, 5))
         {
@@ -361,6 +507,24 @@ void Tutorial09_Quads::UpdateUI()
                 StartWorkerThreads(m_NumWorkerThreads);
             }
         }
+        {
+            ImGui::ScopedDisabler Disable(m_BatchSize == 1);
+            if (ImGui::Checkbox("Instance ring", &m_UseInstanceRing))
+            {
+                if (m_UseInstanceRing)
+                    CreateInstanceRing();
+                else
+                    m_InstanceRing.reset();
+            }
+        }
+        if (m_InstanceRing && m_BatchSize > 1)
+        {
+            ImGui::TextDisabled(m_InstanceRing->IsPersistent() ? "Persistently mapped unified memory" : "Dynamic buffer mapped once per context");
+            ImGui::Text("Ring wraps: %u, stalls: %u", m_InstanceRing->GetNumWraps(), m_InstanceRing->GetNumStalls());
+        }
+        ImGui::Text("Map calls per frame: %d", m_MapsPerFrame);
+        if (m_BatchSize > 1)
+            ImGui::Text("Instance data: %.2f MB per frame", static_cast<double>(m_NumQuads * sizeof(InstanceData)) / (1 << 20));
     }
     ImGui::End();
 }
@@ -382,6 +546,8 @@ void Tutorial09_Quads::Initialize(const SampleInitInfo& InitInfo)
 
     if (m_BatchSize > 1)
         CreateInstanceBuffer();
+    if (m_UseInstanceRing)
+        CreateInstanceRing();
 
     StartWorkerThreads(m_NumWorkerThreads);
 }
@@ -527,7 +693,8 @@ void Tutorial09_Quads::RenderSubset(IDeviceContext* pCtx, Uint32 Subset)
     auto* pRTV = m_pSwapChain->GetCurrentBackBufferRTV();
     pCtx->SetRenderTargets(1, &pRTV, m_pSwapChain->GetDepthBufferDSV(), RESOURCE_STATE_TRANSITION_MODE_VERIFY);
 
-    if (UseBatch)
+    const bool UseRing = UseBatch && m_InstanceRing;
+    if (UseBatch && !UseRing)
     {
         IBuffer* pBuffs[] = {m_BatchDataBuffer};
         pCtx->SetVertexBuffers(0, _countof(pBuffs), pBuffs, nullptr, RESOURCE_STATE_TRANSITION_MODE_VERIFY, SET_VERTEX_BUFFERS_FLAG_RESET);
@@ -542,6 +709,24 @@ void Tutorial09_Quads::RenderSubset(IDeviceContext* pCtx, Uint32 Subset)
     const Uint32 SusbsetSize  = TotalBatches / NumSubsets;
     const Uint32 StartBatch   = SusbsetSize * Subset;
     const Uint32 EndBatch     = (Subset < NumSubsets - 1) ? SusbsetSize * (Subset + 1) : TotalBatches;
+
+    int NumMaps = 0;
+
+    // In ring mode, instance data of the entire subset is allocated at once, and every batch
+    // binds the ring buffer at the offset of its instances
+    const Uint32  SubsetStartInst = StartBatch * m_BatchSize;
+    InstanceData* pRingData       = nullptr;
+    Uint64        RingOffset      = 0;
+    if (UseRing && EndBatch > StartBatch)
+    {
+        const Uint32 SubsetEndInst = std::min(EndBatch * m_BatchSize, TotalQuads);
+        const Uint32 SubsetSize    = static_cast<Uint32>((SubsetEndInst - SubsetStartInst) * sizeof(InstanceData));
+
+        pRingData = reinterpret_cast<InstanceData*>(m_InstanceRing->Allocate(pCtx, Subset, SubsetSize, RingOffset));
+        if (!m_InstanceRing->IsPersistent())
+            ++NumMaps;
+    }
+
     for (Uint32 batch = StartBatch; batch < EndBatch; ++batch)
     {
         const Uint32 StartInst = batch * m_BatchSize;
@@ -552,10 +737,23 @@ void Tutorial09_Quads::RenderSubset(IDeviceContext* pCtx, Uint32 Subset)
         pCtx->SetPipelineState(m_pPSO[UseBatch ? 1 : 0][StateInd]);
 
         MapHelper<InstanceData> BatchData;
+        InstanceData*           pBatchData = nullptr;
         if (UseBatch)
         {
             pCtx->CommitShaderResources(m_BatchSRB, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
-            BatchData.Map(pCtx, m_BatchDataBuffer, MAP_WRITE, MAP_FLAG_DISCARD);
+            if (UseRing)
+            {
+                IBuffer* pBuffs[]  = {m_InstanceRing->GetBuffer()};
+                Uint64   Offsets[] = {RingOffset + (StartInst - SubsetStartInst) * sizeof(InstanceData)};
+                pCtx->SetVertexBuffers(0, _countof(pBuffs), pBuffs, Offsets, RESOURCE_STATE_TRANSITION_MODE_VERIFY, SET_VERTEX_BUFFERS_FLAG_RESET);
+                pBatchData = pRingData + (StartInst - SubsetStartInst);
+            }
+            else
+            {
+                BatchData.Map(pCtx, m_BatchDataBuffer, MAP_WRITE, MAP_FLAG_DISCARD);
+                pBatchData = BatchData;
+                ++NumMaps;
+            }
         }
 
         for (Uint32 inst = StartInst; inst < EndInst; ++inst)
@@ -587,7 +785,7 @@ void Tutorial09_Quads::RenderSubset(IDeviceContext* pCtx, Uint32 Subset)
 
                 if (UseBatch)
                 {
-                    auto& CurrQuad                = BatchData[inst - StartInst];
+                    auto& CurrQuad                = pBatchData[inst - StartInst];
                     CurrQuad.QuadRotationAndScale = QuadRotationAndScale;
                     CurrQuad.QuadCenter           = CurrInstData.Pos;
                     CurrQuad.TexArrInd            = static_cast<float>(CurrInstData.TextureInd);
@@ -602,6 +800,7 @@ void Tutorial09_Quads::RenderSubset(IDeviceContext* pCtx, Uint32 Subset)
 
                     // Map the buffer and write current world-view-projection matrix
                     MapHelper<QuadAttribs> InstData(pCtx, m_QuadAttribsCB, MAP_WRITE, MAP_FLAG_DISCARD);
+                    ++NumMaps;
 
                     InstData->g_QuadRotationAndScale = QuadRotationAndScale;
                     InstData->g_QuadCenter.x         = CurrInstData.Pos.x;
@@ -616,6 +815,11 @@ void Tutorial09_Quads::RenderSubset(IDeviceContext* pCtx, Uint32 Subset)
         DrawAttrs.NumInstances = EndInst - StartInst;
         pCtx->Draw(DrawAttrs);
     }
+
+    if (pRingData != nullptr)
+        m_InstanceRing->Release(Subset);
+
+    m_NumMaps.fetch_add(NumMaps);
 }
 
 // Render a frame
@@ -633,6 +837,10 @@ void Tutorial09_Quads::Render()
     m_pImmediateContext->ClearRenderTarget(pRTV, ClearColor.Data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
     m_pImmediateContext->ClearDepthStencil(pDSV, CLEAR_DEPTH_FLAG, 1.f, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
 
+    const bool UseRing = m_BatchSize > 1 && m_InstanceRing;
+    if (UseRing)
+        m_InstanceRing->BeginFrame();
+
     if (!m_WorkerThreads.empty())
     {
         m_NumThreadsCompleted.store(0);
@@ -665,6 +873,11 @@ void Tutorial09_Quads::Render()
         m_NumThreadsReady.store(0);
         m_GotoNextFrameSignal.Trigger(true);
     }
+
+    if (UseRing)
+        m_InstanceRing->EndFrame(m_pImmediateContext);
+
+    m_MapsPerFrame = m_NumMaps.exchange(0);
 }
 
 void Tutorial09_Quads::CreateInstanceBuffer()
@@ -683,6 +896,13 @@ void Tutorial09_Quads::CreateInstanceBuffer()
     m_pImmediateContext->TransitionResourceStates(1, &Barrier);
 }
 
+void Tutorial09_Quads::CreateInstanceRing()
+{
+    // The ring holds instance data of all quads for every frame regardless of the batch size
+    const auto FrameSize = static_cast<Uint32>(sizeof(InstanceData) * m_NumQuads);
+    m_InstanceRing.reset(new InstanceRingBuffer{m_pDevice, m_pImmediateContext, FrameSize, NumRingFrames, 1 + m_pDeferredContexts.size()});
+}
+
 void Tutorial09_Quads::Update(double CurrTime, double ElapsedTime)
 {
     SampleBase::Update(CurrTime, ElapsedTime);
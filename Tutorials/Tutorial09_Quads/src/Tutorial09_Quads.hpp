@@ -28,6 +28,7 @@
 #pragma once
 
 #include <atomic>
+#include <memory>
 #include <vector>
 #include <thread>
 #include <mutex>
@@ -61,6 +62,7 @@ private:
 
     void InitializeQuads();
     void CreateInstanceBuffer();
+    void CreateInstanceRing();
     void UpdateQuads(float elapsedTime);
     void StartWorkerThreads(size_t NumThreads);
     void StopWorkerThreads();
@@ -85,6 +87,16 @@ private:
     RefCntAutoPtr<IBuffer>        m_QuadAttribsCB;
     RefCntAutoPtr<IBuffer>        m_BatchDataBuffer;
 
+    // Number of frames whose instance data the ring can hold
+    static constexpr Uint32                   NumRingFrames = 3;
+    std::unique_ptr<class InstanceRingBuffer> m_InstanceRing;
+
+    bool m_UseInstanceRing = false;
+
+    // Number of Map() calls issued by all contexts in the current and the last frame
+    std::atomic_int m_NumMaps{0};
+    int             m_MapsPerFrame = 0;
+
     static constexpr int                  NumTextures = 4;
     RefCntAutoPtr<IShaderResourceBinding> m_SRB[NumTextures];
     RefCntAutoPtr<IShaderResourceBinding> m_BatchSRB;
@@ -0,0 +1,204 @@
+/*
+ *  Copyright 2019-2022 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+
+#include "PolygonSimulation.hpp"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define POLYGON_SIMULATION_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#    include <arm_neon.h>
+#    define POLYGON_SIMULATION_NEON 1
+#endif
+
+namespace Diligent
+{
+
+void PolygonSimulationData::Resize(Uint32 Count)
+{
+    NumPolygons = Count;
+    PosX.assign(Count, 0.f);
+    PosY.assign(Count, 0.f);
+    MoveDirX.assign(Count, 0.f);
+    MoveDirY.assign(Count, 0.f);
+    Angle.assign(Count, 0.f);
+    RotSpeed.assign(Count, 0.f);
+}
+
+namespace
+{
+
+constexpr float WallPos = 0.95f;
+
+// PCG hash, see https://www.reedbeta.com/blog/hash-functions-for-gpu-rendering/
+Uint32 PCGHash(Uint32 Value)
+{
+    const Uint32 State = Value * 747796405u + 2891336453u;
+    const Uint32 Word  = ((State >> ((State >> 28u) + 4u)) ^ State) * 277803737u;
+    return (Word >> 22u) ^ Word;
+}
+
+// Random rotation speed in [-pi/2, pi/2]
+float GetRandomRotSpeed(Uint32 Seed, Uint32 Polygon)
+{
+    const Uint32 Rand = PCGHash(PCGHash(Seed) + Polygon);
+    return (static_cast<float>(Rand >> 8u) / static_cast<float>(1u << 24u) * 2.f - 1.f) * PI_F * 0.5f;
+}
+
+void UpdatePolygon(PolygonSimulationData& Data, float ElapsedTime, Uint32 Seed, Uint32 Polygon)
+{
+    Data.Angle[Polygon] += Data.RotSpeed[Polygon] * ElapsedTime;
+
+    bool Bounced = false;
+    if (std::abs(Data.PosX[Polygon] + Data.MoveDirX[Polygon] * ElapsedTime) > WallPos)
+    {
+        Data.MoveDirX[Polygon] *= -1.f;
+        Bounced = true;
+    }
+    Data.PosX[Polygon] += Data.MoveDirX[Polygon] * ElapsedTime;
+    if (std::abs(Data.PosY[Polygon] + Data.MoveDirY[Polygon] * ElapsedTime) > WallPos)
+    {
+        Data.MoveDirY[Polygon] *= -1.f;
+        Bounced = true;
+    }
+    Data.PosY[Polygon] += Data.MoveDirY[Polygon] * ElapsedTime;
+
+    if (Bounced)
+        Data.RotSpeed[Polygon] = GetRandomRotSpeed(Seed, Polygon);
+}
+
+#if POLYGON_SIMULATION_SSE2
+
+using Vec4  = __m128;
+using Mask4 = __m128;
+
+inline Vec4 Set1(float f) { return _mm_set1_ps(f); }
+inline Vec4 Load(const float* p) { return _mm_loadu_ps(p); }
+inline void Store(float* p, Vec4 v) { _mm_storeu_ps(p, v); }
+inline Vec4 Add(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+inline Vec4 Mul(Vec4 a, Vec4 b) { return _mm_mul_ps(a, b); }
+
+// Lanes where |v| > Limit
+inline Mask4 AbsGreater(Vec4 v, Vec4 Limit)
+{
+    return _mm_cmpgt_ps(_mm_andnot_ps(_mm_set1_ps(-0.f), v), Limit);
+}
+
+// Negates the lanes selected by the mask
+inline Vec4 NegateMasked(Vec4 v, Mask4 m)
+{
+    return _mm_xor_ps(v, _mm_and_ps(m, _mm_set1_ps(-0.f)));
+}
+
+inline Mask4 Or(Mask4 a, Mask4 b) { return _mm_or_ps(a, b); }
+inline int   GetMaskBits(Mask4 m) { return _mm_movemask_ps(m); }
+
+#elif POLYGON_SIMULATION_NEON
+
+using Vec4  = float32x4_t;
+using Mask4 = uint32x4_t;
+
+inline Vec4 Set1(float f) { return vdupq_n_f32(f); }
+inline Vec4 Load(const float* p) { return vld1q_f32(p); }
+inline void Store(float* p, Vec4 v) { vst1q_f32(p, v); }
+inline Vec4 Add(Vec4 a, Vec4 b) { return vaddq_f32(a, b); }
+inline Vec4 Mul(Vec4 a, Vec4 b) { return vmulq_f32(a, b); }
+
+inline Mask4 AbsGreater(Vec4 v, Vec4 Limit)
+{
+    return vcgtq_f32(vabsq_f32(v), Limit);
+}
+
+inline Vec4 NegateMasked(Vec4 v, Mask4 m)
+{
+    return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(v), vandq_u32(m, vdupq_n_u32(0x80000000u))));
+}
+
+inline Mask4 Or(Mask4 a, Mask4 b) { return vorrq_u32(a, b); }
+
+inline int GetMaskBits(Mask4 m)
+{
+    uint32_t Lanes[4];
+    vst1q_u32(Lanes, m);
+    return static_cast<int>((Lanes[0] & 1u) | (Lanes[1] & 2u) | (Lanes[2] & 4u) | (Lanes[3] & 8u));
+}
+
+#endif
+
+#if POLYGON_SIMULATION_SSE2 || POLYGON_SIMULATION_NEON
+
+// Moves four polygons along one axis and returns the mask of polygons that hit the wall
+inline Mask4 MoveAndReflect(float* pPos, float* pDir, Vec4 vElapsedTime)
+{
+    const Vec4  Pos    = Load(pPos);
+    const Vec4  Dir    = Load(pDir);
+    const Mask4 Hit    = AbsGreater(Add(Pos, Mul(Dir, vElapsedTime)), Set1(WallPos));
+    const Vec4  NewDir = NegateMasked(Dir, Hit);
+    Store(pDir, NewDir);
+    Store(pPos, Add(Pos, Mul(NewDir, vElapsedTime)));
+    return Hit;
+}
+
+#endif
+
+} // namespace
+
+void UpdatePolygonRange(PolygonSimulationData& Data, float ElapsedTime, Uint32 Seed, Uint32 Start, Uint32 End)
+{
+    VERIFY_EXPR(Start <= End && End <= Data.NumPolygons);
+
+    Uint32 Polygon = Start;
+
+#if POLYGON_SIMULATION_SSE2 || POLYGON_SIMULATION_NEON
+    const Vec4 vElapsedTime = Set1(ElapsedTime);
+    for (; Polygon + 4 <= End; Polygon += 4)
+    {
+        Store(&Data.Angle[Polygon], Add(Load(&Data.Angle[Polygon]), Mul(Load(&Data.RotSpeed[Polygon]), vElapsedTime)));
+
+        const Mask4 HitX = MoveAndReflect(&Data.PosX[Polygon], &Data.MoveDirX[Polygon], vElapsedTime);
+        const Mask4 HitY = MoveAndReflect(&Data.PosY[Polygon], &Data.MoveDirY[Polygon], vElapsedTime);
+
+        // Bounces are rare, so new rotation speeds are generated by the scalar code
+        const int HitBits = GetMaskBits(Or(HitX, HitY));
+        if (HitBits != 0)
+        {
+            for (Uint32 i = 0; i < 4; ++i)
+            {
+                if (HitBits & (1 << i))
+                    Data.RotSpeed[Polygon + i] = GetRandomRotSpeed(Seed, Polygon + i);
+            }
+        }
+    }
+#endif
+
+    for (; Polygon < End; ++Polygon)
+        UpdatePolygon(Data, ElapsedTime, Seed, Polygon);
+}
+
+} // namespace Diligent
@@ -0,0 +1,58 @@
+/*
+ *  Copyright 2019-2022 Diligent Graphics LLC
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ *
+ *  In no event and under no legal theory, whether in tort (including negligence),
+ *  contract, or otherwise, unless required by applicable law (such as deliberate
+ *  and grossly negligent acts) or agreed to in writing, shall any Contributor be
+ *  liable for any damages, including any direct, indirect, special, incidental,
+ *  or consequential damages of any character arising as a result of this License or
+ *  out of the use or inability to use the software (including but not limited to damages
+ *  for loss of goodwill, work stoppage, computer failure or malfunction, or any and
+ *  all other commercial damages or losses), even if such Contributor has been advised
+ *  of the possibility of such damages.
+ */
+
+
+#pragma once
+
+#include <vector>
+
+#include "BasicMath.hpp"
+
+namespace Diligent
+{
+
+// Simulation state of all polygons in structure-of-arrays layout, so that several
+// polygons can be moved at once with SIMD instructions.
+struct PolygonSimulationData
+{
+    std::vector<float> PosX;
+    std::vector<float> PosY;
+    std::vector<float> MoveDirX;
+    std::vector<float> MoveDirY;
+    std::vector<float> Angle;
+    std::vector<float> RotSpeed;
+
+    Uint32 NumPolygons = 0;
+
+    void Resize(Uint32 Count);
+};
+
+// Moves polygons [Start, End) by ElapsedTime and reflects them from the walls of the [-0.95, 0.95] square.
+// A polygon that hits a wall gets a new rotation speed that is randomly generated from Seed and its index.
+// Only polygons in [Start, End) are written, so disjoint ranges can be updated by different threads.
+void UpdatePolygonRange(PolygonSimulationData& Data, float ElapsedTime, Uint32 Seed, Uint32 Start, Uint32 End);
+
+} // namespace Diligent
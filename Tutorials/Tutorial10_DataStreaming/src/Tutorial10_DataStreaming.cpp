@@ -31,12 +31,16 @@
 #include <algorithm>
 #include <limits>
 #include <cstdlib>
+#include <chrono>
+#include <deque>
+#include <fstream>
 
 #include "Tutorial10_DataStreaming.hpp"
 #include "MapHelper.hpp"
 #include "GraphicsUtilities.h"
 #include "TextureUtilities.h"
 #include "ColorConversion.h"
+#include "GraphicsAccessories.hpp"
 #include "imgui.h"
 #include "ImGuiUtils.hpp"
 #include "CommandLineParser.hpp"
@@ -44,6 +48,25 @@
 namespace Diligent
 {
 
+// Adds the lifetime of the object to the counter. Used to measure the time spent in Map and Unmap.
+class ScopedMapTimer
+{
+public:
+    explicit ScopedMapTimer(double& TimeMs) :
+        m_TimeMs{TimeMs},
+        m_StartTime{std::chrono::high_resolution_clock::now()}
+    {}
+
+    ~ScopedMapTimer()
+    {
+        m_TimeMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - m_StartTime).count();
+    }
+
+private:
+    double&                                              m_TimeMs;
+    const std::chrono::high_resolution_clock::time_point m_StartTime;
+};
+
 class StreamingBuffer
 {
 public:
@@ -69,13 +92,21 @@ public:
         {
             // Unmap the buffer
             Flush(CtxNum);
+            ++MapInfo.m_NumWraps;
         }
 
         if (MapInfo.m_MappedData == nullptr)
         {
             // If current offset is zero, we are mapping the buffer for the first time after it has been flushed. Use MAP_FLAG_DISCARD flag.
             // Otherwise use MAP_FLAG_NO_OVERWRITE flag.
-            MapInfo.m_MappedData.Map(pCtx, m_pBuffer, MAP_WRITE, MapInfo.m_CurrOffset == 0 ? MAP_FLAG_DISCARD : MAP_FLAG_NO_OVERWRITE);
+            const auto MapFlags = MapInfo.m_CurrOffset == 0 ? MAP_FLAG_DISCARD : MAP_FLAG_NO_OVERWRITE;
+            {
+                ScopedMapTimer Timer{MapInfo.m_Stats.MapTimeMs};
+                MapInfo.m_MappedData.Map(pCtx, m_pBuffer, MAP_WRITE, MapFlags);
+            }
+            MapInfo.m_Stats.NumMaps += 1;
+            if (MapFlags == MAP_FLAG_DISCARD)
+                MapInfo.m_Stats.NumDiscards += 1;
         }
 
         auto Offset = MapInfo.m_CurrOffset;
@@ -88,13 +119,17 @@ public:
     {
         if (!m_AllowPersistentMap)
         {
+            ScopedMapTimer Timer{m_MapInfo[CtxNum].m_Stats.MapTimeMs};
             m_MapInfo[CtxNum].m_MappedData.Unmap();
         }
     }
 
     void Flush(size_t CtxNum)
     {
-        m_MapInfo[CtxNum].m_MappedData.Unmap();
+        {
+            ScopedMapTimer Timer{m_MapInfo[CtxNum].m_Stats.MapTimeMs};
+            m_MapInfo[CtxNum].m_MappedData.Unmap();
+        }
         m_MapInfo[CtxNum].m_CurrOffset = 0;
     }
 
@@ -109,6 +144,22 @@ public:
         m_AllowPersistentMap = AllowMapping;
     }
 
+    // Adds the map statistics of the context since the last call to Stats
+    void CollectMapStats(size_t CtxNum, StreamingStats& Stats)
+    {
+        Stats += m_MapInfo[CtxNum].m_Stats;
+        m_MapInfo[CtxNum].m_Stats = {};
+    }
+
+    // Must not be called while the contexts are allocating
+    Uint32 GetNumWraps() const
+    {
+        Uint32 NumWraps = 0;
+        for (const auto& MapInfo : m_MapInfo)
+            NumWraps += MapInfo.m_NumWraps;
+        return NumWraps;
+    }
+
 private:
     RefCntAutoPtr<IBuffer> m_pBuffer;
     const Uint32           m_BufferSize;
@@ -119,11 +170,231 @@ private:
     {
         MapHelper<Uint8> m_MappedData;
         Uint32           m_CurrOffset = 0;
+        Uint32           m_NumWraps   = 0;
+        StreamingStats   m_Stats;
     };
     // We need to keep track of mapped data for every context
     std::vector<MapInfo> m_MapInfo;
 };
 
+// Ring buffer in unified memory shared by all contexts. Any thread sub-allocates from the ring with
+// a lock-free compare-and-swap on the head. The space used by a frame is released when the GPU
+// signals the fence enqueued at the end of the frame. If the ring is full, the allocating thread
+// waits for the oldest frame in flight. The ring only grows at the beginning of the frame, so that
+// buffers are created and mapped by the immediate context and never by a worker thread.
+class SharedStreamingRing
+{
+public:
+    struct Allocation
+    {
+        IBuffer* pBuffer     = nullptr;
+        Uint64   Offset      = 0;
+        Uint8*   pCPUAddress = nullptr;
+    };
+
+    SharedStreamingRing(IRenderDevice* pDevice, IDeviceContext* pImmediateCtx, BIND_FLAGS BindFlags, RESOURCE_STATE State, Uint64 Size, const Char* Name) :
+        m_pDevice{pDevice},
+        m_BindFlags{BindFlags},
+        m_State{State},
+        m_Name{Name}
+    {
+        FenceDesc FDesc;
+        FDesc.Name = "Streaming ring fence";
+        pDevice->CreateFence(FDesc, &m_pFence);
+
+        m_Rings.emplace_back(CreateRing(pImmediateCtx, Size));
+        m_pCurrRing = m_Rings.back().get();
+    }
+
+    // The ring is written by all contexts through a single persistent mapping, which requires
+    // CPU-writable unified memory
+    static bool IsSupported(IRenderDevice* pDevice)
+    {
+        return (pDevice->GetAdapterInfo().Memory.UnifiedMemoryCPUAccess & CPU_ACCESS_WRITE) != 0;
+    }
+
+    // Releases the space used by the completed frames and makes sure that FrameSize bytes
+    // can be allocated in the new frame. Must be called by the main thread before any context allocates.
+    void BeginFrame(IDeviceContext* pImmediateCtx, Uint64 FrameSize)
+    {
+        std::lock_guard<std::mutex> Lock{m_Mtx};
+
+        const auto CompletedValue = m_pFence->GetCompletedValue();
+        RetireFrames(*m_pCurrRing, CompletedValue);
+
+        // Release the rings that have been replaced by larger ones once the GPU is done with them.
+        // The last ring is the current one.
+        auto LastRetired = std::remove_if(m_Rings.begin(), m_Rings.end() - 1,
+                                          [CompletedValue](const std::unique_ptr<Ring>& pRing) {
+                                              return pRing->ReleaseFenceValue <= CompletedValue;
+                                          });
+        m_Rings.erase(LastRetired, m_Rings.end() - 1);
+
+        // Every allocation of the frame wastes less than its own size when it wraps, so twice the frame
+        // size always fits once the previous frames are retired. This also leaves room for one frame in flight.
+        if (m_pCurrRing->Capacity < FrameSize * 2)
+        {
+            auto NewCapacity = m_pCurrRing->Capacity * 2;
+            while (NewCapacity < FrameSize * 2)
+                NewCapacity *= 2;
+
+            // Allocations of the previous frames remain in the old buffer until the GPU is done with them
+            m_pCurrRing->ReleaseFenceValue = m_FenceValue;
+            m_Rings.emplace_back(CreateRing(pImmediateCtx, NewCapacity));
+            m_pCurrRing = m_Rings.back().get();
+            ++m_NumGrowths;
+        }
+    }
+
+    // Thread-safe. Returns empty allocation if the frame is larger than the size given to BeginFrame().
+    Allocation Allocate(Uint64 Size)
+    {
+        auto& R    = *m_pCurrRing;
+        auto  Head = R.Head.load();
+        for (;;)
+        {
+            const auto Padding = GetWrapPadding(R, Head, Size);
+            if (Head + Padding + Size - R.Tail.load() > R.Capacity)
+            {
+                if (!MakeSpace(R, Size))
+                    return {};
+                Head = R.Head.load();
+                continue;
+            }
+
+            // If another thread has moved the head, Head receives the new value and we try again
+            if (R.Head.compare_exchange_weak(Head, Head + Padding + Size))
+            {
+                if (Padding != 0)
+                    m_NumWraps.fetch_add(1);
+
+                const auto Offset = (Head + Padding) % R.Capacity;
+                return {R.pBuffer, Offset, static_cast<Uint8*>(R.MappedData) + Offset};
+            }
+        }
+    }
+
+    // Must be called by the main thread after the command lists of all contexts have been submitted
+    void EndFrame(IDeviceContext* pImmediateCtx)
+    {
+        std::lock_guard<std::mutex> Lock{m_Mtx};
+
+        pImmediateCtx->EnqueueSignal(m_pFence, ++m_FenceValue);
+        m_pCurrRing->FramesInFlight.push_back({m_FenceValue, m_pCurrRing->Head.load()});
+    }
+
+    Uint64 GetCapacity() const { return m_pCurrRing->Capacity; }
+    Uint32 GetNumWraps() const { return m_NumWraps.load(); }
+    Uint32 GetNumStalls() const { return m_NumStalls.load(); }
+    Uint32 GetNumGrowths() const { return m_NumGrowths; }
+
+private:
+    struct FrameInFlight
+    {
+        Uint64 FenceValue;
+        // Head of the ring at the end of the frame. Everything before it is free once the fence is signaled.
+        Uint64 Head;
+    };
+
+    struct Ring
+    {
+        RefCntAutoPtr<IBuffer> pBuffer;
+        MapHelper<Uint8>       MappedData;
+        Uint64                 Capacity = 0;
+
+        // Head and tail grow monotonically, the offset in the buffer is the value modulo the capacity
+        std::atomic<Uint64> Head{0};
+        std::atomic<Uint64> Tail{0};
+
+        std::deque<FrameInFlight> FramesInFlight;
+
+        // Fence value after which the ring can be released when it has been replaced by a larger one
+        Uint64 ReleaseFenceValue = 0;
+    };
+
+    std::unique_ptr<Ring> CreateRing(IDeviceContext* pImmediateCtx, Uint64 Capacity)
+    {
+        auto pRing      = std::make_unique<Ring>();
+        pRing->Capacity = Capacity;
+
+        BufferDesc BuffDesc;
+        BuffDesc.Name           = m_Name.c_str();
+        BuffDesc.Usage          = USAGE_UNIFIED;
+        BuffDesc.BindFlags      = m_BindFlags;
+        BuffDesc.CPUAccessFlags = CPU_ACCESS_WRITE;
+        BuffDesc.Size           = Capacity;
+        m_pDevice->CreateBuffer(BuffDesc, nullptr, &pRing->pBuffer);
+
+        StateTransitionDesc Barrier{pRing->pBuffer, RESOURCE_STATE_UNKNOWN, m_State, STATE_TRANSITION_FLAG_UPDATE_STATE};
+        pImmediateCtx->TransitionResourceStates(1, &Barrier);
+
+        // The buffer stays mapped until the ring is released; the application synchronizes access with the fence
+        pRing->MappedData.Map(pImmediateCtx, pRing->pBuffer, MAP_WRITE, MAP_FLAG_NO_OVERWRITE);
+
+        return pRing;
+    }
+
+    // Allocations never straddle the end of the buffer
+    static Uint64 GetWrapPadding(const Ring& R, Uint64 Head, Uint64 Size)
+    {
+        const auto Offset = Head % R.Capacity;
+        return Offset + Size > R.Capacity ? R.Capacity - Offset : 0;
+    }
+
+    void RetireFrames(Ring& R, Uint64 CompletedValue)
+    {
+        while (!R.FramesInFlight.empty() && R.FramesInFlight.front().FenceValue <= CompletedValue)
+        {
+            R.Tail.store(R.FramesInFlight.front().Head);
+            R.FramesInFlight.pop_front();
+        }
+    }
+
+    // Slow path of the allocation: waits for the GPU to release space.
+    // Returns false if the ring is too small even when all previous frames are retired.
+    bool MakeSpace(Ring& R, Uint64 Size)
+    {
+        std::lock_guard<std::mutex> Lock{m_Mtx};
+        for (;;)
+        {
+            RetireFrames(R, m_pFence->GetCompletedValue());
+
+            const auto Head = R.Head.load();
+            if (Head + GetWrapPadding(R, Head, Size) + Size - R.Tail.load() <= R.Capacity)
+                return true;
+
+            if (R.FramesInFlight.empty())
+            {
+                UNEXPECTED("The frame does not fit into the streaming ring. The frame size given to BeginFrame() is too small.");
+                return false;
+            }
+
+            // Wait for the oldest frame to release its part of the ring
+            m_pFence->Wait(R.FramesInFlight.front().FenceValue);
+            m_NumStalls.fetch_add(1);
+        }
+    }
+
+    RefCntAutoPtr<IRenderDevice> m_pDevice;
+    RefCntAutoPtr<IFence>        m_pFence;
+
+    const BIND_FLAGS     m_BindFlags;
+    const RESOURCE_STATE m_State;
+    const std::string    m_Name;
+
+    // Protects everything except the fast path of the allocation
+    std::mutex m_Mtx;
+
+    // The current ring only changes in BeginFrame(), while no context allocates
+    std::vector<std::unique_ptr<Ring>> m_Rings;
+    Ring*                              m_pCurrRing  = nullptr;
+    Uint64                             m_FenceValue = 0;
+
+    std::atomic<Uint32> m_NumWraps{0};
+    std::atomic<Uint32> m_NumStalls{0};
+    Uint32              m_NumGrowths = 0;
+};
+
 SampleBase* CreateSample()
 {
     return new Tutorial10_DataStreaming();
@@ -149,6 +420,13 @@ Tutorial10_DataStreaming::CommandLineStatus Tutorial10_DataStreaming::ProcessCom
     {
         m_NumWorkerThreads = clamp(m_NumWorkerThreads, 0, 128);
     }
+    ArgsParser.Parse("shared_ring", m_UseSharedRing);
+    ArgsParser.Parse("persistent_map", m_bAllowPersistentMap);
+    ArgsParser.Parse("report", m_ReportPath);
+    if (ArgsParser.Parse("report_frames", m_ReportFrames))
+    {
+        m_ReportFrames = std::max(m_ReportFrames, 1);
+    }
 
     return CommandLineStatus::OK;
 }
@@ -157,6 +435,8 @@ void Tutorial10_DataStreaming::ModifyEngineInitInfo(const ModifyEngineInitInfoAt
 {
     SampleBase::ModifyEngineInitInfo(Attribs);
     Attribs.EngineCI.NumDeferredContexts = std::max(std::thread::hardware_concurrency() - 1, 2u);
+
+    Attribs.EngineCI.Features.TimestampQueries = DEVICE_FEATURE_STATE_OPTIONAL;
 #if VULKAN_SUPPORTED
     if (Attribs.DeviceType == RENDER_DEVICE_TYPE_VULKAN)
     {
@@ -441,6 +721,7 @@ void Tutorial10_DataStreaming::UpdateUI()
         {
             m_BatchSize = clamp(m_BatchSize, 1, MaxBatchSize);
             CreateInstanceBuffer();
+            ComputeStreamingFrameSize();
         }
         {
             ImGui::ScopedDisabler Disable(m_MaxThreads == 0);
@@ -453,8 +734,39 @@ void Tutorial10_DataStreaming::UpdateUI()
         if (m_pDevice->GetDeviceInfo().Type == RENDER_DEVICE_TYPE_D3D12 ||
             m_pDevice->GetDeviceInfo().Type == RENDER_DEVICE_TYPE_VULKAN)
         {
+            ImGui::ScopedDisabler Disable(m_UseSharedRing);
             ImGui::Checkbox("Persistent map", &m_bAllowPersistentMap);
         }
+        {
+            ImGui::ScopedDisabler Disable(!m_SharedVB);
+            ImGui::Checkbox("Shared ring", &m_UseSharedRing);
+        }
+
+        ImGui::Text("Simulation: %.2f ms/step (%.2f ms CPU)", m_SimWallTimeMs, m_SimCPUTimeMs);
+        ImGui::Text("Simulation cost: %.1f ns/polygon", m_SimCPUTimeMs * 1e+6 / static_cast<double>(m_NumPolygons));
+
+        const auto& Stats = m_AvgStreamingStats;
+        ImGui::Text("Written: %.2f MB/frame", Stats.BytesWritten / double{1 << 20});
+        ImGui::Text("Map/Unmap: %.3f ms/frame", Stats.MapTimeMs);
+        ImGui::Text("Maps: %.0f, discards: %.0f per frame", Stats.NumMaps, Stats.NumDiscards);
+        if (m_AvgGPUTimeMs >= 0)
+            ImGui::Text("GPU draw time: %.2f ms", m_AvgGPUTimeMs);
+        else
+            ImGui::TextDisabled("GPU draw time: n/a");
+
+        if (m_UseSharedRing)
+        {
+            ImGui::Text("Ring size: %d KB VB, %d KB IB", static_cast<int>(m_SharedVB->GetCapacity() >> 10), static_cast<int>(m_SharedIB->GetCapacity() >> 10));
+            ImGui::Text("Wraps: %u, stalls: %u, growths: %u",
+                        m_SharedVB->GetNumWraps() + m_SharedIB->GetNumWraps(),
+                        m_SharedVB->GetNumStalls() + m_SharedIB->GetNumStalls(),
+                        m_SharedVB->GetNumGrowths() + m_SharedIB->GetNumGrowths());
+        }
+        else
+        {
+            // Stalls of the per-context buffers are hidden in the driver
+            ImGui::Text("Wraps: %u", m_StreamingVB->GetNumWraps() + m_StreamingIB->GetNumWraps());
+        }
     }
     ImGui::End();
 }
@@ -466,6 +778,25 @@ void Tutorial10_DataStreaming::Initialize(const SampleInitInfo& InitInfo)
 
     m_MaxThreads       = static_cast<int>(m_pDeferredContexts.size());
     m_NumWorkerThreads = std::min(m_NumWorkerThreads, m_MaxThreads);
+    m_SubsetSimTimeNs.resize(1 + m_pDeferredContexts.size());
+    m_SubsetStreamingStats.resize(1 + m_pDeferredContexts.size());
+
+    // Persistent mapping of dynamic buffers is only allowed in Direct3D12 and Vulkan
+    if (m_pDevice->GetDeviceInfo().Type != RENDER_DEVICE_TYPE_D3D12 &&
+        m_pDevice->GetDeviceInfo().Type != RENDER_DEVICE_TYPE_VULKAN)
+    {
+        m_bAllowPersistentMap = false;
+    }
+
+    if (m_pDevice->GetDeviceInfo().Features.TimestampQueries)
+    {
+        m_pDrawDuration = std::make_unique<DurationQueryHelper>(m_pDevice, 2);
+    }
+
+    if (!m_ReportPath.empty())
+    {
+        m_ReportRows.reserve(m_ReportFrames);
+    }
 
     std::vector<StateTransitionDesc> Barriers;
     CreatePipelineStates(Barriers);
@@ -478,6 +809,16 @@ void Tutorial10_DataStreaming::Initialize(const SampleInitInfo& InitInfo)
     Barriers.emplace_back(m_StreamingVB->GetBuffer(), RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_VERTEX_BUFFER, STATE_TRANSITION_FLAG_UPDATE_STATE);
     Barriers.emplace_back(m_StreamingIB->GetBuffer(), RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_INDEX_BUFFER, STATE_TRANSITION_FLAG_UPDATE_STATE);
 
+    if (SharedStreamingRing::IsSupported(m_pDevice))
+    {
+        m_SharedVB = std::make_unique<SharedStreamingRing>(m_pDevice, m_pImmediateContext, BIND_VERTEX_BUFFER, RESOURCE_STATE_VERTEX_BUFFER, InitialSharedRingSize, "Shared streaming vertex buffer");
+        m_SharedIB = std::make_unique<SharedStreamingRing>(m_pDevice, m_pImmediateContext, BIND_INDEX_BUFFER, RESOURCE_STATE_INDEX_BUFFER, InitialSharedRingSize, "Shared streaming index buffer");
+    }
+    else
+    {
+        m_UseSharedRing = false;
+    }
+
     InitializePolygonGeometry();
     InitializePolygons();
 
@@ -513,9 +854,23 @@ void Tutorial10_DataStreaming::InitializePolygonGeometry()
     }
 }
 
+void Tutorial10_DataStreaming::ComputeStreamingFrameSize()
+{
+    // Geometry of the first polygon of every batch is streamed once per frame
+    m_FrameVBSize = 0;
+    m_FrameIBSize = 0;
+    for (size_t StartInst = 0; StartInst < m_Polygons.size(); StartInst += m_BatchSize)
+    {
+        const auto& PolygonGeo = m_PolygonGeo[m_Polygons[StartInst].NumVerts];
+        m_FrameVBSize += PolygonGeo.Verts.size() * sizeof(float2);
+        m_FrameIBSize += PolygonGeo.Inds.size() * sizeof(Uint32);
+    }
+}
+
 void Tutorial10_DataStreaming::InitializePolygons()
 {
     m_Polygons.resize(m_NumPolygons);
+    m_PolygonSim.Resize(m_NumPolygons);
 
     std::mt19937 gen; // Standard mersenne_twister_engine. Use default seed
                       // to generate consistent distribution.
@@ -531,23 +886,39 @@ void Tutorial10_DataStreaming::InitializePolygons()
 
     for (int Polygon = 0; Polygon < m_NumPolygons; ++Polygon)
     {
-        auto& CurrInst     = m_Polygons[Polygon];
-        CurrInst.Size      = scale_distr(gen);
-        CurrInst.Angle     = angle_distr(gen);
-        CurrInst.Pos.x     = pos_distr(gen);
-        CurrInst.Pos.y     = pos_distr(gen);
-        CurrInst.MoveDir.x = move_dir_distr(gen);
-        CurrInst.MoveDir.y = move_dir_distr(gen);
-        CurrInst.RotSpeed  = rot_distr(gen);
+        auto& CurrInst                 = m_Polygons[Polygon];
+        CurrInst.Size                  = scale_distr(gen);
+        m_PolygonSim.Angle[Polygon]    = angle_distr(gen);
+        m_PolygonSim.PosX[Polygon]     = pos_distr(gen);
+        m_PolygonSim.PosY[Polygon]     = pos_distr(gen);
+        m_PolygonSim.MoveDirX[Polygon] = move_dir_distr(gen);
+        m_PolygonSim.MoveDirY[Polygon] = move_dir_distr(gen);
+        m_PolygonSim.RotSpeed[Polygon] = rot_distr(gen);
         // Texture array index
         CurrInst.TextureInd = tex_distr(gen);
         CurrInst.StateInd   = state_distr(gen);
         CurrInst.NumVerts   = num_verts_distr(gen);
     }
+
+    ComputeStreamingFrameSize();
 }
 
-std::pair<Diligent::Uint32, Diligent::Uint32> Tutorial10_DataStreaming::WritePolygon(const PolygonGeometry& PolygonGeo, IDeviceContext* pCtx, size_t CtxNum)
+Tutorial10_DataStreaming::StreamedPolygon Tutorial10_DataStreaming::WritePolygon(const PolygonGeometry& PolygonGeo, IDeviceContext* pCtx, size_t CtxNum)
 {
+    if (m_UseSharedRing)
+    {
+        // The rings may be replaced by larger ones between frames, so every allocation returns its buffer
+        const auto VBAlloc = m_SharedVB->Allocate(PolygonGeo.Verts.size() * sizeof(float2));
+        const auto IBAlloc = m_SharedIB->Allocate(PolygonGeo.Inds.size() * sizeof(Uint32));
+        if (VBAlloc.pBuffer == nullptr || IBAlloc.pBuffer == nullptr)
+            return {};
+
+        memcpy(VBAlloc.pCPUAddress, PolygonGeo.Verts.data(), PolygonGeo.Verts.size() * sizeof(float2));
+        memcpy(IBAlloc.pCPUAddress, PolygonGeo.Inds.data(), PolygonGeo.Inds.size() * sizeof(Uint32));
+
+        return {VBAlloc.pBuffer, VBAlloc.Offset, IBAlloc.pBuffer, IBAlloc.Offset};
+    }
+
     // Request memory for vertices and indices
     auto  VBOffset   = m_StreamingVB->Allocate(pCtx, static_cast<Uint32>(PolygonGeo.Verts.size()) * sizeof(float2), CtxNum);
     auto  IBOffset   = m_StreamingIB->Allocate(pCtx, static_cast<Uint32>(PolygonGeo.Inds.size()) * sizeof(Uint32), CtxNum);
@@ -559,32 +930,18 @@ std::pair<Diligent::Uint32, Diligent::Uint32> Tutorial10_DataStreaming::WritePol
     m_StreamingVB->Release(CtxNum);
     m_StreamingIB->Release(CtxNum);
 
-    return {VBOffset, IBOffset};
+    return {m_StreamingVB->GetBuffer(), VBOffset, m_StreamingIB->GetBuffer(), IBOffset};
 }
 
-void Tutorial10_DataStreaming::UpdatePolygons(float elapsedTime)
+void Tutorial10_DataStreaming::UpdatePolygons(Uint32 Subset, Uint32 StartPolygon, Uint32 EndPolygon)
 {
-    std::mt19937 gen; // Standard mersenne_twister_engine. Use default seed
-                      // to generate consistent distribution.
+    const auto StartTime = std::chrono::high_resolution_clock::now();
 
-    std::uniform_real_distribution<float> rot_distr(-PI_F * 0.5f, +PI_F * 0.5f);
-    for (int Polygon = 0; Polygon < m_NumPolygons; ++Polygon)
-    {
-        auto& CurrInst = m_Polygons[Polygon];
-        CurrInst.Angle += CurrInst.RotSpeed * elapsedTime;
-        if (std::abs(CurrInst.Pos.x + CurrInst.MoveDir.x * elapsedTime) > 0.95)
-        {
-            CurrInst.MoveDir.x *= -1.f;
-            CurrInst.RotSpeed = rot_distr(gen);
-        }
-        CurrInst.Pos.x += CurrInst.MoveDir.x * elapsedTime;
-        if (std::abs(CurrInst.Pos.y + CurrInst.MoveDir.y * elapsedTime) > 0.95)
-        {
-            CurrInst.MoveDir.y *= -1.f;
-            CurrInst.RotSpeed = rot_distr(gen);
-        }
-        CurrInst.Pos.y += CurrInst.MoveDir.y * elapsedTime;
-    }
+    // Every subset only updates the polygons it renders, so no synchronization is needed
+    UpdatePolygonRange(m_PolygonSim, m_SimElapsedTime, m_SimStep, StartPolygon, EndPolygon);
+
+    const auto EndTime        = std::chrono::high_resolution_clock::now();
+    m_SubsetSimTimeNs[Subset] = std::chrono::duration<double, std::nano>(EndTime - StartTime).count();
 }
 
 void Tutorial10_DataStreaming::StartWorkerThreads(size_t NumThreads)
@@ -681,6 +1038,12 @@ void Tutorial10_DataStreaming::RenderSubset(IDeviceContext* pCtx, Uint32 Subset)
     const Uint32 SusbsetSize   = TotalBatches / NumSubsets;
     const Uint32 StartBatch    = SusbsetSize * Subset;
     const Uint32 EndBatch      = (Subset < NumSubsets - 1) ? SusbsetSize * (Subset + 1) : TotalBatches;
+
+    UpdatePolygons(Subset, std::min(StartBatch * m_BatchSize, TotalPolygons), std::min(EndBatch * m_BatchSize, TotalPolygons));
+
+    auto& Stats = m_SubsetStreamingStats[Subset];
+    Stats       = {};
+
     for (Uint32 batch = StartBatch; batch < EndBatch; ++batch)
     {
         const Uint32 StartInst = batch * m_BatchSize;
@@ -691,23 +1054,34 @@ void Tutorial10_DataStreaming::RenderSubset(IDeviceContext* pCtx, Uint32 Subset)
         pCtx->SetPipelineState(m_pPSO[UseBatch ? 1 : 0][StateInd]);
 
         const auto&  PolygonGeo = m_PolygonGeo[m_Polygons[StartInst].NumVerts];
-        auto         Offsets    = WritePolygon(PolygonGeo, pCtx, Subset);
-        const Uint64 offsets[]  = {Offsets.first, 0};
-        IBuffer*     pBuffs[]   = {m_StreamingVB->GetBuffer(), m_BatchDataBuffer};
+        const auto   Streamed   = WritePolygon(PolygonGeo, pCtx, Subset);
+        if (Streamed.pVB == nullptr)
+            continue;
+
+        const Uint64 offsets[]  = {Streamed.VBOffset, 0};
+        IBuffer*     pBuffs[]   = {Streamed.pVB, m_BatchDataBuffer};
         pCtx->SetVertexBuffers(0, UseBatch ? 2 : 1, pBuffs, offsets, RESOURCE_STATE_TRANSITION_MODE_VERIFY, SET_VERTEX_BUFFERS_FLAG_RESET);
 
-        pCtx->SetIndexBuffer(m_StreamingIB->GetBuffer(), Offsets.second, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+        pCtx->SetIndexBuffer(Streamed.pIB, Streamed.IBOffset, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+        Stats.BytesWritten += static_cast<double>(PolygonGeo.Verts.size() * sizeof(float2) + PolygonGeo.Inds.size() * sizeof(Uint32));
 
         MapHelper<InstanceData> BatchData;
         if (UseBatch)
         {
             pCtx->CommitShaderResources(m_BatchSRB, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
-            BatchData.Map(pCtx, m_BatchDataBuffer, MAP_WRITE, MAP_FLAG_DISCARD);
+            {
+                ScopedMapTimer Timer{Stats.MapTimeMs};
+                BatchData.Map(pCtx, m_BatchDataBuffer, MAP_WRITE, MAP_FLAG_DISCARD);
+            }
+            Stats.NumMaps      += 1;
+            Stats.NumDiscards  += 1;
+            Stats.BytesWritten += static_cast<double>(sizeof(InstanceData) * (EndInst - StartInst));
         }
 
         for (Uint32 inst = StartInst; inst < EndInst; ++inst)
         {
             const auto& CurrInstData = m_Polygons[inst];
+            const auto  Angle        = m_PolygonSim.Angle[inst];
             // Shader resources have been explicitly transitioned to correct states, so
             // RESOURCE_STATE_TRANSITION_MODE_TRANSITION mode is not needed.
             // Instead, we use RESOURCE_STATE_TRANSITION_MODE_VERIFY mode to
@@ -724,8 +1098,8 @@ void Tutorial10_DataStreaming::RenderSubset(IDeviceContext* pCtx, Uint32 Subset)
                     0.f,               CurrInstData.Size
                 };
                 // clang-format on
-                float    sinAngle = sinf(CurrInstData.Angle);
-                float    cosAngle = cosf(CurrInstData.Angle);
+                float    sinAngle = sinf(Angle);
+                float    cosAngle = cosf(Angle);
                 float2x2 RotMatr(cosAngle, -sinAngle,
                                  sinAngle, cosAngle);
 
@@ -737,7 +1111,7 @@ void Tutorial10_DataStreaming::RenderSubset(IDeviceContext* pCtx, Uint32 Subset)
                 {
                     auto& CurrPolygon                   = BatchData[inst - StartInst];
                     CurrPolygon.PolygonRotationAndScale = PolygonRotationAndScale;
-                    CurrPolygon.PolygonCenter           = CurrInstData.Pos;
+                    CurrPolygon.PolygonCenter           = float2{m_PolygonSim.PosX[inst], m_PolygonSim.PosY[inst]};
                     CurrPolygon.TexArrInd               = static_cast<float>(CurrInstData.TextureInd);
                 }
                 else
@@ -749,25 +1123,43 @@ void Tutorial10_DataStreaming::RenderSubset(IDeviceContext* pCtx, Uint32 Subset)
                     };
 
                     // Map the buffer and write current world-view-projection matrix
-                    MapHelper<PolygonAttribs> InstData(pCtx, m_PolygonAttribsCB, MAP_WRITE, MAP_FLAG_DISCARD);
+                    MapHelper<PolygonAttribs> InstData;
+                    {
+                        ScopedMapTimer Timer{Stats.MapTimeMs};
+                        InstData.Map(pCtx, m_PolygonAttribsCB, MAP_WRITE, MAP_FLAG_DISCARD);
+                    }
+                    Stats.NumMaps      += 1;
+                    Stats.NumDiscards  += 1;
+                    Stats.BytesWritten += static_cast<double>(sizeof(PolygonAttribs));
 
                     InstData->g_PolygonRotationAndScale = PolygonRotationAndScale;
-                    InstData->g_PolygonCenter.x         = CurrInstData.Pos.x;
-                    InstData->g_PolygonCenter.y         = CurrInstData.Pos.y;
+                    InstData->g_PolygonCenter.x         = m_PolygonSim.PosX[inst];
+                    InstData->g_PolygonCenter.y         = m_PolygonSim.PosY[inst];
+
+                    ScopedMapTimer Timer{Stats.MapTimeMs};
+                    InstData.Unmap();
                 }
             }
         }
 
         if (UseBatch)
+        {
+            ScopedMapTimer Timer{Stats.MapTimeMs};
             BatchData.Unmap();
+        }
 
         DrawAttrs.NumIndices   = static_cast<Uint32>(PolygonGeo.Inds.size());
         DrawAttrs.NumInstances = EndInst - StartInst;
         pCtx->DrawIndexed(DrawAttrs);
     }
 
-    m_StreamingVB->Flush(Subset);
-    m_StreamingIB->Flush(Subset);
+    if (!m_UseSharedRing)
+    {
+        m_StreamingVB->Flush(Subset);
+        m_StreamingIB->Flush(Subset);
+    }
+    m_StreamingVB->CollectMapStats(Subset, Stats);
+    m_StreamingIB->CollectMapStats(Subset, Stats);
 }
 
 // Render a frame
@@ -788,6 +1180,17 @@ void Tutorial10_DataStreaming::Render()
     m_StreamingIB->AllowPersistentMapping(m_bAllowPersistentMap);
     m_StreamingVB->AllowPersistentMapping(m_bAllowPersistentMap);
 
+    if (m_UseSharedRing)
+    {
+        m_SharedVB->BeginFrame(m_pImmediateContext, m_FrameVBSize);
+        m_SharedIB->BeginFrame(m_pImmediateContext, m_FrameIBSize);
+    }
+
+    // Command lists recorded by the worker threads are executed by the immediate context,
+    // so the query covers the draw passes of all subsets
+    if (m_pDrawDuration)
+        m_pDrawDuration->Begin(m_pImmediateContext);
+
     if (!m_WorkerThreads.empty())
     {
         m_NumThreadsCompleted.store(0);
@@ -820,6 +1223,99 @@ void Tutorial10_DataStreaming::Render()
         m_NumThreadsReady.store(0);
         m_GotoNextFrameSignal.Trigger(true);
     }
+
+    if (m_pDrawDuration)
+    {
+        double Duration = 0;
+        if (m_pDrawDuration->End(m_pImmediateContext, Duration))
+        {
+            m_GPUTimeMs     = Duration * 1000.0;
+            m_GPUTimeAccum += m_GPUTimeMs;
+            ++m_GPUTimeSamples;
+        }
+    }
+
+    if (m_UseSharedRing)
+    {
+        m_SharedVB->EndFrame(m_pImmediateContext);
+        m_SharedIB->EndFrame(m_pImmediateContext);
+    }
+
+    // All subsets have completed, so their simulation times can be safely read.
+    // Wall time of the simulation step is defined by the slowest subset.
+    double         SimWallTimeNs = 0;
+    double         SimCPUTimeNs  = 0;
+    StreamingStats FrameStats;
+    for (size_t Subset = 0; Subset < 1 + m_WorkerThreads.size(); ++Subset)
+    {
+        SimWallTimeNs = std::max(SimWallTimeNs, m_SubsetSimTimeNs[Subset]);
+        SimCPUTimeNs += m_SubsetSimTimeNs[Subset];
+        FrameStats   += m_SubsetStreamingStats[Subset];
+    }
+    m_SimWallTimeAccum += SimWallTimeNs * 1e-6;
+    m_SimCPUTimeAccum  += SimCPUTimeNs * 1e-6;
+    m_StreamingAccum   += FrameStats;
+    ++m_StatsFramesAccum;
+
+    if (!m_ReportPath.empty() && m_ReportRows.size() < static_cast<size_t>(m_ReportFrames))
+    {
+        ReportRow Row;
+        Row.Mode        = GetStreamingModeName();
+        Row.NumPolygons = m_NumPolygons;
+        Row.BatchSize   = m_BatchSize;
+        Row.NumThreads  = static_cast<int>(m_WorkerThreads.size());
+        Row.FrameTimeMs = m_FrameTimeMs;
+        Row.GPUTimeMs   = m_GPUTimeMs;
+        Row.Stats       = FrameStats;
+        m_ReportRows.push_back(Row);
+
+        if (m_ReportRows.size() == static_cast<size_t>(m_ReportFrames))
+            WriteReport();
+    }
+}
+
+const char* Tutorial10_DataStreaming::GetStreamingModeName() const
+{
+    if (m_UseSharedRing)
+        return "shared_ring";
+    return m_bAllowPersistentMap ? "persistent_map" : "map_unmap";
+}
+
+void Tutorial10_DataStreaming::WriteReport()
+{
+    std::ofstream Report{m_ReportPath};
+    if (!Report)
+    {
+        LOG_ERROR_MESSAGE("Failed to open streaming report file '", m_ReportPath, "'");
+        return;
+    }
+
+    const auto  DeviceType = m_pDevice->GetDeviceInfo().Type;
+    const auto& Adapter    = m_pDevice->GetAdapterInfo();
+
+    // GPU time is empty until the first query result is available
+    Report << "frame,backend,adapter,mode,polygons,batch_size,threads,frame_time_ms,bytes_written,map_calls,discards,map_time_ms,gpu_time_ms\n";
+    for (size_t Frame = 0; Frame < m_ReportRows.size(); ++Frame)
+    {
+        const auto& Row = m_ReportRows[Frame];
+        Report << Frame << ','
+               << GetRenderDeviceTypeShortString(DeviceType) << ','
+               << '"' << Adapter.Description << '"' << ','
+               << Row.Mode << ','
+               << Row.NumPolygons << ','
+               << Row.BatchSize << ','
+               << Row.NumThreads << ','
+               << Row.FrameTimeMs << ','
+               << static_cast<Uint64>(Row.Stats.BytesWritten) << ','
+               << static_cast<Uint32>(Row.Stats.NumMaps) << ','
+               << static_cast<Uint32>(Row.Stats.NumDiscards) << ','
+               << Row.Stats.MapTimeMs << ',';
+        if (Row.GPUTimeMs >= 0)
+            Report << Row.GPUTimeMs;
+        Report << '\n';
+    }
+
+    LOG_INFO_MESSAGE("Streaming report (", m_ReportRows.size(), " frames) written to ", m_ReportPath);
 }
 
 void Tutorial10_DataStreaming::CreateInstanceBuffer()
@@ -841,7 +1337,36 @@ void Tutorial10_DataStreaming::Update(double CurrTime, double ElapsedTime)
     SampleBase::Update(CurrTime, ElapsedTime);
     UpdateUI();
 
-    UpdatePolygons(static_cast<float>(std::min(ElapsedTime, 0.25)));
+    m_FrameTimeMs = ElapsedTime * 1000.0;
+
+    // Polygons are updated by the subsets in Render()
+    m_SimElapsedTime = static_cast<float>(std::min(ElapsedTime, 0.25));
+    ++m_SimStep;
+
+    // Average the simulation and streaming statistics over half a second to get stable readings
+    if (CurrTime - m_StatsStartTime >= 0.5)
+    {
+        if (m_StatsFramesAccum > 0)
+        {
+            const auto Scale = 1.0 / m_StatsFramesAccum;
+
+            m_SimWallTimeMs                  = m_SimWallTimeAccum * Scale;
+            m_SimCPUTimeMs                   = m_SimCPUTimeAccum * Scale;
+            m_AvgStreamingStats.BytesWritten = m_StreamingAccum.BytesWritten * Scale;
+            m_AvgStreamingStats.MapTimeMs    = m_StreamingAccum.MapTimeMs * Scale;
+            m_AvgStreamingStats.NumMaps      = m_StreamingAccum.NumMaps * Scale;
+            m_AvgStreamingStats.NumDiscards  = m_StreamingAccum.NumDiscards * Scale;
+        }
+        if (m_GPUTimeSamples > 0)
+            m_AvgGPUTimeMs = m_GPUTimeAccum / m_GPUTimeSamples;
+        m_SimWallTimeAccum = 0;
+        m_SimCPUTimeAccum  = 0;
+        m_StreamingAccum   = {};
+        m_GPUTimeAccum     = 0;
+        m_GPUTimeSamples   = 0;
+        m_StatsFramesAccum = 0;
+        m_StatsStartTime   = CurrTime;
+    }
 }
 
 } // namespace Diligent
@@ -32,13 +32,35 @@
 #include <vector>
 #include <thread>
 #include <mutex>
+#include <string>
 #include "SampleBase.hpp"
 #include "BasicMath.hpp"
 #include "ThreadSignal.hpp"
+#include "DurationQueryHelper.hpp"
+#include "PolygonSimulation.hpp"
 
 namespace Diligent
 {
 
+// Data written to mapped memory and the cost of mapping it. Counters are stored as doubles
+// so that the same structure holds the per-frame averages.
+struct StreamingStats
+{
+    double BytesWritten = 0;
+    double MapTimeMs    = 0;
+    double NumMaps      = 0;
+    double NumDiscards  = 0;
+
+    StreamingStats& operator+=(const StreamingStats& rhs)
+    {
+        BytesWritten += rhs.BytesWritten;
+        MapTimeMs    += rhs.MapTimeMs;
+        NumMaps      += rhs.NumMaps;
+        NumDiscards  += rhs.NumDiscards;
+        return *this;
+    }
+};
+
 class Tutorial10_DataStreaming final : public SampleBase
 {
 public:
@@ -62,10 +84,14 @@ private:
 
     void InitializePolygons();
     void InitializePolygonGeometry();
+    void ComputeStreamingFrameSize();
     void CreateInstanceBuffer();
-    void UpdatePolygons(float elapsedTime);
+    void UpdatePolygons(Uint32 Subset, Uint32 StartPolygon, Uint32 EndPolygon);
     void StartWorkerThreads(size_t NumThreads);
     void StopWorkerThreads();
+    void WriteReport();
+
+    const char* GetStreamingModeName() const;
 
     template <bool UseBatch>
     void RenderSubset(IDeviceContext* pCtx, Uint32 Subset);
@@ -93,13 +119,22 @@ private:
     std::unique_ptr<class StreamingBuffer> m_StreamingVB;
     std::unique_ptr<class StreamingBuffer> m_StreamingIB;
 
+    // Rings shared by all contexts, see SharedStreamingRing. They grow at the beginning
+    // of the frame when the geometry streamed per frame does not fit.
+    static constexpr const Uint64              InitialSharedRingSize = 1 << 20;
+    std::unique_ptr<class SharedStreamingRing> m_SharedVB;
+    std::unique_ptr<class SharedStreamingRing> m_SharedIB;
+    bool                                       m_UseSharedRing = false;
+    Uint64                                     m_FrameVBSize   = 0;
+    Uint64                                     m_FrameIBSize   = 0;
+
     static constexpr int                  NumTextures = 4;
     RefCntAutoPtr<IShaderResourceBinding> m_SRB[NumTextures];
     RefCntAutoPtr<IShaderResourceBinding> m_BatchSRB;
     RefCntAutoPtr<ITextureView>           m_TextureSRV[NumTextures];
     RefCntAutoPtr<ITextureView>           m_TexArraySRV;
 
-    static constexpr int MaxPolygons  = 100000;
+    static constexpr int MaxPolygons  = 1000000;
     static constexpr int MaxBatchSize = 100;
 
     int m_NumPolygons = 1000;
@@ -108,19 +143,62 @@ private:
     int m_MaxThreads       = 8;
     int m_NumWorkerThreads = 4;
 
+    // Attributes that do not change during the simulation
     struct PolygonData
     {
-        float2 Pos;
-        float2 MoveDir;
-        float  Size       = 0;
-        float  Angle      = 0;
-        float  RotSpeed   = 0;
-        int    TextureInd = 0;
-        int    StateInd   = 0;
-        int    NumVerts   = 0;
+        float Size       = 0;
+        int   TextureInd = 0;
+        int   StateInd   = 0;
+        int   NumVerts   = 0;
     };
     std::vector<PolygonData> m_Polygons;
 
+    // Positions, directions and rotations are updated every frame by the subsets
+    // that render the polygons, see UpdatePolygons()
+    PolygonSimulationData m_PolygonSim;
+
+    float  m_SimElapsedTime = 0;
+    Uint32 m_SimStep        = 0;
+
+    // Simulation time of every subset in the last frame, in nanoseconds
+    std::vector<double> m_SubsetSimTimeNs;
+
+    // Streaming statistics of every subset in the last frame
+    std::vector<StreamingStats> m_SubsetStreamingStats;
+
+    // GPU time of the draw passes. Results become available a few frames later.
+    std::unique_ptr<DurationQueryHelper> m_pDrawDuration;
+    double                               m_GPUTimeMs = -1;
+
+    double m_FrameTimeMs      = 0;
+    double m_SimWallTimeAccum = 0;
+    double m_SimCPUTimeAccum  = 0;
+    double m_GPUTimeAccum     = 0;
+    int    m_GPUTimeSamples   = 0;
+    int    m_StatsFramesAccum = 0;
+    double m_StatsStartTime   = 0;
+    double m_SimWallTimeMs    = 0;
+    double m_SimCPUTimeMs     = 0;
+    double m_AvgGPUTimeMs     = -1;
+
+    StreamingStats m_StreamingAccum;
+    StreamingStats m_AvgStreamingStats;
+
+    // CSV report requested by --report command line option
+    struct ReportRow
+    {
+        const char*    Mode        = nullptr;
+        int            NumPolygons = 0;
+        int            BatchSize   = 0;
+        int            NumThreads  = 0;
+        double         FrameTimeMs = 0;
+        double         GPUTimeMs   = -1;
+        StreamingStats Stats;
+    };
+    std::string            m_ReportPath;
+    int                    m_ReportFrames = 300;
+    std::vector<ReportRow> m_ReportRows;
+
     struct InstanceData
     {
         float4 PolygonRotationAndScale;
@@ -137,7 +215,15 @@ private:
     };
     std::vector<PolygonGeometry> m_PolygonGeo;
     bool                         m_bAllowPersistentMap = false;
-    std::pair<Uint32, Uint32>    WritePolygon(const PolygonGeometry& PolygonGeo, IDeviceContext* pCtx, size_t CtxNum);
+
+    struct StreamedPolygon
+    {
+        IBuffer* pVB      = nullptr;
+        Uint64   VBOffset = 0;
+        IBuffer* pIB      = nullptr;
+        Uint64   IBOffset = 0;
+    };
+    StreamedPolygon WritePolygon(const PolygonGeometry& PolygonGeo, IDeviceContext* pCtx, size_t CtxNum);
 };
 
 } // namespace Diligent